@@ -0,0 +1,686 @@
+#include "DeviceAllocator.hpp"
+#include "Defines.hpp"
+
+#include <bit>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include <algorithm>
+
+// Free lists: the first level splits sizes by power of two, the second level splits each power
+// of two range in SL_COUNT lists. Sizes and offsets are multiples of ALLOCATION_GRANULE.
+static constexpr uint32_t SL_BITS = 4;
+static constexpr uint32_t SL_COUNT = 1u << SL_BITS;
+static constexpr uint32_t FL_COUNT = 64 - SL_BITS;
+static constexpr VkDeviceSize ALLOCATION_GRANULE = 16;
+
+static constexpr uint32_t INVALID_INDEX = UINT32_MAX;
+
+struct MemoryRegion
+{
+    VkDeviceSize offset;
+    VkDeviceSize size;
+    VkDeviceSize alignment;
+    uint32_t prevPhysical;  // neighbours in address order
+    uint32_t nextPhysical;
+    uint32_t prevFree;      // neighbours in the free list, free regions only
+    uint32_t nextFree;
+    bool free;
+    void* userData;
+    VkDeviceSize requestedSize; // allocated regions only, for the stats
+    MemoryCategory category;
+};
+
+struct MemoryBlock
+{
+    VkDeviceMemory memory = VK_NULL_HANDLE;
+    VkDeviceSize size = 0;
+    char* mappedData = nullptr;
+    bool dedicated = false;
+    VkDeviceSize usedBytes = 0;
+    uint32_t allocationCount = 0;
+
+    uint64_t flBitmap = 0;
+    uint32_t slBitmaps[FL_COUNT] {};
+    uint32_t freeHeads[FL_COUNT][SL_COUNT];
+
+    std::vector<MemoryRegion> regions;
+    std::vector<uint32_t> unusedRegions;
+};
+
+struct MemoryPool
+{
+    uint32_t memoryTypeIndex;
+    bool linear;
+    VkDeviceSize blockSize;
+    std::vector<std::unique_ptr<MemoryBlock>> blocks; // released blocks leave a null slot
+};
+
+static struct
+{
+    std::mutex mutex;
+    VkDevice device = VK_NULL_HANDLE;
+    VkPhysicalDeviceMemoryProperties memoryProperties {};
+    VkDeviceSize nonCoherentAtomSize = 1;
+    uint32_t maxMemoryAllocationCount = 0;
+    uint32_t memoryAllocationCount = 0; // live VkDeviceMemory objects
+
+    std::unordered_map<uint64_t, uint32_t> memoryTypeIndices; // (memoryTypeBits, properties) -> index
+    std::vector<MemoryPool> pools;                            // memoryTypeCount * 2, optimal then linear
+    DeviceMemoryStats categoryStats[static_cast<uint32_t>(MemoryCategory::eCount)] {};
+} allocator;
+
+static const char* getCategoryName(MemoryCategory category)
+{
+    switch (category)
+    {
+        case MemoryCategory::eStaging:    return "staging";
+        case MemoryCategory::eUniform:    return "uniform";
+        case MemoryCategory::eGeometry:   return "geometry";
+        case MemoryCategory::eAttachment: return "attachment";
+        default:                          return "other";
+    }
+}
+
+static VkDeviceSize alignUp(VkDeviceSize value, VkDeviceSize alignment)
+{
+    return (value + alignment - 1) & ~(alignment - 1);
+}
+
+static uint32_t getMemoryTypeIndex(uint32_t memoryTypeBits, VkMemoryPropertyFlags memoryProperties)
+{
+    const uint64_t key = (uint64_t(memoryTypeBits) << 32) | memoryProperties;
+    const auto cached = allocator.memoryTypeIndices.find(key);
+    if (cached != allocator.memoryTypeIndices.end())
+        return cached->second;
+
+    for (uint32_t i = 0; i < allocator.memoryProperties.memoryTypeCount; i++)
+    {
+        if ((memoryTypeBits & (1u << i)) && (allocator.memoryProperties.memoryTypes[i].propertyFlags & memoryProperties) == memoryProperties)
+        {
+            allocator.memoryTypeIndices.emplace(key, i);
+            return i;
+        }
+    }
+
+    assert(false && "Could not find suitable memory type!");
+    return 0;
+}
+
+// List a free region of this size belongs to
+static void mapFreeList(VkDeviceSize size, uint32_t& fl, uint32_t& sl)
+{
+    const uint64_t granules = size / ALLOCATION_GRANULE;
+    const uint32_t log2 = 63 - std::countl_zero(granules);
+    if (log2 < SL_BITS)
+    {
+        fl = 0;
+        sl = static_cast<uint32_t>(granules);
+    }
+    else
+    {
+        fl = log2 - SL_BITS + 1;
+        sl = static_cast<uint32_t>(granules >> (log2 - SL_BITS)) & (SL_COUNT - 1);
+    }
+}
+
+// First list whose regions are all at least this large
+static void mapSearchList(VkDeviceSize size, uint32_t& fl, uint32_t& sl)
+{
+    uint64_t granules = size / ALLOCATION_GRANULE;
+    const uint32_t log2 = 63 - std::countl_zero(granules);
+    if (log2 >= SL_BITS)
+        granules += (uint64_t(1) << (log2 - SL_BITS)) - 1;
+
+    mapFreeList(granules * ALLOCATION_GRANULE, fl, sl);
+}
+
+static void insertFreeRegion(MemoryBlock& block, uint32_t regionIndex)
+{
+    MemoryRegion& region = block.regions[regionIndex];
+    uint32_t fl, sl;
+    mapFreeList(region.size, fl, sl);
+
+    region.free = true;
+    region.prevFree = INVALID_INDEX;
+    region.nextFree = block.freeHeads[fl][sl];
+    if (region.nextFree != INVALID_INDEX)
+        block.regions[region.nextFree].prevFree = regionIndex;
+
+    block.freeHeads[fl][sl] = regionIndex;
+    block.flBitmap |= uint64_t(1) << fl;
+    block.slBitmaps[fl] |= 1u << sl;
+}
+
+static void removeFreeRegion(MemoryBlock& block, uint32_t regionIndex)
+{
+    MemoryRegion& region = block.regions[regionIndex];
+    uint32_t fl, sl;
+    mapFreeList(region.size, fl, sl);
+
+    if (region.prevFree != INVALID_INDEX)
+        block.regions[region.prevFree].nextFree = region.nextFree;
+    else
+        block.freeHeads[fl][sl] = region.nextFree;
+
+    if (region.nextFree != INVALID_INDEX)
+        block.regions[region.nextFree].prevFree = region.prevFree;
+
+    if (block.freeHeads[fl][sl] == INVALID_INDEX)
+    {
+        block.slBitmaps[fl] &= ~(1u << sl);
+        if (block.slBitmaps[fl] == 0)
+            block.flBitmap &= ~(uint64_t(1) << fl);
+    }
+
+    region.free = false;
+}
+
+static uint32_t createRegion(MemoryBlock& block, VkDeviceSize offset, VkDeviceSize size)
+{
+    uint32_t regionIndex;
+    if (!block.unusedRegions.empty())
+    {
+        regionIndex = block.unusedRegions.back();
+        block.unusedRegions.pop_back();
+    }
+    else
+    {
+        regionIndex = static_cast<uint32_t>(block.regions.size());
+        block.regions.emplace_back();
+    }
+
+    block.regions[regionIndex] = MemoryRegion {
+        .offset = offset,
+        .size = size,
+        .alignment = ALLOCATION_GRANULE,
+        .prevPhysical = INVALID_INDEX,
+        .nextPhysical = INVALID_INDEX,
+        .prevFree = INVALID_INDEX,
+        .nextFree = INVALID_INDEX,
+        .free = false,
+        .userData = nullptr,
+        .requestedSize = 0,
+        .category = MemoryCategory::eOther,
+    };
+
+    return regionIndex;
+}
+
+// Splits the region, the new region takes the part starting at offset + size
+static uint32_t splitRegion(MemoryBlock& block, uint32_t regionIndex, VkDeviceSize size)
+{
+    const uint32_t tailIndex = createRegion(block, block.regions[regionIndex].offset + size, block.regions[regionIndex].size - size);
+
+    MemoryRegion& region = block.regions[regionIndex];
+    MemoryRegion& tail = block.regions[tailIndex];
+    tail.prevPhysical = regionIndex;
+    tail.nextPhysical = region.nextPhysical;
+    if (region.nextPhysical != INVALID_INDEX)
+        block.regions[region.nextPhysical].prevPhysical = tailIndex;
+
+    region.nextPhysical = tailIndex;
+    region.size = size;
+
+    return tailIndex;
+}
+
+// Merges the region with the next one, which is released
+static void mergeWithNext(MemoryBlock& block, uint32_t regionIndex)
+{
+    MemoryRegion& region = block.regions[regionIndex];
+    const uint32_t nextIndex = region.nextPhysical;
+    const MemoryRegion& next = block.regions[nextIndex];
+
+    region.size += next.size;
+    region.nextPhysical = next.nextPhysical;
+    if (next.nextPhysical != INVALID_INDEX)
+        block.regions[next.nextPhysical].prevPhysical = regionIndex;
+
+    block.unusedRegions.push_back(nextIndex);
+}
+
+// Free region of at least size bytes, INVALID_INDEX if there is none
+static uint32_t findFreeRegion(const MemoryBlock& block, VkDeviceSize size)
+{
+    uint32_t fl, sl;
+    mapSearchList(size, fl, sl);
+    if (fl < FL_COUNT)
+    {
+        uint32_t slMap = block.slBitmaps[fl] & (~0u << sl);
+        if (slMap == 0)
+        {
+            const uint64_t flMap = (fl + 1 < 64) ? (block.flBitmap & (~uint64_t(0) << (fl + 1))) : 0;
+            if (flMap != 0)
+            {
+                fl = std::countr_zero(flMap);
+                slMap = block.slBitmaps[fl];
+            }
+        }
+
+        if (slMap != 0)
+            return block.freeHeads[fl][std::countr_zero(slMap)];
+    }
+
+    // the search rounds up past the list size falls in, whose regions can still be large enough,
+    // e.g. the only region of a dedicated block, which is exactly as large as the allocation
+    mapFreeList(size, fl, sl);
+    for (uint32_t r = block.freeHeads[fl][sl]; r != INVALID_INDEX; r = block.regions[r].nextFree)
+    {
+        if (block.regions[r].size >= size)
+            return r;
+    }
+
+    return INVALID_INDEX;
+}
+
+static uint32_t allocateFromBlock(MemoryBlock& block, VkDeviceSize size, VkDeviceSize alignment)
+{
+    // a region that fits size + alignment padding fits wherever the region starts
+    const VkDeviceSize searchSize = size + alignment - ALLOCATION_GRANULE;
+    if (searchSize > block.size)
+        return INVALID_INDEX;
+
+    uint32_t regionIndex = findFreeRegion(block, searchSize);
+    if (regionIndex == INVALID_INDEX)
+        return INVALID_INDEX;
+
+    removeFreeRegion(block, regionIndex);
+
+    const VkDeviceSize padding = alignUp(block.regions[regionIndex].offset, alignment) - block.regions[regionIndex].offset;
+    if (padding > 0)
+    {
+        const uint32_t alignedIndex = splitRegion(block, regionIndex, padding);
+        insertFreeRegion(block, regionIndex);
+        regionIndex = alignedIndex;
+    }
+
+    if (block.regions[regionIndex].size > size)
+    {
+        const uint32_t tailIndex = splitRegion(block, regionIndex, size);
+        insertFreeRegion(block, tailIndex);
+    }
+
+    block.regions[regionIndex].alignment = alignment;
+    block.usedBytes += size;
+    block.allocationCount++;
+
+    return regionIndex;
+}
+
+static void freeRegion(MemoryBlock& block, uint32_t regionIndex)
+{
+    block.usedBytes -= block.regions[regionIndex].size;
+    block.allocationCount--;
+    block.regions[regionIndex].userData = nullptr;
+
+    const uint32_t nextIndex = block.regions[regionIndex].nextPhysical;
+    if (nextIndex != INVALID_INDEX && block.regions[nextIndex].free)
+    {
+        removeFreeRegion(block, nextIndex);
+        mergeWithNext(block, regionIndex);
+    }
+
+    const uint32_t prevIndex = block.regions[regionIndex].prevPhysical;
+    if (prevIndex != INVALID_INDEX && block.regions[prevIndex].free)
+    {
+        removeFreeRegion(block, prevIndex);
+        mergeWithNext(block, prevIndex);
+        regionIndex = prevIndex;
+    }
+
+    insertFreeRegion(block, regionIndex);
+}
+
+static uint32_t createBlock(MemoryPool& pool, VkDeviceSize size, bool dedicated)
+{
+    assert(allocator.memoryAllocationCount < allocator.maxMemoryAllocationCount);
+
+    auto block = std::make_unique<MemoryBlock>();
+    block->size = size;
+    block->dedicated = dedicated;
+    for (auto& heads : block->freeHeads)
+        std::fill(std::begin(heads), std::end(heads), INVALID_INDEX);
+
+    const VkMemoryAllocateInfo allocInfo {
+        .sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO,
+        .allocationSize = size,
+        .memoryTypeIndex = pool.memoryTypeIndex,
+    };
+
+    VK_CHECK(vkAllocateMemory(allocator.device, &allocInfo, nullptr, &block->memory));
+    allocator.memoryAllocationCount++;
+
+    if (allocator.memoryProperties.memoryTypes[pool.memoryTypeIndex].propertyFlags & VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT)
+    {
+        void* mappedData = nullptr;
+        VK_CHECK(vkMapMemory(allocator.device, block->memory, 0, VK_WHOLE_SIZE, 0, &mappedData));
+        block->mappedData = static_cast<char*>(mappedData);
+    }
+
+    insertFreeRegion(*block, createRegion(*block, 0, size));
+
+    const auto slot = std::find(pool.blocks.begin(), pool.blocks.end(), nullptr);
+    if (slot != pool.blocks.end())
+    {
+        *slot = std::move(block);
+        return static_cast<uint32_t>(slot - pool.blocks.begin());
+    }
+
+    pool.blocks.push_back(std::move(block));
+    return static_cast<uint32_t>(pool.blocks.size() - 1);
+}
+
+static void destroyBlock(MemoryPool& pool, uint32_t blockIndex)
+{
+    MemoryBlock& block = *pool.blocks[blockIndex];
+    assert(block.allocationCount == 0);
+
+    if (block.mappedData != nullptr)
+        vkUnmapMemory(allocator.device, block.memory);
+
+    vkFreeMemory(allocator.device, block.memory, nullptr);
+    allocator.memoryAllocationCount--;
+
+    pool.blocks[blockIndex].reset();
+}
+
+// Dedicated blocks go as soon as they are empty, a pool keeps one empty block around
+static void releaseEmptyBlocks(MemoryPool& pool)
+{
+    bool keptEmptyBlock = false;
+    for (uint32_t i = 0; i < pool.blocks.size(); ++i)
+    {
+        if (pool.blocks[i] == nullptr || pool.blocks[i]->allocationCount > 0)
+            continue;
+
+        if (!pool.blocks[i]->dedicated && !keptEmptyBlock)
+            keptEmptyBlock = true;
+        else
+            destroyBlock(pool, i);
+    }
+}
+
+static DeviceAllocation makeAllocation(const MemoryPool& pool, uint32_t poolIndex, uint32_t blockIndex, uint32_t regionIndex)
+{
+    const MemoryBlock& block = *pool.blocks[blockIndex];
+    const MemoryRegion& region = block.regions[regionIndex];
+
+    return DeviceAllocation {
+        .memory = block.memory,
+        .offset = region.offset,
+        .size = region.requestedSize,
+        .mappedData = (block.mappedData != nullptr) ? block.mappedData + region.offset : nullptr,
+        .poolIndex = poolIndex,
+        .blockIndex = blockIndex,
+        .regionIndex = regionIndex,
+        .category = region.category,
+    };
+}
+
+void initDeviceAllocator(VkDevice device, VkPhysicalDevice physicalDevice, VkDeviceSize preferredBlockSize)
+{
+    std::lock_guard<std::mutex> lock(allocator.mutex);
+
+    VkPhysicalDeviceProperties properties;
+    vkGetPhysicalDeviceProperties(physicalDevice, &properties);
+    vkGetPhysicalDeviceMemoryProperties(physicalDevice, &allocator.memoryProperties);
+
+    allocator.device = device;
+    allocator.nonCoherentAtomSize = properties.limits.nonCoherentAtomSize;
+    allocator.maxMemoryAllocationCount = properties.limits.maxMemoryAllocationCount;
+
+    allocator.pools.resize(allocator.memoryProperties.memoryTypeCount * 2);
+    for (uint32_t i = 0; i < allocator.pools.size(); ++i)
+    {
+        MemoryPool& pool = allocator.pools[i];
+        pool.memoryTypeIndex = i / 2;
+        pool.linear = (i % 2) == 1;
+
+        // small heaps (e.g. the 256 MB device local and host visible one) get smaller blocks
+        const VkMemoryType& memoryType = allocator.memoryProperties.memoryTypes[pool.memoryTypeIndex];
+        const VkDeviceSize heapSize = allocator.memoryProperties.memoryHeaps[memoryType.heapIndex].size;
+        pool.blockSize = alignUp(std::min(preferredBlockSize, heapSize / 8), ALLOCATION_GRANULE);
+    }
+}
+
+void destroyDeviceAllocator()
+{
+    std::lock_guard<std::mutex> lock(allocator.mutex);
+
+    for (MemoryPool& pool : allocator.pools)
+    {
+        for (uint32_t i = 0; i < pool.blocks.size(); ++i)
+        {
+            if (pool.blocks[i] != nullptr)
+                destroyBlock(pool, i);
+        }
+    }
+
+    assert(allocator.memoryAllocationCount == 0 && "device memory is still in use");
+    allocator.pools.clear();
+    allocator.memoryTypeIndices.clear();
+}
+
+DeviceAllocation allocateDeviceMemory(const VkMemoryRequirements& requirements, VkMemoryPropertyFlags memoryProperties, bool linear, MemoryCategory category, void* userData)
+{
+    std::lock_guard<std::mutex> lock(allocator.mutex);
+
+    const uint32_t poolIndex = getMemoryTypeIndex(requirements.memoryTypeBits, memoryProperties) * 2 + (linear ? 1 : 0);
+    MemoryPool& pool = allocator.pools[poolIndex];
+
+    const VkDeviceSize size = alignUp(std::max<VkDeviceSize>(requirements.size, 1), ALLOCATION_GRANULE);
+    const VkDeviceSize alignment = std::max(requirements.alignment, ALLOCATION_GRANULE);
+
+    uint32_t blockIndex = INVALID_INDEX;
+    uint32_t regionIndex = INVALID_INDEX;
+
+    if (size > pool.blockSize / 2)
+    {
+        blockIndex = createBlock(pool, size, true);
+        regionIndex = allocateFromBlock(*pool.blocks[blockIndex], size, ALLOCATION_GRANULE);
+    }
+    else
+    {
+        for (uint32_t i = 0; i < pool.blocks.size() && regionIndex == INVALID_INDEX; ++i)
+        {
+            if (pool.blocks[i] == nullptr || pool.blocks[i]->dedicated)
+                continue;
+
+            regionIndex = allocateFromBlock(*pool.blocks[i], size, alignment);
+            blockIndex = i;
+        }
+
+        if (regionIndex == INVALID_INDEX)
+        {
+            blockIndex = createBlock(pool, pool.blockSize, false);
+            regionIndex = allocateFromBlock(*pool.blocks[blockIndex], size, alignment);
+        }
+    }
+
+    assert(regionIndex != INVALID_INDEX);
+    MemoryRegion& region = pool.blocks[blockIndex]->regions[regionIndex];
+    region.userData = userData;
+    region.requestedSize = requirements.size;
+    region.category = category;
+
+    DeviceMemoryStats& stats = allocator.categoryStats[static_cast<uint32_t>(category)];
+    stats.allocationCount++;
+    stats.allocatedBytes += requirements.size;
+
+    return makeAllocation(pool, poolIndex, blockIndex, regionIndex);
+}
+
+void freeDeviceMemory(DeviceAllocation& allocation)
+{
+    if (allocation.memory == VK_NULL_HANDLE)
+        return;
+
+    std::lock_guard<std::mutex> lock(allocator.mutex);
+
+    MemoryPool& pool = allocator.pools[allocation.poolIndex];
+    freeRegion(*pool.blocks[allocation.blockIndex], allocation.regionIndex);
+    if (pool.blocks[allocation.blockIndex]->allocationCount == 0)
+        releaseEmptyBlocks(pool);
+
+    DeviceMemoryStats& stats = allocator.categoryStats[static_cast<uint32_t>(allocation.category)];
+    stats.allocationCount--;
+    stats.allocatedBytes -= allocation.size;
+
+    allocation = {};
+}
+
+void flushDeviceMemory(const DeviceAllocation& allocation, VkDeviceSize offset, VkDeviceSize size)
+{
+    std::lock_guard<std::mutex> lock(allocator.mutex);
+
+    const MemoryPool& pool = allocator.pools[allocation.poolIndex];
+    if (allocator.memoryProperties.memoryTypes[pool.memoryTypeIndex].propertyFlags & VK_MEMORY_PROPERTY_HOST_COHERENT_BIT)
+        return;
+
+    // the range has to cover whole atoms, without going past the end of the block
+    const VkDeviceSize atomSize = allocator.nonCoherentAtomSize;
+    const VkDeviceSize begin = (allocation.offset + offset) / atomSize * atomSize;
+    const VkDeviceSize end = std::min(alignUp(allocation.offset + offset + size, atomSize), pool.blocks[allocation.blockIndex]->size);
+
+    const VkMappedMemoryRange range {
+        .sType = VK_STRUCTURE_TYPE_MAPPED_MEMORY_RANGE,
+        .memory = allocation.memory,
+        .offset = begin,
+        .size = (end == pool.blocks[allocation.blockIndex]->size) ? VK_WHOLE_SIZE : end - begin,
+    };
+
+    VK_CHECK(vkFlushMappedMemoryRanges(allocator.device, 1, &range));
+}
+
+DeviceMemoryStats getDeviceMemoryStats(MemoryCategory category)
+{
+    std::lock_guard<std::mutex> lock(allocator.mutex);
+    return allocator.categoryStats[static_cast<uint32_t>(category)];
+}
+
+void logDeviceMemoryStats()
+{
+    std::lock_guard<std::mutex> lock(allocator.mutex);
+
+    LOG("Device memory : %u allocations of %u allowed\n", allocator.memoryAllocationCount, allocator.maxMemoryAllocationCount);
+
+    for (uint32_t i = 0; i < static_cast<uint32_t>(MemoryCategory::eCount); ++i)
+    {
+        const DeviceMemoryStats& stats = allocator.categoryStats[i];
+        if (stats.allocationCount > 0)
+        {
+            LOG("    %-10s : %6llu resources, %8.2f MB\n", getCategoryName(static_cast<MemoryCategory>(i)), static_cast<unsigned long long>(stats.allocationCount), stats.allocatedBytes / (1024.0 * 1024.0));
+        }
+    }
+
+    for (const MemoryPool& pool : allocator.pools)
+    {
+        uint32_t blockCount = 0;
+        VkDeviceSize blockBytes = 0;
+        VkDeviceSize usedBytes = 0;
+        VkDeviceSize largestFreeRegion = 0;
+        uint32_t freeRegionCount = 0;
+
+        for (const auto& block : pool.blocks)
+        {
+            if (block == nullptr)
+                continue;
+
+            blockCount++;
+            blockBytes += block->size;
+            usedBytes += block->usedBytes;
+            for (uint32_t r = 0; r != INVALID_INDEX; r = block->regions[r].nextPhysical)
+            {
+                if (block->regions[r].free)
+                {
+                    freeRegionCount++;
+                    largestFreeRegion = std::max(largestFreeRegion, block->regions[r].size);
+                }
+            }
+        }
+
+        if (blockCount > 0)
+        {
+            LOG("    type %2u %-7s : %u blocks, %8.2f of %8.2f MB used, %u free regions, largest %.2f MB\n", pool.memoryTypeIndex, pool.linear ? "linear" : "optimal",
+                blockCount, usedBytes / (1024.0 * 1024.0), blockBytes / (1024.0 * 1024.0), freeRegionCount, largestFreeRegion / (1024.0 * 1024.0));
+        }
+    }
+}
+
+std::vector<DefragmentationMove> beginDefragmentation(uint32_t maxMoves)
+{
+    std::lock_guard<std::mutex> lock(allocator.mutex);
+
+    std::vector<DefragmentationMove> moves;
+
+    for (uint32_t poolIndex = 0; poolIndex < allocator.pools.size() && moves.size() < maxMoves; ++poolIndex)
+    {
+        MemoryPool& pool = allocator.pools[poolIndex];
+
+        // the least used block is the cheapest one to empty
+        uint32_t srcBlockIndex = INVALID_INDEX;
+        uint32_t blockCount = 0;
+        for (uint32_t i = 0; i < pool.blocks.size(); ++i)
+        {
+            if (pool.blocks[i] == nullptr || pool.blocks[i]->dedicated || pool.blocks[i]->allocationCount == 0)
+                continue;
+
+            blockCount++;
+            if (srcBlockIndex == INVALID_INDEX || pool.blocks[i]->usedBytes < pool.blocks[srcBlockIndex]->usedBytes)
+                srcBlockIndex = i;
+        }
+
+        if (blockCount < 2)
+            continue;
+
+        MemoryBlock& srcBlock = *pool.blocks[srcBlockIndex];
+        for (uint32_t r = 0; r != INVALID_INDEX && moves.size() < maxMoves; r = srcBlock.regions[r].nextPhysical)
+        {
+            const MemoryRegion& srcRegion = srcBlock.regions[r];
+            if (srcRegion.free)
+                continue;
+
+            for (uint32_t i = 0; i < pool.blocks.size(); ++i)
+            {
+                if (i == srcBlockIndex || pool.blocks[i] == nullptr || pool.blocks[i]->dedicated || pool.blocks[i]->allocationCount == 0)
+                    continue;
+
+                const uint32_t dstRegionIndex = allocateFromBlock(*pool.blocks[i], srcRegion.size, srcRegion.alignment);
+                if (dstRegionIndex == INVALID_INDEX)
+                    continue;
+
+                MemoryRegion& dstRegion = pool.blocks[i]->regions[dstRegionIndex];
+                dstRegion.userData = srcRegion.userData;
+                dstRegion.requestedSize = srcRegion.requestedSize;
+                dstRegion.category = srcRegion.category;
+
+                moves.push_back(DefragmentationMove {
+                    .src = makeAllocation(pool, poolIndex, srcBlockIndex, r),
+                    .dst = makeAllocation(pool, poolIndex, i, dstRegionIndex),
+                    .userData = srcRegion.userData,
+                    .skip = false,
+                });
+                break;
+            }
+        }
+    }
+
+    return moves;
+}
+
+void endDefragmentation(std::vector<DefragmentationMove>& moves)
+{
+    std::lock_guard<std::mutex> lock(allocator.mutex);
+
+    for (DefragmentationMove& move : moves)
+    {
+        const DeviceAllocation& released = move.skip ? move.dst : move.src;
+        freeRegion(*allocator.pools[released.poolIndex].blocks[released.blockIndex], released.regionIndex);
+    }
+
+    for (MemoryPool& pool : allocator.pools)
+        releaseEmptyBlocks(pool);
+
+    moves.clear();
+}
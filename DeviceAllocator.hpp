@@ -0,0 +1,81 @@
+#ifndef DEVICE_ALLOCATOR_HPP
+#define DEVICE_ALLOCATOR_HPP
+
+#include <stdint.h>
+#include <vector>
+
+#include <vulkan/vulkan.h>
+
+/*
+ * Suballocates buffers and images from large VkDeviceMemory blocks, so the number of
+ * vkAllocateMemory calls stays far below maxMemoryAllocationCount.
+ *
+ * There is one pool per memory type and resource kind (linear buffers, optimal images), which
+ * keeps bufferImageGranularity out of the picture. Each block keeps its free regions in TLSF
+ * style segregated lists: a two level bitmap finds a free region large enough in constant time
+ * and freed regions merge with their free neighbours. Requests larger than half a block get a
+ * block of their own. Host visible blocks stay mapped for their whole lifetime.
+ *
+ * All functions are thread safe.
+ */
+
+enum class MemoryCategory : uint32_t
+{
+    eStaging = 0,
+    eUniform,
+    eGeometry,   // vertex, index, storage and indirect buffers
+    eAttachment,
+    eOther,
+    eCount
+};
+
+struct DeviceAllocation
+{
+    VkDeviceMemory memory;
+    VkDeviceSize offset;
+    VkDeviceSize size;
+    void* mappedData;           // non null when the memory type is host visible
+    uint32_t poolIndex;
+    uint32_t blockIndex;
+    uint32_t regionIndex;
+    MemoryCategory category;
+};
+
+struct DeviceMemoryStats
+{
+    uint64_t allocationCount;
+    uint64_t allocatedBytes;    // requested sizes, without alignment padding
+};
+
+// A region to move during defragmentation. The caller copies the data from src to dst and
+// rebinds the resource (buffers have to be recreated), or sets skip to keep it where it is.
+struct DefragmentationMove
+{
+    DeviceAllocation src;
+    DeviceAllocation dst;
+    void* userData;
+    bool skip;
+};
+
+void initDeviceAllocator(VkDevice device, VkPhysicalDevice physicalDevice, VkDeviceSize preferredBlockSize = 64 * 1024 * 1024);
+// Every allocation has to be freed by then
+void destroyDeviceAllocator();
+
+// userData is handed back with the defragmentation moves of the allocation
+DeviceAllocation allocateDeviceMemory(const VkMemoryRequirements& requirements, VkMemoryPropertyFlags memoryProperties, bool linear, MemoryCategory category, void* userData = nullptr);
+void freeDeviceMemory(DeviceAllocation& allocation);
+
+// Makes host writes to a mapped allocation visible to the device, nothing to do for coherent memory
+void flushDeviceMemory(const DeviceAllocation& allocation, VkDeviceSize offset, VkDeviceSize size);
+
+DeviceMemoryStats getDeviceMemoryStats(MemoryCategory category);
+void logDeviceMemoryStats();
+
+// Plans up to maxMoves moves out of the least used block of each pool into the other blocks of
+// the pool. The regions of both src and dst stay reserved until endDefragmentation, which frees
+// src (or dst for skipped moves) and releases the blocks left empty. The GPU must not use the
+// src regions anymore by then.
+std::vector<DefragmentationMove> beginDefragmentation(uint32_t maxMoves);
+void endDefragmentation(std::vector<DefragmentationMove>& moves);
+
+#endif // DEVICE_ALLOCATOR_HPP
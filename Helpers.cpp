@@ -89,7 +89,7 @@ VkSemaphore createSemaphore(VkDevice device)
     return semaphore;
 }
 
-VkImageView createImageView(VkDevice device, VkImage image, VkFormat format, VkImageAspectFlags aspectMask, uint32_t numMipLevels)
+VkImageView createImageView(VkDevice device, VkImage image, VkFormat format, VkImageAspectFlags aspectMask, uint32_t baseMipLevel, uint32_t numMipLevels)
 {
     const VkImageViewCreateInfo imageViewCreateInfo {
         .sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO,
@@ -103,7 +103,7 @@ VkImageView createImageView(VkDevice device, VkImage image, VkFormat format, VkI
             .a = VK_COMPONENT_SWIZZLE_IDENTITY },
         .subresourceRange = {
             .aspectMask = aspectMask,
-            .baseMipLevel = 0,
+            .baseMipLevel = baseMipLevel,
             .levelCount = numMipLevels,
             .baseArrayLayer = 0,
             .layerCount = 1 }
@@ -1,138 +1,896 @@
 #include "Loader.hpp"
+#include "MappedFile.hpp"
+#include "MeshFile.hpp"
+#include "Overdraw.hpp"
+#include "Defines.hpp"
 
 #include <fstream>
 #include <assert.h>
-#include <sstream>
+#include <string.h>
+#include <charconv>
 #include <iostream>
-#include <unordered_map>
-#include <array>
+#include <algorithm>
+#include <thread>
 
-ObjectBufferData loadObjFile(const std::string& filepath)
+// -------------------------
+// OBJ PARSING
+// -------------------------
+
+static constexpr uint32_t OBJ_INDEX_ABSENT = UINT32_MAX;
+
+// Resolved (0-based) position/uv/normal indices of one face corner
+struct ObjVertexKey
 {
-    std::ifstream file (filepath, std::ifstream::in);
-    assert(file.is_open());
+    uint32_t pos;
+    uint32_t uv;
+    uint32_t normal;
+
+    bool operator==(const ObjVertexKey& other) const
+    {
+        return pos == other.pos && uv == other.uv && normal == other.normal;
+    }
+};
+
+static inline uint64_t hashObjVertexKey(const ObjVertexKey& key)
+{
+    uint64_t h = key.pos * 0x9E3779B97F4A7C15ull;
+    h ^= (key.uv + 0x632BE59BD9B4E019ull) * 0xC2B2AE3D27D4EB4Full;
+    h ^= (key.normal + 0x85EBCA77C2B2AE63ull) * 0x165667B19E3779F9ull;
+    h ^= h >> 29;
+    return h;
+}
+
+// Open addressing hash table from face corner to output vertex index. Keeps dedup free of
+// per-vertex allocations, unlike an unordered_map keyed on the corner text.
+class ObjVertexLookup
+{
+private:
+    std::vector<ObjVertexKey> keys;
+    std::vector<uint32_t> values;
+    size_t count = 0;
+
+    void grow()
+    {
+        std::vector<ObjVertexKey> oldKeys = std::move(keys);
+        std::vector<uint32_t> oldValues = std::move(values);
+
+        const size_t capacity = oldValues.empty() ? 1024 : oldValues.size() * 2;
+        keys.assign(capacity, {});
+        values.assign(capacity, UINT32_MAX);
+
+        for (size_t i = 0; i < oldValues.size(); ++i)
+        {
+            if (oldValues[i] != UINT32_MAX)
+            {
+                size_t slot = static_cast<size_t>(hashObjVertexKey(oldKeys[i])) & (capacity - 1);
+                while (values[slot] != UINT32_MAX)
+                    slot = (slot + 1) & (capacity - 1);
+
+                keys[slot] = oldKeys[i];
+                values[slot] = oldValues[i];
+            }
+        }
+    }
+
+public:
+    // Returns the index stored for key, or stores and returns newValue if the key is new
+    uint32_t findOrInsert(const ObjVertexKey& key, uint32_t newValue)
+    {
+        // keep the load factor below 1/2
+        if ((count + 1) * 2 > values.size())
+            grow();
+
+        const size_t mask = values.size() - 1;
+        size_t slot = static_cast<size_t>(hashObjVertexKey(key)) & mask;
+        while (values[slot] != UINT32_MAX)
+        {
+            if (keys[slot] == key)
+                return values[slot];
+
+            slot = (slot + 1) & mask;
+        }
+
+        keys[slot] = key;
+        values[slot] = newValue;
+        count++;
+        return newValue;
+    }
+};
+
+static inline bool isObjSpace(char c)
+{
+    return c == ' ' || c == '\t' || c == '\r';
+}
+
+static inline const char* skipObjSpaces(const char* p, const char* end)
+{
+    while (p < end && isObjSpace(*p))
+        ++p;
+    return p;
+}
+
+static inline const char* skipObjLine(const char* p, const char* end)
+{
+    const char* newline = static_cast<const char*>(memchr(p, '\n', end - p));
+    return (newline != nullptr) ? newline + 1 : end;
+}
+
+// Parses up to `count` floats, components that fail to parse are left untouched
+static inline const char* parseObjFloats(const char* p, const char* end, float* values, uint32_t count)
+{
+    for (uint32_t i = 0; i < count; ++i)
+    {
+        p = skipObjSpaces(p, end);
+        if (p < end && *p == '+')
+            ++p;
+
+        p = std::from_chars(p, end, values[i]).ptr;
+    }
+    return p;
+}
+
+// Converts a 1-based (or negative, relative) OBJ index into a 0-based one
+static inline uint32_t resolveObjIndex(int32_t idx, size_t elementCount)
+{
+    if (idx > 0)
+        return static_cast<uint32_t>(idx - 1);
+    if (idx < 0)
+        return static_cast<uint32_t>(static_cast<int64_t>(elementCount) + idx);
+    return OBJ_INDEX_ABSENT;
+}
+
+// Parses one "v", "v/vt", "v//vn" or "v/vt/vn" face corner. Returns p unchanged if there is none.
+static inline const char* parseObjCorner(const char* p, const char* end, int32_t (&corner)[3])
+{
+    corner[0] = corner[1] = corner[2] = 0;
+
+    const char* next = std::from_chars(p, end, corner[0]).ptr;
+    if (next == p)
+        return p;
+
+    p = next;
+    if (p < end && *p == '/')
+    {
+        p = std::from_chars(p + 1, end, corner[1]).ptr;
+        if (p < end && *p == '/')
+        {
+            p = std::from_chars(p + 1, end, corner[2]).ptr;
+        }
+    }
+
+    return p;
+}
+
+static ObjectBufferData loadObjFileSerial(const MappedFile& file)
+{
+    const char* p = file.data();
+    const char* const end = p + file.size();
 
     std::vector<glm::vec3> positions;
     std::vector<glm::vec2> texCoords;
     std::vector<glm::vec3> normals;
 
     ObjectBufferData objectData;
-    std::vector<Vertex> vertexData;
-    std::vector<uint32_t> indexData;
-    std::unordered_map<std::string, uint32_t> indexLookup;
-    uint32_t nextIdx = 0;
+    ObjVertexLookup indexLookup;
+    std::vector<ObjVertexKey> polygon;
+    std::vector<uint32_t> polygonIndices;
 
-    std::string line;
-    while (std::getline(file, line))
+    while (p < end)
     {
-        std::string header;
-        std::istringstream iss(line);
-        iss >> header;
+        p = skipObjSpaces(p, end);
 
-        if (header == "v")
+        if (end - p >= 2 && p[0] == 'v' && isObjSpace(p[1]))
         {
-            glm::vec3 pos;
-            iss >> pos[0] >> pos[1] >> pos[2];
+            glm::vec3 pos { 0.0f };
+            p = parseObjFloats(p + 2, end, &pos[0], 3);
             positions.push_back(pos);
         }
-        else if (header == "vt")
+        else if (end - p >= 3 && p[0] == 'v' && p[1] == 't' && isObjSpace(p[2]))
         {
-            glm::vec2 uv;
-            iss >> uv[0] >> uv[1];
+            glm::vec2 uv { 0.0f };
+            p = parseObjFloats(p + 3, end, &uv[0], 2);
             texCoords.push_back(uv);
         }
-        else if (header == "vn")
+        else if (end - p >= 3 && p[0] == 'v' && p[1] == 'n' && isObjSpace(p[2]))
         {
-            glm::vec3 norm;
-            iss >> norm[0] >> norm[1] >> norm[2];
+            glm::vec3 norm { 0.0f };
+            p = parseObjFloats(p + 3, end, &norm[0], 3);
             normals.push_back(norm);
         }
-        else if (header == "f")
+        else if (end - p >= 2 && p[0] == 'f' && isObjSpace(p[1]))
+        {
+            p += 2;
+            polygon.clear();
+
+            while (true)
+            {
+                p = skipObjSpaces(p, end);
+
+                int32_t corner[3];
+                const char* next = parseObjCorner(p, end, corner);
+                if (next == p)
+                    break;
+                p = next;
+
+                const ObjVertexKey key {
+                    resolveObjIndex(corner[0], positions.size()),
+                    resolveObjIndex(corner[1], texCoords.size()),
+                    resolveObjIndex(corner[2], normals.size()),
+                };
+                assert(key.pos < positions.size());
+
+                polygon.push_back(key);
+            }
+
+            // faces with fewer than 3 corners have no triangle, their corners make no vertices
+            polygonIndices.clear();
+            for (size_t i = 0; i < polygon.size() && polygon.size() >= 3; ++i)
+            {
+                const ObjVertexKey& key = polygon[i];
+                const uint32_t nextIdx = static_cast<uint32_t>(objectData.vertices.size());
+                const uint32_t idx = indexLookup.findOrInsert(key, nextIdx);
+                if (idx == nextIdx)
+                {
+                    objectData.vertices.emplace_back(
+                        positions[key.pos],
+                        (key.uv     < texCoords.size()) ? texCoords[key.uv]   : glm::vec2(0.0f),
+                        (key.normal < normals.size())   ? normals[key.normal] : glm::vec3(0.0f));
+                }
+
+                polygonIndices.push_back(idx);
+            }
+
+            // triangulate polygons as a fan around their first corner
+            for (size_t i = 2; i < polygonIndices.size(); ++i)
+            {
+                objectData.indices.push_back(polygonIndices[0]);
+                objectData.indices.push_back(polygonIndices[i - 1]);
+                objectData.indices.push_back(polygonIndices[i]);
+            }
+        }
+
+        p = skipObjLine(p, end);
+    }
+
+    return objectData;
+}
+
+// -------------------------
+// PARALLEL OBJ PARSING
+// -------------------------
+
+// Files smaller than this are not worth the thread startup
+static constexpr size_t OBJ_PARALLEL_MIN_FILE_SIZE = 1 << 20;
+
+// Face corner as parsed from one chunk. Positive OBJ indices are already absolute, negative ones
+// can only be resolved against the chunk's global element offsets and are flagged as relative.
+struct ObjChunkCorner
+{
+    uint32_t idx[3];
+    uint8_t relativeMask;
+};
+
+struct ObjChunk
+{
+    const char* begin;
+    const char* end;
+
+    std::vector<glm::vec3> positions;
+    std::vector<glm::vec2> texCoords;
+    std::vector<glm::vec3> normals;
+    std::vector<ObjChunkCorner> corners; // already triangulated, 3 per triangle
+
+    // global element/corner offsets, filled in by the prefix sum over all chunks
+    size_t positionBase;
+    size_t texCoordBase;
+    size_t normalBase;
+    size_t cornerBase;
+
+    // corners of this chunk that belong to each dedup shard, in file order
+    std::vector<std::vector<uint32_t>> shardCorners;
+    size_t vertexBase;
+    size_t vertexCount;
+};
+
+// Runs fn(0) .. fn(count - 1) on their own threads
+template<typename Fn>
+static void parallelFor(uint32_t count, Fn&& fn)
+{
+    std::vector<std::thread> threads;
+    threads.reserve(count - 1);
+    for (uint32_t i = 1; i < count; ++i)
+    {
+        threads.emplace_back(fn, i);
+    }
+
+    fn(0);
+
+    for (std::thread& thread : threads)
+    {
+        thread.join();
+    }
+}
+
+static void parseObjChunk(ObjChunk& chunk)
+{
+    const char* p = chunk.begin;
+    const char* const end = chunk.end;
+
+    auto encodeIndex = [](int32_t idx, size_t localCount, uint8_t relativeBit, uint8_t& relativeMask)
+    {
+        if (idx > 0)
+            return static_cast<uint32_t>(idx - 1);
+        if (idx == 0)
+            return OBJ_INDEX_ABSENT;
+
+        relativeMask |= relativeBit;
+        return static_cast<uint32_t>(static_cast<int64_t>(localCount) + idx);
+    };
+
+    ObjChunkCorner polygon[3];
+    uint32_t polygonSize = 0;
+
+    while (p < end)
+    {
+        p = skipObjSpaces(p, end);
+
+        if (end - p >= 2 && p[0] == 'v' && isObjSpace(p[1]))
         {
-            std::array<std::string, 3> faces; 
-            iss >> faces[0] >> faces[1] >> faces[2];
+            glm::vec3 pos { 0.0f };
+            p = parseObjFloats(p + 2, end, &pos[0], 3);
+            chunk.positions.push_back(pos);
+        }
+        else if (end - p >= 3 && p[0] == 'v' && p[1] == 't' && isObjSpace(p[2]))
+        {
+            glm::vec2 uv { 0.0f };
+            p = parseObjFloats(p + 3, end, &uv[0], 2);
+            chunk.texCoords.push_back(uv);
+        }
+        else if (end - p >= 3 && p[0] == 'v' && p[1] == 'n' && isObjSpace(p[2]))
+        {
+            glm::vec3 norm { 0.0f };
+            p = parseObjFloats(p + 3, end, &norm[0], 3);
+            chunk.normals.push_back(norm);
+        }
+        else if (end - p >= 2 && p[0] == 'f' && isObjSpace(p[1]))
+        {
+            p += 2;
+            polygonSize = 0;
 
-            for (uint8_t i = 0; i < faces.size(); i++)
+            while (true)
             {
-                auto iter = indexLookup.find(faces[i]);
-                if (iter != indexLookup.end())
+                p = skipObjSpaces(p, end);
+
+                int32_t corner[3];
+                const char* next = parseObjCorner(p, end, corner);
+                if (next == p)
+                    break;
+                p = next;
+
+                ObjChunkCorner chunkCorner { {}, 0 };
+                chunkCorner.idx[0] = encodeIndex(corner[0], chunk.positions.size(), 0x1, chunkCorner.relativeMask);
+                chunkCorner.idx[1] = encodeIndex(corner[1], chunk.texCoords.size(), 0x2, chunkCorner.relativeMask);
+                chunkCorner.idx[2] = encodeIndex(corner[2], chunk.normals.size(), 0x4, chunkCorner.relativeMask);
+
+                // fan triangulation, emitted in the same corner order as the serial path. Corners
+                // of faces with fewer than 3 of them are never emitted, nor made into vertices.
+                if (polygonSize < 3)
                 {
-                    objectData.indices.push_back(iter->second);
+                    polygon[polygonSize++] = chunkCorner;
+                    if (polygonSize == 3)
+                        chunk.corners.insert(chunk.corners.end(), polygon, polygon + 3);
                 }
                 else
                 {
-                    std::istringstream issFace(faces[i]);
+                    chunk.corners.push_back(polygon[0]);
+                    chunk.corners.push_back(polygon[2]);
+                    chunk.corners.push_back(chunkCorner);
+                    polygon[2] = chunkCorner;
+                }
+            }
+        }
 
-                    std::string strPosIdx, strUvIdx, strNormalIdx;
-                    std::getline(issFace, strPosIdx, '/');
-                    std::getline(issFace, strUvIdx, '/');
-                    std::getline(issFace, strNormalIdx, '/');
+        p = skipObjLine(p, end);
+    }
+}
 
-                    objectData.vertices.emplace_back(positions[std::stoi(strPosIdx)-1], texCoords[std::stoi(strUvIdx)-1], normals[std::stoi(strNormalIdx)-1]);
+/*
+ * Same result as loadObjFileSerial, computed in phases that each run on threadCount threads:
+ *  1. parse line aligned chunks of the file into chunk local attribute and corner lists
+ *  2. prefix sum the chunk sizes and concatenate the attributes
+ *  3. resolve corners to global keys and bucket them into dedup shards by hash
+ *  4. per shard, find the first corner using each key
+ *  5. number first occurrences in file order (prefix sum over chunks) and write vertices/indices
+ */
+static ObjectBufferData loadObjFileParallel(const MappedFile& file, uint32_t threadCount)
+{
+    const char* const fileBegin = file.data();
+    const char* const fileEnd = fileBegin + file.size();
 
-                    indexLookup.emplace(faces[i], nextIdx);
-                    objectData.indices.push_back(nextIdx++);
-                }
+    // 1. Chunks end right after a newline so no line is split
+    std::vector<ObjChunk> chunks(threadCount);
+    {
+        const char* chunkBegin = fileBegin;
+        for (uint32_t i = 0; i < threadCount; ++i)
+        {
+            const char* chunkEnd = (i + 1 == threadCount) ? fileEnd : fileBegin + file.size() * (i + 1) / threadCount;
+            chunkEnd = (chunkEnd <= chunkBegin) ? chunkBegin : skipObjLine(chunkEnd, fileEnd);
+
+            chunks[i].begin = chunkBegin;
+            chunks[i].end = chunkEnd;
+            chunkBegin = chunkEnd;
+        }
+    }
+
+    parallelFor(threadCount, [&](uint32_t i) { parseObjChunk(chunks[i]); });
+
+    // 2.
+    size_t positionCount = 0, texCoordCount = 0, normalCount = 0, cornerCount = 0;
+    for (ObjChunk& chunk : chunks)
+    {
+        chunk.positionBase = positionCount;
+        chunk.texCoordBase = texCoordCount;
+        chunk.normalBase = normalCount;
+        chunk.cornerBase = cornerCount;
+
+        positionCount += chunk.positions.size();
+        texCoordCount += chunk.texCoords.size();
+        normalCount += chunk.normals.size();
+        cornerCount += chunk.corners.size();
+    }
+
+    assert(cornerCount < UINT32_MAX);
+
+    std::vector<glm::vec3> positions(positionCount);
+    std::vector<glm::vec2> texCoords(texCoordCount);
+    std::vector<glm::vec3> normals(normalCount);
+
+    const uint32_t shardCount = threadCount;
+    std::vector<ObjVertexKey> keys(cornerCount);
+
+    parallelFor(threadCount, [&](uint32_t i)
+    {
+        ObjChunk& chunk = chunks[i];
+        std::copy(chunk.positions.begin(), chunk.positions.end(), positions.begin() + chunk.positionBase);
+        std::copy(chunk.texCoords.begin(), chunk.texCoords.end(), texCoords.begin() + chunk.texCoordBase);
+        std::copy(chunk.normals.begin(), chunk.normals.end(), normals.begin() + chunk.normalBase);
+
+        // 3.
+        chunk.shardCorners.resize(shardCount);
+        for (std::vector<uint32_t>& shard : chunk.shardCorners)
+            shard.reserve(chunk.corners.size() / shardCount + 16);
+
+        const size_t bases[3] = { chunk.positionBase, chunk.texCoordBase, chunk.normalBase };
+        for (size_t c = 0; c < chunk.corners.size(); ++c)
+        {
+            const ObjChunkCorner& corner = chunk.corners[c];
+
+            uint32_t resolved[3];
+            for (uint32_t k = 0; k < 3; ++k)
+            {
+                resolved[k] = (corner.relativeMask & (1u << k))
+                    ? static_cast<uint32_t>(static_cast<int64_t>(bases[k]) + static_cast<int32_t>(corner.idx[k]))
+                    : corner.idx[k];
             }
+
+            const size_t cornerIdx = chunk.cornerBase + c;
+            keys[cornerIdx] = { resolved[0], resolved[1], resolved[2] };
+            assert(keys[cornerIdx].pos < positionCount);
+
+            const uint32_t shard = static_cast<uint32_t>((hashObjVertexKey(keys[cornerIdx]) >> 32) % shardCount);
+            chunk.shardCorners[shard].push_back(static_cast<uint32_t>(cornerIdx));
         }
+
+        std::vector<ObjChunkCorner>().swap(chunk.corners);
+    });
+
+    // 4. Every key lives in exactly one shard, and each shard sees its corners in file order
+    std::vector<uint32_t> firstCorner(cornerCount);
+
+    parallelFor(shardCount, [&](uint32_t shard)
+    {
+        ObjVertexLookup lookup;
+        for (const ObjChunk& chunk : chunks)
+        {
+            for (const uint32_t cornerIdx : chunk.shardCorners[shard])
+            {
+                firstCorner[cornerIdx] = lookup.findOrInsert(keys[cornerIdx], cornerIdx);
+            }
+        }
+    });
+
+    // 5.
+    parallelFor(threadCount, [&](uint32_t i)
+    {
+        ObjChunk& chunk = chunks[i];
+        const size_t cornerEnd = (i + 1 == threadCount) ? cornerCount : chunks[i + 1].cornerBase;
+
+        chunk.vertexCount = 0;
+        for (size_t c = chunk.cornerBase; c < cornerEnd; ++c)
+            chunk.vertexCount += (firstCorner[c] == c) ? 1 : 0;
+    });
+
+    size_t vertexCount = 0;
+    for (ObjChunk& chunk : chunks)
+    {
+        chunk.vertexBase = vertexCount;
+        vertexCount += chunk.vertexCount;
     }
 
+    ObjectBufferData objectData;
+    objectData.vertices.resize(vertexCount);
+    objectData.indices.resize(cornerCount);
+
+    // the vertex index of a first occurrence is stored in its own index slot, repeats look it up there
+    parallelFor(threadCount, [&](uint32_t i)
+    {
+        const ObjChunk& chunk = chunks[i];
+        const size_t cornerEnd = (i + 1 == threadCount) ? cornerCount : chunks[i + 1].cornerBase;
+
+        uint32_t nextIdx = static_cast<uint32_t>(chunk.vertexBase);
+        for (size_t c = chunk.cornerBase; c < cornerEnd; ++c)
+        {
+            if (firstCorner[c] != c)
+                continue;
+
+            const ObjVertexKey& key = keys[c];
+            objectData.vertices[nextIdx] = Vertex(
+                positions[key.pos],
+                (key.uv     < texCoords.size()) ? texCoords[key.uv]   : glm::vec2(0.0f),
+                (key.normal < normals.size())   ? normals[key.normal] : glm::vec3(0.0f));
+
+            objectData.indices[c] = nextIdx++;
+        }
+    });
+
+    parallelFor(threadCount, [&](uint32_t i)
+    {
+        const size_t cornerEnd = (i + 1 == threadCount) ? cornerCount : chunks[i + 1].cornerBase;
+        for (size_t c = chunks[i].cornerBase; c < cornerEnd; ++c)
+        {
+            if (firstCorner[c] != c)
+                objectData.indices[c] = objectData.indices[firstCorner[c]];
+        }
+    });
+
     return objectData;
 }
 
-enum class VertexInputAttribute_T
+ObjectBufferData loadObjFile(const std::string& filepath, const ObjLoadParams& params)
 {
-    ePosition = 0,
-    eUv          , // 1
-    eNormal      , // 2
-};
+    const MappedFile file(filepath);
 
-static std::unordered_map<VertexInputAttribute_T, uint32_t> attributeComponentSizeLUT {
-    { VertexInputAttribute_T::ePosition, 3 },
-    { VertexInputAttribute_T::eUv      , 2 },
-    { VertexInputAttribute_T::eNormal  , 3 },
-};
+    uint32_t threadCount = (params.threadCount == 0) ? std::max(1u, std::thread::hardware_concurrency()) : params.threadCount;
+    if (file.size() < OBJ_PARALLEL_MIN_FILE_SIZE)
+        threadCount = 1;
 
-MeshBufferData loadMeshFile(const std::string& filepath)
+    ObjectBufferData objectData = (threadCount > 1) ? loadObjFileParallel(file, threadCount) : loadObjFileSerial(file);
+    optimizeVertexCache(objectData, params.vertexCacheOptimizer);
+
+    if (params.overdrawThreshold > 0.0f)
+        optimizeOverdraw(objectData, params.overdrawThreshold);
+
+    if (params.vertexFetchOrder)
+        optimizeVertexFetch(objectData);
+
+    return objectData;
+}
+
+static MeshFileView viewMeshFileV1(const MappedFile& file)
 {
-    std::ifstream file { filepath, std::ifstream::in };
-    assert( file.is_open ());
+    const char* p = file.data();
+    const char* const end = p + file.size();
+
+    // returns a pointer to the next `size` bytes and skips them
+    auto take = [&](size_t size)
+    {
+        if (size > static_cast<size_t>(end - p))
+        {
+            EXIT("Truncated mesh file");
+        }
+
+        const char* region = p;
+        p += size;
+        return region;
+    };
 
     // read # of attribs
     uint8_t attribCount = 0;
-    file.read(reinterpret_cast<char*>(&attribCount), sizeof(uint8_t));
+    memcpy(&attribCount, take(sizeof(uint8_t)), sizeof(uint8_t));
 
     // read attribs
-    std::vector<uint8_t> attribs( attribCount, 0 );
-    file.read(reinterpret_cast<char*>(attribs.data()), sizeof(uint8_t) * attribCount);
+    const uint8_t* attribs = reinterpret_cast<const uint8_t*>(take(sizeof(uint8_t) * attribCount));
+
+    MeshFileView view;
 
     // read vertex count
-    uint32_t vertexCount = 0;
-    file.read(reinterpret_cast<char*>(&vertexCount), sizeof(uint32_t));
+    memcpy(&view.vertexCount, take(sizeof(uint32_t)), sizeof(uint32_t));
 
     // read index count
-    uint32_t indexCount = 0;
-    file.read(reinterpret_cast<char*>(&indexCount), sizeof(uint32_t));
+    memcpy(&view.indexCount, take(sizeof(uint32_t)), sizeof(uint32_t));
+
+    if (!getVertexFormat(attribs, attribCount, &view.vertexFormat))
+    {
+        EXIT("Unsupported vertex attribute layout");
+    }
+
+    view.vertexStride = getVertexStride(attribs, attribCount);
+
+    view.vertices = take(size_t(view.vertexCount) * view.vertexStride);
+    view.indices = take(sizeof(uint32_t) * view.indexCount);
+
+    // meshlets, optional trailer written by older meshbake versions
+    if (p != end)
+    {
+        memcpy(&view.meshletCount, take(sizeof(uint32_t)), sizeof(uint32_t));
+        view.meshlets = take(sizeof(Meshlet) * view.meshletCount);
+    }
+
+    return view;
+}
+
+static MeshFileView viewMeshFileV2(const MeshFileHeader* header)
+{
+    MeshFileView view;
+    if (!getVertexFormat(header->attribs, header->attribCount, &view.vertexFormat))
+    {
+        EXIT("Unsupported vertex attribute layout");
+    }
+
+
+    view.vertexCount = header->vertexCount;
+    view.indexCount = header->indexCount;
+    view.vertexStride = header->vertexStride;
+
+    uint64_t size = 0;
+    view.positions = getMeshFileSection(header, MeshSection_T::ePositions, &size);
+    if (view.positions != nullptr)
+    {
+        view.vertexFormat.separatePositions = true;
+        if (size != uint64_t(header->vertexCount) * getPositionStride(view.vertexFormat))
+        {
+            EXIT("Position section size does not match the vertex count");
+        }
+    }
+
+    if (header->vertexStride != getVertexStride(view.vertexFormat))
+    {
+        EXIT("Vertex stride does not match the vertex attributes");
+    }
 
-    const uint32_t floatStride = [&](){
-        uint32_t ret = 0;
-        for (const auto attrib : attribs)
+    // the sizes come from the file, a section shorter than the header counts would be read past its end
+    view.vertices = getMeshFileSection(header, MeshSection_T::eVertices, &size);
+    if (size != uint64_t(header->vertexCount) * header->vertexStride)
+    {
+        EXIT("Vertex section size does not match the vertex count");
+    }
+
+    view.indices = getMeshFileSection(header, MeshSection_T::eIndices, &size);
+    if (size != uint64_t(header->indexCount) * sizeof(uint32_t))
+    {
+        EXIT("Index section size does not match the index count");
+    }
+
+    view.meshlets = getMeshFileSection(header, MeshSection_T::eMeshlets, &size);
+    if (view.meshlets != nullptr)
+    {
+        view.meshletCount = header->meshletCount;
+        if (size != uint64_t(header->meshletCount) * sizeof(Meshlet))
         {
-            ret += attributeComponentSizeLUT.at(static_cast<VertexInputAttribute_T>(attrib));
+            EXIT("Meshlet section size does not match the meshlet count");
         }
 
-        return ret;
-    }();
+        view.meshletBounds = static_cast<const MeshletBounds*>(getMeshFileSection(header, MeshSection_T::eMeshletBounds, &size));
+        if (view.meshletBounds != nullptr && size != uint64_t(header->meshletCount) * sizeof(MeshletBounds))
+        {
+            EXIT("Meshlet bounds section size does not match the meshlet count");
+        }
+    }
 
+    view.lods = static_cast<const MeshLod*>(getMeshFileSection(header, MeshSection_T::eLods, &size));
+    if (view.lods != nullptr)
+    {
+        view.lodCount = header->lodCount;
+        if (size != uint64_t(header->lodCount) * sizeof(MeshLod))
+        {
+            EXIT("LOD section size does not match the LOD count");
+        }
+    }
+
+    view.hierarchyMeshlets = getMeshFileSection(header, MeshSection_T::eMeshletHierarchy, &size);
+    if (view.hierarchyMeshlets != nullptr)
+    {
+        view.hierarchyMeshletCount = static_cast<uint32_t>(size / sizeof(Meshlet));
+        if (size != uint64_t(view.hierarchyMeshletCount) * sizeof(Meshlet))
+        {
+            EXIT("Meshlet hierarchy section size is not a whole number of meshlets");
+        }
+
+        view.meshletClusters = static_cast<const MeshletCluster*>(getMeshFileSection(header, MeshSection_T::eMeshletClusters, &size));
+        if (view.meshletClusters == nullptr || size != uint64_t(view.meshletCount + view.hierarchyMeshletCount) * sizeof(MeshletCluster))
+        {
+            EXIT("Meshlet cluster section size does not match the meshlet counts");
+        }
+    }
+
+    const void* quantization = getMeshFileSection(header, MeshSection_T::eVertexQuantization, &size);
+    if (quantization != nullptr)
+    {
+        if (size != sizeof(PositionQuantization))
+        {
+            EXIT("Quantization section size does not match PositionQuantization");
+        }
+        memcpy(&view.positionQuantization, quantization, sizeof(PositionQuantization));
+    }
+    else if (view.vertexFormat.position == VertexInputAttribute_T::ePositionUnorm16)
+    {
+        EXIT("Quantized positions without a quantization section");
+    }
+
+    return view;
+}
+
+MeshFileView viewMeshFile(const MappedFile& file)
+{
+    const MeshFileHeader* header = getMeshFileHeader(file.data(), file.size());
+    return (header != nullptr) ? viewMeshFileV2(header) : viewMeshFileV1(file);
+}
+
+MeshBufferData loadMeshFile(const std::string& filepath)
+{
+    const MappedFile file(filepath);
+    const MeshFileView view = viewMeshFile(file);
+
+    MeshBufferData meshData;
+    meshData.vertexCount = view.vertexCount;
+    meshData.vertexFormat = view.vertexFormat;
+    meshData.positionQuantization = view.positionQuantization;
+
+    meshData.vertices.resize(size_t(view.vertexCount) * view.vertexStride);
+    memcpy(meshData.vertices.data(), view.vertices, meshData.vertices.size());
+
+    if (view.positions != nullptr)
+    {
+        meshData.positions.resize(size_t(view.vertexCount) * getPositionStride(view.vertexFormat));
+        memcpy(meshData.positions.data(), view.positions, meshData.positions.size());
+    }
+
+    meshData.indices.resize(view.indexCount);
+    memcpy(meshData.indices.data(), view.indices, sizeof(uint32_t) * meshData.indices.size());
+
+    if (view.meshlets != nullptr)
+    {
+        meshData.meshlets.resize(view.meshletCount);
+        memcpy(meshData.meshlets.data(), view.meshlets, sizeof(Meshlet) * meshData.meshlets.size());
+
+        if (view.meshletBounds != nullptr)
+            meshData.meshletBounds.assign(view.meshletBounds, view.meshletBounds + view.meshletCount);
+    }
+
+    if (view.lods != nullptr)
+        meshData.lods.assign(view.lods, view.lods + view.lodCount);
+
+    if (view.hierarchyMeshlets != nullptr)
+    {
+        meshData.meshletHierarchy.meshlets.resize(view.hierarchyMeshletCount);
+        memcpy(meshData.meshletHierarchy.meshlets.data(), view.hierarchyMeshlets, sizeof(Meshlet) * view.hierarchyMeshletCount);
+        meshData.meshletHierarchy.clusters.assign(view.meshletClusters, view.meshletClusters + view.meshletCount + view.hierarchyMeshletCount);
+    }
+
+    return meshData;
+}
+
+MeshBufferData toMeshBufferData(const ObjectBufferData& objectData, const VertexFormat& format)
+{
     MeshBufferData meshData;
+    meshData.vertexCount = static_cast<uint32_t>(objectData.vertices.size());
+    meshData.vertexFormat = format;
+    meshData.positionQuantization = computePositionQuantization(objectData.vertices.data(), objectData.vertices.size());
 
-    // read vertices
-    meshData.vertices.resize(vertexCount * floatStride);
-    file.read(reinterpret_cast<char*>(meshData.vertices.data()), sizeof(float) * meshData.vertices.size());
+    meshData.vertices.resize(objectData.vertices.size() * getVertexStride(format));
+    meshData.positions.resize(objectData.vertices.size() * getPositionStride(format));
+    encodeVertices(objectData.vertices.data(), objectData.vertices.size(), format, meshData.positionQuantization, meshData.vertices.data(), meshData.positions.data());
 
-    // read indices
-    meshData.indices.resize(indexCount);
-    file.read(reinterpret_cast<char*>(meshData.indices.data()), sizeof(uint32_t) * indexCount);
+    meshData.indices = objectData.indices;
 
     return meshData;
-}
\ No newline at end of file
+}
+
+void writeMeshFile(const std::string& filepath, const MeshBufferData& meshData)
+{
+    const uint8_t attribs[] {
+        static_cast<uint8_t>(meshData.vertexFormat.position),
+        static_cast<uint8_t>(meshData.vertexFormat.uv),
+        static_cast<uint8_t>(meshData.vertexFormat.normal),
+    };
+
+    const uint32_t vertexStride = getVertexStride(meshData.vertexFormat);
+    assert(meshData.vertices.size() == size_t(meshData.vertexCount) * vertexStride);
+    assert(meshData.positions.size() == size_t(meshData.vertexCount) * getPositionStride(meshData.vertexFormat));
+
+    MeshFileHeader header {};
+    header.magic = MESH_FILE_MAGIC;
+    header.version = MESH_FILE_VERSION;
+    header.headerSize = sizeof(MeshFileHeader);
+    header.vertexCount = meshData.vertexCount;
+    header.vertexStride = vertexStride;
+    header.indexCount = static_cast<uint32_t>(meshData.indices.size());
+    header.meshletCount = static_cast<uint32_t>(meshData.meshlets.size());
+    header.lodCount = static_cast<uint32_t>(meshData.lods.size());
+    header.attribCount = sizeof(attribs);
+    memcpy(header.attribs, attribs, sizeof(attribs));
+
+    struct SectionSource
+    {
+        MeshSection_T type;
+        uint32_t alignment;
+        const void* data;
+        uint64_t size;
+    };
+
+    std::vector<SectionSource> sources {
+        { MeshSection_T::eVertices, MESH_SECTION_BUFFER_ALIGNMENT, meshData.vertices.data(), meshData.vertices.size() },
+        { MeshSection_T::eIndices , MESH_SECTION_BUFFER_ALIGNMENT, meshData.indices.data() , sizeof(uint32_t) * meshData.indices.size() },
+    };
+
+    if (!meshData.meshlets.empty())
+        sources.push_back({ MeshSection_T::eMeshlets, MESH_SECTION_BUFFER_ALIGNMENT, meshData.meshlets.data(), sizeof(Meshlet) * meshData.meshlets.size() });
+
+    if (!meshData.meshletBounds.empty())
+    {
+        assert(meshData.meshletBounds.size() == meshData.meshlets.size());
+        sources.push_back({ MeshSection_T::eMeshletBounds, MESH_SECTION_BUFFER_ALIGNMENT, meshData.meshletBounds.data(), sizeof(MeshletBounds) * meshData.meshletBounds.size() });
+    }
+
+    if (!meshData.lods.empty())
+        sources.push_back({ MeshSection_T::eLods, MESH_SECTION_TABLE_ALIGNMENT, meshData.lods.data(), sizeof(MeshLod) * meshData.lods.size() });
+
+    const MeshletHierarchy& hierarchy = meshData.meshletHierarchy;
+    if (!hierarchy.clusters.empty())
+    {
+        assert(hierarchy.clusters.size() == meshData.meshlets.size() + hierarchy.meshlets.size());
+        sources.push_back({ MeshSection_T::eMeshletHierarchy, MESH_SECTION_BUFFER_ALIGNMENT, hierarchy.meshlets.data(), sizeof(Meshlet) * hierarchy.meshlets.size() });
+        sources.push_back({ MeshSection_T::eMeshletClusters, MESH_SECTION_BUFFER_ALIGNMENT, hierarchy.clusters.data(), sizeof(MeshletCluster) * hierarchy.clusters.size() });
+    }
+
+    if (meshData.vertexFormat.separatePositions)
+        sources.push_back({ MeshSection_T::ePositions, MESH_SECTION_BUFFER_ALIGNMENT, meshData.positions.data(), meshData.positions.size() });
+
+    if (meshData.vertexFormat.position == VertexInputAttribute_T::ePositionUnorm16)
+        sources.push_back({ MeshSection_T::eVertexQuantization, MESH_SECTION_TABLE_ALIGNMENT, &meshData.positionQuantization, sizeof(PositionQuantization) });
+
+    header.sectionCount = static_cast<uint32_t>(sources.size());
+
+    std::vector<MeshFileSection> sections(sources.size());
+    uint64_t offset = sizeof(MeshFileHeader) + sizeof(MeshFileSection) * sections.size();
+    for (size_t i = 0; i < sources.size(); ++i)
+    {
+        offset = (offset + sources[i].alignment - 1) / sources[i].alignment * sources[i].alignment;
+
+        sections[i] = {
+            .type = static_cast<uint32_t>(sources[i].type),
+            .alignment = sources[i].alignment,
+            .offset = offset,
+            .size = sources[i].size,
+        };
+
+        offset += sources[i].size;
+    }
+
+    std::ofstream file { filepath, std::ofstream::out | std::ofstream::binary };
+    assert(file.is_open());
+
+    file.write(reinterpret_cast<const char*>(&header), sizeof(MeshFileHeader));
+    file.write(reinterpret_cast<const char*>(sections.data()), sizeof(MeshFileSection) * sections.size());
+
+    static const char padding[MESH_SECTION_BUFFER_ALIGNMENT] = {};
+    uint64_t written = sizeof(MeshFileHeader) + sizeof(MeshFileSection) * sections.size();
+    for (size_t i = 0; i < sources.size(); ++i)
+    {
+        file.write(padding, static_cast<std::streamsize>(sections[i].offset - written));
+        file.write(static_cast<const char*>(sources[i].data), static_cast<std::streamsize>(sources[i].size));
+        written = sections[i].offset + sections[i].size;
+    }
+
+    assert(file.good());
+}
@@ -6,8 +6,15 @@
 #include <vector>
 #include <string>
 
+#include "Meshlet.hpp"
+#include "MeshletBounds.hpp"
+#include "VertexFormat.hpp"
+#include "VertexCache.hpp"
+#include "Lod.hpp"
+
 struct Vertex
 {
+    Vertex() = default;
     Vertex(glm::vec3 _pos, glm::vec2 _uv, glm::vec3 _norm)
         : pos { std::move(_pos) }
         , uv { std::move(_uv) }
@@ -27,12 +34,68 @@ struct ObjectBufferData
 
 struct MeshBufferData
 {
-    std::vector<float> vertices;
-    std::vector<uint32_t> indices;
+    uint32_t vertexCount = 0;
+    VertexFormat vertexFormat;
+    PositionQuantization positionQuantization; // only meaningful for ePositionUnorm16
+    std::vector<uint8_t> vertices;             // vertexCount * getVertexStride(vertexFormat) bytes
+    std::vector<uint8_t> positions;            // vertexCount * getPositionStride(vertexFormat) bytes, empty unless vertexFormat.separatePositions
+    std::vector<uint32_t> indices;             // every level of detail, the full mesh first
+    std::vector<Meshlet> meshlets; // empty if the file was baked without meshlets, otherwise they cover the full mesh
+    std::vector<MeshletBounds> meshletBounds; // one per meshlet, empty if the file was baked without them
+    std::vector<MeshLod> lods;     // empty if the file was baked without levels of detail
+    MeshletHierarchy meshletHierarchy; // empty if the file was baked without one
 };
 
-ObjectBufferData loadObjFile(const std::string& filepath);
+// Parts of a mapped .mesh file (v1 or v2). The pointers point into the mapping.
+struct MeshFileView
+{
+    uint32_t vertexCount = 0;
+    uint32_t vertexStride = 0; // bytes
+    uint32_t indexCount = 0;
+    uint32_t meshletCount = 0;
+    uint32_t lodCount = 0;
+    uint32_t hierarchyMeshletCount = 0;
+
+    VertexFormat vertexFormat;
+    PositionQuantization positionQuantization;
+
+    const void* vertices = nullptr;
+    const void* positions = nullptr; // nullptr unless vertexFormat.separatePositions
+    const void* indices = nullptr;
+    const void* meshlets = nullptr; // nullptr if the file has none
+    const MeshletBounds* meshletBounds = nullptr; // meshletCount entries, nullptr if the file has none
+    const MeshLod* lods = nullptr;  // nullptr if the file has none, indexCount then covers one level
+    const void* hierarchyMeshlets = nullptr;          // nullptr if the file has no meshlet hierarchy
+    const MeshletCluster* meshletClusters = nullptr;  // meshletCount + hierarchyMeshletCount entries
+};
+
+class MappedFile;
+
+struct ObjLoadParams
+{
+    // 1 parses on the calling thread, 0 uses one thread per hardware thread
+    uint32_t threadCount = 1;
+
+    // reorders the triangles for the post-transform vertex cache once parsed
+    VertexCacheOptimizer_T vertexCacheOptimizer = VertexCacheOptimizer_T::eNone;
+
+    // renumbers vertices in the order the indices first use them and drops unused ones, see optimizeVertexFetch
+    bool vertexFetchOrder = false;
+
+    // sorts triangle clusters outwards facing first once the vertex cache order is set, 0 skips it, see optimizeOverdraw
+    float overdrawThreshold = 0.0f;
+};
+
+ObjectBufferData loadObjFile(const std::string& filepath, const ObjLoadParams& params = {});
 
 MeshBufferData loadMeshFile(const std::string& filepath);
 
+// Describes the contents of a mapped .mesh file without copying anything
+MeshFileView viewMeshFile(const MappedFile& file);
+
+// Interleaves position/uv/normal into the layout loadMeshFile produces, encoding each attribute as format asks
+MeshBufferData toMeshBufferData(const ObjectBufferData& objectData, const VertexFormat& format = {});
+
+void writeMeshFile(const std::string& filepath, const MeshBufferData& meshData);
+
 #endif // LOADER_HPP
\ No newline at end of file
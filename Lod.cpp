@@ -0,0 +1,463 @@
+#include "Lod.hpp"
+#include "Loader.hpp"
+#include "Defines.hpp"
+
+#include <math.h>
+#include <string.h>
+#include <chrono>
+#include <algorithm>
+
+// Symmetric 4x4 error quadric : error(p) = p A p + 2 b p + c, weight is the area it was built from
+struct Quadric
+{
+    double a00 = 0.0, a01 = 0.0, a02 = 0.0, a11 = 0.0, a12 = 0.0, a22 = 0.0;
+    double b0 = 0.0, b1 = 0.0, b2 = 0.0;
+    double c = 0.0;
+    double weight = 0.0;
+
+    // plane n.p + d = 0, n unit length
+    void addPlane(const glm::dvec3& n, double d, double w)
+    {
+        a00 += w * n.x * n.x; a01 += w * n.x * n.y; a02 += w * n.x * n.z;
+        a11 += w * n.y * n.y; a12 += w * n.y * n.z; a22 += w * n.z * n.z;
+        b0 += w * n.x * d; b1 += w * n.y * d; b2 += w * n.z * d;
+        c += w * d * d;
+        weight += w;
+    }
+
+    void add(const Quadric& q)
+    {
+        a00 += q.a00; a01 += q.a01; a02 += q.a02; a11 += q.a11; a12 += q.a12; a22 += q.a22;
+        b0 += q.b0; b1 += q.b1; b2 += q.b2;
+        c += q.c;
+        weight += q.weight;
+    }
+
+    // weighted mean squared distance to the planes, as a distance
+    double getError(const glm::dvec3& p) const
+    {
+        const double rx = a00 * p.x + a01 * p.y + a02 * p.z;
+        const double ry = a01 * p.x + a11 * p.y + a12 * p.z;
+        const double rz = a02 * p.x + a12 * p.y + a22 * p.z;
+        const double e = rx * p.x + ry * p.y + rz * p.z + 2.0 * (b0 * p.x + b1 * p.y + b2 * p.z) + c;
+
+        return (weight > 0.0) ? sqrt(std::max(e, 0.0) / weight) : 0.0;
+    }
+};
+
+// Border edges weigh this much more than the surface around them
+constexpr double LOD_BORDER_WEIGHT = 10.0;
+
+// Collapsing an edge may not turn a triangle normal by more than this, as a cosine
+constexpr double LOD_MIN_NORMAL_COSINE = 0.0;
+
+static glm::dvec3 toDouble(const glm::vec3& v)
+{
+    return glm::dvec3(v.x, v.y, v.z);
+}
+
+std::vector<uint32_t> buildPositionRemap(const Vertex* vertices, size_t vertexCount)
+{
+    std::vector<uint32_t> order(vertexCount);
+    for (size_t v = 0; v < vertexCount; ++v)
+        order[v] = static_cast<uint32_t>(v);
+
+    auto less = [&](uint32_t a, uint32_t b)
+    {
+        const glm::vec3& pa = vertices[a].pos;
+        const glm::vec3& pb = vertices[b].pos;
+        if (pa.x != pb.x) return pa.x < pb.x;
+        if (pa.y != pb.y) return pa.y < pb.y;
+        if (pa.z != pb.z) return pa.z < pb.z;
+        return a < b;
+    };
+    std::sort(order.begin(), order.end(), less);
+
+    std::vector<uint32_t> remap(vertexCount);
+    for (size_t i = 0; i < vertexCount; ++i)
+    {
+        const bool samePosition = (i > 0) && (vertices[order[i]].pos == vertices[order[i - 1]].pos);
+        remap[order[i]] = samePosition ? remap[order[i - 1]] : order[i];
+    }
+
+    return remap;
+}
+
+// position -> triangle adjacency over the current triangle list
+struct PositionAdjacency
+{
+    std::vector<uint32_t> offsets;
+    std::vector<uint32_t> triangles;
+};
+
+static void buildPositionAdjacency(const std::vector<uint32_t>& triangles, size_t vertexCount, PositionAdjacency& adjacency)
+{
+    adjacency.offsets.assign(vertexCount + 1, 0);
+    adjacency.triangles.resize(triangles.size());
+
+    for (uint32_t p : triangles)
+        adjacency.offsets[p + 1]++;
+
+    for (size_t v = 0; v < vertexCount; ++v)
+        adjacency.offsets[v + 1] += adjacency.offsets[v];
+
+    std::vector<uint32_t> fill(adjacency.offsets.begin(), adjacency.offsets.end() - 1);
+    for (size_t i = 0; i < triangles.size(); ++i)
+        adjacency.triangles[fill[triangles[i]]++] = static_cast<uint32_t>(i / 3);
+}
+
+struct Collapse
+{
+    uint32_t from;
+    uint32_t to;
+    double error;
+};
+
+static double getCollapseError(const std::vector<Quadric>& quadrics, const Vertex* vertices, uint32_t from, uint32_t to)
+{
+    Quadric q = quadrics[from];
+    q.add(quadrics[to]);
+    return q.getError(toDouble(vertices[to].pos));
+}
+
+// Rejects a collapse that would flip or fold one of the triangles around from
+static bool isCollapseValid(const std::vector<uint32_t>& triangles, const PositionAdjacency& adjacency, const Vertex* vertices, uint32_t from, uint32_t to)
+{
+    for (uint32_t a = adjacency.offsets[from]; a < adjacency.offsets[from + 1]; ++a)
+    {
+        const uint32_t* triangle = &triangles[adjacency.triangles[a] * 3];
+        if (triangle[0] == to || triangle[1] == to || triangle[2] == to)
+            continue;
+
+        glm::dvec3 p[3];
+        for (uint32_t k = 0; k < 3; ++k)
+            p[k] = toDouble(vertices[triangle[k]].pos);
+
+        const glm::dvec3 before = glm::cross(p[1] - p[0], p[2] - p[0]);
+        for (uint32_t k = 0; k < 3; ++k)
+        {
+            if (triangle[k] == from)
+                p[k] = toDouble(vertices[to].pos);
+        }
+        const glm::dvec3 after = glm::cross(p[1] - p[0], p[2] - p[0]);
+
+        if (glm::dot(before, after) <= LOD_MIN_NORMAL_COSINE * glm::length(before) * glm::length(after))
+            return false;
+    }
+
+    return true;
+}
+
+// Vertex at position root whose attributes are closest to those of vertex v
+static uint32_t findClosestWedge(const Vertex* vertices, const std::vector<uint32_t>& wedgeOffsets, const std::vector<uint32_t>& wedges, uint32_t root, uint32_t v)
+{
+    uint32_t best = root;
+    float bestDistance = INFINITY;
+    for (uint32_t w = wedgeOffsets[root]; w < wedgeOffsets[root + 1]; ++w)
+    {
+        const Vertex& candidate = vertices[wedges[w]];
+        const glm::vec3 dn = candidate.normal - vertices[v].normal;
+        const glm::vec2 duv = candidate.uv - vertices[v].uv;
+        const float distance = glm::dot(dn, dn) + glm::dot(duv, duv);
+        if (distance < bestDistance)
+        {
+            bestDistance = distance;
+            best = wedges[w];
+        }
+    }
+
+    return best;
+}
+
+std::vector<uint32_t> simplifyMesh(const uint32_t* indices, size_t indexCount, const Vertex* vertices, size_t vertexCount, size_t targetIndexCount, float maxError, float* error, const uint8_t* vertexLock)
+{
+    assert(indexCount % 3 == 0);
+
+    *error = 0.0f;
+
+    const std::vector<uint32_t> positionRemap = buildPositionRemap(vertices, vertexCount);
+
+    // triangles over positions, and the input vertex of every corner to pick attributes from
+    std::vector<uint32_t> triangles;
+    std::vector<uint32_t> corners;
+    triangles.reserve(indexCount);
+    corners.reserve(indexCount);
+    for (size_t i = 0; i < indexCount; i += 3)
+    {
+        const uint32_t a = positionRemap[indices[i + 0]];
+        const uint32_t b = positionRemap[indices[i + 1]];
+        const uint32_t c = positionRemap[indices[i + 2]];
+        if (a == b || b == c || c == a)
+            continue;
+
+        triangles.insert(triangles.end(), { a, b, c });
+        corners.insert(corners.end(), indices + i, indices + i + 3);
+    }
+
+    std::vector<Quadric> quadrics(vertexCount);
+    for (size_t i = 0; i < triangles.size(); i += 3)
+    {
+        const glm::dvec3 p0 = toDouble(vertices[triangles[i + 0]].pos);
+        const glm::dvec3 p1 = toDouble(vertices[triangles[i + 1]].pos);
+        const glm::dvec3 p2 = toDouble(vertices[triangles[i + 2]].pos);
+
+        const glm::dvec3 cross = glm::cross(p1 - p0, p2 - p0);
+        const double length = glm::length(cross);
+        if (length == 0.0)
+            continue;
+
+        const glm::dvec3 n = cross / length;
+        Quadric q;
+        q.addPlane(n, -glm::dot(n, p0), length * 0.5);
+
+        for (uint32_t k = 0; k < 3; ++k)
+            quadrics[triangles[i + k]].add(q);
+    }
+
+    // border edges are used by one triangle only, the opposite half edge does not exist
+    {
+        std::vector<uint64_t> halfEdges;
+        halfEdges.reserve(triangles.size());
+        for (size_t i = 0; i < triangles.size(); ++i)
+        {
+            const uint32_t a = triangles[i];
+            const uint32_t b = triangles[(i % 3 == 2) ? i - 2 : i + 1];
+            halfEdges.push_back((uint64_t(a) << 32) | b);
+        }
+        std::sort(halfEdges.begin(), halfEdges.end());
+
+        for (size_t i = 0; i < triangles.size(); ++i)
+        {
+            const uint32_t a = triangles[i];
+            const uint32_t b = triangles[(i % 3 == 2) ? i - 2 : i + 1];
+            const uint32_t c = triangles[(i % 3 == 0) ? i + 2 : i - 1];
+            if (std::binary_search(halfEdges.begin(), halfEdges.end(), (uint64_t(b) << 32) | a))
+                continue;
+
+            // plane through the edge, perpendicular to the triangle
+            const glm::dvec3 pa = toDouble(vertices[a].pos);
+            const glm::dvec3 edge = toDouble(vertices[b].pos) - pa;
+            const glm::dvec3 normal = glm::cross(edge, toDouble(vertices[c].pos) - pa);
+            const glm::dvec3 perpendicular = glm::cross(edge, normal);
+            const double length = glm::length(perpendicular);
+            if (length == 0.0)
+                continue;
+
+            const glm::dvec3 n = perpendicular / length;
+            Quadric q;
+            q.addPlane(n, -glm::dot(n, pa), LOD_BORDER_WEIGHT * glm::dot(edge, edge));
+
+            quadrics[a].add(q);
+            quadrics[b].add(q);
+        }
+    }
+
+    // a position is locked when any of its vertices is
+    std::vector<uint8_t> positionLock(vertexCount, 0);
+    if (vertexLock != nullptr)
+    {
+        for (size_t v = 0; v < vertexCount; ++v)
+            positionLock[positionRemap[v]] |= vertexLock[v];
+    }
+
+    // collapsed[p] is the position p was moved to, p itself while it is alive
+    std::vector<uint32_t> collapsed(vertexCount);
+    for (size_t v = 0; v < vertexCount; ++v)
+        collapsed[v] = static_cast<uint32_t>(v);
+
+    PositionAdjacency adjacency;
+    std::vector<Collapse> collapses;
+    std::vector<uint64_t> edges;
+    std::vector<uint8_t> locked(vertexCount);
+
+    // every pass collapses a set of independent edges, cheapest first
+    while (triangles.size() > targetIndexCount)
+    {
+        edges.clear();
+        for (size_t i = 0; i < triangles.size(); ++i)
+        {
+            const uint32_t a = triangles[i];
+            const uint32_t b = triangles[(i % 3 == 2) ? i - 2 : i + 1];
+            edges.push_back((uint64_t(std::min(a, b)) << 32) | std::max(a, b));
+        }
+        std::sort(edges.begin(), edges.end());
+        edges.erase(std::unique(edges.begin(), edges.end()), edges.end());
+
+        collapses.clear();
+        for (uint64_t edge : edges)
+        {
+            const uint32_t a = static_cast<uint32_t>(edge >> 32);
+            const uint32_t b = static_cast<uint32_t>(edge);
+            if (positionLock[a] && positionLock[b])
+                continue;
+
+            const double errorAB = positionLock[a] ? INFINITY : getCollapseError(quadrics, vertices, a, b);
+            const double errorBA = positionLock[b] ? INFINITY : getCollapseError(quadrics, vertices, b, a);
+            collapses.push_back((errorAB <= errorBA) ? Collapse { a, b, errorAB } : Collapse { b, a, errorBA });
+        }
+        std::sort(collapses.begin(), collapses.end(), [](const Collapse& x, const Collapse& y) { return x.error < y.error; });
+
+        buildPositionAdjacency(triangles, vertexCount, adjacency);
+        std::fill(locked.begin(), locked.end(), 0);
+
+        // a collapse removes the triangles that hold both ends of the edge
+        const size_t triangleGoal = (triangles.size() - targetIndexCount) / 3;
+        size_t removed = 0;
+        size_t collapseCount = 0;
+
+        for (const Collapse& collapse : collapses)
+        {
+            if (collapse.error > maxError || removed >= triangleGoal)
+                break;
+
+            if (locked[collapse.from] || locked[collapse.to])
+                continue;
+
+            if (!isCollapseValid(triangles, adjacency, vertices, collapse.from, collapse.to))
+                continue;
+
+            collapsed[collapse.from] = collapse.to;
+            quadrics[collapse.to].add(quadrics[collapse.from]);
+            *error = std::max(*error, static_cast<float>(collapse.error));
+            collapseCount++;
+
+            // the triangles around from change shape, none of their vertices may move again this pass
+            for (uint32_t a = adjacency.offsets[collapse.from]; a < adjacency.offsets[collapse.from + 1]; ++a)
+            {
+                const uint32_t* triangle = &triangles[adjacency.triangles[a] * 3];
+                const bool hasTo = (triangle[0] == collapse.to || triangle[1] == collapse.to || triangle[2] == collapse.to);
+                removed += hasTo ? 1 : 0;
+
+                for (uint32_t k = 0; k < 3; ++k)
+                    locked[triangle[k]] = 1;
+            }
+        }
+
+        if (collapseCount == 0)
+            break;
+
+        // from and to were locked, so one step resolves every position
+        size_t write = 0;
+        for (size_t i = 0; i < triangles.size(); i += 3)
+        {
+            const uint32_t a = collapsed[triangles[i + 0]];
+            const uint32_t b = collapsed[triangles[i + 1]];
+            const uint32_t c = collapsed[triangles[i + 2]];
+            if (a == b || b == c || c == a)
+                continue;
+
+            triangles[write + 0] = a;
+            triangles[write + 1] = b;
+            triangles[write + 2] = c;
+            memcpy(&corners[write], &corners[i], sizeof(uint32_t) * 3);
+            write += 3;
+        }
+        triangles.resize(write);
+        corners.resize(write);
+    }
+
+    // vertices sharing each position, to carry attributes over
+    std::vector<uint32_t> wedgeOffsets(vertexCount + 1, 0);
+    std::vector<uint32_t> wedges(vertexCount);
+    for (size_t v = 0; v < vertexCount; ++v)
+        wedgeOffsets[positionRemap[v] + 1]++;
+    for (size_t v = 0; v < vertexCount; ++v)
+        wedgeOffsets[v + 1] += wedgeOffsets[v];
+    {
+        std::vector<uint32_t> fill(wedgeOffsets.begin(), wedgeOffsets.end() - 1);
+        for (size_t v = 0; v < vertexCount; ++v)
+            wedges[fill[positionRemap[v]]++] = static_cast<uint32_t>(v);
+    }
+
+    std::vector<uint32_t> result(triangles.size());
+    for (size_t i = 0; i < triangles.size(); ++i)
+    {
+        const uint32_t v = corners[i];
+        result[i] = (positionRemap[v] == triangles[i]) ? v : findClosestWedge(vertices, wedgeOffsets, wedges, triangles[i], v);
+    }
+
+    return result;
+}
+
+std::vector<MeshLod> buildLodChain(std::vector<uint32_t>& indices, const Vertex* vertices, size_t vertexCount, const LodBuildParams& params)
+{
+    assert(indices.size() % 3 == 0);
+    assert(params.reduction > 0.0f && params.reduction < 1.0f);
+
+    const auto start = std::chrono::steady_clock::now();
+
+    const uint32_t baseIndexCount = static_cast<uint32_t>(indices.size());
+    std::vector<MeshLod> lods { { 0, baseIndexCount, 0.0f, 0 } };
+
+    if (vertexCount == 0 || baseIndexCount == 0)
+        return lods;
+
+    const PositionQuantization bounds = computePositionQuantization(vertices, vertexCount);
+    const float diagonal = sqrtf(bounds.scale[0] * bounds.scale[0] + bounds.scale[1] * bounds.scale[1] + bounds.scale[2] * bounds.scale[2]);
+    const float maxError = params.maxError * diagonal;
+
+    while (lods.size() < params.maxLodCount && lods.back().indexCount / 3 > params.minTriangleCount)
+    {
+        const MeshLod& previous = lods.back();
+        const size_t target = static_cast<size_t>(previous.indexCount / 3 * params.reduction) * 3;
+
+        // each level is simplified from the previous one, which is cheaper than from the full mesh,
+        // so its error bound is the previous one plus its own
+        float error = 0.0f;
+        std::vector<uint32_t> lodIndices = simplifyMesh(indices.data() + previous.indexOffset, previous.indexCount, vertices, vertexCount, std::max<size_t>(target, 3), maxError - previous.error, &error);
+
+        // less than 10% fewer triangles is not worth a level
+        if (lodIndices.empty() || lodIndices.size() * 10 > size_t(previous.indexCount) * 9)
+            break;
+
+        optimizeVertexCache(lodIndices.data(), lodIndices.size(), vertexCount, params.vertexCacheOptimizer);
+
+        lods.push_back({
+            .indexOffset = static_cast<uint32_t>(indices.size()),
+            .indexCount = static_cast<uint32_t>(lodIndices.size()),
+            .error = previous.error + error,
+            .reserved = 0,
+        });
+        indices.insert(indices.end(), lodIndices.begin(), lodIndices.end());
+    }
+
+    const double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    LOG("buildLodChain : %zu levels in %.2f ms\n", lods.size(), ms);
+    for (size_t i = 0; i < lods.size(); ++i)
+    {
+        LOG("  LOD %zu : %u triangles, error %.6g (%.4f%% of the bounds diagonal)\n", i, lods[i].indexCount / 3, lods[i].error, (diagonal > 0.0f) ? 100.0f * lods[i].error / diagonal : 0.0f);
+    }
+
+    return lods;
+}
+
+std::vector<MeshLod> getMeshLods(const MeshBufferData& meshData)
+{
+    if (meshData.lods.empty())
+        return { { 0, static_cast<uint32_t>(meshData.indices.size()), 0.0f, 0 } };
+
+    return meshData.lods;
+}
+
+float getPixelsPerUnit(const glm::mat4& projMatrix, float viewDepth, uint32_t viewportHeight)
+{
+    // clip w is -z for a perspective projection and 1 for an orthographic one
+    const bool perspective = (projMatrix[2][3] != 0.0f);
+    const float scale = fabsf(projMatrix[1][1]) * 0.5f * viewportHeight;
+
+    return perspective ? scale / std::max(viewDepth, 1e-6f) : scale;
+}
+
+uint32_t selectLod(const MeshLod* lods, uint32_t lodCount, float pixelsPerUnit, float maxPixelError)
+{
+    uint32_t selected = 0;
+    for (uint32_t i = 1; i < lodCount; ++i)
+    {
+        if (lods[i].error * pixelsPerUnit > maxPixelError)
+            break;
+
+        selected = i;
+    }
+
+    return selected;
+}
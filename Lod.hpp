@@ -0,0 +1,71 @@
+#ifndef LOD_HPP
+#define LOD_HPP
+
+#include <stdint.h>
+#include <stddef.h>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+#include "VertexCache.hpp"
+
+struct Vertex;
+struct MeshBufferData;
+
+constexpr uint32_t LOD_MAX_COUNT = 8;
+
+// One level of detail : a range of the shared index buffer, all levels use the same vertices
+struct MeshLod
+{
+    uint32_t indexOffset;
+    uint32_t indexCount;
+    float error;        // object space distance the level may be off the full mesh by, 0 for the full mesh
+    uint32_t reserved;
+};
+
+static_assert(sizeof(MeshLod) == 16, "MeshLod layout is part of the file format");
+
+struct LodBuildParams
+{
+    uint32_t maxLodCount = LOD_MAX_COUNT; // including the full mesh
+    float reduction = 0.5f;               // triangle count of a level relative to the previous one
+    uint32_t minTriangleCount = 32;       // no level is simplified further once it is this small
+    float maxError = 0.05f;               // relative to the bounds diagonal, no collapse goes past it
+    VertexCacheOptimizer_T vertexCacheOptimizer = VertexCacheOptimizer_T::eTipsify;
+};
+
+/*
+ * Edge collapse simplification driven by quadric error metrics (Garland and Heckbert 1997).
+ *
+ * Vertices sharing a position are simplified as one, so attribute seams do not stop it, and an
+ * edge always collapses onto one of its endpoints : the result indexes the input vertices and
+ * needs no vertex buffer of its own. Where a position collapses, each corner takes the vertex
+ * at the kept position whose normal and uv are closest to its own. Border edges are held in
+ * place by extra quadrics and collapses that flip a triangle are rejected.
+ *
+ * Collapses stop at targetIndexCount or before one would exceed maxError, an object space
+ * distance. error receives the largest error of the collapses done. Positions of the vertices
+ * vertexLock marks never move, which keeps the border of a part simplified on its own in place.
+ */
+std::vector<uint32_t> simplifyMesh(const uint32_t* indices, size_t indexCount, const Vertex* vertices, size_t vertexCount, size_t targetIndexCount, float maxError, float* error, const uint8_t* vertexLock = nullptr);
+
+// Maps every vertex to the first vertex with the same position
+std::vector<uint32_t> buildPositionRemap(const Vertex* vertices, size_t vertexCount);
+
+/*
+ * Appends coarser levels to indices, which holds the full mesh on input, each simplified from
+ * the previous level and optimized for the vertex cache. Returns the level table, the full mesh
+ * first. Stops early when a level gets too small or simplification stops making progress.
+ */
+std::vector<MeshLod> buildLodChain(std::vector<uint32_t>& indices, const Vertex* vertices, size_t vertexCount, const LodBuildParams& params = {});
+
+// The mesh levels, a single level covering all indices if it has no LOD table
+std::vector<MeshLod> getMeshLods(const MeshBufferData& meshData);
+
+// Pixels one object space unit covers at viewDepth, which an orthographic projection ignores
+float getPixelsPerUnit(const glm::mat4& projMatrix, float viewDepth, uint32_t viewportHeight);
+
+// Coarsest level whose error stays within maxPixelError pixels on screen
+uint32_t selectLod(const MeshLod* lods, uint32_t lodCount, float pixelsPerUnit, float maxPixelError);
+
+#endif // LOD_HPP
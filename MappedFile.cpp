@@ -0,0 +1,50 @@
+#include "MappedFile.hpp"
+#include "Defines.hpp"
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+MappedFile::MappedFile(const std::string& filepath)
+{
+    const int fd = open(filepath.c_str(), O_RDONLY);
+    if (fd < 0)
+    {
+        EXIT("Failed to open file " << filepath);
+    }
+
+    struct stat fileStat {};
+    if (fstat(fd, &fileStat) != 0)
+    {
+        close(fd);
+        EXIT("Failed to stat file " << filepath);
+    }
+
+    fileSize = static_cast<size_t>(fileStat.st_size);
+
+    // mmap of a zero sized range fails, an empty file simply has no data
+    if (fileSize > 0)
+    {
+        void* mapping = mmap(nullptr, fileSize, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (mapping == MAP_FAILED)
+        {
+            close(fd);
+            EXIT("Failed to map file " << filepath);
+        }
+
+        // files are read front to back
+        madvise(mapping, fileSize, MADV_SEQUENTIAL);
+        fileData = static_cast<const char*>(mapping);
+    }
+
+    close(fd);
+}
+
+MappedFile::~MappedFile()
+{
+    if (fileData != nullptr)
+    {
+        munmap(const_cast<char*>(fileData), fileSize);
+    }
+}
@@ -0,0 +1,24 @@
+#ifndef MAPPED_FILE_HPP
+#define MAPPED_FILE_HPP
+
+#include <stddef.h>
+#include <string>
+
+// Read-only memory mapping of a whole file. The mapping lives as long as the object.
+class MappedFile
+{
+private:
+    const char* fileData = nullptr;
+    size_t fileSize = 0;
+public:
+    MappedFile(const std::string& filepath);
+    ~MappedFile();
+
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    const char* data() const { return fileData; }
+    size_t size() const { return fileSize; }
+};
+
+#endif // MAPPED_FILE_HPP
@@ -0,0 +1,50 @@
+#include "MeshFile.hpp"
+
+const MeshFileHeader* getMeshFileHeader(const void* data, size_t size)
+{
+    if (data == nullptr || size < sizeof(MeshFileHeader))
+        return nullptr;
+
+    const MeshFileHeader* header = static_cast<const MeshFileHeader*>(data);
+    if (header->magic != MESH_FILE_MAGIC || header->version != MESH_FILE_VERSION || header->headerSize < sizeof(MeshFileHeader))
+        return nullptr;
+
+    if (header->attribCount > MESH_FILE_MAX_ATTRIBUTES)
+        return nullptr;
+
+    const uint64_t tableEnd = header->headerSize + uint64_t(header->sectionCount) * sizeof(MeshFileSection);
+    if (tableEnd > size)
+        return nullptr;
+
+    const MeshFileSection* sections = reinterpret_cast<const MeshFileSection*>(static_cast<const char*>(data) + header->headerSize);
+    for (uint32_t i = 0; i < header->sectionCount; ++i)
+    {
+        const MeshFileSection& section = sections[i];
+        if (section.alignment == 0 || section.offset % section.alignment != 0)
+            return nullptr;
+        if (section.offset < tableEnd || section.size > size || section.offset > size - section.size)
+            return nullptr;
+    }
+
+    return header;
+}
+
+const void* getMeshFileSection(const MeshFileHeader* header, MeshSection_T type, uint64_t* size)
+{
+    const char* fileData = reinterpret_cast<const char*>(header);
+    const MeshFileSection* sections = reinterpret_cast<const MeshFileSection*>(fileData + header->headerSize);
+
+    for (uint32_t i = 0; i < header->sectionCount; ++i)
+    {
+        if (sections[i].type == static_cast<uint32_t>(type))
+        {
+            if (size != nullptr)
+                *size = sections[i].size;
+            return fileData + sections[i].offset;
+        }
+    }
+
+    if (size != nullptr)
+        *size = 0;
+    return nullptr;
+}
@@ -0,0 +1,92 @@
+#ifndef MESH_FILE_HPP
+#define MESH_FILE_HPP
+
+#include <stdint.h>
+#include <stddef.h>
+
+/*
+ * .mesh v2 layout
+ *
+ *   MeshFileHeader
+ *   MeshFileSection[header.sectionCount]
+ *   section data, each section starting at a multiple of its alignment
+ *
+ * Section contents are laid out exactly as the GPU buffers expect them, so a mapped file can
+ * be copied to the device section by section without touching the data on the CPU.
+ *
+ * v1 files have no header: u8 attribute count, u8 attribute ids, u32 vertex count, u32 index
+ * count, vertex floats, u32 indices and an optional u32 count + Meshlet trailer.
+ */
+
+constexpr uint32_t MESH_FILE_MAGIC   = 0x3248534D; // "MSH2"
+constexpr uint32_t MESH_FILE_VERSION = 2;
+
+// Offsets of buffers bound as storage/vertex/index buffers, covers minStorageBufferOffsetAlignment on all devices
+constexpr uint32_t MESH_SECTION_BUFFER_ALIGNMENT = 256;
+// Offsets of tables only read on the CPU
+constexpr uint32_t MESH_SECTION_TABLE_ALIGNMENT  = 16;
+
+constexpr uint32_t MESH_FILE_MAX_ATTRIBUTES = 16;
+
+enum class VertexInputAttribute_T
+{
+    ePosition = 0    , // 3x float32
+    eUv              , // 1, 2x float32
+    eNormal          , // 2, 3x float32
+    ePositionUnorm16 , // 3, 4x unorm16, xyz quantized against the mesh bounds (eVertexQuantization), w unused
+    eUvHalf          , // 4, 2x float16
+    eNormalOctSnorm16, // 5, 2x snorm16 octahedral
+    eNormalOctSnorm8 , // 6, 2x snorm8 octahedral
+};
+
+enum class MeshSection_T : uint32_t
+{
+    eVertices      = 0, // interleaved vertex attributes, header.vertexStride bytes per vertex
+    eIndices       = 1, // u32 triangle list
+    eMeshlets      = 2, // Meshlet[header.meshletCount]
+    eMeshletBounds = 3, // one bounds record per meshlet
+    eLods          = 4, // MeshLod[header.lodCount], ranges of eIndices from the full mesh to the coarsest level
+    eVertexQuantization = 5, // PositionQuantization, written when positions are ePositionUnorm16
+    ePositions     = 6, // positions only, when they are stored apart from the other attributes
+    eMeshletHierarchy = 7, // Meshlet[], the coarser levels of the meshlet hierarchy
+    eMeshletClusters  = 8, // MeshletCluster[], one per meshlet of eMeshlets then eMeshletHierarchy
+    eCount
+};
+
+struct MeshFileHeader
+{
+    uint32_t magic;
+    uint32_t version;
+    uint32_t headerSize;   // sizeof(MeshFileHeader), lets later versions grow the header
+    uint32_t sectionCount;
+
+    uint32_t vertexCount;
+    uint32_t vertexStride; // bytes
+    uint32_t indexCount;
+    uint32_t meshletCount;
+
+    uint32_t lodCount;
+    uint32_t attribCount;
+    uint32_t reserved[2];
+
+    uint8_t attribs[MESH_FILE_MAX_ATTRIBUTES]; // VertexInputAttribute_T, in vertex order
+};
+
+struct MeshFileSection
+{
+    uint32_t type;      // MeshSection_T
+    uint32_t alignment;
+    uint64_t offset;    // from the start of the file
+    uint64_t size;      // bytes
+};
+
+static_assert(sizeof(MeshFileHeader) == 64, "MeshFileHeader layout is part of the file format");
+static_assert(sizeof(MeshFileSection) == 24, "MeshFileSection layout is part of the file format");
+
+// Returns the header if data holds a valid v2 mesh file (section table in bounds and aligned), nullptr otherwise
+const MeshFileHeader* getMeshFileHeader(const void* data, size_t size);
+
+// Returns a pointer to the section inside data, or nullptr if the file does not have it
+const void* getMeshFileSection(const MeshFileHeader* header, MeshSection_T type, uint64_t* size);
+
+#endif // MESH_FILE_HPP
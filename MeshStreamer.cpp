@@ -0,0 +1,237 @@
+#include "MeshStreamer.hpp"
+#include "Defines.hpp"
+#include "MappedFile.hpp"
+
+#include <string.h>
+#include <chrono>
+
+static void submitSignaling(VkQueue queue, VkCommandBuffer commandBuffer, VkSemaphore timelineSemaphore, uint64_t timelineValue)
+{
+    const VkTimelineSemaphoreSubmitInfo timelineSubmitInfo {
+        .sType = VK_STRUCTURE_TYPE_TIMELINE_SEMAPHORE_SUBMIT_INFO,
+        .signalSemaphoreValueCount = 1,
+        .pSignalSemaphoreValues = &timelineValue,
+    };
+
+    const VkSubmitInfo submitInfo {
+        .sType = VK_STRUCTURE_TYPE_SUBMIT_INFO,
+        .pNext = &timelineSubmitInfo,
+        .commandBufferCount = 1u,
+        .pCommandBuffers = &commandBuffer,
+        .signalSemaphoreCount = 1u,
+        .pSignalSemaphores = &timelineSemaphore,
+    };
+
+    VK_CHECK(vkQueueSubmit(queue, 1u, &submitInfo, VK_NULL_HANDLE));
+}
+
+MeshStreamer::MeshStreamer(const MeshStreamerParams& _params)
+    : params { _params }
+    , sharedQueue { _params.transferQueue == _params.graphicsQueue }
+    , uploader { UploadManagerParams {
+        .device = _params.device,
+        .queue = _params.transferQueue,
+        .queueFamilyIndex = _params.transferQueueFamilyIndex,
+        .stagingBuffer = _params.stagingBuffer,
+        // the graphics queue belongs to the thread calling poll
+        .submit = (_params.transferQueue == _params.graphicsQueue)
+            ? [this](VkCommandBuffer commandBuffer, uint64_t timelineValue) { submit(commandBuffer, timelineValue); }
+            : std::function<void(VkCommandBuffer, uint64_t)> {},
+    }}
+{
+    LOG("MeshStreamer : %s queue, %.2f MB of staging memory\n", sharedQueue ? "shared graphics" : "dedicated transfer", params.stagingBuffer->size / (1024.0 * 1024.0));
+
+    loaderThread = std::thread(&MeshStreamer::run, this);
+}
+
+MeshStreamer::~MeshStreamer()
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopRequested = true;
+    }
+    requestAdded.notify_one();
+
+    // the loader thread finishes the mesh it is on, which may need poll to submit its copies
+    while (!loaderDone.load())
+    {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            submitPending();
+        }
+        std::this_thread::yield();
+    }
+    loaderThread.join();
+
+    submitPending();
+    uploader.waitIdle();
+
+    // meshes nobody polled
+    for (StreamedMesh& mesh : inFlight)
+    {
+        destroyBuffer(params.device, mesh.vertexBuffer);
+        destroyBuffer(params.device, mesh.indexBuffer);
+        destroyBuffer(params.device, mesh.positionBuffer);
+        destroyBuffer(params.device, mesh.meshletBuffer);
+        destroyBuffer(params.device, mesh.meshletBoundsBuffer);
+        destroyBuffer(params.device, mesh.meshletIndexBuffer);
+    }
+}
+
+void MeshStreamer::request(const std::string& path)
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        requests.push_back(path);
+    }
+    requestAdded.notify_one();
+}
+
+std::vector<StreamedMesh> MeshStreamer::poll()
+{
+    std::vector<StreamedMesh> ready;
+
+    std::lock_guard<std::mutex> lock(mutex);
+    submitPending();
+
+    uint64_t completedValue = 0;
+    VK_CHECK(vkGetSemaphoreCounterValue(params.device, uploader.getSemaphore(), &completedValue));
+
+    while (!inFlight.empty() && inFlight.front().timelineValue <= completedValue)
+    {
+        ready.push_back(std::move(inFlight.front()));
+        inFlight.pop_front();
+    }
+
+    return ready;
+}
+
+void MeshStreamer::run()
+{
+    while (true)
+    {
+        std::string path;
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            requestAdded.wait(lock, [&]() { return stopRequested || !requests.empty(); });
+            if (stopRequested)
+                break;
+
+            path = std::move(requests.front());
+            requests.pop_front();
+        }
+
+        StreamedMesh mesh = loadMesh(path);
+
+        std::lock_guard<std::mutex> lock(mutex);
+        inFlight.push_back(std::move(mesh));
+    }
+
+    loaderDone.store(true);
+}
+
+StreamedMesh MeshStreamer::loadMesh(const std::string& path)
+{
+    const auto start = std::chrono::steady_clock::now();
+
+    const MappedFile meshFile(path);
+    const MeshFileView meshView = viewMeshFile(meshFile);
+
+    StreamedMesh mesh;
+    mesh.path = path;
+    mesh.vertexCount = meshView.vertexCount;
+    mesh.indexCount = meshView.indexCount;
+    mesh.vertexFormat = meshView.vertexFormat;
+    mesh.positionQuantization = meshView.positionQuantization;
+
+    if (meshView.lods != nullptr)
+        mesh.lods.assign(meshView.lods, meshView.lods + meshView.lodCount);
+    else
+        mesh.lods = { { 0, meshView.indexCount, 0.0f, 0 } };
+
+    if (meshView.meshlets != nullptr)
+    {
+        mesh.meshlets.resize(meshView.meshletCount);
+        memcpy(mesh.meshlets.data(), meshView.meshlets, sizeof(Meshlet) * meshView.meshletCount);
+    }
+    else
+    {
+        // only the full mesh, coarser levels follow it in the index buffer
+        mesh.meshlets = buildMeshlets(static_cast<const uint32_t*>(meshView.indices) + mesh.lods[0].indexOffset, mesh.lods[0].indexCount, meshView.vertexCount);
+    }
+
+    // baked files carry bounds for their meshlets, the rest are computed from the decoded positions
+    std::vector<MeshletBounds> meshletBounds;
+    if (meshView.meshletBounds != nullptr)
+    {
+        meshletBounds.assign(meshView.meshletBounds, meshView.meshletBounds + meshView.meshletCount);
+    }
+    else
+    {
+        const uint8_t* vertices = static_cast<const uint8_t*>(meshView.vertices);
+        const uint8_t* positions = static_cast<const uint8_t*>(meshView.positions);
+        const uint32_t positionStride = getPositionStride(meshView.vertexFormat);
+
+        std::vector<Vertex> decoded(meshView.vertexCount);
+        for (uint32_t i = 0; i < meshView.vertexCount; ++i)
+            decoded[i] = decodeVertex(vertices + size_t(i) * meshView.vertexStride, meshView.vertexFormat, meshView.positionQuantization, (positions != nullptr) ? positions + size_t(i) * positionStride : nullptr);
+
+        meshletBounds = computeMeshletBounds(mesh.meshlets, decoded.data(), decoded.size());
+    }
+
+    const std::vector<uint32_t> meshletIndices = getMeshletIndicesStrided(mesh.meshlets);
+
+    const VkDeviceSize vertexBufferSize = VkDeviceSize(meshView.vertexCount) * meshView.vertexStride;
+    const VkDeviceSize indexBufferSize = sizeof(uint32_t) * VkDeviceSize(meshView.indexCount);
+    const VkDeviceSize positionBufferSize = VkDeviceSize(meshView.vertexCount) * getPositionStride(meshView.vertexFormat);
+    const VkDeviceSize meshletBufferSize = sizeof(Meshlet) * VkDeviceSize(mesh.meshlets.size());
+    const VkDeviceSize meshletBoundsBufferSize = sizeof(MeshletBounds) * VkDeviceSize(meshletBounds.size());
+    const VkDeviceSize meshletIndexBufferSize = sizeof(uint32_t) * VkDeviceSize(meshletIndices.size());
+
+    const uint32_t queueFamilyIndices[] { params.transferQueueFamilyIndex, params.graphicsQueueFamilyIndex };
+
+    // vertex and position streams are also storage buffers, the mesh shader path fetches them itself.
+    // Every buffer is a copy source too, defragmentation moves them by copying.
+    createBuffer(params.device, vertexBufferSize, VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_SRC_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, queueFamilyIndices, 2, mesh.vertexBuffer);
+    createBuffer(params.device, indexBufferSize, VK_BUFFER_USAGE_INDEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_SRC_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, queueFamilyIndices, 2, mesh.indexBuffer);
+    createBuffer(params.device, meshletBufferSize, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_SRC_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, queueFamilyIndices, 2, mesh.meshletBuffer);
+    createBuffer(params.device, meshletBoundsBufferSize, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_SRC_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, queueFamilyIndices, 2, mesh.meshletBoundsBuffer);
+    createBuffer(params.device, meshletIndexBufferSize, VK_BUFFER_USAGE_INDEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_SRC_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, queueFamilyIndices, 2, mesh.meshletIndexBuffer);
+
+    // regions of the mapped file go straight into staging memory
+    uploader.upload(mesh.vertexBuffer, 0, meshView.vertices, vertexBufferSize);
+    uploader.upload(mesh.indexBuffer, 0, meshView.indices, indexBufferSize);
+    uploader.upload(mesh.meshletBuffer, 0, mesh.meshlets.data(), meshletBufferSize);
+    uploader.upload(mesh.meshletBoundsBuffer, 0, meshletBounds.data(), meshletBoundsBufferSize);
+    uploader.upload(mesh.meshletIndexBuffer, 0, meshletIndices.data(), meshletIndexBufferSize);
+
+    if (meshView.positions != nullptr)
+    {
+        createBuffer(params.device, positionBufferSize, VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_SRC_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, queueFamilyIndices, 2, mesh.positionBuffer);
+        uploader.upload(mesh.positionBuffer, 0, meshView.positions, positionBufferSize);
+    }
+
+    mesh.timelineValue = uploader.flush();
+
+    const UploadStats stats = uploader.getStats();
+    LOG("MeshStreamer : %s (%.2f MB) staged in %.2f ms on the loader thread, %.2f MB in flight, %llu stalls (%.2f ms)\n", path.c_str(),
+        (vertexBufferSize + indexBufferSize + meshletBufferSize + meshletBoundsBufferSize + meshletIndexBufferSize + ((meshView.positions != nullptr) ? positionBufferSize : 0)) / (1024.0 * 1024.0),
+        std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count(),
+        stats.bytesInFlight / (1024.0 * 1024.0), static_cast<unsigned long long>(stats.stallCount), stats.stallMs);
+
+    return mesh;
+}
+
+void MeshStreamer::submit(VkCommandBuffer commandBuffer, uint64_t timelineValue)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    pendingSubmits.push_back({ commandBuffer, timelineValue });
+}
+
+void MeshStreamer::submitPending()
+{
+    for (const PendingSubmit& pending : pendingSubmits)
+        submitSignaling(params.transferQueue, pending.commandBuffer, uploader.getSemaphore(), pending.timelineValue);
+
+    pendingSubmits.clear();
+}
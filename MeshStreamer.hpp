@@ -0,0 +1,112 @@
+#ifndef MESH_STREAMER_HPP
+#define MESH_STREAMER_HPP
+
+#include <stdint.h>
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <vulkan/vulkan.h>
+
+#include "Resources.hpp"
+#include "Loader.hpp"
+#include "UploadManager.hpp"
+
+// A mesh whose buffers the streamer filled. Whoever polls it owns the buffers from then on.
+struct StreamedMesh
+{
+    std::string path;
+
+    Buffer vertexBuffer {};
+    Buffer indexBuffer {};
+    Buffer positionBuffer {}; // empty unless vertexFormat.separatePositions
+    Buffer meshletBuffer {};  // meshlets, for the mesh shader path
+    Buffer meshletBoundsBuffer {}; // one MeshletBounds per meshlet
+    Buffer meshletIndexBuffer {};  // getMeshletIndicesStrided, for the vertex path with occlusion culling
+
+    uint32_t vertexCount = 0;
+    uint32_t indexCount = 0;
+    VertexFormat vertexFormat;
+    PositionQuantization positionQuantization;
+
+    std::vector<MeshLod> lods;     // a single level covering all indices if the file has none
+    std::vector<Meshlet> meshlets; // built on the loader thread if the file has none
+
+    uint64_t timelineValue = 0;    // the streamer semaphore reaches it once the copies are done
+};
+
+struct MeshStreamerParams
+{
+    VkDevice device;
+    VkQueue transferQueue;
+    uint32_t transferQueueFamilyIndex;
+    VkQueue graphicsQueue;
+    uint32_t graphicsQueueFamilyIndex;
+    const Buffer* stagingBuffer; // persistently mapped, only the loader thread writes to it
+};
+
+/*
+ * Loads .mesh files on a thread of its own and copies them into device local buffers on the
+ * transfer queue, so the frame loop never waits for I/O or copies.
+ *
+ * Uploads go through an UploadManager using the staging buffer as a ring, one batch per mesh
+ * unless the mesh does not fit. Each batch signals the next value of the uploader timeline
+ * semaphore. poll reads its counter without waiting and hands out the meshes whose last copy is
+ * done; the graphics submission that first uses one still waits on its value, which costs nothing
+ * then but orders the memory accesses.
+ *
+ * Buffers are shared between the transfer and graphics families (VK_SHARING_MODE_CONCURRENT),
+ * so there are no ownership transfers. When the device has no second queue for transfers the
+ * loader thread only records the copies and poll submits them from the thread that owns the
+ * graphics queue.
+ */
+class MeshStreamer
+{
+private:
+    struct PendingSubmit
+    {
+        VkCommandBuffer commandBuffer;
+        uint64_t timelineValue;
+    };
+
+    MeshStreamerParams params;
+    bool sharedQueue = false;
+
+    UploadManager uploader; // loader thread only, besides getStats
+
+    std::mutex mutex;
+    std::condition_variable requestAdded;
+    std::deque<std::string> requests;
+    std::deque<StreamedMesh> inFlight;        // ordered by timelineValue
+    std::vector<PendingSubmit> pendingSubmits; // sharedQueue only
+    bool stopRequested = false;
+
+    std::atomic<bool> loaderDone { false };
+    std::thread loaderThread;
+
+    void run();
+    StreamedMesh loadMesh(const std::string& path);
+    void submit(VkCommandBuffer commandBuffer, uint64_t timelineValue); // sharedQueue only
+    void submitPending(); // mutex held
+public:
+    MeshStreamer(const MeshStreamerParams& params);
+    ~MeshStreamer();
+
+    MeshStreamer(const MeshStreamer&) = delete;
+    MeshStreamer& operator=(const MeshStreamer&) = delete;
+
+    // Queues a file for the loader thread, files are loaded in request order
+    void request(const std::string& path);
+
+    // Meshes whose copies are done, never waits for the loader thread or the GPU
+    std::vector<StreamedMesh> poll();
+
+    VkSemaphore getSemaphore() const { return uploader.getSemaphore(); }
+    UploadStats getUploadStats() const { return uploader.getStats(); }
+};
+
+#endif // MESH_STREAMER_HPP
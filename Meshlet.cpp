@@ -0,0 +1,538 @@
+#include "Meshlet.hpp"
+#include "Loader.hpp"
+#include "Defines.hpp"
+#include "VertexCache.hpp"
+
+#include <float.h>
+#include <math.h>
+#include <chrono>
+#include <algorithm>
+
+static constexpr uint8_t INVALID_LOCAL_IDX = 0xff;
+
+static void appendMeshlets(const uint32_t* indices, size_t indexCount, size_t vertexCount, const MeshletBuildParams& params, std::vector<Meshlet>& meshlets)
+{
+    assert(indexCount % 3 == 0);
+    assert(params.maxVertices >= 3 && params.maxVertices <= MESHLET_MAX_VERTICES);
+    assert(params.maxTriangles >= 1 && params.maxTriangles <= MESHLET_MAX_TRIANGLES);
+
+    const size_t triangleCount = indexCount / 3;
+
+    // vertex -> triangle adjacency, stored as one flat array with per-vertex offsets
+    std::vector<uint32_t> adjacencyOffsets(vertexCount + 1, 0);
+    for (size_t i = 0; i < indexCount; ++i)
+    {
+        assert(indices[i] < vertexCount);
+        adjacencyOffsets[indices[i] + 1]++;
+    }
+
+    for (size_t v = 0; v < vertexCount; ++v)
+    {
+        adjacencyOffsets[v + 1] += adjacencyOffsets[v];
+    }
+
+    std::vector<uint32_t> adjacency(indexCount);
+    {
+        std::vector<uint32_t> fill(adjacencyOffsets.begin(), adjacencyOffsets.end() - 1);
+        for (size_t i = 0; i < indexCount; ++i)
+        {
+            adjacency[fill[indices[i]]++] = static_cast<uint32_t>(i / 3);
+        }
+    }
+
+    std::vector<uint8_t> emitted(triangleCount, 0);
+    std::vector<uint8_t> localIdx(vertexCount, INVALID_LOCAL_IDX);
+
+    // Growth candidates of the current meshlet, bucketed by how many vertices they would add.
+    // Entries go stale when a triangle is emitted or moves to a lower bucket and are dropped lazily.
+    std::vector<uint32_t> candidates[3];
+    size_t candidateHead[3] = { 0, 0, 0 };
+
+    meshlets.reserve(meshlets.size() + triangleCount / params.maxTriangles + 1);
+
+    Meshlet meshlet {};
+    size_t seedCursor = 0;
+
+    auto newVertexCount = [&](uint32_t tri)
+    {
+        uint32_t count = 0;
+        for (uint32_t k = 0; k < 3; ++k)
+        {
+            count += (localIdx[indices[tri * 3 + k]] == INVALID_LOCAL_IDX) ? 1 : 0;
+        }
+        return count;
+    };
+
+    auto appendTriangle = [&](uint32_t tri)
+    {
+        for (uint32_t k = 0; k < 3; ++k)
+        {
+            const uint32_t v = indices[tri * 3 + k];
+            if (localIdx[v] == INVALID_LOCAL_IDX)
+            {
+                localIdx[v] = meshlet.vertexCount;
+                meshlet.vertices[meshlet.vertexCount++] = v;
+
+                // every live triangle touching the new vertex needs one vertex less now
+                for (uint32_t a = adjacencyOffsets[v]; a < adjacencyOffsets[v + 1]; ++a)
+                {
+                    const uint32_t neighbour = adjacency[a];
+                    if (!emitted[neighbour] && neighbour != tri)
+                        candidates[newVertexCount(neighbour)].push_back(neighbour);
+                }
+            }
+
+            meshlet.indices[meshlet.triangleCount * 3 + k] = localIdx[v];
+        }
+
+        meshlet.triangleCount++;
+        emitted[tri] = 1;
+    };
+
+    auto flushMeshlet = [&]()
+    {
+        for (uint32_t i = 0; i < meshlet.vertexCount; ++i)
+        {
+            localIdx[meshlet.vertices[i]] = INVALID_LOCAL_IDX;
+        }
+
+        meshlets.push_back(meshlet);
+        meshlet = {};
+
+        for (uint32_t b = 0; b < 3; ++b)
+        {
+            candidates[b].clear();
+            candidateHead[b] = 0;
+        }
+    };
+
+    for (size_t emittedCount = 0; emittedCount < triangleCount; ++emittedCount)
+    {
+        // Take the candidate that adds the fewest vertices. Within a bucket candidates are taken
+        // in the order they were found, so the meshlet grows outwards in rings around its seed.
+        uint32_t best = UINT32_MAX;
+        uint32_t blocked = UINT32_MAX;
+
+        for (uint32_t b = 0; b < 3 && best == UINT32_MAX; ++b)
+        {
+            while (candidateHead[b] < candidates[b].size())
+            {
+                const uint32_t tri = candidates[b][candidateHead[b]];
+                if (emitted[tri] || newVertexCount(tri) != b)
+                {
+                    candidateHead[b]++;
+                    continue;
+                }
+
+                if (meshlet.vertexCount + b > params.maxVertices)
+                {
+                    blocked = tri;
+                    break;
+                }
+
+                best = tri;
+                candidateHead[b]++;
+                break;
+            }
+        }
+
+        if (best == UINT32_MAX)
+        {
+            if (blocked != UINT32_MAX)
+            {
+                // Vertex limit reached, start the next meshlet right next to this one
+                best = blocked;
+                flushMeshlet();
+            }
+            else
+            {
+                // Region exhausted, continue with the next unused triangle in index order
+                while (emitted[seedCursor])
+                    ++seedCursor;
+
+                best = static_cast<uint32_t>(seedCursor);
+
+                if (meshlet.vertexCount + newVertexCount(best) > params.maxVertices)
+                    flushMeshlet();
+            }
+        }
+
+        appendTriangle(best);
+
+        if (meshlet.triangleCount == params.maxTriangles)
+            flushMeshlet();
+    }
+
+    if (meshlet.triangleCount > 0)
+        flushMeshlet();
+}
+
+std::vector<Meshlet> buildMeshlets(const uint32_t* indices, size_t indexCount, size_t vertexCount, const MeshletBuildParams& params)
+{
+    const auto start = std::chrono::steady_clock::now();
+
+    std::vector<Meshlet> meshlets;
+    appendMeshlets(indices, indexCount, vertexCount, params, meshlets);
+
+    const size_t triangleCount = indexCount / 3;
+    const double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+    size_t meshletVertexCount = 0;
+    for (const Meshlet& m : meshlets)
+        meshletVertexCount += m.vertexCount;
+
+    LOG("buildMeshlets : %zu triangles -> %zu meshlets in %.2f ms (%.2f Mtri/s, %.3f vertices/triangle)\n",
+        triangleCount, meshlets.size(), ms,
+        (ms > 0.0) ? (triangleCount / 1000.0) / ms : 0.0,
+        (triangleCount > 0) ? double(meshletVertexCount) / triangleCount : 0.0);
+
+    return meshlets;
+}
+
+std::vector<Meshlet> buildMeshlets(const ObjectBufferData& objectData, const MeshletBuildParams& params)
+{
+    return buildMeshlets(objectData.indices.data(), objectData.indices.size(), objectData.vertices.size(), params);
+}
+
+std::vector<Meshlet> buildMeshlets(const MeshBufferData& meshData, const MeshletBuildParams& params)
+{
+    // meshlets cover the full mesh only
+    const MeshLod fullMesh = getMeshLods(meshData)[0];
+    return buildMeshlets(meshData.indices.data() + fullMesh.indexOffset, fullMesh.indexCount, meshData.vertexCount, params);
+}
+
+std::vector<uint32_t> getMeshletIndices(const std::vector<Meshlet>& meshlets)
+{
+    std::vector<uint32_t> indices;
+
+    for (const Meshlet& meshlet : meshlets)
+    {
+        for (uint32_t t = 0; t < meshlet.triangleCount * 3u; ++t)
+        {
+            indices.push_back(meshlet.vertices[meshlet.indices[t]]);
+        }
+    }
+
+    return indices;
+}
+
+std::vector<uint32_t> getMeshletIndicesStrided(const std::vector<Meshlet>& meshlets)
+{
+    std::vector<uint32_t> indices(meshlets.size() * MESHLET_MAX_TRIANGLES * 3, 0u);
+
+    for (size_t i = 0; i < meshlets.size(); ++i)
+    {
+        const Meshlet& meshlet = meshlets[i];
+        uint32_t* meshletIndices = indices.data() + i * MESHLET_MAX_TRIANGLES * 3;
+
+        for (uint32_t t = 0; t < meshlet.triangleCount * 3u; ++t)
+        {
+            meshletIndices[t] = meshlet.vertices[meshlet.indices[t]];
+        }
+    }
+
+    return indices;
+}
+
+void reorderByMeshlets(ObjectBufferData& objectData, std::vector<Meshlet>& meshlets)
+{
+    std::vector<uint32_t> indices = getMeshletIndices(meshlets);
+    assert(indices.size() == objectData.indices.size());
+
+    objectData.indices = std::move(indices);
+    optimizeVertexFetch(objectData, &meshlets);
+}
+
+// Smallest sphere around both spheres, xyz center, w radius
+static glm::vec4 mergeSpheres(const glm::vec4& a, const glm::vec4& b)
+{
+    const glm::vec3 d = glm::vec3(b) - glm::vec3(a);
+    const float distance = glm::length(d);
+
+    if (distance + b.w <= a.w)
+        return a;
+    if (distance + a.w <= b.w)
+        return b;
+
+    const float radius = (distance + a.w + b.w) * 0.5f;
+    return glm::vec4(glm::vec3(a) + d * ((radius - a.w) / distance), radius);
+}
+
+static glm::vec4 getMeshletSphere(const Meshlet& meshlet, const Vertex* vertices)
+{
+    glm::vec3 lo = vertices[meshlet.vertices[0]].pos;
+    glm::vec3 hi = lo;
+    for (uint32_t i = 1; i < meshlet.vertexCount; ++i)
+    {
+        lo = glm::min(lo, vertices[meshlet.vertices[i]].pos);
+        hi = glm::max(hi, vertices[meshlet.vertices[i]].pos);
+    }
+
+    const glm::vec3 center = (lo + hi) * 0.5f;
+    float radius = 0.0f;
+    for (uint32_t i = 0; i < meshlet.vertexCount; ++i)
+        radius = std::max(radius, glm::distance(center, vertices[meshlet.vertices[i]].pos));
+
+    return glm::vec4(center, radius);
+}
+
+// Unique positions the meshlet touches, in positionRemap terms
+static void getMeshletPositions(const Meshlet& meshlet, const std::vector<uint32_t>& positionRemap, std::vector<uint32_t>& positions)
+{
+    positions.clear();
+    for (uint32_t i = 0; i < meshlet.vertexCount; ++i)
+        positions.push_back(positionRemap[meshlet.vertices[i]]);
+
+    std::sort(positions.begin(), positions.end());
+    positions.erase(std::unique(positions.begin(), positions.end()), positions.end());
+}
+
+/*
+ * Partitions the meshlets into groups of up to groupSize. A group starts from the first meshlet
+ * not grouped yet and takes the neighbour sharing the most positions with it until it is full
+ * or has no neighbours left. Returns the groups as ranges of the returned order.
+ */
+static std::vector<uint32_t> groupMeshlets(const std::vector<Meshlet>& meshlets, const std::vector<uint32_t>& level, const std::vector<uint32_t>& positionRemap, uint32_t groupSize, std::vector<uint32_t>& groupOffsets)
+{
+    const size_t vertexCount = positionRemap.size();
+
+    // position -> meshlet adjacency, meshlets as indices into level
+    std::vector<uint32_t> meshletOffsets(level.size() + 1, 0);
+    std::vector<uint32_t> meshletPositions;
+    {
+        std::vector<uint32_t> positions;
+        for (size_t m = 0; m < level.size(); ++m)
+        {
+            getMeshletPositions(meshlets[level[m]], positionRemap, positions);
+            meshletPositions.insert(meshletPositions.end(), positions.begin(), positions.end());
+            meshletOffsets[m + 1] = static_cast<uint32_t>(meshletPositions.size());
+        }
+    }
+
+    std::vector<uint32_t> adjacencyOffsets(vertexCount + 1, 0);
+    for (uint32_t p : meshletPositions)
+        adjacencyOffsets[p + 1]++;
+    for (size_t v = 0; v < vertexCount; ++v)
+        adjacencyOffsets[v + 1] += adjacencyOffsets[v];
+
+    std::vector<uint32_t> adjacency(meshletPositions.size());
+    {
+        std::vector<uint32_t> fill(adjacencyOffsets.begin(), adjacencyOffsets.end() - 1);
+        for (size_t m = 0; m < level.size(); ++m)
+        {
+            for (uint32_t i = meshletOffsets[m]; i < meshletOffsets[m + 1]; ++i)
+                adjacency[fill[meshletPositions[i]]++] = static_cast<uint32_t>(m);
+        }
+    }
+
+    std::vector<uint8_t> grouped(level.size(), 0);
+    std::vector<uint32_t> shared(level.size(), 0);
+    std::vector<uint32_t> neighbours;
+
+    std::vector<uint32_t> order;
+    order.reserve(level.size());
+    groupOffsets.assign(1, 0);
+
+    for (size_t seed = 0; seed < level.size(); ++seed)
+    {
+        if (grouped[seed])
+            continue;
+
+        uint32_t m = static_cast<uint32_t>(seed);
+        for (uint32_t size = 0; size < groupSize; ++size)
+        {
+            grouped[m] = 1;
+            order.push_back(level[m]);
+
+            for (uint32_t i = meshletOffsets[m]; i < meshletOffsets[m + 1]; ++i)
+            {
+                const uint32_t p = meshletPositions[i];
+                for (uint32_t a = adjacencyOffsets[p]; a < adjacencyOffsets[p + 1]; ++a)
+                {
+                    const uint32_t neighbour = adjacency[a];
+                    if (grouped[neighbour])
+                        continue;
+
+                    if (shared[neighbour]++ == 0)
+                        neighbours.push_back(neighbour);
+                }
+            }
+
+            uint32_t best = UINT32_MAX;
+            for (uint32_t neighbour : neighbours)
+            {
+                if (!grouped[neighbour] && (best == UINT32_MAX || shared[neighbour] > shared[best]))
+                    best = neighbour;
+            }
+
+            if (best == UINT32_MAX)
+                break;
+
+            m = best;
+        }
+
+        for (uint32_t neighbour : neighbours)
+            shared[neighbour] = 0;
+        neighbours.clear();
+
+        groupOffsets.push_back(static_cast<uint32_t>(order.size()));
+    }
+
+    return order;
+}
+
+MeshletHierarchy buildMeshletHierarchy(const std::vector<Meshlet>& meshlets, const Vertex* vertices, size_t vertexCount, const MeshletHierarchyParams& params)
+{
+    assert(params.groupSize >= 2);
+    assert(params.reduction > 0.0f && params.reduction < 1.0f);
+
+    const auto start = std::chrono::steady_clock::now();
+
+    // all levels while building, the full mesh meshlets first
+    std::vector<Meshlet> allMeshlets = meshlets;
+    std::vector<MeshletCluster> clusters(meshlets.size());
+    for (size_t m = 0; m < meshlets.size(); ++m)
+    {
+        const glm::vec4 sphere = getMeshletSphere(meshlets[m], vertices);
+        clusters[m] = { sphere, sphere, 0.0f, FLT_MAX, 0, 0 };
+    }
+
+    const PositionQuantization bounds = computePositionQuantization(vertices, vertexCount);
+    const float diagonal = sqrtf(bounds.scale[0] * bounds.scale[0] + bounds.scale[1] * bounds.scale[1] + bounds.scale[2] * bounds.scale[2]);
+    const float maxError = params.maxError * diagonal;
+
+    const std::vector<uint32_t> positionRemap = buildPositionRemap(vertices, vertexCount);
+
+    constexpr uint32_t POSITION_UNUSED = UINT32_MAX;
+    constexpr uint32_t POSITION_SHARED = UINT32_MAX - 1;
+    std::vector<uint32_t> positionGroup(vertexCount);
+
+    // group vertices are copied out so simplifyMesh and appendMeshlets only see the group
+    std::vector<uint32_t> localIndex(vertexCount, UINT32_MAX);
+    std::vector<uint32_t> localVertices;
+    std::vector<Vertex> groupVertices;
+    std::vector<uint8_t> groupLock;
+    std::vector<uint32_t> groupIndices;
+    std::vector<Meshlet> splitMeshlets;
+    std::vector<uint32_t> groupOffsets;
+
+    // meshlets the next level is built from
+    std::vector<uint32_t> level(meshlets.size());
+    for (size_t m = 0; m < meshlets.size(); ++m)
+        level[m] = static_cast<uint32_t>(m);
+
+    uint32_t levelCount = 1;
+    while (level.size() > 1 && levelCount < params.maxLevelCount)
+    {
+        const std::vector<uint32_t> order = groupMeshlets(allMeshlets, level, positionRemap, params.groupSize, groupOffsets);
+        const size_t groupCount = groupOffsets.size() - 1;
+
+        // positions used by more than one group are group borders
+        std::fill(positionGroup.begin(), positionGroup.end(), POSITION_UNUSED);
+        for (size_t g = 0; g < groupCount; ++g)
+        {
+            for (uint32_t i = groupOffsets[g]; i < groupOffsets[g + 1]; ++i)
+            {
+                const Meshlet& meshlet = allMeshlets[order[i]];
+                for (uint32_t v = 0; v < meshlet.vertexCount; ++v)
+                {
+                    uint32_t& owner = positionGroup[positionRemap[meshlet.vertices[v]]];
+                    owner = (owner == POSITION_UNUSED || owner == g) ? static_cast<uint32_t>(g) : POSITION_SHARED;
+                }
+            }
+        }
+
+        std::vector<uint32_t> nextLevel;
+        size_t simplifiedCount = 0;
+
+        for (size_t g = 0; g < groupCount; ++g)
+        {
+            const uint32_t first = groupOffsets[g];
+            const uint32_t last = groupOffsets[g + 1];
+
+            float childError = 0.0f;
+            glm::vec4 groupBounds = clusters[order[first]].bounds;
+            for (uint32_t i = first; i < last; ++i)
+            {
+                childError = std::max(childError, clusters[order[i]].error);
+                groupBounds = mergeSpheres(groupBounds, clusters[order[i]].bounds);
+            }
+
+            localVertices.clear();
+            groupIndices.clear();
+            for (uint32_t i = first; i < last; ++i)
+            {
+                const Meshlet& meshlet = allMeshlets[order[i]];
+                for (uint32_t t = 0; t < meshlet.triangleCount * 3u; ++t)
+                {
+                    const uint32_t v = meshlet.vertices[meshlet.indices[t]];
+                    if (localIndex[v] == UINT32_MAX)
+                    {
+                        localIndex[v] = static_cast<uint32_t>(localVertices.size());
+                        localVertices.push_back(v);
+                    }
+                    groupIndices.push_back(localIndex[v]);
+                }
+            }
+
+            groupVertices.resize(localVertices.size());
+            groupLock.resize(localVertices.size());
+            for (size_t v = 0; v < localVertices.size(); ++v)
+            {
+                groupVertices[v] = vertices[localVertices[v]];
+                groupLock[v] = (positionGroup[positionRemap[localVertices[v]]] == POSITION_SHARED) ? 1 : 0;
+                localIndex[localVertices[v]] = UINT32_MAX;
+            }
+
+            const size_t target = static_cast<size_t>(groupIndices.size() / 3 * params.reduction) * 3;
+            float error = 0.0f;
+            std::vector<uint32_t> simplified;
+            if (maxError > childError)
+                simplified = simplifyMesh(groupIndices.data(), groupIndices.size(), groupVertices.data(), groupVertices.size(), target, maxError - childError, &error, groupLock.data());
+
+            // less than 15% fewer triangles, the meshlets go on to the next level as they are
+            if (simplified.empty() || simplified.size() * 20 > groupIndices.size() * 17)
+            {
+                nextLevel.insert(nextLevel.end(), order.begin() + first, order.begin() + last);
+                continue;
+            }
+
+            const float groupError = childError + error;
+            for (uint32_t i = first; i < last; ++i)
+            {
+                clusters[order[i]].parentBounds = groupBounds;
+                clusters[order[i]].parentError = groupError;
+            }
+
+            splitMeshlets.clear();
+            appendMeshlets(simplified.data(), simplified.size(), groupVertices.size(), params.meshletParams, splitMeshlets);
+
+            for (Meshlet& meshlet : splitMeshlets)
+            {
+                for (uint32_t v = 0; v < meshlet.vertexCount; ++v)
+                    meshlet.vertices[v] = localVertices[meshlet.vertices[v]];
+
+                nextLevel.push_back(static_cast<uint32_t>(allMeshlets.size()));
+                allMeshlets.push_back(meshlet);
+                clusters.push_back({ groupBounds, groupBounds, groupError, FLT_MAX, levelCount, 0 });
+            }
+
+            simplifiedCount++;
+        }
+
+        if (simplifiedCount == 0)
+            break;
+
+        level = std::move(nextLevel);
+        levelCount++;
+    }
+
+    MeshletHierarchy hierarchy;
+    hierarchy.meshlets.assign(allMeshlets.begin() + meshlets.size(), allMeshlets.end());
+    hierarchy.clusters = std::move(clusters);
+
+    const double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    LOG("buildMeshletHierarchy : %zu meshlets -> %zu more in %u levels, %zu roots in %.2f ms\n", meshlets.size(), hierarchy.meshlets.size(), levelCount, level.size(), ms);
+
+    return hierarchy;
+}
@@ -0,0 +1,109 @@
+#ifndef MESHLET_HPP
+#define MESHLET_HPP
+
+#include <stdint.h>
+#include <stddef.h>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+struct Vertex;
+struct ObjectBufferData;
+struct MeshBufferData;
+
+constexpr uint32_t MESHLET_MAX_VERTICES  = 64;
+constexpr uint32_t MESHLET_MAX_TRIANGLES = 126;
+
+struct Meshlet
+{
+    uint32_t vertices[MESHLET_MAX_VERTICES];       // indices into the mesh vertex buffer
+    uint8_t indices[MESHLET_MAX_TRIANGLES * 3];    // indices into Meshlet::vertices, 3 per triangle
+    uint8_t triangleCount;
+    uint8_t vertexCount;
+};
+
+// mesh.mesh reads meshlets from a storage buffer, the counts fill the last word of indices
+static_assert(sizeof(Meshlet) == 636 && offsetof(Meshlet, triangleCount) == 634, "Meshlet layout is read by mesh.mesh");
+
+struct MeshletBuildParams
+{
+    uint32_t maxVertices  = MESHLET_MAX_VERTICES;
+    uint32_t maxTriangles = MESHLET_MAX_TRIANGLES;
+};
+
+// Place of one meshlet in the cluster hierarchy, laid out for a storage buffer. Only meshbake
+// writes it for now, neither the runtime nor the shaders read it.
+struct MeshletCluster
+{
+    glm::vec4 bounds;       // xyz center, w radius of the group the meshlet was built from, its own for the full mesh
+    glm::vec4 parentBounds; // of the group the meshlet was simplified in, encloses bounds
+    float error;            // object space distance from the full mesh, 0 for the full mesh
+    float parentError;      // error of the meshlets that replace it, FLT_MAX if none do
+    uint32_t level;         // 0 for the full mesh
+    uint32_t reserved;
+};
+
+static_assert(sizeof(MeshletCluster) == 48, "MeshletCluster layout is part of the file format");
+
+struct MeshletHierarchyParams
+{
+    uint32_t groupSize = 8;     // meshlets simplified together
+    float reduction = 0.5f;     // triangle count of a simplified group relative to its meshlets
+    float maxError = 0.1f;      // relative to the bounds diagonal, no group is simplified past it
+    uint32_t maxLevelCount = 16;
+    MeshletBuildParams meshletParams {};
+};
+
+// Bake-only data : .mesh files carry it and loadMeshFile reads it back, but MeshStreamer uploads
+// the full mesh meshlets only and nothing selects a cut through the levels at runtime
+struct MeshletHierarchy
+{
+    std::vector<Meshlet> meshlets;        // coarser levels, they follow the full mesh meshlets
+    std::vector<MeshletCluster> clusters; // one per meshlet, the full mesh meshlets first
+};
+
+/*
+ * Splits an indexed triangle list into meshlets.
+ *
+ * Each meshlet is grown greedily from the triangles adjacent to the vertices it already
+ * holds, preferring the triangle that adds the fewest new vertices, so vertex reuse inside
+ * a meshlet stays high. A full meshlet hands its remaining neighbours to the next one; when
+ * there are none left the next meshlet is seeded from the first unused triangle in index order.
+ */
+std::vector<Meshlet> buildMeshlets(const uint32_t* indices, size_t indexCount, size_t vertexCount, const MeshletBuildParams& params = {});
+
+std::vector<Meshlet> buildMeshlets(const ObjectBufferData& objectData, const MeshletBuildParams& params = {});
+std::vector<Meshlet> buildMeshlets(const MeshBufferData& meshData, const MeshletBuildParams& params = {});
+
+// Index buffer the meshlets describe, in meshlet order, with indices into the mesh vertex buffer
+std::vector<uint32_t> getMeshletIndices(const std::vector<Meshlet>& meshlets);
+
+// Same indices with MESHLET_MAX_TRIANGLES * 3 slots per meshlet, the unused ones 0, so meshlet i
+// starts at index i * MESHLET_MAX_TRIANGLES * 3 and shaders draw meshlets without an offset table
+std::vector<uint32_t> getMeshletIndicesStrided(const std::vector<Meshlet>& meshlets);
+
+/*
+ * Rewrites the index buffer so triangles appear in meshlet order, and the vertex buffer so
+ * vertices appear in the order that index buffer first uses them. Vertices no triangle uses are
+ * dropped. Meshlet vertex lists are remapped to match.
+ */
+void reorderByMeshlets(ObjectBufferData& objectData, std::vector<Meshlet>& meshlets);
+
+/*
+ * Builds coarser levels on top of the full mesh meshlets for continuous level of detail.
+ *
+ * Each level groups neighbouring meshlets, simplifies every group to about half its triangles
+ * with simplifyMesh and splits the result into new meshlets, which form the next level. Group
+ * borders are locked, so groups simplified independently still meet without cracks, and they
+ * move between levels because groups are formed anew. Groups that do not simplify carry their
+ * meshlets over to the next level as they are.
+ *
+ * All meshlets of a group share its bounds and error, and the meshlets it was built from get
+ * them as their parent bounds and error; errors add up from level to level. A renderer selecting
+ * the meshlets whose own error projects to at most its pixel threshold and whose parent error to
+ * more, both projected at the point of their bounds closest to the eye, gets the same answer for
+ * all meshlets of a group and a crack free cut.
+ */
+MeshletHierarchy buildMeshletHierarchy(const std::vector<Meshlet>& meshlets, const Vertex* vertices, size_t vertexCount, const MeshletHierarchyParams& params = {});
+
+#endif // MESHLET_HPP
@@ -0,0 +1,132 @@
+#include "MeshletBounds.hpp"
+#include "MeshletBoundsKernel.hpp"
+#include "Loader.hpp"
+#include "Defines.hpp"
+
+#if defined(__x86_64__) || defined(__i386__)
+#define MESHLET_BOUNDS_X86
+#include <emmintrin.h>
+#endif
+
+#ifdef MESHLET_BOUNDS_X86
+
+namespace
+{
+
+// SSE2 is part of x86-64, the baseline of every build
+struct Sse2Lanes
+{
+    static constexpr uint32_t width = 4;
+    using Float = __m128;
+    using Mask = __m128;
+
+    static Float set(float v) { return _mm_set1_ps(v); }
+    static Float load(const float* p) { return _mm_load_ps(p); }
+    static void store(float* p, Float v) { _mm_store_ps(p, v); }
+
+    static Float add(Float a, Float b) { return _mm_add_ps(a, b); }
+    static Float sub(Float a, Float b) { return _mm_sub_ps(a, b); }
+    static Float mul(Float a, Float b) { return _mm_mul_ps(a, b); }
+    static Float div(Float a, Float b) { return _mm_div_ps(a, b); }
+    static Float min(Float a, Float b) { return _mm_min_ps(a, b); }
+    static Float max(Float a, Float b) { return _mm_max_ps(a, b); }
+    static Float sqrt(Float a) { return _mm_sqrt_ps(a); }
+
+    static Mask less(Float a, Float b) { return _mm_cmplt_ps(a, b); }
+    static Mask greater(Float a, Float b) { return _mm_cmpgt_ps(a, b); }
+    static Mask andMask(Mask a, Mask b) { return _mm_and_ps(a, b); }
+    static Float select(Mask m, Float a, Float b) { return _mm_or_ps(_mm_and_ps(m, a), _mm_andnot_ps(m, b)); }
+
+    // no gather before AVX2
+    static Float gather(const float* base, const int32_t* offsets) { return _mm_set_ps(base[offsets[3]], base[offsets[2]], base[offsets[1]], base[offsets[0]]); }
+};
+
+} // namespace
+
+// MeshletBoundsAvx2.cpp, only called when the CPU supports AVX2
+void computeMeshletBoundsAvx2(const Meshlet* meshlets, size_t meshletCount, const float* positions, size_t positionStride, MeshletBounds* bounds);
+
+#endif // MESHLET_BOUNDS_X86
+
+void computeMeshletBounds(const Meshlet* meshlets, size_t meshletCount, const float* positions, size_t positionStride, MeshletBounds* bounds, MeshletBoundsKernel_T kernel)
+{
+    if (kernel == MeshletBoundsKernel_T::eAuto)
+        kernel = getBestMeshletBoundsKernel();
+
+    assert(isMeshletBoundsKernelSupported(kernel));
+
+    switch (kernel)
+    {
+#ifdef MESHLET_BOUNDS_X86
+        case MeshletBoundsKernel_T::eAvx2:
+            computeMeshletBoundsAvx2(meshlets, meshletCount, positions, positionStride, bounds);
+            return;
+        case MeshletBoundsKernel_T::eSse2:
+            computeMeshletBoundsLanes<Sse2Lanes>(meshlets, meshletCount, positions, positionStride, bounds);
+            return;
+#endif
+        default:
+            computeMeshletBoundsLanes<ScalarLanes>(meshlets, meshletCount, positions, positionStride, bounds);
+            return;
+    }
+}
+
+std::vector<MeshletBounds> computeMeshletBounds(const std::vector<Meshlet>& meshlets, const Vertex* vertices, size_t vertexCount, MeshletBoundsKernel_T kernel)
+{
+    // gathers address positions with 32 bit offsets
+    assert(vertexCount * (sizeof(Vertex) / sizeof(float)) <= INT32_MAX);
+
+    std::vector<MeshletBounds> bounds(meshlets.size());
+    computeMeshletBounds(meshlets.data(), meshlets.size(), &vertices[0].pos.x, sizeof(Vertex), bounds.data(), kernel);
+
+    return bounds;
+}
+
+bool isMeshletBoundsKernelSupported(MeshletBoundsKernel_T kernel)
+{
+    switch (kernel)
+    {
+        case MeshletBoundsKernel_T::eScalar:
+        case MeshletBoundsKernel_T::eAuto:
+            return true;
+#ifdef MESHLET_BOUNDS_X86
+        case MeshletBoundsKernel_T::eSse2:
+            return true;
+        case MeshletBoundsKernel_T::eAvx2:
+            return __builtin_cpu_supports("avx2");
+#endif
+        default:
+            return false;
+    }
+}
+
+MeshletBoundsKernel_T getBestMeshletBoundsKernel()
+{
+    static const MeshletBoundsKernel_T best =
+        isMeshletBoundsKernelSupported(MeshletBoundsKernel_T::eAvx2) ? MeshletBoundsKernel_T::eAvx2 :
+        isMeshletBoundsKernelSupported(MeshletBoundsKernel_T::eSse2) ? MeshletBoundsKernel_T::eSse2 :
+        MeshletBoundsKernel_T::eScalar;
+
+    return best;
+}
+
+const char* getMeshletBoundsKernelName(MeshletBoundsKernel_T kernel)
+{
+    switch (kernel)
+    {
+        case MeshletBoundsKernel_T::eScalar: return "scalar";
+        case MeshletBoundsKernel_T::eSse2:   return "sse2";
+        case MeshletBoundsKernel_T::eAvx2:   return "avx2";
+        case MeshletBoundsKernel_T::eAuto:   return "auto";
+    }
+
+    EXIT("Unknown meshlet bounds kernel " << static_cast<uint32_t>(kernel));
+}
+
+bool isMeshletBackfacing(const MeshletBounds& bounds, const glm::vec3& viewPos)
+{
+    const glm::vec3 apex = glm::vec3(bounds.coneApex);
+    const glm::vec3 axis = glm::vec3(bounds.coneAxis);
+
+    return glm::dot(glm::normalize(apex - viewPos), axis) > bounds.coneAxis.w;
+}
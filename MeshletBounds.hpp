@@ -0,0 +1,57 @@
+#ifndef MESHLET_BOUNDS_HPP
+#define MESHLET_BOUNDS_HPP
+
+#include <stdint.h>
+#include <stddef.h>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+#include "Meshlet.hpp"
+
+// Culling bounds of one meshlet, in object space, laid out for a storage buffer
+struct MeshletBounds
+{
+    glm::vec4 sphere;   // xyz center, w radius
+    glm::vec4 aabbMin;  // w unused
+    glm::vec4 aabbMax;  // w unused
+    glm::vec4 coneApex; // w unused
+    glm::vec4 coneAxis; // xyz axis, w cutoff, see isMeshletBackfacing
+};
+
+static_assert(sizeof(MeshletBounds) == 80, "MeshletBounds layout is part of the file format");
+
+enum class MeshletBoundsKernel_T
+{
+    eScalar = 0,
+    eSse2,       // 4 meshlets at a time
+    eAvx2,       // 8 meshlets at a time, positions fetched with gathers
+    eAuto,       // the widest one the CPU supports
+};
+
+/*
+ * Computes the bounds of each meshlet from the positions of its vertices.
+ *
+ * The sphere is centered on the box, its radius reaches the farthest vertex. The normal cone
+ * axis is the average of the triangle normals and its cutoff comes from the normal furthest
+ * from it; the apex is moved back along the axis until every triangle plane faces away from
+ * it. Meshlets whose normals spread too far get a cutoff of 1 and are never backfacing.
+ *
+ * The kernels process several meshlets side by side, one per SIMD lane, with the same
+ * operations in the same order as the scalar one, so all kernels give the same results unless
+ * the compiler contracts multiplies and adds into FMAs.
+ *
+ * positionStride is in bytes, a multiple of 4. Meshlets must not be empty.
+ */
+void computeMeshletBounds(const Meshlet* meshlets, size_t meshletCount, const float* positions, size_t positionStride, MeshletBounds* bounds, MeshletBoundsKernel_T kernel = MeshletBoundsKernel_T::eAuto);
+
+std::vector<MeshletBounds> computeMeshletBounds(const std::vector<Meshlet>& meshlets, const Vertex* vertices, size_t vertexCount, MeshletBoundsKernel_T kernel = MeshletBoundsKernel_T::eAuto);
+
+bool isMeshletBoundsKernelSupported(MeshletBoundsKernel_T kernel);
+MeshletBoundsKernel_T getBestMeshletBoundsKernel();
+const char* getMeshletBoundsKernelName(MeshletBoundsKernel_T kernel);
+
+// The meshlet faces away from viewPos : dot(normalize(apex - viewPos), axis) > cutoff, never for a cutoff of 1
+bool isMeshletBackfacing(const MeshletBounds& bounds, const glm::vec3& viewPos);
+
+#endif // MESHLET_BOUNDS_HPP
@@ -0,0 +1,46 @@
+// Built with -mavx2 on x86, see CMakeLists.txt. Nothing here may be called before checking
+// that the CPU supports AVX2, and nothing but the kernel may be defined here.
+
+#include "MeshletBoundsKernel.hpp"
+
+#if defined(__x86_64__) || defined(__i386__)
+
+#include <immintrin.h>
+
+namespace
+{
+
+struct Avx2Lanes
+{
+    static constexpr uint32_t width = 8;
+    using Float = __m256;
+    using Mask = __m256;
+
+    static Float set(float v) { return _mm256_set1_ps(v); }
+    static Float load(const float* p) { return _mm256_load_ps(p); }
+    static void store(float* p, Float v) { _mm256_store_ps(p, v); }
+
+    static Float add(Float a, Float b) { return _mm256_add_ps(a, b); }
+    static Float sub(Float a, Float b) { return _mm256_sub_ps(a, b); }
+    static Float mul(Float a, Float b) { return _mm256_mul_ps(a, b); }
+    static Float div(Float a, Float b) { return _mm256_div_ps(a, b); }
+    static Float min(Float a, Float b) { return _mm256_min_ps(a, b); }
+    static Float max(Float a, Float b) { return _mm256_max_ps(a, b); }
+    static Float sqrt(Float a) { return _mm256_sqrt_ps(a); }
+
+    static Mask less(Float a, Float b) { return _mm256_cmp_ps(a, b, _CMP_LT_OQ); }
+    static Mask greater(Float a, Float b) { return _mm256_cmp_ps(a, b, _CMP_GT_OQ); }
+    static Mask andMask(Mask a, Mask b) { return _mm256_and_ps(a, b); }
+    static Float select(Mask m, Float a, Float b) { return _mm256_blendv_ps(b, a, m); }
+
+    static Float gather(const float* base, const int32_t* offsets) { return _mm256_i32gather_ps(base, _mm256_load_si256(reinterpret_cast<const __m256i*>(offsets)), 4); }
+};
+
+} // namespace
+
+void computeMeshletBoundsAvx2(const Meshlet* meshlets, size_t meshletCount, const float* positions, size_t positionStride, MeshletBounds* bounds)
+{
+    computeMeshletBoundsLanes<Avx2Lanes>(meshlets, meshletCount, positions, positionStride, bounds);
+}
+
+#endif
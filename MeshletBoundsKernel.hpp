@@ -0,0 +1,242 @@
+#ifndef MESHLET_BOUNDS_KERNEL_HPP
+#define MESHLET_BOUNDS_KERNEL_HPP
+
+#include <stdint.h>
+#include <stddef.h>
+#include <assert.h>
+#include <float.h>
+#include <string.h>
+
+#include "Meshlet.hpp"
+#include "MeshletBounds.hpp"
+
+static_assert(sizeof(MeshletBounds) == 20 * sizeof(float), "the kernel writes MeshletBounds as 20 floats");
+
+/*
+ * The meshlet bounds kernel, written once against a set of lanes L and compiled by
+ * MeshletBounds.cpp for scalar and SSE2 lanes, and by MeshletBoundsAvx2.cpp for AVX2 lanes.
+ *
+ * L provides width, Float and Mask types, and static functions : set, load, store, add, sub,
+ * mul, div, min, max, sqrt, less, greater, andMask, select, and gather, where lane i of
+ * gather(base, offsets) is base[offsets[i]]. min(a, b) is a < b ? a : b and max(a, b) is
+ * a > b ? a : b, which is what the SSE and AVX instructions do.
+ *
+ * Everything lives in an anonymous namespace, each translation unit gets its own copy compiled
+ * with its own instruction set, and none of it can be merged across them at link time.
+ */
+
+namespace
+{
+
+struct ScalarLanes
+{
+    static constexpr uint32_t width = 1;
+    using Float = float;
+    using Mask = bool;
+
+    static Float set(float v) { return v; }
+    static Float load(const float* p) { return *p; }
+    static void store(float* p, Float v) { *p = v; }
+
+    static Float add(Float a, Float b) { return a + b; }
+    static Float sub(Float a, Float b) { return a - b; }
+    static Float mul(Float a, Float b) { return a * b; }
+    static Float div(Float a, Float b) { return a / b; }
+    static Float min(Float a, Float b) { return a < b ? a : b; }
+    static Float max(Float a, Float b) { return a > b ? a : b; }
+    static Float sqrt(Float a) { return __builtin_sqrtf(a); }
+
+    static Mask less(Float a, Float b) { return a < b; }
+    static Mask greater(Float a, Float b) { return a > b; }
+    static Mask andMask(Mask a, Mask b) { return a && b; }
+    static Float select(Mask m, Float a, Float b) { return m ? a : b; }
+
+    static Float gather(const float* base, const int32_t* offsets) { return base[offsets[0]]; }
+};
+
+template <typename L>
+typename L::Float dot3(typename L::Float ax, typename L::Float ay, typename L::Float az, typename L::Float bx, typename L::Float by, typename L::Float bz)
+{
+    return L::add(L::add(L::mul(ax, bx), L::mul(ay, by)), L::mul(az, bz));
+}
+
+// L::width meshlets per iteration, the last one repeats its last meshlet in the spare lanes
+template <typename L>
+void computeMeshletBoundsLanes(const Meshlet* meshlets, size_t meshletCount, const float* positions, size_t positionStride, MeshletBounds* bounds)
+{
+    using Float = typename L::Float;
+    using Mask = typename L::Mask;
+    constexpr uint32_t W = L::width;
+
+    assert(positionStride % sizeof(float) == 0);
+    const size_t strideFloats = positionStride / sizeof(float);
+
+    // vertex i of lane j at [i * W + j], vertices past the meshlet's count repeat its last one
+    alignas(32) float px[MESHLET_MAX_VERTICES * W];
+    alignas(32) float py[MESHLET_MAX_VERTICES * W];
+    alignas(32) float pz[MESHLET_MAX_VERTICES * W];
+
+    // unit normal and centroid of triangle t of lane j at [t * W + j]
+    alignas(32) float nx[MESHLET_MAX_TRIANGLES * W];
+    alignas(32) float ny[MESHLET_MAX_TRIANGLES * W];
+    alignas(32) float nz[MESHLET_MAX_TRIANGLES * W];
+    alignas(32) float centroidX[MESHLET_MAX_TRIANGLES * W];
+    alignas(32) float centroidY[MESHLET_MAX_TRIANGLES * W];
+    alignas(32) float centroidZ[MESHLET_MAX_TRIANGLES * W];
+
+    alignas(32) int32_t offsets[3][W];
+    alignas(32) float triangleCounts[W];
+
+    for (size_t first = 0; first < meshletCount; first += W)
+    {
+        const Meshlet* lanes[W];
+        uint32_t maxVertexCount = 0;
+        uint32_t maxTriangleCount = 0;
+        for (uint32_t j = 0; j < W; ++j)
+        {
+            lanes[j] = &meshlets[(first + j < meshletCount) ? first + j : meshletCount - 1];
+            assert(lanes[j]->vertexCount > 0 && lanes[j]->triangleCount > 0);
+
+            maxVertexCount = (lanes[j]->vertexCount > maxVertexCount) ? lanes[j]->vertexCount : maxVertexCount;
+            maxTriangleCount = (lanes[j]->triangleCount > maxTriangleCount) ? lanes[j]->triangleCount : maxTriangleCount;
+            triangleCounts[j] = static_cast<float>(lanes[j]->triangleCount);
+        }
+
+        // Positions
+        for (uint32_t i = 0; i < maxVertexCount; ++i)
+        {
+            for (uint32_t j = 0; j < W; ++j)
+            {
+                const uint32_t local = (i < lanes[j]->vertexCount) ? i : lanes[j]->vertexCount - 1u;
+                offsets[0][j] = static_cast<int32_t>(lanes[j]->vertices[local] * strideFloats);
+            }
+
+            L::store(px + i * W, L::gather(positions + 0, offsets[0]));
+            L::store(py + i * W, L::gather(positions + 1, offsets[0]));
+            L::store(pz + i * W, L::gather(positions + 2, offsets[0]));
+        }
+
+        // Box and sphere
+        Float minX = L::set(FLT_MAX), minY = L::set(FLT_MAX), minZ = L::set(FLT_MAX);
+        Float maxX = L::set(-FLT_MAX), maxY = L::set(-FLT_MAX), maxZ = L::set(-FLT_MAX);
+        for (uint32_t i = 0; i < maxVertexCount; ++i)
+        {
+            const Float x = L::load(px + i * W), y = L::load(py + i * W), z = L::load(pz + i * W);
+            minX = L::min(minX, x); minY = L::min(minY, y); minZ = L::min(minZ, z);
+            maxX = L::max(maxX, x); maxY = L::max(maxY, y); maxZ = L::max(maxZ, z);
+        }
+
+        const Float half = L::set(0.5f);
+        const Float centerX = L::mul(L::add(minX, maxX), half);
+        const Float centerY = L::mul(L::add(minY, maxY), half);
+        const Float centerZ = L::mul(L::add(minZ, maxZ), half);
+
+        Float radius2 = L::set(0.0f);
+        for (uint32_t i = 0; i < maxVertexCount; ++i)
+        {
+            const Float dx = L::sub(L::load(px + i * W), centerX);
+            const Float dy = L::sub(L::load(py + i * W), centerY);
+            const Float dz = L::sub(L::load(pz + i * W), centerZ);
+            radius2 = L::max(radius2, dot3<L>(dx, dy, dz, dx, dy, dz));
+        }
+
+        // Triangle normals, the cone axis is their average
+        const Float zero = L::set(0.0f);
+        const Float one = L::set(1.0f);
+        const Float third = L::set(1.0f / 3.0f);
+
+        Float axisX = zero, axisY = zero, axisZ = zero;
+        for (uint32_t t = 0; t < maxTriangleCount; ++t)
+        {
+            for (uint32_t j = 0; j < W; ++j)
+            {
+                const uint32_t triangle = (t < lanes[j]->triangleCount) ? t : lanes[j]->triangleCount - 1u;
+                for (uint32_t k = 0; k < 3; ++k)
+                    offsets[k][j] = static_cast<int32_t>(lanes[j]->indices[triangle * 3 + k] * W + j);
+            }
+
+            const Float ax = L::gather(px, offsets[0]), ay = L::gather(py, offsets[0]), az = L::gather(pz, offsets[0]);
+            const Float bx = L::gather(px, offsets[1]), by = L::gather(py, offsets[1]), bz = L::gather(pz, offsets[1]);
+            const Float cx = L::gather(px, offsets[2]), cy = L::gather(py, offsets[2]), cz = L::gather(pz, offsets[2]);
+
+            const Float e0x = L::sub(bx, ax), e0y = L::sub(by, ay), e0z = L::sub(bz, az);
+            const Float e1x = L::sub(cx, ax), e1y = L::sub(cy, ay), e1z = L::sub(cz, az);
+
+            Float normalX = L::sub(L::mul(e0y, e1z), L::mul(e0z, e1y));
+            Float normalY = L::sub(L::mul(e0z, e1x), L::mul(e0x, e1z));
+            Float normalZ = L::sub(L::mul(e0x, e1y), L::mul(e0y, e1x));
+
+            // spare lanes and zero area triangles get a zero normal, which the passes below skip
+            const Float length2 = dot3<L>(normalX, normalY, normalZ, normalX, normalY, normalZ);
+            const Mask valid = L::andMask(L::less(L::set(static_cast<float>(t)), L::load(triangleCounts)), L::greater(length2, zero));
+            const Float length = L::select(valid, L::sqrt(length2), one);
+
+            normalX = L::select(valid, L::div(normalX, length), zero);
+            normalY = L::select(valid, L::div(normalY, length), zero);
+            normalZ = L::select(valid, L::div(normalZ, length), zero);
+
+            L::store(nx + t * W, normalX);
+            L::store(ny + t * W, normalY);
+            L::store(nz + t * W, normalZ);
+            L::store(centroidX + t * W, L::mul(L::add(L::add(ax, bx), cx), third));
+            L::store(centroidY + t * W, L::mul(L::add(L::add(ay, by), cy), third));
+            L::store(centroidZ + t * W, L::mul(L::add(L::add(az, bz), cz), third));
+
+            axisX = L::add(axisX, normalX);
+            axisY = L::add(axisY, normalY);
+            axisZ = L::add(axisZ, normalZ);
+        }
+
+        const Float axisLength2 = dot3<L>(axisX, axisY, axisZ, axisX, axisY, axisZ);
+        const Float axisLength = L::select(L::greater(axisLength2, zero), L::sqrt(axisLength2), one);
+        axisX = L::div(axisX, axisLength);
+        axisY = L::div(axisY, axisLength);
+        axisZ = L::div(axisZ, axisLength);
+
+        // Spread of the normals around the axis, and how far back the apex has to go for every
+        // triangle plane to face away from it
+        Float minDot = one;
+        Float maxT = zero;
+        for (uint32_t t = 0; t < maxTriangleCount; ++t)
+        {
+            const Float normalX = L::load(nx + t * W), normalY = L::load(ny + t * W), normalZ = L::load(nz + t * W);
+            const Mask valid = L::greater(dot3<L>(normalX, normalY, normalZ, normalX, normalY, normalZ), zero);
+
+            const Float dn = dot3<L>(normalX, normalY, normalZ, axisX, axisY, axisZ);
+            minDot = L::select(valid, L::min(minDot, dn), minDot);
+
+            // the apex lies on this triangle's plane when center - axis * t reaches it
+            const Float dc = dot3<L>(L::sub(centerX, L::load(centroidX + t * W)), L::sub(centerY, L::load(centroidY + t * W)), L::sub(centerZ, L::load(centroidZ + t * W)), normalX, normalY, normalZ);
+            const Mask facing = L::andMask(valid, L::greater(dn, zero));
+            maxT = L::select(facing, L::max(maxT, L::div(dc, L::select(facing, dn, one))), maxT);
+        }
+
+        // past ~84 degrees between the axis and a normal the cone is too wide to ever cull
+        const Mask narrow = L::greater(minDot, L::set(0.1f));
+        const Float cutoff = L::select(narrow, L::sqrt(L::max(L::sub(one, L::mul(minDot, minDot)), zero)), one);
+        const Float apexT = L::select(narrow, maxT, zero);
+
+        // in MeshletBounds order, written as plain floats so no glm code gets compiled with L's instruction set
+        alignas(32) float out[20][W];
+        L::store(out[0], centerX); L::store(out[1], centerY); L::store(out[2], centerZ); L::store(out[3], L::sqrt(radius2));
+        L::store(out[4], minX); L::store(out[5], minY); L::store(out[6], minZ); L::store(out[7], zero);
+        L::store(out[8], maxX); L::store(out[9], maxY); L::store(out[10], maxZ); L::store(out[11], zero);
+        L::store(out[12], L::sub(centerX, L::mul(axisX, apexT)));
+        L::store(out[13], L::sub(centerY, L::mul(axisY, apexT)));
+        L::store(out[14], L::sub(centerZ, L::mul(axisZ, apexT)));
+        L::store(out[15], zero);
+        L::store(out[16], axisX); L::store(out[17], axisY); L::store(out[18], axisZ); L::store(out[19], cutoff);
+
+        for (uint32_t j = 0; j < W && first + j < meshletCount; ++j)
+        {
+            float record[20];
+            for (uint32_t k = 0; k < 20; ++k)
+                record[k] = out[k][j];
+            memcpy(&bounds[first + j], record, sizeof(record));
+        }
+    }
+}
+
+} // namespace
+
+#endif // MESHLET_BOUNDS_KERNEL_HPP
@@ -0,0 +1,369 @@
+#include "Overdraw.hpp"
+#include "Loader.hpp"
+#include "Meshlet.hpp"
+#include "Defines.hpp"
+
+#include <math.h>
+#include <string.h>
+#include <chrono>
+#include <algorithm>
+
+// One orthographic view of the estimator, depth buffer cleared to the far plane
+struct OverdrawView
+{
+    std::vector<float> depth;
+    size_t pixelsShaded = 0;
+};
+
+// Top left fill rule, so an edge shared by two triangles belongs to exactly one of them
+static bool isTopLeft(float dx, float dy)
+{
+    return (dy < 0.0f) || (dy == 0.0f && dx < 0.0f);
+}
+
+static bool isInside(float w, bool topLeft)
+{
+    return (w > 0.0f) || (w == 0.0f && topLeft);
+}
+
+// a, b, c are in pixels, z in [0, 1] with 0 closest to the viewer
+static void rasterize(OverdrawView& view, glm::vec3 a, glm::vec3 b, glm::vec3 c)
+{
+    float area = (b.x - a.x) * (c.y - a.y) - (b.y - a.y) * (c.x - a.x);
+    if (area == 0.0f)
+        return;
+
+    if (area < 0.0f)
+    {
+        std::swap(b, c);
+        area = -area;
+    }
+
+    const int minX = std::max(static_cast<int>(floorf(std::min({ a.x, b.x, c.x }))), 0);
+    const int minY = std::max(static_cast<int>(floorf(std::min({ a.y, b.y, c.y }))), 0);
+    const int maxX = std::min(static_cast<int>(ceilf(std::max({ a.x, b.x, c.x }))), static_cast<int>(OVERDRAW_VIEWPORT_SIZE) - 1);
+    const int maxY = std::min(static_cast<int>(ceilf(std::max({ a.y, b.y, c.y }))), static_cast<int>(OVERDRAW_VIEWPORT_SIZE) - 1);
+
+    const bool topLeftA = isTopLeft(c.x - b.x, c.y - b.y);
+    const bool topLeftB = isTopLeft(a.x - c.x, a.y - c.y);
+    const bool topLeftC = isTopLeft(b.x - a.x, b.y - a.y);
+
+    for (int y = minY; y <= maxY; ++y)
+    {
+        const float py = y + 0.5f;
+        for (int x = minX; x <= maxX; ++x)
+        {
+            const float px = x + 0.5f;
+
+            // weight of each vertex, from the edge opposite to it
+            const float wa = (c.x - b.x) * (py - b.y) - (c.y - b.y) * (px - b.x);
+            const float wb = (a.x - c.x) * (py - c.y) - (a.y - c.y) * (px - c.x);
+            const float wc = (b.x - a.x) * (py - a.y) - (b.y - a.y) * (px - a.x);
+
+            if (!isInside(wa, topLeftA) || !isInside(wb, topLeftB) || !isInside(wc, topLeftC))
+                continue;
+
+            const float z = (wa * a.z + wb * b.z + wc * c.z) / area;
+            float& depth = view.depth[y * OVERDRAW_VIEWPORT_SIZE + x];
+            if (z < depth)
+            {
+                depth = z;
+                view.pixelsShaded++;
+            }
+        }
+    }
+}
+
+OverdrawStats analyzeOverdraw(const uint32_t* indices, size_t indexCount, const Vertex* vertices, size_t vertexCount, bool backFaceCulling)
+{
+    assert(indexCount % 3 == 0);
+
+    OverdrawStats stats;
+    if (indexCount == 0)
+        return stats;
+
+    glm::vec3 boundsMin = vertices[indices[0]].pos;
+    glm::vec3 boundsMax = boundsMin;
+    for (size_t i = 0; i < indexCount; ++i)
+    {
+        assert(indices[i] < vertexCount);
+        boundsMin = glm::min(boundsMin, vertices[indices[i]].pos);
+        boundsMax = glm::max(boundsMax, vertices[indices[i]].pos);
+    }
+
+    // the same scale on every axis keeps the pixel area equal across views
+    const glm::vec3 extent = boundsMax - boundsMin;
+    const float maxExtent = std::max({ extent.x, extent.y, extent.z, 1e-30f });
+    const float pixelScale = (OVERDRAW_VIEWPORT_SIZE - 1) / maxExtent;
+
+    OverdrawView view;
+    for (uint32_t axis = 0; axis < 3; ++axis)
+    {
+        const uint32_t axisU = (axis + 1) % 3;
+        const uint32_t axisV = (axis + 2) % 3;
+
+        // looking down -axis, then down +axis
+        for (float side : { 1.0f, -1.0f })
+        {
+            view.depth.assign(OVERDRAW_VIEWPORT_SIZE * OVERDRAW_VIEWPORT_SIZE, 1.0f);
+            view.pixelsShaded = 0;
+
+            for (size_t i = 0; i < indexCount; i += 3)
+            {
+                glm::vec3 p[3];
+                for (uint32_t k = 0; k < 3; ++k)
+                {
+                    const glm::vec3 pos = vertices[indices[i + k]].pos - boundsMin;
+                    const float depth = (side > 0.0f) ? (extent[axis] - pos[axis]) : pos[axis];
+                    p[k] = glm::vec3(pos[axisU] * pixelScale, pos[axisV] * pixelScale, depth / maxExtent);
+                }
+
+                // signed area in the (u, v) plane is the normal component along axis
+                const float area = (p[1].x - p[0].x) * (p[2].y - p[0].y) - (p[1].y - p[0].y) * (p[2].x - p[0].x);
+                if (backFaceCulling && area * side <= 0.0f)
+                    continue;
+
+                rasterize(view, p[0], p[1], p[2]);
+            }
+
+            stats.pixelsShaded += view.pixelsShaded;
+            stats.pixelsCovered += std::count_if(view.depth.begin(), view.depth.end(), [](float depth) { return depth < 1.0f; });
+        }
+    }
+
+    stats.overdraw = (stats.pixelsCovered > 0) ? double(stats.pixelsShaded) / stats.pixelsCovered : 0.0;
+    return stats;
+}
+
+// FIFO post-transform cache that can start over without clearing, see reset
+struct VertexCacheSimulation
+{
+    std::vector<size_t> insertedAt;
+    size_t misses = 0;
+    uint32_t cacheSize = 0;
+
+    VertexCacheSimulation(size_t vertexCount, uint32_t size)
+        : insertedAt(vertexCount, SIZE_MAX)
+        , cacheSize(size)
+    {}
+
+    // pretend cacheSize misses happened, every cached vertex is then out
+    void reset()
+    {
+        misses += cacheSize;
+    }
+
+    uint32_t addTriangle(const uint32_t* triangle)
+    {
+        uint32_t triangleMisses = 0;
+        for (uint32_t k = 0; k < 3; ++k)
+        {
+            const uint32_t v = triangle[k];
+            if (insertedAt[v] == SIZE_MAX || misses - insertedAt[v] >= cacheSize)
+            {
+                insertedAt[v] = misses++;
+                triangleMisses++;
+            }
+        }
+
+        return triangleMisses;
+    }
+};
+
+// First triangle of every cluster, the triangle count closes the list
+static std::vector<size_t> buildClusters(const uint32_t* indices, size_t indexCount, size_t vertexCount, float threshold, uint32_t cacheSize)
+{
+    const size_t triangleCount = indexCount / 3;
+
+    // hard boundaries : triangles missing all 3 vertices, where the optimizer jumped elsewhere
+    std::vector<size_t> runs;
+    {
+        VertexCacheSimulation cache(vertexCount, cacheSize);
+        for (size_t t = 0; t < triangleCount; ++t)
+        {
+            if (cache.addTriangle(&indices[t * 3]) == 3)
+                runs.push_back(t);
+        }
+    }
+    runs.push_back(triangleCount);
+
+    // soft boundaries : cut a run wherever the cluster so far is within threshold of the run ACMR,
+    // the next cluster then starts with a cold cache which is what the threshold pays for
+    std::vector<size_t> clusters;
+    VertexCacheSimulation cache(vertexCount, cacheSize);
+    for (size_t r = 0; r + 1 < runs.size(); ++r)
+    {
+        const size_t begin = runs[r];
+        const size_t end = runs[r + 1];
+
+        cache.reset();
+        size_t runMisses = 0;
+        for (size_t t = begin; t < end; ++t)
+            runMisses += cache.addTriangle(&indices[t * 3]);
+
+        const double targetAcmr = threshold * double(runMisses) / (end - begin);
+
+        cache.reset();
+        clusters.push_back(begin);
+
+        size_t clusterMisses = 0;
+        size_t clusterTriangles = 0;
+        for (size_t t = begin; t < end; ++t)
+        {
+            clusterMisses += cache.addTriangle(&indices[t * 3]);
+            clusterTriangles++;
+
+            if (t + 1 < end && clusterMisses <= targetAcmr * clusterTriangles)
+            {
+                cache.reset();
+                clusters.push_back(t + 1);
+                clusterMisses = 0;
+                clusterTriangles = 0;
+            }
+        }
+    }
+    clusters.push_back(triangleCount);
+
+    return clusters;
+}
+
+// Area weighted centroid and normal of a set of triangles, the normal keeps its length
+struct ClusterShape
+{
+    glm::vec3 centroid = glm::vec3(0.0f);
+    glm::vec3 normal = glm::vec3(0.0f);
+    float area = 0.0f;
+
+    void addTriangle(const glm::vec3& a, const glm::vec3& b, const glm::vec3& c)
+    {
+        const glm::vec3 n = glm::cross(b - a, c - a);
+        const float triangleArea = glm::length(n) * 0.5f;
+
+        centroid += (a + b + c) * (triangleArea / 3.0f);
+        normal += n;
+        area += triangleArea;
+    }
+
+    glm::vec3 getCentroid() const
+    {
+        return (area > 0.0f) ? centroid / area : centroid;
+    }
+};
+
+/*
+ * How far out a cluster faces : its centroid seen from the mesh centroid, along its normal.
+ * Clusters on the outside of a closed mesh score high and are drawn first.
+ */
+static float getOutwardScore(const ClusterShape& cluster, const glm::vec3& meshCentroid)
+{
+    const float normalLength = glm::length(cluster.normal);
+    if (normalLength == 0.0f)
+        return 0.0f;
+
+    return glm::dot(cluster.getCentroid() - meshCentroid, cluster.normal / normalLength);
+}
+
+// Stable, so clusters facing alike keep their order
+static std::vector<uint32_t> sortClusters(const std::vector<ClusterShape>& clusters)
+{
+    ClusterShape mesh;
+    for (const ClusterShape& cluster : clusters)
+    {
+        mesh.centroid += cluster.centroid;
+        mesh.area += cluster.area;
+    }
+    const glm::vec3 meshCentroid = mesh.getCentroid();
+
+    std::vector<float> scores(clusters.size());
+    std::vector<uint32_t> order(clusters.size());
+    for (size_t i = 0; i < clusters.size(); ++i)
+    {
+        scores[i] = getOutwardScore(clusters[i], meshCentroid);
+        order[i] = static_cast<uint32_t>(i);
+    }
+
+    std::stable_sort(order.begin(), order.end(), [&](uint32_t a, uint32_t b) { return scores[a] > scores[b]; });
+    return order;
+}
+
+void optimizeOverdraw(uint32_t* indices, size_t indexCount, const Vertex* vertices, size_t vertexCount, float threshold, uint32_t cacheSize)
+{
+    assert(indexCount % 3 == 0);
+    assert(threshold >= 1.0f);
+
+    if (indexCount == 0)
+        return;
+
+    const OverdrawStats overdrawBefore = analyzeOverdraw(indices, indexCount, vertices, vertexCount);
+    const VertexCacheStats cacheBefore = analyzeVertexCache(indices, indexCount, vertexCount, cacheSize, VertexCacheModel_T::eFifo);
+    const auto start = std::chrono::steady_clock::now();
+
+    const std::vector<size_t> clusters = buildClusters(indices, indexCount, vertexCount, threshold, cacheSize);
+    const size_t clusterCount = clusters.size() - 1;
+
+    std::vector<ClusterShape> shapes(clusterCount);
+    for (size_t c = 0; c < clusterCount; ++c)
+    {
+        for (size_t t = clusters[c]; t < clusters[c + 1]; ++t)
+            shapes[c].addTriangle(vertices[indices[t * 3 + 0]].pos, vertices[indices[t * 3 + 1]].pos, vertices[indices[t * 3 + 2]].pos);
+    }
+
+    const std::vector<uint32_t> order = sortClusters(shapes);
+
+    std::vector<uint32_t> sorted;
+    sorted.reserve(indexCount);
+    for (uint32_t c : order)
+        sorted.insert(sorted.end(), indices + clusters[c] * 3, indices + clusters[c + 1] * 3);
+
+    memcpy(indices, sorted.data(), sizeof(uint32_t) * indexCount);
+
+    const double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    const OverdrawStats overdrawAfter = analyzeOverdraw(indices, indexCount, vertices, vertexCount);
+    const VertexCacheStats cacheAfter = analyzeVertexCache(indices, indexCount, vertexCount, cacheSize, VertexCacheModel_T::eFifo);
+
+    LOG("optimizeOverdraw : %zu clusters, threshold %.2f, %zu triangles in %.2f ms, overdraw %.3f -> %.3f, FIFO %u ACMR %.3f -> %.3f\n",
+        clusterCount, threshold, indexCount / 3, ms, overdrawBefore.overdraw, overdrawAfter.overdraw, cacheSize, cacheBefore.acmr, cacheAfter.acmr);
+}
+
+void optimizeOverdraw(ObjectBufferData& objectData, float threshold, uint32_t cacheSize)
+{
+    optimizeOverdraw(objectData.indices.data(), objectData.indices.size(), objectData.vertices.data(), objectData.vertices.size(), threshold, cacheSize);
+}
+
+void optimizeOverdraw(std::vector<Meshlet>& meshlets, const Vertex* vertices, size_t vertexCount)
+{
+    if (meshlets.empty())
+        return;
+
+    std::vector<uint32_t> indices = getMeshletIndices(meshlets);
+    const OverdrawStats before = analyzeOverdraw(indices.data(), indices.size(), vertices, vertexCount);
+    const auto start = std::chrono::steady_clock::now();
+
+    std::vector<ClusterShape> shapes(meshlets.size());
+    for (size_t m = 0; m < meshlets.size(); ++m)
+    {
+        const Meshlet& meshlet = meshlets[m];
+        for (uint32_t i = 0; i < meshlet.triangleCount * 3u; i += 3)
+        {
+            shapes[m].addTriangle(vertices[meshlet.vertices[meshlet.indices[i + 0]]].pos,
+                                  vertices[meshlet.vertices[meshlet.indices[i + 1]]].pos,
+                                  vertices[meshlet.vertices[meshlet.indices[i + 2]]].pos);
+        }
+    }
+
+    const std::vector<uint32_t> order = sortClusters(shapes);
+
+    std::vector<Meshlet> sorted;
+    sorted.reserve(meshlets.size());
+    for (uint32_t m : order)
+        sorted.push_back(meshlets[m]);
+
+    meshlets = std::move(sorted);
+
+    const double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+    indices = getMeshletIndices(meshlets);
+    const OverdrawStats after = analyzeOverdraw(indices.data(), indices.size(), vertices, vertexCount);
+
+    LOG("optimizeOverdraw : %zu meshlets in %.2f ms, overdraw %.3f -> %.3f\n", meshlets.size(), ms, before.overdraw, after.overdraw);
+}
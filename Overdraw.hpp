@@ -0,0 +1,49 @@
+#ifndef OVERDRAW_HPP
+#define OVERDRAW_HPP
+
+#include <stdint.h>
+#include <stddef.h>
+#include <vector>
+
+#include "VertexCache.hpp"
+
+struct Vertex;
+struct ObjectBufferData;
+struct Meshlet;
+
+// ACMR the overdraw pass may give up for finer clusters, 1.05 allows 5% more vertex shader invocations
+constexpr float OVERDRAW_DEFAULT_THRESHOLD = 1.05f;
+
+// Resolution of each view of the overdraw estimator
+constexpr uint32_t OVERDRAW_VIEWPORT_SIZE = 256;
+
+struct OverdrawStats
+{
+    double overdraw = 0.0;  // shaded fragments per covered pixel, 1 is optimal
+    size_t pixelsCovered = 0;
+    size_t pixelsShaded = 0;
+};
+
+/*
+ * Estimates overdraw without a GPU : rasterizes the triangles in index order with a depth test
+ * from the 6 axis directions, orthographic, and counts the fragments that pass the depth test.
+ * With backFaceCulling the triangles facing away from the view are skipped, counter clockwise
+ * seen from the outside is front facing as in OBJ files.
+ */
+OverdrawStats analyzeOverdraw(const uint32_t* indices, size_t indexCount, const Vertex* vertices, size_t vertexCount, bool backFaceCulling = true);
+
+/*
+ * Reorders the triangles so the ones facing outwards are drawn first and hide the ones behind
+ * them from the fragment shader. Run it after optimizeVertexCache : the index buffer is split
+ * where the vertex cache starts over and then wherever the ACMR of a cluster is within
+ * threshold times that of its run, and the clusters are sorted by how far out they face.
+ * Triangles keep their order inside a cluster, so ACMR grows by about threshold at most.
+ */
+void optimizeOverdraw(uint32_t* indices, size_t indexCount, const Vertex* vertices, size_t vertexCount, float threshold = OVERDRAW_DEFAULT_THRESHOLD, uint32_t cacheSize = VERTEX_CACHE_DEFAULT_SIZE);
+
+void optimizeOverdraw(ObjectBufferData& objectData, float threshold = OVERDRAW_DEFAULT_THRESHOLD, uint32_t cacheSize = VERTEX_CACHE_DEFAULT_SIZE);
+
+// Sorts whole meshlets the same way, their contents and so the vertex cache behaviour are kept
+void optimizeOverdraw(std::vector<Meshlet>& meshlets, const Vertex* vertices, size_t vertexCount);
+
+#endif // OVERDRAW_HPP
@@ -0,0 +1,358 @@
+#include "PipelineBuilder.hpp"
+#include "Defines.hpp"
+#include "Helpers.hpp"
+
+#include <array>
+#include <chrono>
+#include <unordered_map>
+
+static std::unordered_map<VertexInputAttribute_T, VkFormat> vertexAttributeFormatLUT {
+    { VertexInputAttribute_T::ePosition        , VK_FORMAT_R32G32B32_SFLOAT },
+    { VertexInputAttribute_T::eUv              , VK_FORMAT_R32G32_SFLOAT },
+    { VertexInputAttribute_T::eNormal          , VK_FORMAT_R32G32B32_SFLOAT },
+    { VertexInputAttribute_T::ePositionUnorm16 , VK_FORMAT_R16G16B16A16_UNORM },
+    { VertexInputAttribute_T::eUvHalf          , VK_FORMAT_R16G16_SFLOAT },
+    { VertexInputAttribute_T::eNormalOctSnorm16, VK_FORMAT_R16G16_SNORM },
+    { VertexInputAttribute_T::eNormalOctSnorm8 , VK_FORMAT_R8G8_SNORM },
+};
+
+PipelineBuilder::PipelineBuilder(const PipelineBuilderParams& _params)
+    : params { _params }
+{
+    assert(params.threadCount > 0);
+
+    workers.reserve(params.threadCount);
+    for (uint32_t i = 0; i < params.threadCount; ++i)
+        workers.emplace_back(&PipelineBuilder::run, this);
+
+    LOG("PipelineBuilder : %u worker threads\n", params.threadCount);
+}
+
+PipelineBuilder::~PipelineBuilder()
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopRequested = true;
+    }
+    jobAdded.notify_all();
+
+    // the workers finish the pipeline they are on, queued jobs are dropped
+    for (std::thread& worker : workers)
+        worker.join();
+
+    for (const PipelineEntry& entry : entries)
+        vkDestroyPipeline(params.device, entry.pipeline, nullptr);
+}
+
+uint32_t PipelineBuilder::request(const PipelineDesc& desc)
+{
+    uint32_t id = 0;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+
+        for (; id < entries.size(); ++id)
+        {
+            if (entries[id].desc == desc)
+                return id;
+        }
+
+        entries.push_back({ .desc = desc });
+        jobs.push_back(id);
+    }
+    jobAdded.notify_one();
+
+    return id;
+}
+
+VkPipeline PipelineBuilder::get(uint32_t id)
+{
+    std::unique_lock<std::mutex> lock(mutex);
+    assert(id < entries.size());
+
+    PipelineEntry& entry = entries[id];
+    if (!entry.done)
+    {
+        const auto start = std::chrono::steady_clock::now();
+        jobDone.wait(lock, [&]() { return entry.done; });
+
+        const double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+        LOG("PipelineBuilder : waited %.2f ms for %s\n", ms, entry.desc.name.c_str());
+    }
+
+    return entry.pipeline;
+}
+
+bool PipelineBuilder::isReady(uint32_t id)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    assert(id < entries.size());
+    return entries[id].done;
+}
+
+void PipelineBuilder::run()
+{
+    while (true)
+    {
+        uint32_t id = 0;
+        PipelineDesc desc;
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            jobAdded.wait(lock, [&]() { return stopRequested || !jobs.empty(); });
+            if (stopRequested)
+                break;
+
+            id = jobs.front();
+            jobs.pop_front();
+            desc = entries[id].desc;
+        }
+
+        const auto start = std::chrono::steady_clock::now();
+        const VkPipeline pipeline = createPipeline(desc);
+        const double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+        LOG("PipelineBuilder : %s compiled in %.2f ms\n", desc.name.c_str(), ms);
+
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            entries[id].pipeline = pipeline;
+            entries[id].done = true;
+        }
+        jobDone.notify_all();
+    }
+}
+
+VkPipeline PipelineBuilder::createComputePipeline(const PipelineDesc& desc) const
+{
+    const VkComputePipelineCreateInfo pipelineCreateInfo {
+        .sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO,
+        .stage = {
+            .sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO,
+            .stage = VK_SHADER_STAGE_COMPUTE_BIT,
+            .module = createShaderModule(params.device, desc.computeShader.c_str()),
+            .pName = "main",
+        },
+        .layout = (desc.layout != VK_NULL_HANDLE) ? desc.layout : params.pipelineLayout,
+        .basePipelineHandle = VK_NULL_HANDLE,
+        .basePipelineIndex = 0,
+    };
+
+    VkPipeline pipeline = VK_NULL_HANDLE;
+    VK_CHECK(vkCreateComputePipelines(params.device, params.pipelineCache, 1, &pipelineCreateInfo, nullptr, &pipeline));
+
+    vkDestroyShaderModule(params.device, pipelineCreateInfo.stage.module, nullptr);
+
+    return pipeline;
+}
+
+VkPipeline PipelineBuilder::createPipeline(const PipelineDesc& desc) const
+{
+    if (!desc.computeShader.empty())
+        return createComputePipeline(desc);
+
+    const bool depthOnly = desc.fragmentShader.empty();
+    const bool meshShading = !desc.meshShader.empty();
+
+    const VkSpecializationMapEntry specializationMapEntries[] {
+        { .constantID = 0, .offset = 0 * sizeof(uint32_t), .size = sizeof(uint32_t) },
+        { .constantID = 1, .offset = 1 * sizeof(uint32_t), .size = sizeof(uint32_t) },
+        { .constantID = 2, .offset = 2 * sizeof(uint32_t), .size = sizeof(uint32_t) },
+        { .constantID = 3, .offset = 3 * sizeof(uint32_t), .size = sizeof(uint32_t) },
+        { .constantID = 4, .offset = 4 * sizeof(uint32_t), .size = sizeof(uint32_t) },
+        { .constantID = 5, .offset = 5 * sizeof(uint32_t), .size = sizeof(uint32_t) },
+        { .constantID = 6, .offset = 6 * sizeof(uint32_t), .size = sizeof(uint32_t) },
+        { .constantID = 7, .offset = 7 * sizeof(uint32_t), .size = sizeof(uint32_t) },
+        { .constantID = 8, .offset = 8 * sizeof(uint32_t), .size = sizeof(uint32_t) },
+    };
+    assert(desc.vertexSpecialization.size() <= std::size(specializationMapEntries));
+
+    const VkSpecializationInfo vertexSpecializationInfo {
+        .mapEntryCount = static_cast<uint32_t>(desc.vertexSpecialization.size()),
+        .pMapEntries = specializationMapEntries,
+        .dataSize = sizeof(uint32_t) * desc.vertexSpecialization.size(),
+        .pData = desc.vertexSpecialization.data(),
+    };
+
+    // task (optional), then vertex or mesh, then fragment unless depth only
+    std::array<VkPipelineShaderStageCreateInfo, 3> shaderStageCreateInfo;
+    uint32_t stageCount = 0;
+
+    if (!desc.taskShader.empty())
+    {
+        assert(meshShading);
+        shaderStageCreateInfo[stageCount++] = {
+            .sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO,
+            .stage = VK_SHADER_STAGE_TASK_BIT_EXT,
+            .module = createShaderModule(params.device, desc.taskShader.c_str()),
+            .pName = "main",
+            .pSpecializationInfo = desc.vertexSpecialization.empty() ? nullptr : &vertexSpecializationInfo,
+        };
+    }
+
+    shaderStageCreateInfo[stageCount++] = {
+        .sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO,
+        .stage = meshShading ? VK_SHADER_STAGE_MESH_BIT_EXT : VK_SHADER_STAGE_VERTEX_BIT,
+        .module = createShaderModule(params.device, meshShading ? desc.meshShader.c_str() : desc.vertexShader.c_str()),
+        .pName = "main",
+        .pSpecializationInfo = desc.vertexSpecialization.empty() ? nullptr : &vertexSpecializationInfo,
+    };
+
+    if (!depthOnly)
+    {
+        shaderStageCreateInfo[stageCount++] = {
+            .sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO,
+            .stage = VK_SHADER_STAGE_FRAGMENT_BIT,
+            .module = createShaderModule(params.device, desc.fragmentShader.c_str()),
+            .pName = "main",
+        };
+    }
+
+    // binding 0 holds every attribute, or only positions when they are a separate stream and binding 1 the rest
+    const VertexFormat& vertexFormat = desc.vertexFormat;
+    const bool separatePositions = vertexFormat.separatePositions;
+
+    const std::array<VkVertexInputBindingDescription, 2> vertexInputBindings {{
+        {
+            .binding = 0,
+            .stride = separatePositions ? getPositionStride(vertexFormat) : getVertexStride(vertexFormat),
+            .inputRate = VK_VERTEX_INPUT_RATE_VERTEX,
+        },
+        {
+            .binding = 1,
+            .stride = getVertexStride(vertexFormat),
+            .inputRate = VK_VERTEX_INPUT_RATE_VERTEX,
+        }
+    }};
+
+    const std::array<VertexInputAttribute_T, 3> attribs { vertexFormat.position, vertexFormat.uv, vertexFormat.normal };
+
+    std::array<VkVertexInputAttributeDescription, 3> vertexInputAttributes;
+    uint32_t attribOffset = 0;
+    for (size_t i = 0; i < attribs.size(); ++i)
+    {
+        const uint32_t binding = (separatePositions && i > 0) ? 1 : 0;
+        if (separatePositions && i == 1)
+            attribOffset = 0;
+
+        vertexInputAttributes[i] = {
+            .location = getVertexAttributeLocation(attribs[i]),
+            .binding = binding,
+            .format = vertexAttributeFormatLUT.at(attribs[i]),
+            .offset = attribOffset,
+        };
+
+        attribOffset += getVertexAttributeSize(attribs[i]);
+    }
+
+    const VkPipelineVertexInputStateCreateInfo vertexInputStateCreateInfo{
+        .sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO,
+        .vertexBindingDescriptionCount = separatePositions ? 2u : 1u,
+        .pVertexBindingDescriptions = vertexInputBindings.data(),
+        .vertexAttributeDescriptionCount = static_cast<uint32_t>(vertexInputAttributes.size()),
+        .pVertexAttributeDescriptions = vertexInputAttributes.data()
+    };
+
+    const VkViewport viewport{
+        .x = 0,
+        .y = 0,
+        .width = static_cast<float>(params.extent.width),
+        .height = static_cast<float>(params.extent.height),
+        .minDepth = 0.0f,
+        .maxDepth = 1.0f,
+    };
+
+    const VkRect2D scissorRect{
+        .offset = {.x = 0, .y = 0},
+        .extent = params.extent};
+
+    const VkPipelineViewportStateCreateInfo viewportStateCreateInfo{
+        .sType = VK_STRUCTURE_TYPE_PIPELINE_VIEWPORT_STATE_CREATE_INFO,
+        .viewportCount = 1,
+        .pViewports = &viewport,
+        .scissorCount = 1,
+        .pScissors = &scissorRect,
+    };
+
+    const VkPipelineDepthStencilStateCreateInfo depthStencilStateCreateInfo {
+        .sType = VK_STRUCTURE_TYPE_PIPELINE_DEPTH_STENCIL_STATE_CREATE_INFO,
+        .depthTestEnable = VK_TRUE,
+        .depthWriteEnable = VK_TRUE,
+        .depthCompareOp = VK_COMPARE_OP_LESS,
+        .depthBoundsTestEnable = VK_FALSE,
+        .stencilTestEnable = VK_FALSE,
+    };
+
+    const VkPipelineColorBlendAttachmentState colorBlendAttachmentState{
+        .blendEnable = VK_FALSE,
+        .srcColorBlendFactor = VK_BLEND_FACTOR_ZERO,
+        .dstColorBlendFactor = VK_BLEND_FACTOR_ZERO,
+        .colorBlendOp = VK_BLEND_OP_ADD,
+        .srcAlphaBlendFactor = VK_BLEND_FACTOR_ZERO,
+        .dstAlphaBlendFactor = VK_BLEND_FACTOR_ZERO,
+        .alphaBlendOp = VK_BLEND_OP_ADD,
+        .colorWriteMask = depthOnly ? 0u : (VK_COLOR_COMPONENT_R_BIT | VK_COLOR_COMPONENT_G_BIT | VK_COLOR_COMPONENT_B_BIT | VK_COLOR_COMPONENT_A_BIT),
+    };
+
+    const VkPipelineColorBlendStateCreateInfo colorBlendStateCreateInfo{
+        .sType = VK_STRUCTURE_TYPE_PIPELINE_COLOR_BLEND_STATE_CREATE_INFO,
+        .logicOpEnable = VK_FALSE,
+        .logicOp = VK_LOGIC_OP_COPY,
+        .attachmentCount = 1,
+        .pAttachments = &colorBlendAttachmentState,
+        .blendConstants = {0, 0, 0, 0}};
+
+    const VkPipelineInputAssemblyStateCreateInfo inputAssemblyStateCreateInfo{
+        .sType = VK_STRUCTURE_TYPE_PIPELINE_INPUT_ASSEMBLY_STATE_CREATE_INFO,
+        .topology = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST,
+        .primitiveRestartEnable = VK_FALSE,
+    };
+
+    const VkPipelineRasterizationStateCreateInfo rasterizationStateCreateInfo{
+        .sType = VK_STRUCTURE_TYPE_PIPELINE_RASTERIZATION_STATE_CREATE_INFO,
+        .depthClampEnable = VK_FALSE,
+        .rasterizerDiscardEnable = VK_FALSE,
+        .polygonMode = desc.polygonMode,
+        .cullMode = desc.cullMode,
+        .frontFace = desc.frontFace,
+        .depthBiasEnable = VK_FALSE,
+        .depthBiasConstantFactor = 0.0f,
+        .depthBiasClamp = 0.0f,
+        .depthBiasSlopeFactor = 0.0f,
+        .lineWidth = 1.0f,
+    };
+
+    const VkPipelineMultisampleStateCreateInfo multisampleStateCreateInfo{
+        .sType = VK_STRUCTURE_TYPE_PIPELINE_MULTISAMPLE_STATE_CREATE_INFO,
+        .rasterizationSamples = VK_SAMPLE_COUNT_1_BIT,
+        .sampleShadingEnable = VK_FALSE,
+        .minSampleShading = 0.0f,
+        .pSampleMask = nullptr,
+        .alphaToCoverageEnable = VK_FALSE,
+        .alphaToOneEnable = VK_FALSE,
+    };
+
+    const VkGraphicsPipelineCreateInfo pipelineCreateInfo{
+        .sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO,
+        .stageCount = stageCount,
+        .pStages = shaderStageCreateInfo.data(),
+        .pVertexInputState = meshShading ? nullptr : &vertexInputStateCreateInfo,
+        .pInputAssemblyState = meshShading ? nullptr : &inputAssemblyStateCreateInfo,
+        .pViewportState = &viewportStateCreateInfo,
+        .pRasterizationState = &rasterizationStateCreateInfo,
+        .pMultisampleState = &multisampleStateCreateInfo,
+        .pDepthStencilState = &depthStencilStateCreateInfo,
+        .pColorBlendState = &colorBlendStateCreateInfo,
+        .layout = (desc.layout != VK_NULL_HANDLE) ? desc.layout : params.pipelineLayout,
+        .renderPass = params.renderPass,
+        .subpass = 0,
+        .basePipelineHandle = VK_NULL_HANDLE,
+        .basePipelineIndex = 0,
+    };
+
+    VkPipeline pipeline = VK_NULL_HANDLE;
+    VK_CHECK(vkCreateGraphicsPipelines(params.device, params.pipelineCache, 1, &pipelineCreateInfo, nullptr, &pipeline));
+
+    for (uint32_t i = 0; i < stageCount; ++i)
+        vkDestroyShaderModule(params.device, shaderStageCreateInfo[i].module, nullptr);
+
+    return pipeline;
+}
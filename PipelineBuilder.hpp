@@ -0,0 +1,102 @@
+#ifndef PIPELINE_BUILDER_HPP
+#define PIPELINE_BUILDER_HPP
+
+#include <stdint.h>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <vulkan/vulkan.h>
+
+#include "VertexFormat.hpp"
+
+// A graphics pipeline of the main render pass as plain data. The rest of the state is fixed :
+// depth test less, no blending, triangle lists, the viewport covering the whole extent.
+// With computeShader set it is a compute pipeline instead, and only the layout applies.
+struct PipelineDesc
+{
+    std::string name;                     // for the logs
+
+    std::string computeShader;            // SPIR-V paths
+    std::string vertexShader;
+    std::string taskShader;               // optional task stage in front of meshShader, which it launches
+    std::string meshShader;               // replaces the vertex stage when set, vertices are then fetched by the shader
+    std::string fragmentShader;           // empty for depth only pipelines, which leave color alone
+
+    // specialization constants of the vertex, task and mesh stages, constant_id i is vertexSpecialization[i]
+    std::vector<uint32_t> vertexSpecialization;
+
+    VkPipelineLayout layout = VK_NULL_HANDLE; // PipelineBuilderParams::pipelineLayout when null
+
+    VertexFormat vertexFormat;            // vertex input state, unused by mesh shader pipelines
+    VkPolygonMode polygonMode = VK_POLYGON_MODE_FILL;
+    VkCullModeFlags cullMode = VK_CULL_MODE_NONE;
+    VkFrontFace frontFace = VK_FRONT_FACE_COUNTER_CLOCKWISE; // shaders culling triangles themselves take it as a specialization constant
+
+    bool operator==(const PipelineDesc&) const = default;
+};
+
+struct PipelineBuilderParams
+{
+    VkDevice device;
+    VkPipelineCache pipelineCache;        // shared by the workers, pipeline caches are internally synchronized
+    VkPipelineLayout pipelineLayout;      // unless the description has its own
+    VkRenderPass renderPass;
+    VkExtent2D extent;
+    uint32_t threadCount;
+};
+
+/*
+ * Creates graphics and compute pipelines on a pool of worker threads.
+ *
+ * request queues a description and returns right away with its id, requesting a description
+ * again returns the same id. get returns the pipeline, and only waits if the workers have not
+ * finished it yet, so a pipeline requested early costs the frame loop nothing. Each pipeline
+ * logs its compile time, and get logs how long a frame had to wait for one.
+ *
+ * The builder owns the pipelines, they are destroyed with it. request and get are called from
+ * one thread.
+ */
+class PipelineBuilder
+{
+private:
+    struct PipelineEntry
+    {
+        PipelineDesc desc;
+        VkPipeline pipeline = VK_NULL_HANDLE;
+        bool done = false;
+    };
+
+    PipelineBuilderParams params;
+
+    std::mutex mutex;
+    std::condition_variable jobAdded;
+    std::condition_variable jobDone;
+    std::deque<PipelineEntry> entries;  // indexed by id, a deque keeps references stable
+    std::deque<uint32_t> jobs;
+    bool stopRequested = false;
+
+    std::vector<std::thread> workers;
+
+    void run();
+    VkPipeline createPipeline(const PipelineDesc& desc) const;
+    VkPipeline createComputePipeline(const PipelineDesc& desc) const;
+public:
+    PipelineBuilder(const PipelineBuilderParams& params);
+    ~PipelineBuilder();
+
+    PipelineBuilder(const PipelineBuilder&) = delete;
+    PipelineBuilder& operator=(const PipelineBuilder&) = delete;
+
+    uint32_t request(const PipelineDesc& desc);
+
+    // Waits for the workers if the pipeline is not created yet
+    VkPipeline get(uint32_t id);
+
+    bool isReady(uint32_t id);
+};
+
+#endif // PIPELINE_BUILDER_HPP
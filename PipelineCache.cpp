@@ -0,0 +1,100 @@
+#include "PipelineCache.hpp"
+#include "Defines.hpp"
+
+#include <stdio.h>
+#include <string.h>
+#include <string>
+#include <vector>
+
+// VkPipelineCacheHeaderVersionOne, read field by field since the blob carries no alignment guarantee
+static constexpr size_t PIPELINE_CACHE_HEADER_SIZE = 16 + VK_UUID_SIZE;
+
+static bool isPipelineCacheCompatible(VkPhysicalDevice physicalDevice, const std::vector<char>& blob)
+{
+    if (blob.size() < PIPELINE_CACHE_HEADER_SIZE)
+        return false;
+
+    uint32_t header[4];
+    memcpy(header, blob.data(), sizeof(header));
+    const uint32_t headerSize = header[0];
+    const uint32_t headerVersion = header[1];
+    const uint32_t vendorID = header[2];
+    const uint32_t deviceID = header[3];
+
+    VkPhysicalDeviceProperties properties;
+    vkGetPhysicalDeviceProperties(physicalDevice, &properties);
+
+    return headerSize >= PIPELINE_CACHE_HEADER_SIZE && headerSize <= blob.size() &&
+        headerVersion == VK_PIPELINE_CACHE_HEADER_VERSION_ONE &&
+        vendorID == properties.vendorID &&
+        deviceID == properties.deviceID &&
+        memcmp(blob.data() + 16, properties.pipelineCacheUUID, VK_UUID_SIZE) == 0;
+}
+
+VkPipelineCache loadPipelineCache(VkDevice device, VkPhysicalDevice physicalDevice, const char* filepath, bool& warm)
+{
+    std::vector<char> blob;
+
+    FILE* f = fopen(filepath, "rb");
+    if (f != nullptr)
+    {
+        fseek(f, 0, SEEK_END);
+        const long fileSize = ftell(f);
+        rewind(f);
+
+        blob.resize(fileSize > 0 ? static_cast<size_t>(fileSize) : 0);
+        if (fread(blob.data(), 1, blob.size(), f) != blob.size())
+            blob.clear();
+        fclose(f);
+    }
+
+    warm = isPipelineCacheCompatible(physicalDevice, blob);
+    if (!warm && !blob.empty())
+    {
+        LOG("Pipeline cache %s was written by another device or driver, starting empty\n", filepath);
+    }
+
+    const VkPipelineCacheCreateInfo createInfo {
+        .sType = VK_STRUCTURE_TYPE_PIPELINE_CACHE_CREATE_INFO,
+        .initialDataSize = warm ? blob.size() : 0,
+        .pInitialData = warm ? blob.data() : nullptr,
+    };
+
+    VkPipelineCache pipelineCache = VK_NULL_HANDLE;
+    VK_CHECK(vkCreatePipelineCache(device, &createInfo, nullptr, &pipelineCache));
+
+    if (warm)
+    {
+        LOG("Pipeline cache loaded from %s : %zu bytes\n", filepath, blob.size());
+    }
+
+    return pipelineCache;
+}
+
+void savePipelineCache(VkDevice device, VkPipelineCache pipelineCache, const char* filepath)
+{
+    size_t dataSize = 0;
+    VK_CHECK(vkGetPipelineCacheData(device, pipelineCache, &dataSize, nullptr));
+
+    std::vector<char> blob(dataSize);
+    VK_CHECK(vkGetPipelineCacheData(device, pipelineCache, &dataSize, blob.data()));
+
+    const std::string tmpFilepath = std::string(filepath) + ".tmp";
+
+    FILE* f = fopen(tmpFilepath.c_str(), "wb");
+    if (f == nullptr)
+    {
+        LOG("Failed to open %s, the pipeline cache is not saved\n", tmpFilepath.c_str());
+        return;
+    }
+
+    const bool written = (fwrite(blob.data(), 1, dataSize, f) == dataSize);
+    if (fclose(f) != 0 || !written || rename(tmpFilepath.c_str(), filepath) != 0)
+    {
+        LOG("Failed to write %s, the pipeline cache is not saved\n", filepath);
+        remove(tmpFilepath.c_str());
+        return;
+    }
+
+    LOG("Pipeline cache saved to %s : %zu bytes\n", filepath, dataSize);
+}
@@ -0,0 +1,19 @@
+#ifndef PIPELINE_CACHE_HPP
+#define PIPELINE_CACHE_HPP
+
+#include <vulkan/vulkan.h>
+
+/*
+ * VkPipelineCache persisted between runs.
+ *
+ * The blob on disk is only used when its header matches the device : vendor, device and
+ * pipelineCacheUUID, which changes with the driver version. Anything else starts an empty cache.
+ */
+
+// warm is set when a valid blob was loaded
+VkPipelineCache loadPipelineCache(VkDevice device, VkPhysicalDevice physicalDevice, const char* filepath, bool& warm);
+
+// Writes to a temporary file renamed over filepath, a crash never leaves a truncated cache behind
+void savePipelineCache(VkDevice device, VkPipelineCache pipelineCache, const char* filepath);
+
+#endif // PIPELINE_CACHE_HPP
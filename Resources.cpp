@@ -1,135 +1,120 @@
 #include <string.h>
+#include <algorithm>
 
 #include "Resources.hpp"
 #include "Defines.hpp"
 
-static VkPhysicalDeviceMemoryProperties physicalDeviceMemoryProperties {};
-
-static uint32_t getHeapIdx(uint32_t memoryTypeBits, VkMemoryPropertyFlags memoryProperties)
+static MemoryCategory getBufferCategory(VkBufferUsageFlags usage)
 {
-	// Iterate over all memory types available for the device used in this example
-	for (uint32_t i = 0; i < physicalDeviceMemoryProperties.memoryTypeCount; i++)
-	{
-		if (memoryTypeBits & (1 << i) && (physicalDeviceMemoryProperties.memoryTypes[i].propertyFlags & memoryProperties) == memoryProperties)
-		{
-			return i;
-		}
-	}
-
-    assert( false && "Could not find suitable memory type!");
-    return 0;
+    if (usage & (VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_INDEX_BUFFER_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT))
+        return MemoryCategory::eGeometry;
+
+    if (usage & VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT)
+        return MemoryCategory::eUniform;
+
+    if (usage & VK_BUFFER_USAGE_TRANSFER_SRC_BIT)
+        return MemoryCategory::eStaging;
+
+    return MemoryCategory::eOther;
 }
 
-void setPhysicalDeviceMemoryProperties(const VkPhysicalDeviceMemoryProperties& _physicalDeviceMemoryProperties)
+void createBuffer(VkDevice device, VkDeviceSize size, VkBufferUsageFlags usage, VkMemoryPropertyFlags memoryProperties, Buffer& buffer)
 {
-    physicalDeviceMemoryProperties = _physicalDeviceMemoryProperties;
+    createBuffer(device, size, usage, memoryProperties, nullptr, 0, buffer);
 }
 
-void createBuffer(VkDevice device, VkDeviceSize size, VkBufferUsageFlags usage, VkMemoryPropertyFlags memoryProperties, Buffer& buffer)
+static void createVkBuffer(VkDevice device, Buffer& buffer)
 {
     const VkBufferCreateInfo createInfo {
         .sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO,
-        .size = size,
-        .usage = usage,
-        .sharingMode = VK_SHARING_MODE_EXCLUSIVE,
+        .size = buffer.size,
+        .usage = buffer.usage,
+        .sharingMode = (buffer.queueFamilyIndexCount > 0) ? VK_SHARING_MODE_CONCURRENT : VK_SHARING_MODE_EXCLUSIVE,
+        .queueFamilyIndexCount = buffer.queueFamilyIndexCount,
+        .pQueueFamilyIndices = (buffer.queueFamilyIndexCount > 0) ? buffer.queueFamilyIndices : nullptr,
     };
 
     VK_CHECK(vkCreateBuffer(device, &createInfo, nullptr, &buffer.buffer));
+}
+
+void createBuffer(VkDevice device, VkDeviceSize size, VkBufferUsageFlags usage, VkMemoryPropertyFlags memoryProperties, const uint32_t* queueFamilyIndices, uint32_t queueFamilyIndexCount, Buffer& buffer)
+{
+    // concurrent sharing needs distinct families
+    const bool concurrent = (queueFamilyIndexCount > 1) && std::any_of(queueFamilyIndices + 1, queueFamilyIndices + queueFamilyIndexCount, [&](uint32_t idx) { return idx != queueFamilyIndices[0]; });
+    assert(!concurrent || queueFamilyIndexCount <= 2);
+
+    buffer.size = size;
+    buffer.mappedData = nullptr;
+    buffer.usage = usage;
+    buffer.queueFamilyIndexCount = concurrent ? queueFamilyIndexCount : 0;
+    if (concurrent)
+        std::copy(queueFamilyIndices, queueFamilyIndices + queueFamilyIndexCount, buffer.queueFamilyIndices);
+
+    createVkBuffer(device, buffer);
 
     VkMemoryRequirements memReqs;
     vkGetBufferMemoryRequirements(device, buffer.buffer, &memReqs);
 
-    const VkMemoryAllocateInfo allocInfo{
-        .sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO,
-        .allocationSize = memReqs.size,
-        .memoryTypeIndex = getHeapIdx(memReqs.memoryTypeBits, memoryProperties)
-    };
+    buffer.allocation = allocateDeviceMemory(memReqs, memoryProperties, true, getBufferCategory(usage));
 
-    VK_CHECK(vkAllocateMemory(device, &allocInfo, nullptr, &buffer.memory));
+    VK_CHECK(vkBindBufferMemory(device, buffer.buffer, buffer.allocation.memory, buffer.allocation.offset));
+}
 
-    VK_CHECK(vkBindBufferMemory(device, buffer.buffer, buffer.memory, 0));
+void mapBuffer(VkDevice device, Buffer& buffer)
+{
+    // host visible blocks stay mapped, the buffer only points into them
+    assert(buffer.mappedData == nullptr && buffer.allocation.mappedData != nullptr);
+    buffer.mappedData = buffer.allocation.mappedData;
 }
 
 void uploadToBuffer(VkDevice device, const Buffer& buffer, VkDeviceSize size, VkDeviceSize offset, void* data)
 {
-    // TODO : store mapped pointer
-    void* mappedData = nullptr;
-    vkMapMemory(device, buffer.memory, 0, VK_WHOLE_SIZE, 0, &mappedData);
-    memcpy(mappedData + offset, data, size);
-
-    VkMappedMemoryRange range{
-        .sType = VK_STRUCTURE_TYPE_MAPPED_MEMORY_RANGE,
-        .memory = buffer.memory,
-        .offset = 0,
-        .size = VK_WHOLE_SIZE,
-    };
+    assert(buffer.allocation.mappedData != nullptr && "uploadToBuffer needs a host visible buffer");
+    memcpy(static_cast<char*>(buffer.allocation.mappedData) + offset, data, size);
 
-    vkFlushMappedMemoryRanges(device, 1, &range);
-    vkUnmapMemory(device, buffer.memory);
+    flushDeviceMemory(buffer.allocation, offset, size);
 }
 
-void uploadBuffer(VkDevice device, VkCommandPool commandPool, VkCommandBuffer commandBuffer, VkQueue queue, const Buffer& stagingBuffer, const Buffer& dstBuffer, VkDeviceSize size, void* data)
+void destroyBuffer(VkDevice device, Buffer& buffer)
 {
-    void* stagingData = nullptr;
-    vkMapMemory(device, stagingBuffer.memory, 0, VK_WHOLE_SIZE, 0, &stagingData);
-    memcpy(stagingData, data, size);
-
-    VkMappedMemoryRange range{
-        .sType = VK_STRUCTURE_TYPE_MAPPED_MEMORY_RANGE,
-        .memory = stagingBuffer.memory,
-        .offset = 0,
-        .size = VK_WHOLE_SIZE,
-    };
+    vkDestroyBuffer(device, buffer.buffer, nullptr);
+    freeDeviceMemory(buffer.allocation);
 
-    vkFlushMappedMemoryRanges(device, 1, &range);
-    vkUnmapMemory(device, stagingBuffer.memory);
+    buffer.buffer = VK_NULL_HANDLE;
+    buffer.size = 0;
+    buffer.mappedData = nullptr;
+}
 
-    static const VkCommandBufferBeginInfo commandBufferBeginInfo {
-        .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO,
-        .flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT
-    };
+VkBuffer moveBuffer(VkDevice device, VkCommandBuffer commandBuffer, Buffer& buffer, const DeviceAllocation& allocation)
+{
+    const VkBuffer oldBuffer = buffer.buffer;
+
+    // same create info, so the same memory requirements the allocation was made for
+    createVkBuffer(device, buffer);
+    buffer.allocation = allocation;
+    VK_CHECK(vkBindBufferMemory(device, buffer.buffer, buffer.allocation.memory, buffer.allocation.offset));
 
-    VK_CHECK(vkBeginCommandBuffer(commandBuffer, &commandBufferBeginInfo));
+    if (buffer.mappedData != nullptr)
+        buffer.mappedData = buffer.allocation.mappedData;
 
-    const VkBufferCopy buffer_copy {
+    const VkBufferCopy region {
         .srcOffset = 0,
         .dstOffset = 0,
-        .size = size
+        .size = buffer.size,
     };
+    vkCmdCopyBuffer(commandBuffer, oldBuffer, buffer.buffer, 1, &region);
 
-    vkCmdCopyBuffer(commandBuffer, stagingBuffer.buffer, dstBuffer.buffer, 1u, &buffer_copy);
-
-    VK_CHECK(vkEndCommandBuffer(commandBuffer));
-
-    const VkSubmitInfo submitInfo {
-        .sType = VK_STRUCTURE_TYPE_SUBMIT_INFO,
-        .commandBufferCount = 1u,
-        .pCommandBuffers = &commandBuffer
-    };
-
-    VK_CHECK(vkQueueSubmit(queue, 1u, &submitInfo, VK_NULL_HANDLE));
-
-    vkQueueWaitIdle(queue);
-    vkResetCommandPool(device, commandPool,  0x0);
+    return oldBuffer;
 }
 
-void destroyBuffer(VkDevice device, Buffer& buffer)
-{
-    vkFreeMemory(device, buffer.memory, nullptr);
-    vkDestroyBuffer(device, buffer.buffer, nullptr);
-
-    buffer.memory = VK_NULL_HANDLE;
-    buffer.buffer = VK_NULL_HANDLE;
-}
-
-void createAttachment(const VkDevice device, const VkFormat format, const VkExtent3D extent, VkImageUsageFlags usage, VkImageAspectFlags aspectMask, Attachment& attachment)
+void createAttachment(const VkDevice device, const VkFormat format, const VkExtent3D extent, VkImageUsageFlags usage, VkImageAspectFlags aspectMask, uint32_t mipLevels, Attachment& attachment)
 {
     const VkImageCreateInfo imageCreateInfo = {
         .sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO,
         .imageType = VK_IMAGE_TYPE_2D,
         .format = format,
         .extent = extent,
-        .mipLevels = 1,
+        .mipLevels = mipLevels,
         .arrayLayers = 1,
         .samples = VK_SAMPLE_COUNT_1_BIT,
         .tiling = VK_IMAGE_TILING_OPTIMAL,
@@ -143,14 +128,8 @@ void createAttachment(const VkDevice device, const VkFormat format, const VkExte
     VkMemoryRequirements memReqs;
     vkGetImageMemoryRequirements(device, attachment.image, &memReqs);
 
-    const VkMemoryAllocateInfo allocateInfo = { 
-        .sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO,
-        .allocationSize = memReqs.size,
-        .memoryTypeIndex = getHeapIdx(memReqs.memoryTypeBits, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT)
-    };
-
-    VK_CHECK(vkAllocateMemory(device, &allocateInfo, nullptr, &attachment.memory));
-    VK_CHECK(vkBindImageMemory(device, attachment.image, attachment.memory, 0));
+    attachment.allocation = allocateDeviceMemory(memReqs, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, false, MemoryCategory::eAttachment);
+    VK_CHECK(vkBindImageMemory(device, attachment.image, attachment.allocation.memory, attachment.allocation.offset));
 
     const VkImageViewCreateInfo imageViewCreateInfo {
         .sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO,
@@ -165,7 +144,7 @@ void createAttachment(const VkDevice device, const VkFormat format, const VkExte
         .subresourceRange = {
             .aspectMask = aspectMask,
             .baseMipLevel = 0,
-            .levelCount = 1,
+            .levelCount = mipLevels,
             .baseArrayLayer = 0,
             .layerCount = 1 }
     };
@@ -176,10 +155,9 @@ void createAttachment(const VkDevice device, const VkFormat format, const VkExte
 void destroyAttachment(VkDevice device, Attachment& attachment)
 {
     vkDestroyImage(device, attachment.image, nullptr);
-    vkFreeMemory(device, attachment.memory, nullptr);
+    freeDeviceMemory(attachment.allocation);
     vkDestroyImageView(device, attachment.view, nullptr);
 
     attachment.image = VK_NULL_HANDLE;
-    attachment.memory = VK_NULL_HANDLE;
     attachment.view = VK_NULL_HANDLE;
 }
\ No newline at end of file
@@ -3,27 +3,40 @@
 
 #include <vulkan/vulkan.h>
 
+#include "DeviceAllocator.hpp"
+
 struct Buffer
 {
     VkBuffer buffer;
-    VkDeviceMemory memory;
+    DeviceAllocation allocation; // offset into a VkDeviceMemory block shared with other resources
+    VkDeviceSize size;
+    void* mappedData; // non null while persistently mapped
+
+    // how the buffer was created, moveBuffer creates it again the same way
+    VkBufferUsageFlags usage;
+    uint32_t queueFamilyIndices[2]; // concurrent sharing, queueFamilyIndexCount of them
+    uint32_t queueFamilyIndexCount;
 };
 
 struct Attachment
 {
     VkImage image;
-    VkDeviceMemory memory;
+    DeviceAllocation allocation;
     VkImageView view;
 };
 
-void setPhysicalDeviceMemoryProperties(const VkPhysicalDeviceMemoryProperties& _physicalDeviceMemoryProperties);
-
 void createBuffer(VkDevice device, VkDeviceSize size, VkBufferUsageFlags usage, VkMemoryPropertyFlags memoryProperties, Buffer& buffer);
+// Shared by the given queue families without ownership transfers when there is more than one distinct family
+void createBuffer(VkDevice device, VkDeviceSize size, VkBufferUsageFlags usage, VkMemoryPropertyFlags memoryProperties, const uint32_t* queueFamilyIndices, uint32_t queueFamilyIndexCount, Buffer& buffer);
+void mapBuffer(VkDevice device, Buffer& buffer);
 void uploadToBuffer(VkDevice device, const Buffer& buffer, VkDeviceSize size, VkDeviceSize offset, void* data);
-void uploadBuffer(VkDevice device, VkCommandPool commandPool, VkCommandBuffer commandBuffer, VkQueue queue, const Buffer& stagingBuffer, const Buffer& dstBuffer, VkDeviceSize size, void* data);
 void destroyBuffer(VkDevice device, Buffer& buffer);
+// Recreates the buffer on the dst allocation of a defragmentation move and records the copy of its
+// contents. Returns the old VkBuffer, to destroy once the copy is done.
+VkBuffer moveBuffer(VkDevice device, VkCommandBuffer commandBuffer, Buffer& buffer, const DeviceAllocation& allocation);
 
-void createAttachment(const VkDevice device, const VkFormat format, const VkExtent3D extent, VkImageUsageFlags usage, VkImageAspectFlags aspectMask, Attachment& attachment);
+// The view covers every mip level
+void createAttachment(const VkDevice device, const VkFormat format, const VkExtent3D extent, VkImageUsageFlags usage, VkImageAspectFlags aspectMask, uint32_t mipLevels, Attachment& attachment);
 void destroyAttachment(VkDevice device, Attachment& attachment);
 
 #endif // RESOURCES_HPP
\ No newline at end of file
@@ -0,0 +1,45 @@
+#include <string.h>
+
+#include "UniformRing.hpp"
+#include "Defines.hpp"
+
+static VkDeviceSize alignUniform(VkDeviceSize value, VkDeviceSize alignment)
+{
+    return (value + alignment - 1) / alignment * alignment;
+}
+
+void createUniformRing(VkDevice device, VkPhysicalDevice physicalDevice, VkDeviceSize frameSize, uint32_t frameCount, Buffer& buffer, UniformRing& ring)
+{
+    VkPhysicalDeviceProperties properties;
+    vkGetPhysicalDeviceProperties(physicalDevice, &properties);
+
+    ring.alignment = properties.limits.minUniformBufferOffsetAlignment;
+    ring.frameSize = alignUniform(frameSize, ring.alignment);
+    ring.frameBegin = 0;
+    ring.offset = 0;
+
+    // coherent, so a push is only a memcpy
+    createBuffer(device, ring.frameSize * frameCount, VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, buffer);
+    mapBuffer(device, buffer);
+
+    ring.buffer = &buffer;
+}
+
+void beginUniformFrame(UniformRing& ring, uint32_t frameIndex)
+{
+    ring.frameBegin = ring.frameSize * frameIndex;
+    ring.offset = ring.frameBegin;
+
+    assert(ring.frameBegin + ring.frameSize <= ring.buffer->size);
+}
+
+uint32_t pushUniforms(UniformRing& ring, const void* data, VkDeviceSize size)
+{
+    const VkDeviceSize offset = ring.offset;
+    assert(offset + size <= ring.frameBegin + ring.frameSize && "uniform ring frame region is full");
+
+    memcpy(static_cast<char*>(ring.buffer->mappedData) + offset, data, size);
+    ring.offset = alignUniform(offset + size, ring.alignment);
+
+    return static_cast<uint32_t>(offset);
+}
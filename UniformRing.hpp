@@ -0,0 +1,32 @@
+#ifndef UNIFORM_RING_HPP
+#define UNIFORM_RING_HPP
+
+#include <stdint.h>
+
+#include <vulkan/vulkan.h>
+
+#include "Resources.hpp"
+
+/*
+ * Per frame uniform data, bump allocated into one persistently mapped, host coherent buffer.
+ *
+ * The buffer is split into one region per frame in flight. beginUniformFrame rewinds the region of
+ * the frame about to be recorded, which the GPU must be done with, and pushUniforms copies data into
+ * it and returns the offset to bind it at with a dynamic uniform buffer descriptor. The descriptors
+ * point at the start of the buffer and never change.
+ */
+struct UniformRing
+{
+    Buffer* buffer;
+    VkDeviceSize frameSize;  // bytes per frame region, a multiple of alignment
+    VkDeviceSize alignment;  // minUniformBufferOffsetAlignment
+    VkDeviceSize frameBegin; // region of the current frame
+    VkDeviceSize offset;     // next free byte in it
+};
+
+void createUniformRing(VkDevice device, VkPhysicalDevice physicalDevice, VkDeviceSize frameSize, uint32_t frameCount, Buffer& buffer, UniformRing& ring);
+void beginUniformFrame(UniformRing& ring, uint32_t frameIndex);
+// Returns the dynamic offset of the copy
+uint32_t pushUniforms(UniformRing& ring, const void* data, VkDeviceSize size);
+
+#endif // UNIFORM_RING_HPP
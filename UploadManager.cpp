@@ -0,0 +1,231 @@
+#include "UploadManager.hpp"
+#include "Defines.hpp"
+#include "Helpers.hpp"
+
+#include <string.h>
+#include <chrono>
+#include <algorithm>
+#include <tuple>
+
+// copy regions start on 16 bytes, the ring size is rounded down to it
+static constexpr uint64_t UPLOAD_ALIGNMENT = 16;
+
+static uint64_t alignUpload(uint64_t value)
+{
+    return (value + UPLOAD_ALIGNMENT - 1) & ~(UPLOAD_ALIGNMENT - 1);
+}
+
+UploadManager::UploadManager(const UploadManagerParams& _params)
+    : params { _params }
+{
+    assert(params.stagingBuffer->mappedData != nullptr && "UploadManager needs a persistently mapped staging buffer");
+
+    ringSize = params.stagingBuffer->size & ~(UPLOAD_ALIGNMENT - 1);
+
+    VkSemaphoreTypeCreateInfo semaphoreTypeCreateInfo {
+        .sType = VK_STRUCTURE_TYPE_SEMAPHORE_TYPE_CREATE_INFO,
+        .semaphoreType = VK_SEMAPHORE_TYPE_TIMELINE,
+        .initialValue = 0,
+    };
+
+    const VkSemaphoreCreateInfo semaphoreCreateInfo {
+        .sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO,
+        .pNext = &semaphoreTypeCreateInfo,
+    };
+
+    VK_CHECK(vkCreateSemaphore(params.device, &semaphoreCreateInfo, nullptr, &timelineSemaphore));
+}
+
+UploadManager::~UploadManager()
+{
+    assert(pendingCopies.empty() && "uploads were never flushed");
+    waitIdle();
+
+    for (const UploadBatch& batch : batches)
+        vkDestroyCommandPool(params.device, batch.commandPool, nullptr);
+
+    for (const auto& [commandPool, commandBuffer] : freeCommandBuffers)
+        vkDestroyCommandPool(params.device, commandPool, nullptr);
+
+    vkDestroySemaphore(params.device, timelineSemaphore, nullptr);
+}
+
+void UploadManager::upload(const Buffer& dstBuffer, VkDeviceSize dstOffset, const void* data, VkDeviceSize size)
+{
+    uint64_t completedValue = 0;
+    VK_CHECK(vkGetSemaphoreCounterValue(params.device, timelineSemaphore, &completedValue));
+    retire(completedValue);
+
+    VkDeviceSize uploaded = 0;
+    while (uploaded < size)
+    {
+        const uint64_t head = ringHead.load(std::memory_order_relaxed);
+        const uint64_t tail = ringTail.load(std::memory_order_relaxed);
+
+        // contiguous free space up to the end of the ring or the oldest region still in use
+        const uint64_t ringOffset = head % ringSize;
+        const uint64_t available = std::min(ringSize - ringOffset, ringSize - (head - tail));
+        if (available == 0)
+        {
+            waitForSpace();
+            continue;
+        }
+
+        const VkDeviceSize chunk = std::min<VkDeviceSize>(size - uploaded, available);
+        memcpy(static_cast<char*>(params.stagingBuffer->mappedData) + ringOffset, static_cast<const char*>(data) + uploaded, chunk);
+
+        pendingCopies.push_back({ dstBuffer.buffer, VkBufferCopy {
+            .srcOffset = ringOffset,
+            .dstOffset = dstOffset + uploaded,
+            .size = chunk,
+        }});
+
+        ringHead.store(head + alignUpload(chunk), std::memory_order_relaxed);
+        uploaded += chunk;
+    }
+
+    bytesUploaded.fetch_add(size, std::memory_order_relaxed);
+}
+
+uint64_t UploadManager::flush()
+{
+    if (pendingCopies.empty())
+        return lastSubmittedValue;
+
+    static const VkCommandBufferBeginInfo commandBufferBeginInfo {
+        .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO,
+        .flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT
+    };
+
+    UploadBatch batch {};
+    if (freeCommandBuffers.empty())
+    {
+        batch.commandPool = createCommandPool(params.device, params.queueFamilyIndex);
+        batch.commandBuffer = createCommandBuffer(params.device, batch.commandPool);
+    }
+    else
+    {
+        std::tie(batch.commandPool, batch.commandBuffer) = freeCommandBuffers.back();
+        freeCommandBuffers.pop_back();
+    }
+
+    VK_CHECK(vkBeginCommandBuffer(batch.commandBuffer, &commandBufferBeginInfo));
+
+    // consecutive regions usually go to the same buffer, one command per destination run
+    size_t runBegin = 0;
+    std::vector<VkBufferCopy> regions;
+    for (size_t i = 0; i <= pendingCopies.size(); ++i)
+    {
+        if (i < pendingCopies.size() && pendingCopies[i].dstBuffer == pendingCopies[runBegin].dstBuffer)
+            continue;
+
+        regions.clear();
+        for (size_t j = runBegin; j < i; ++j)
+            regions.push_back(pendingCopies[j].region);
+
+        vkCmdCopyBuffer(batch.commandBuffer, params.stagingBuffer->buffer, pendingCopies[runBegin].dstBuffer, static_cast<uint32_t>(regions.size()), regions.data());
+        runBegin = i;
+    }
+
+    VK_CHECK(vkEndCommandBuffer(batch.commandBuffer));
+
+    // staging memory is coherent, nothing to flush
+    batch.timelineValue = ++lastSubmittedValue;
+    batch.ringEnd = ringHead.load(std::memory_order_relaxed);
+
+    if (params.submit)
+    {
+        params.submit(batch.commandBuffer, batch.timelineValue);
+    }
+    else
+    {
+        const VkTimelineSemaphoreSubmitInfo timelineSubmitInfo {
+            .sType = VK_STRUCTURE_TYPE_TIMELINE_SEMAPHORE_SUBMIT_INFO,
+            .signalSemaphoreValueCount = 1,
+            .pSignalSemaphoreValues = &batch.timelineValue,
+        };
+
+        const VkSubmitInfo submitInfo {
+            .sType = VK_STRUCTURE_TYPE_SUBMIT_INFO,
+            .pNext = &timelineSubmitInfo,
+            .commandBufferCount = 1u,
+            .pCommandBuffers = &batch.commandBuffer,
+            .signalSemaphoreCount = 1u,
+            .pSignalSemaphores = &timelineSemaphore,
+        };
+
+        VK_CHECK(vkQueueSubmit(params.queue, 1u, &submitInfo, VK_NULL_HANDLE));
+    }
+
+    batches.push_back(batch);
+    pendingCopies.clear();
+    submitCount.fetch_add(1, std::memory_order_relaxed);
+
+    return lastSubmittedValue;
+}
+
+void UploadManager::waitIdle()
+{
+    const VkSemaphoreWaitInfo waitInfo {
+        .sType = VK_STRUCTURE_TYPE_SEMAPHORE_WAIT_INFO,
+        .semaphoreCount = 1,
+        .pSemaphores = &timelineSemaphore,
+        .pValues = &lastSubmittedValue,
+    };
+    VK_CHECK(vkWaitSemaphores(params.device, &waitInfo, UINT64_MAX));
+
+    retire(lastSubmittedValue);
+}
+
+UploadStats UploadManager::getStats() const
+{
+    return UploadStats {
+        .bytesUploaded = bytesUploaded.load(std::memory_order_relaxed),
+        .bytesInFlight = ringHead.load(std::memory_order_relaxed) - ringTail.load(std::memory_order_relaxed),
+        .submitCount = submitCount.load(std::memory_order_relaxed),
+        .stallCount = stallCount.load(std::memory_order_relaxed),
+        .stallMs = stallNs.load(std::memory_order_relaxed) / 1e6,
+    };
+}
+
+void UploadManager::retire(uint64_t completedValue)
+{
+    while (!batches.empty() && batches.front().timelineValue <= completedValue)
+    {
+        const UploadBatch& batch = batches.front();
+        VK_CHECK(vkResetCommandPool(params.device, batch.commandPool, 0x0));
+        freeCommandBuffers.push_back({ batch.commandPool, batch.commandBuffer });
+        ringTail.store(batch.ringEnd, std::memory_order_relaxed);
+        batches.pop_front();
+    }
+
+    // nothing in flight or pending, the next upload starts at the beginning of the ring
+    if (batches.empty() && pendingCopies.empty())
+    {
+        const uint64_t ringStart = (ringHead.load(std::memory_order_relaxed) + ringSize - 1) / ringSize * ringSize;
+        ringHead.store(ringStart, std::memory_order_relaxed);
+        ringTail.store(ringStart, std::memory_order_relaxed);
+    }
+}
+
+void UploadManager::waitForSpace()
+{
+    // the ring is full of copies nobody submitted yet
+    if (batches.empty())
+        flush();
+
+    const auto start = std::chrono::steady_clock::now();
+
+    const VkSemaphoreWaitInfo waitInfo {
+        .sType = VK_STRUCTURE_TYPE_SEMAPHORE_WAIT_INFO,
+        .semaphoreCount = 1,
+        .pSemaphores = &timelineSemaphore,
+        .pValues = &batches.front().timelineValue,
+    };
+    VK_CHECK(vkWaitSemaphores(params.device, &waitInfo, UINT64_MAX));
+
+    stallCount.fetch_add(1, std::memory_order_relaxed);
+    stallNs.fetch_add(std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count(), std::memory_order_relaxed);
+
+    retire(batches.front().timelineValue);
+}
@@ -0,0 +1,103 @@
+#ifndef UPLOAD_MANAGER_HPP
+#define UPLOAD_MANAGER_HPP
+
+#include <stdint.h>
+#include <atomic>
+#include <deque>
+#include <functional>
+#include <vector>
+
+#include <vulkan/vulkan.h>
+
+#include "Resources.hpp"
+
+struct UploadManagerParams
+{
+    VkDevice device;
+    VkQueue queue;
+    uint32_t queueFamilyIndex;
+    const Buffer* stagingBuffer; // persistently mapped, host coherent
+    // Submits a recorded batch so that it signals timelineValue on the manager semaphore. The
+    // manager submits to queue itself when this is empty.
+    std::function<void(VkCommandBuffer commandBuffer, uint64_t timelineValue)> submit;
+};
+
+struct UploadStats
+{
+    uint64_t bytesUploaded;  // since creation
+    uint64_t bytesInFlight;  // ring space not reclaimed yet, staged or being copied
+    uint64_t submitCount;
+    uint64_t stallCount;     // uploads that had to wait for ring space
+    double stallMs;          // total time spent waiting for ring space
+};
+
+/*
+ * Uploads to device local buffers through a staging buffer used as a ring.
+ *
+ * upload copies the data into the ring and records a copy region, flush records all regions
+ * recorded since the last flush into one command buffer and submits it, signaling the next value
+ * of a timeline semaphore. Ring space is reclaimed batch by batch once the semaphore passes their
+ * value, so the CPU only waits when the ring is full. An upload larger than the ring is split and
+ * flushed as it goes.
+ *
+ * Not thread safe, except for getStats which may be called from any thread.
+ */
+class UploadManager
+{
+private:
+    struct UploadCopy
+    {
+        VkBuffer dstBuffer;
+        VkBufferCopy region;
+    };
+
+    struct UploadBatch
+    {
+        VkCommandPool commandPool;
+        VkCommandBuffer commandBuffer;
+        uint64_t timelineValue;
+        uint64_t ringEnd; // ring position the batch space ends at
+    };
+
+    UploadManagerParams params;
+    uint64_t ringSize = 0;
+
+    // absolute byte positions, the ring offset is position % ringSize
+    std::atomic<uint64_t> ringHead { 0 }; // next byte to write
+    std::atomic<uint64_t> ringTail { 0 }; // oldest byte still in use
+
+    std::vector<UploadCopy> pendingCopies;
+    std::deque<UploadBatch> batches;      // submitted, ordered by timelineValue
+    std::vector<std::pair<VkCommandPool, VkCommandBuffer>> freeCommandBuffers;
+
+    VkSemaphore timelineSemaphore = VK_NULL_HANDLE;
+    uint64_t lastSubmittedValue = 0;
+
+    std::atomic<uint64_t> bytesUploaded { 0 };
+    std::atomic<uint64_t> submitCount { 0 };
+    std::atomic<uint64_t> stallCount { 0 };
+    std::atomic<uint64_t> stallNs { 0 };
+
+    void retire(uint64_t completedValue);
+    void waitForSpace();
+public:
+    UploadManager(const UploadManagerParams& params);
+    ~UploadManager();
+
+    UploadManager(const UploadManager&) = delete;
+    UploadManager& operator=(const UploadManager&) = delete;
+
+    void upload(const Buffer& dstBuffer, VkDeviceSize dstOffset, const void* data, VkDeviceSize size);
+
+    // Submits everything uploaded since the last flush, returns the timeline value the semaphore
+    // reaches once those copies are done
+    uint64_t flush();
+
+    // Waits for every submitted batch, pending uploads have to be flushed first
+    void waitIdle();
+
+    UploadStats getStats() const;
+    VkSemaphore getSemaphore() const { return timelineSemaphore; }
+};
+
+#endif // UPLOAD_MANAGER_HPP
@@ -0,0 +1,563 @@
+#include "VertexCache.hpp"
+#include "Loader.hpp"
+#include "Defines.hpp"
+
+#include <math.h>
+#include <string.h>
+#include <chrono>
+#include <algorithm>
+
+// vertex -> triangle adjacency, stored as one flat array with per-vertex offsets
+struct VertexAdjacency
+{
+    std::vector<uint32_t> offsets;
+    std::vector<uint32_t> triangles;
+};
+
+static VertexAdjacency buildVertexAdjacency(const uint32_t* indices, size_t indexCount, size_t vertexCount)
+{
+    VertexAdjacency adjacency;
+    adjacency.offsets.assign(vertexCount + 1, 0);
+    adjacency.triangles.resize(indexCount);
+
+    for (size_t i = 0; i < indexCount; ++i)
+    {
+        assert(indices[i] < vertexCount);
+        adjacency.offsets[indices[i] + 1]++;
+    }
+
+    for (size_t v = 0; v < vertexCount; ++v)
+    {
+        adjacency.offsets[v + 1] += adjacency.offsets[v];
+    }
+
+    std::vector<uint32_t> fill(adjacency.offsets.begin(), adjacency.offsets.end() - 1);
+    for (size_t i = 0; i < indexCount; ++i)
+    {
+        adjacency.triangles[fill[indices[i]]++] = static_cast<uint32_t>(i / 3);
+    }
+
+    return adjacency;
+}
+
+VertexCacheStats analyzeVertexCache(const uint32_t* indices, size_t indexCount, size_t vertexCount, uint32_t cacheSize, VertexCacheModel_T model)
+{
+    assert(indexCount % 3 == 0);
+    assert(cacheSize > 0);
+
+    VertexCacheStats stats;
+    if (indexCount == 0)
+        return stats;
+
+    size_t misses = 0;
+    size_t referencedCount = 0;
+    std::vector<uint8_t> referenced(vertexCount, 0);
+
+    if (model == VertexCacheModel_T::eFifo)
+    {
+        // a vertex is cached while fewer than cacheSize misses happened since it was inserted
+        std::vector<size_t> insertedAt(vertexCount, SIZE_MAX);
+        for (size_t i = 0; i < indexCount; ++i)
+        {
+            const uint32_t v = indices[i];
+            if (insertedAt[v] == SIZE_MAX || misses - insertedAt[v] >= cacheSize)
+            {
+                insertedAt[v] = misses++;
+            }
+
+            referencedCount += referenced[v] ? 0 : 1;
+            referenced[v] = 1;
+        }
+    }
+    else
+    {
+        // most recently used first
+        std::vector<uint32_t> cache;
+        cache.reserve(cacheSize + 1);
+        for (size_t i = 0; i < indexCount; ++i)
+        {
+            const uint32_t v = indices[i];
+            auto it = std::find(cache.begin(), cache.end(), v);
+            if (it == cache.end())
+            {
+                misses++;
+                cache.insert(cache.begin(), v);
+                if (cache.size() > cacheSize)
+                    cache.pop_back();
+            }
+            else
+            {
+                std::rotate(cache.begin(), it, it + 1);
+            }
+
+            referencedCount += referenced[v] ? 0 : 1;
+            referenced[v] = 1;
+        }
+    }
+
+    stats.acmr = double(misses) / (indexCount / 3);
+    stats.atvr = double(misses) / referencedCount;
+    return stats;
+}
+
+VertexFetchStats analyzeVertexFetch(const uint32_t* indices, size_t indexCount, size_t vertexCount, uint32_t vertexStride)
+{
+    assert(indexCount % 3 == 0);
+    assert(vertexStride > 0);
+
+    VertexFetchStats stats;
+    if (indexCount == 0)
+        return stats;
+
+    constexpr uint32_t setCount = VERTEX_FETCH_CACHE_SIZE / VERTEX_FETCH_CACHE_LINE / VERTEX_FETCH_CACHE_WAYS;
+
+    std::vector<uint64_t> tags(setCount * VERTEX_FETCH_CACHE_WAYS, UINT64_MAX);
+    std::vector<uint64_t> lastUse(setCount * VERTEX_FETCH_CACHE_WAYS, 0);
+    std::vector<size_t> insertedAt(vertexCount, SIZE_MAX);
+    std::vector<uint8_t> referenced(vertexCount, 0);
+
+    size_t transformCount = 0;
+    size_t referencedCount = 0;
+    size_t lineAccesses = 0;
+    size_t lineMisses = 0;
+
+    for (size_t i = 0; i < indexCount; ++i)
+    {
+        const uint32_t v = indices[i];
+
+        referencedCount += referenced[v] ? 0 : 1;
+        referenced[v] = 1;
+
+        // post-transform cache hit, nothing is fetched
+        if (insertedAt[v] != SIZE_MAX && transformCount - insertedAt[v] < VERTEX_CACHE_DEFAULT_SIZE)
+            continue;
+
+        insertedAt[v] = transformCount++;
+
+        const uint64_t firstLine = uint64_t(v) * vertexStride / VERTEX_FETCH_CACHE_LINE;
+        const uint64_t lastLine = (uint64_t(v) * vertexStride + vertexStride - 1) / VERTEX_FETCH_CACHE_LINE;
+        for (uint64_t line = firstLine; line <= lastLine; ++line)
+        {
+            lineAccesses++;
+
+            uint64_t* setTags = &tags[(line % setCount) * VERTEX_FETCH_CACHE_WAYS];
+            uint64_t* setLastUse = &lastUse[(line % setCount) * VERTEX_FETCH_CACHE_WAYS];
+
+            uint32_t way = 0;
+            while (way < VERTEX_FETCH_CACHE_WAYS && setTags[way] != line)
+                ++way;
+
+            if (way == VERTEX_FETCH_CACHE_WAYS)
+            {
+                lineMisses++;
+                way = static_cast<uint32_t>(std::min_element(setLastUse, setLastUse + VERTEX_FETCH_CACHE_WAYS) - setLastUse);
+                setTags[way] = line;
+            }
+
+            setLastUse[way] = lineAccesses;
+        }
+    }
+
+    stats.missRate = double(lineMisses) / lineAccesses;
+    stats.bytesRead = lineMisses * VERTEX_FETCH_CACHE_LINE;
+    stats.overfetch = double(stats.bytesRead) / (double(referencedCount) * vertexStride);
+    return stats;
+}
+
+/*
+ * Tipsify : emits every live triangle around a fanning vertex, then moves on to the adjacent
+ * vertex that will still be in the cache after its own remaining triangles are emitted. When
+ * there is none, falls back to the most recently touched live vertex, then to input order.
+ */
+static void tipsify(const uint32_t* indices, size_t indexCount, size_t vertexCount, uint32_t cacheSize, uint32_t* dst)
+{
+    const VertexAdjacency adjacency = buildVertexAdjacency(indices, indexCount, vertexCount);
+
+    std::vector<uint32_t> live(vertexCount);
+    for (size_t v = 0; v < vertexCount; ++v)
+    {
+        live[v] = adjacency.offsets[v + 1] - adjacency.offsets[v];
+    }
+
+    std::vector<uint8_t> emitted(indexCount / 3, 0);
+    std::vector<uint32_t> cacheTime(vertexCount, 0);
+    std::vector<uint32_t> deadEnd;
+    std::vector<uint32_t> candidates;
+    deadEnd.reserve(indexCount);
+
+    // starting past cacheSize puts every vertex out of the cache
+    uint32_t timestamp = cacheSize + 1;
+    size_t cursor = 0;
+    size_t written = 0;
+
+    auto nextInputVertex = [&]()
+    {
+        while (cursor < vertexCount && live[cursor] == 0)
+            ++cursor;
+        return (cursor < vertexCount) ? static_cast<uint32_t>(cursor) : UINT32_MAX;
+    };
+
+    uint32_t fanning = nextInputVertex();
+    while (fanning != UINT32_MAX)
+    {
+        candidates.clear();
+
+        for (uint32_t a = adjacency.offsets[fanning]; a < adjacency.offsets[fanning + 1]; ++a)
+        {
+            const uint32_t tri = adjacency.triangles[a];
+            if (emitted[tri])
+                continue;
+
+            for (uint32_t k = 0; k < 3; ++k)
+            {
+                const uint32_t v = indices[tri * 3 + k];
+                dst[written++] = v;
+                deadEnd.push_back(v);
+                candidates.push_back(v);
+                live[v]--;
+
+                if (timestamp - cacheTime[v] > cacheSize)
+                    cacheTime[v] = timestamp++;
+            }
+
+            emitted[tri] = 1;
+        }
+
+        // prefer the candidate that has been in the cache longest and still fits
+        fanning = UINT32_MAX;
+        int64_t bestPriority = -1;
+        for (const uint32_t v : candidates)
+        {
+            if (live[v] == 0)
+                continue;
+
+            int64_t priority = 0;
+            if (int64_t(timestamp) - cacheTime[v] + 2 * int64_t(live[v]) <= cacheSize)
+                priority = int64_t(timestamp) - cacheTime[v];
+
+            if (priority > bestPriority)
+            {
+                bestPriority = priority;
+                fanning = v;
+            }
+        }
+
+        while (fanning == UINT32_MAX && !deadEnd.empty())
+        {
+            const uint32_t v = deadEnd.back();
+            deadEnd.pop_back();
+            if (live[v] > 0)
+                fanning = v;
+        }
+
+        if (fanning == UINT32_MAX)
+            fanning = nextInputVertex();
+    }
+
+    assert(written == indexCount);
+}
+
+static constexpr uint32_t FORSYTH_MAX_CACHE_SIZE = 64;
+static constexpr uint32_t FORSYTH_MAX_VALENCE = 32;
+
+/*
+ * Forsyth : every vertex is scored from its position in a simulated LRU cache and from how many
+ * triangles it still has to feed, the triangle with the highest score sum among those touching
+ * the cache is emitted next. When the cache neighbourhood is exhausted the next unused triangle
+ * in input order is taken.
+ */
+static void forsyth(const uint32_t* indices, size_t indexCount, size_t vertexCount, uint32_t cacheSize, uint32_t* dst)
+{
+    cacheSize = std::clamp(cacheSize, 4u, FORSYTH_MAX_CACHE_SIZE);
+
+    // scores from the paper, the last triangle's vertices get a fixed score so fans do not win by default
+    float cacheScore[FORSYTH_MAX_CACHE_SIZE + 3];
+    for (uint32_t i = 0; i < cacheSize + 3; ++i)
+    {
+        if (i < 3)
+            cacheScore[i] = 0.75f;
+        else if (i < cacheSize)
+            cacheScore[i] = powf(1.0f - float(i - 3) / (cacheSize - 3), 1.5f);
+        else
+            cacheScore[i] = 0.0f;
+    }
+
+    float valenceScore[FORSYTH_MAX_VALENCE];
+    for (uint32_t i = 1; i < FORSYTH_MAX_VALENCE; ++i)
+    {
+        valenceScore[i] = 2.0f / sqrtf(float(i));
+    }
+
+    VertexAdjacency adjacency = buildVertexAdjacency(indices, indexCount, vertexCount);
+    const size_t triangleCount = indexCount / 3;
+
+    // live triangles of v are adjacency.triangles[offsets[v], offsets[v] + live[v])
+    std::vector<uint32_t> live(vertexCount);
+    std::vector<int32_t> cachePos(vertexCount, -1);
+    std::vector<float> vertexScore(vertexCount);
+    std::vector<float> triangleScore(triangleCount, 0.0f);
+    std::vector<uint8_t> emitted(triangleCount, 0);
+
+    auto scoreVertex = [&](uint32_t v)
+    {
+        if (live[v] == 0)
+            return -1.0f;
+
+        const float valence = (live[v] < FORSYTH_MAX_VALENCE) ? valenceScore[live[v]] : 2.0f / sqrtf(float(live[v]));
+        return valence + ((cachePos[v] >= 0) ? cacheScore[cachePos[v]] : 0.0f);
+    };
+
+    for (size_t v = 0; v < vertexCount; ++v)
+    {
+        live[v] = adjacency.offsets[v + 1] - adjacency.offsets[v];
+        vertexScore[v] = scoreVertex(static_cast<uint32_t>(v));
+    }
+
+    for (size_t t = 0; t < triangleCount; ++t)
+    {
+        for (uint32_t k = 0; k < 3; ++k)
+            triangleScore[t] += vertexScore[indices[t * 3 + k]];
+    }
+
+    uint32_t cache[FORSYTH_MAX_CACHE_SIZE + 3];
+    uint32_t nextCache[FORSYTH_MAX_CACHE_SIZE + 3];
+    uint32_t cacheCount = 0;
+
+    size_t cursor = 0;
+    uint32_t best = UINT32_MAX;
+
+    for (size_t emittedCount = 0; emittedCount < triangleCount; ++emittedCount)
+    {
+        if (best == UINT32_MAX)
+        {
+            while (emitted[cursor])
+                ++cursor;
+            best = static_cast<uint32_t>(cursor);
+        }
+
+        const uint32_t* tri = &indices[best * 3];
+        memcpy(&dst[emittedCount * 3], tri, sizeof(uint32_t) * 3);
+        emitted[best] = 1;
+
+        // drop the triangle from its vertices' live lists
+        for (uint32_t k = 0; k < 3; ++k)
+        {
+            const uint32_t v = tri[k];
+            uint32_t* begin = &adjacency.triangles[adjacency.offsets[v]];
+            uint32_t* it = std::find(begin, begin + live[v], best);
+            *it = begin[live[v] - 1];
+            live[v]--;
+        }
+
+        // the emitted triangle moves to the front, the rest keeps its order
+        uint32_t nextCount = 0;
+        for (uint32_t k = 0; k < 3; ++k)
+            nextCache[nextCount++] = tri[k];
+
+        for (uint32_t i = 0; i < cacheCount; ++i)
+        {
+            const uint32_t v = cache[i];
+            if (v != tri[0] && v != tri[1] && v != tri[2])
+                nextCache[nextCount++] = v;
+        }
+
+        // vertices past cacheSize fall out, update them once more with their scores reset
+        for (uint32_t i = 0; i < nextCount; ++i)
+        {
+            const uint32_t v = nextCache[i];
+            cachePos[v] = (i < cacheSize) ? static_cast<int32_t>(i) : -1;
+
+            const float score = scoreVertex(v);
+            const float delta = score - vertexScore[v];
+            vertexScore[v] = score;
+
+            for (uint32_t a = 0; a < live[v]; ++a)
+                triangleScore[adjacency.triangles[adjacency.offsets[v] + a]] += delta;
+        }
+
+        cacheCount = std::min(nextCount, cacheSize);
+        memcpy(cache, nextCache, sizeof(uint32_t) * cacheCount);
+
+        best = UINT32_MAX;
+        float bestScore = -1.0f;
+        for (uint32_t i = 0; i < cacheCount; ++i)
+        {
+            const uint32_t v = cache[i];
+            for (uint32_t a = 0; a < live[v]; ++a)
+            {
+                const uint32_t t = adjacency.triangles[adjacency.offsets[v] + a];
+                if (triangleScore[t] > bestScore)
+                {
+                    bestScore = triangleScore[t];
+                    best = t;
+                }
+            }
+        }
+    }
+}
+
+static void optimize(uint32_t* indices, size_t indexCount, size_t vertexCount, VertexCacheOptimizer_T optimizer, uint32_t cacheSize, std::vector<uint32_t>& scratch)
+{
+    assert(indexCount % 3 == 0);
+
+    scratch.resize(indexCount);
+
+    switch (optimizer)
+    {
+        case VertexCacheOptimizer_T::eNone:
+            return;
+        case VertexCacheOptimizer_T::eTipsify:
+            tipsify(indices, indexCount, vertexCount, cacheSize, scratch.data());
+            break;
+        case VertexCacheOptimizer_T::eForsyth:
+            forsyth(indices, indexCount, vertexCount, cacheSize, scratch.data());
+            break;
+    }
+
+    memcpy(indices, scratch.data(), sizeof(uint32_t) * indexCount);
+}
+
+static const char* getOptimizerName(VertexCacheOptimizer_T optimizer)
+{
+    switch (optimizer)
+    {
+        case VertexCacheOptimizer_T::eNone:    return "none";
+        case VertexCacheOptimizer_T::eTipsify: return "tipsify";
+        case VertexCacheOptimizer_T::eForsyth: return "forsyth";
+    }
+
+    return "unknown";
+}
+
+static void logOptimization(VertexCacheOptimizer_T optimizer, uint32_t cacheSize, size_t triangleCount, const VertexCacheStats& before, const VertexCacheStats& after, double ms)
+{
+    LOG("optimizeVertexCache : %s, %zu triangles in %.2f ms, FIFO %u ACMR %.3f -> %.3f, ATVR %.3f -> %.3f\n",
+        getOptimizerName(optimizer), triangleCount, ms, cacheSize, before.acmr, after.acmr, before.atvr, after.atvr);
+}
+
+void optimizeVertexCache(uint32_t* indices, size_t indexCount, size_t vertexCount, VertexCacheOptimizer_T optimizer, uint32_t cacheSize)
+{
+    if (optimizer == VertexCacheOptimizer_T::eNone)
+        return;
+
+    const VertexCacheStats before = analyzeVertexCache(indices, indexCount, vertexCount, cacheSize, VertexCacheModel_T::eFifo);
+    const auto start = std::chrono::steady_clock::now();
+
+    std::vector<uint32_t> scratch;
+    optimize(indices, indexCount, vertexCount, optimizer, cacheSize, scratch);
+
+    const double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    const VertexCacheStats after = analyzeVertexCache(indices, indexCount, vertexCount, cacheSize, VertexCacheModel_T::eFifo);
+    logOptimization(optimizer, cacheSize, indexCount / 3, before, after, ms);
+}
+
+void optimizeVertexCache(ObjectBufferData& objectData, VertexCacheOptimizer_T optimizer, uint32_t cacheSize)
+{
+    optimizeVertexCache(objectData.indices.data(), objectData.indices.size(), objectData.vertices.size(), optimizer, cacheSize);
+}
+
+static size_t getMeshletVertexBound(const std::vector<Meshlet>& meshlets)
+{
+    uint32_t bound = 0;
+    for (const Meshlet& meshlet : meshlets)
+    {
+        for (uint32_t i = 0; i < meshlet.vertexCount; ++i)
+            bound = std::max(bound, meshlet.vertices[i] + 1);
+    }
+
+    return bound;
+}
+
+void optimizeVertexCache(std::vector<Meshlet>& meshlets, VertexCacheOptimizer_T optimizer, uint32_t cacheSize)
+{
+    if (optimizer == VertexCacheOptimizer_T::eNone)
+        return;
+
+    const size_t vertexBound = getMeshletVertexBound(meshlets);
+    std::vector<uint32_t> indices = getMeshletIndices(meshlets);
+    const VertexCacheStats before = analyzeVertexCache(indices.data(), indices.size(), vertexBound, cacheSize, VertexCacheModel_T::eFifo);
+
+    const auto start = std::chrono::steady_clock::now();
+
+    std::vector<uint32_t> localIndices;
+    std::vector<uint32_t> scratch;
+    for (Meshlet& meshlet : meshlets)
+    {
+        const uint32_t indexCount = meshlet.triangleCount * 3u;
+        localIndices.assign(meshlet.indices, meshlet.indices + indexCount);
+
+        optimize(localIndices.data(), indexCount, meshlet.vertexCount, optimizer, cacheSize, scratch);
+
+        for (uint32_t i = 0; i < indexCount; ++i)
+            meshlet.indices[i] = static_cast<uint8_t>(localIndices[i]);
+    }
+
+    const double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+    indices = getMeshletIndices(meshlets);
+    const VertexCacheStats after = analyzeVertexCache(indices.data(), indices.size(), vertexBound, cacheSize, VertexCacheModel_T::eFifo);
+    logOptimization(optimizer, cacheSize, indices.size() / 3, before, after, ms);
+}
+
+void optimizeVertexCache(MeshBufferData& meshData, VertexCacheOptimizer_T optimizer, uint32_t cacheSize)
+{
+    if (optimizer == VertexCacheOptimizer_T::eNone)
+        return;
+
+    const std::vector<MeshLod> lods = getMeshLods(meshData);
+
+    // the full mesh follows its meshlets, coarser levels have none
+    for (size_t i = meshData.meshlets.empty() ? 0 : 1; i < lods.size(); ++i)
+    {
+        optimizeVertexCache(meshData.indices.data() + lods[i].indexOffset, lods[i].indexCount, meshData.vertexCount, optimizer, cacheSize);
+    }
+
+    if (meshData.meshlets.empty())
+        return;
+
+    optimizeVertexCache(meshData.meshlets, optimizer, cacheSize);
+
+    // keep the full mesh indices in the order the meshlets emit triangles
+    const std::vector<uint32_t> indices = getMeshletIndices(meshData.meshlets);
+    assert(indices.size() == lods[0].indexCount);
+    memcpy(meshData.indices.data() + lods[0].indexOffset, indices.data(), sizeof(uint32_t) * indices.size());
+}
+
+void optimizeVertexFetch(ObjectBufferData& objectData, std::vector<Meshlet>* meshlets)
+{
+    const size_t vertexCount = objectData.vertices.size();
+    const VertexFetchStats before = analyzeVertexFetch(objectData.indices.data(), objectData.indices.size(), vertexCount, sizeof(Vertex));
+
+    std::vector<uint32_t> remap(vertexCount, UINT32_MAX);
+    std::vector<Vertex> vertices;
+    vertices.reserve(vertexCount);
+
+    for (uint32_t& index : objectData.indices)
+    {
+        if (remap[index] == UINT32_MAX)
+        {
+            remap[index] = static_cast<uint32_t>(vertices.size());
+            vertices.push_back(objectData.vertices[index]);
+        }
+
+        index = remap[index];
+    }
+
+    if (meshlets != nullptr)
+    {
+        for (Meshlet& meshlet : *meshlets)
+        {
+            for (uint32_t i = 0; i < meshlet.vertexCount; ++i)
+            {
+                assert(remap[meshlet.vertices[i]] != UINT32_MAX);
+                meshlet.vertices[i] = remap[meshlet.vertices[i]];
+            }
+        }
+    }
+
+    objectData.vertices = std::move(vertices);
+
+    const VertexFetchStats after = analyzeVertexFetch(objectData.indices.data(), objectData.indices.size(), objectData.vertices.size(), sizeof(Vertex));
+    LOG("optimizeVertexFetch : %zu -> %zu vertices, line miss rate %.3f -> %.3f, overfetch %.2f -> %.2f\n",
+        vertexCount, objectData.vertices.size(), before.missRate, after.missRate, before.overfetch, after.overfetch);
+}
@@ -0,0 +1,74 @@
+#ifndef VERTEX_CACHE_HPP
+#define VERTEX_CACHE_HPP
+
+#include <stdint.h>
+#include <stddef.h>
+#include <vector>
+
+struct ObjectBufferData;
+struct MeshBufferData;
+struct Meshlet;
+
+// Post-transform cache size the optimizers target, close to what current GPUs reuse per batch
+constexpr uint32_t VERTEX_CACHE_DEFAULT_SIZE = 16;
+
+// Memory cache in front of vertex fetch for analyzeVertexFetch, about one L1 slice
+constexpr uint32_t VERTEX_FETCH_CACHE_SIZE = 16 * 1024;
+constexpr uint32_t VERTEX_FETCH_CACHE_LINE = 64;
+constexpr uint32_t VERTEX_FETCH_CACHE_WAYS = 4;
+
+enum class VertexCacheOptimizer_T
+{
+    eNone = 0,
+    eTipsify , // 1, Sander et al. 2007, fans around the last emitted vertices, linear time
+    eForsyth , // 2, Forsyth 2006, greedy best-scored triangle around a simulated LRU cache
+};
+
+enum class VertexCacheModel_T
+{
+    eFifo = 0,
+    eLru     , // 1
+};
+
+struct VertexCacheStats
+{
+    double acmr = 0.0; // transformed vertices per triangle, 0.5 is the best case on a regular grid, 3 the worst
+    double atvr = 0.0; // transformed vertices per referenced vertex, 1 is optimal
+};
+
+struct VertexFetchStats
+{
+    double missRate = 0.0;  // cache line misses per cache line access
+    double overfetch = 0.0; // bytes read from memory per byte of referenced vertex data, 1 is optimal
+    size_t bytesRead = 0;
+};
+
+// Simulates a post-transform cache of `cacheSize` entries over the index buffer
+VertexCacheStats analyzeVertexCache(const uint32_t* indices, size_t indexCount, size_t vertexCount, uint32_t cacheSize, VertexCacheModel_T model);
+
+/*
+ * Simulates the memory reads behind vertex fetch. Every post-transform cache miss (FIFO,
+ * VERTEX_CACHE_DEFAULT_SIZE entries) reads the vertexStride bytes of its vertex through a
+ * set associative LRU cache of VERTEX_FETCH_CACHE_SIZE bytes.
+ */
+VertexFetchStats analyzeVertexFetch(const uint32_t* indices, size_t indexCount, size_t vertexCount, uint32_t vertexStride);
+
+// Reorders triangles in place, each triangle keeps its winding
+void optimizeVertexCache(uint32_t* indices, size_t indexCount, size_t vertexCount, VertexCacheOptimizer_T optimizer, uint32_t cacheSize = VERTEX_CACHE_DEFAULT_SIZE);
+
+void optimizeVertexCache(ObjectBufferData& objectData, VertexCacheOptimizer_T optimizer, uint32_t cacheSize = VERTEX_CACHE_DEFAULT_SIZE);
+
+// Reorders the triangles inside each meshlet, meshlet boundaries and vertex lists are kept
+void optimizeVertexCache(std::vector<Meshlet>& meshlets, VertexCacheOptimizer_T optimizer, uint32_t cacheSize = VERTEX_CACHE_DEFAULT_SIZE);
+
+// With meshlets, optimizes inside each meshlet and rewrites the index buffer in meshlet order
+void optimizeVertexCache(MeshBufferData& meshData, VertexCacheOptimizer_T optimizer, uint32_t cacheSize = VERTEX_CACHE_DEFAULT_SIZE);
+
+/*
+ * Renumbers the vertices in the order the index buffer first uses them and drops the ones no
+ * triangle uses, so vertex fetch walks memory forwards. Run it after the index order is final.
+ * Meshlet vertex lists, if given, are remapped to match.
+ */
+void optimizeVertexFetch(ObjectBufferData& objectData, std::vector<Meshlet>* meshlets = nullptr);
+
+#endif // VERTEX_CACHE_HPP
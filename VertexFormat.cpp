@@ -0,0 +1,374 @@
+#include "VertexFormat.hpp"
+#include "Loader.hpp"
+#include "Defines.hpp"
+
+#include <math.h>
+#include <string.h>
+#include <algorithm>
+
+static uint16_t floatToHalf(float value)
+{
+    uint32_t bits = 0;
+    memcpy(&bits, &value, sizeof(float));
+
+    const uint16_t sign = static_cast<uint16_t>((bits >> 16) & 0x8000);
+    bits &= 0x7fffffff;
+
+    // inf / nan
+    if (bits >= 0x7f800000)
+        return sign | 0x7c00 | ((bits > 0x7f800000) ? 0x0200 : 0);
+
+    // rounds past the largest half (65504)
+    if (bits >= 0x477ff000)
+        return sign | 0x7c00;
+
+    // below the smallest normal half (2^-14), store as a denormal in units of 2^-24
+    if (bits < 0x38800000)
+    {
+        float magnitude = 0.0f;
+        memcpy(&magnitude, &bits, sizeof(float));
+        return sign | static_cast<uint16_t>(lrintf(magnitude * 16777216.0f));
+    }
+
+    // rebias the exponent from 127 to 15 and round the mantissa to nearest even
+    uint32_t half = bits - 0x38000000;
+    half += 0x0fff + ((half >> 13) & 1);
+    return sign | static_cast<uint16_t>(half >> 13);
+}
+
+static float halfToFloat(uint16_t half)
+{
+    const uint32_t sign = uint32_t(half & 0x8000) << 16;
+    const uint32_t exponent = (half >> 10) & 0x1f;
+    const uint32_t mantissa = half & 0x03ff;
+
+    if (exponent == 0)
+    {
+        const float magnitude = ldexpf(static_cast<float>(mantissa), -24);
+        return sign ? -magnitude : magnitude;
+    }
+
+    const uint32_t bits = (exponent == 0x1f)
+        ? sign | 0x7f800000 | (mantissa << 13)
+        : sign | ((exponent + 112) << 23) | (mantissa << 13);
+
+    float value = 0.0f;
+    memcpy(&value, &bits, sizeof(float));
+    return value;
+}
+
+// Vulkan SNORM conversion, -max and -max-1 both map to -1
+static float snormToFloat(int32_t value, int32_t max)
+{
+    return std::max(static_cast<float>(value) / max, -1.0f);
+}
+
+static glm::vec3 decodeOctahedral(float x, float y)
+{
+    glm::vec3 n { x, y, 1.0f - fabsf(x) - fabsf(y) };
+
+    // fold the lower hemisphere back out of the outer triangles
+    const float t = std::max(-n.z, 0.0f);
+    n.x += (n.x >= 0.0f) ? -t : t;
+    n.y += (n.y >= 0.0f) ? -t : t;
+
+    return glm::normalize(n);
+}
+
+/*
+ * Octahedral encoding to snorm with `max` as the largest integer. Of the four integer points
+ * around the projected normal the one decoding closest to the input is kept, which roughly
+ * halves the worst case error of plain rounding at the same bit count.
+ */
+static void encodeOctahedral(const glm::vec3& normal, int32_t max, int32_t* out)
+{
+    const float length = fabsf(normal.x) + fabsf(normal.y) + fabsf(normal.z);
+    if (length == 0.0f)
+    {
+        out[0] = 0;
+        out[1] = 0;
+        return;
+    }
+
+    float x = normal.x / length;
+    float y = normal.y / length;
+    if (normal.z < 0.0f)
+    {
+        const float wrappedX = (1.0f - fabsf(y)) * ((x >= 0.0f) ? 1.0f : -1.0f);
+        const float wrappedY = (1.0f - fabsf(x)) * ((y >= 0.0f) ? 1.0f : -1.0f);
+        x = wrappedX;
+        y = wrappedY;
+    }
+
+    const glm::vec3 target = glm::normalize(normal);
+    const float baseX = floorf(std::clamp(x, -1.0f, 1.0f) * max);
+    const float baseY = floorf(std::clamp(y, -1.0f, 1.0f) * max);
+
+    float bestDot = -2.0f;
+    for (int32_t i = 0; i < 4; ++i)
+    {
+        const int32_t qx = std::clamp(static_cast<int32_t>(baseX) + (i & 1), -max, max);
+        const int32_t qy = std::clamp(static_cast<int32_t>(baseY) + (i >> 1), -max, max);
+
+        const float d = glm::dot(decodeOctahedral(snormToFloat(qx, max), snormToFloat(qy, max)), target);
+        if (d > bestDot)
+        {
+            bestDot = d;
+            out[0] = qx;
+            out[1] = qy;
+        }
+    }
+}
+
+uint32_t getVertexAttributeLocation(VertexInputAttribute_T attrib)
+{
+    switch (attrib)
+    {
+        case VertexInputAttribute_T::ePosition:
+        case VertexInputAttribute_T::ePositionUnorm16:
+            return 0;
+        case VertexInputAttribute_T::eUv:
+        case VertexInputAttribute_T::eUvHalf:
+            return 1;
+        case VertexInputAttribute_T::eNormal:
+        case VertexInputAttribute_T::eNormalOctSnorm16:
+        case VertexInputAttribute_T::eNormalOctSnorm8:
+            return 2;
+    }
+
+    EXIT("Unknown vertex attribute " << static_cast<uint32_t>(attrib));
+}
+
+uint32_t getVertexAttributeSize(VertexInputAttribute_T attrib)
+{
+    switch (attrib)
+    {
+        case VertexInputAttribute_T::ePosition:         return 12;
+        case VertexInputAttribute_T::eUv:               return 8;
+        case VertexInputAttribute_T::eNormal:           return 12;
+        case VertexInputAttribute_T::ePositionUnorm16:  return 8;
+        case VertexInputAttribute_T::eUvHalf:           return 4;
+        case VertexInputAttribute_T::eNormalOctSnorm16: return 4;
+        case VertexInputAttribute_T::eNormalOctSnorm8:  return 2;
+    }
+
+    EXIT("Unknown vertex attribute " << static_cast<uint32_t>(attrib));
+}
+
+static uint32_t getVertexAttributeComponentSize(VertexInputAttribute_T attrib)
+{
+    switch (attrib)
+    {
+        case VertexInputAttribute_T::ePosition:
+        case VertexInputAttribute_T::eUv:
+        case VertexInputAttribute_T::eNormal:
+            return 4;
+        case VertexInputAttribute_T::ePositionUnorm16:
+        case VertexInputAttribute_T::eUvHalf:
+        case VertexInputAttribute_T::eNormalOctSnorm16:
+            return 2;
+        case VertexInputAttribute_T::eNormalOctSnorm8:
+            return 1;
+    }
+
+    EXIT("Unknown vertex attribute " << static_cast<uint32_t>(attrib));
+}
+
+uint32_t getVertexStride(const uint8_t* attribs, uint32_t attribCount)
+{
+    uint32_t stride = 0;
+    uint32_t alignment = 1;
+    for (uint32_t i = 0; i < attribCount; ++i)
+    {
+        const VertexInputAttribute_T attrib = static_cast<VertexInputAttribute_T>(attribs[i]);
+        stride += getVertexAttributeSize(attrib);
+        alignment = std::max(alignment, getVertexAttributeComponentSize(attrib));
+    }
+
+    return (stride + alignment - 1) / alignment * alignment;
+}
+
+uint32_t getVertexStride(const VertexFormat& format)
+{
+    const uint8_t attribs[] {
+        static_cast<uint8_t>(format.position),
+        static_cast<uint8_t>(format.uv),
+        static_cast<uint8_t>(format.normal),
+    };
+
+    return format.separatePositions ? getVertexStride(attribs + 1, 2) : getVertexStride(attribs, 3);
+}
+
+uint32_t getPositionStride(const VertexFormat& format)
+{
+    const uint8_t attrib = static_cast<uint8_t>(format.position);
+    return format.separatePositions ? getVertexStride(&attrib, 1) : 0;
+}
+
+bool getVertexFormat(const uint8_t* attribs, uint32_t attribCount, VertexFormat* format)
+{
+    if (attribCount != 3)
+        return false;
+
+    for (uint32_t i = 0; i < attribCount; ++i)
+    {
+        if (attribs[i] > static_cast<uint8_t>(VertexInputAttribute_T::eNormalOctSnorm8))
+            return false;
+        if (getVertexAttributeLocation(static_cast<VertexInputAttribute_T>(attribs[i])) != i)
+            return false;
+    }
+
+    format->position = static_cast<VertexInputAttribute_T>(attribs[0]);
+    format->uv = static_cast<VertexInputAttribute_T>(attribs[1]);
+    format->normal = static_cast<VertexInputAttribute_T>(attribs[2]);
+
+    return true;
+}
+
+PositionQuantization computePositionQuantization(const Vertex* vertices, size_t vertexCount)
+{
+    PositionQuantization quantization;
+    if (vertexCount == 0)
+        return quantization;
+
+    glm::vec3 boundsMin = vertices[0].pos;
+    glm::vec3 boundsMax = vertices[0].pos;
+    for (size_t i = 1; i < vertexCount; ++i)
+    {
+        boundsMin = glm::min(boundsMin, vertices[i].pos);
+        boundsMax = glm::max(boundsMax, vertices[i].pos);
+    }
+
+    for (uint32_t c = 0; c < 3; ++c)
+    {
+        quantization.offset[c] = boundsMin[c];
+
+        // flat axis, every vertex quantizes to 0 and decodes to the offset
+        quantization.scale[c] = (boundsMax[c] > boundsMin[c]) ? (boundsMax[c] - boundsMin[c]) : 1.0f;
+    }
+
+    return quantization;
+}
+
+void encodeVertices(const Vertex* vertices, size_t vertexCount, const VertexFormat& format, const PositionQuantization& quantization, uint8_t* dst, uint8_t* positionDst)
+{
+    assert(!format.separatePositions || positionDst != nullptr);
+
+    const uint32_t stride = getVertexStride(format);
+    const uint32_t positionStride = getPositionStride(format);
+
+    for (size_t i = 0; i < vertexCount; ++i)
+    {
+        const Vertex& vertex = vertices[i];
+        uint8_t* out = dst + i * stride;
+        memset(out, 0, stride);
+
+        uint8_t* positionOut = format.separatePositions ? positionDst + i * positionStride : out;
+
+        if (format.position == VertexInputAttribute_T::ePositionUnorm16)
+        {
+            uint16_t packed[4] = { 0, 0, 0, 0 };
+            for (uint32_t c = 0; c < 3; ++c)
+            {
+                const float t = (vertex.pos[c] - quantization.offset[c]) / quantization.scale[c];
+                packed[c] = static_cast<uint16_t>(lrintf(std::clamp(t, 0.0f, 1.0f) * 65535.0f));
+            }
+            memcpy(positionOut, packed, sizeof(packed));
+        }
+        else
+        {
+            memcpy(positionOut, &vertex.pos, sizeof(float) * 3);
+        }
+
+        if (!format.separatePositions)
+            out += getVertexAttributeSize(format.position);
+
+        if (format.uv == VertexInputAttribute_T::eUvHalf)
+        {
+            const uint16_t packed[2] = { floatToHalf(vertex.uv.x), floatToHalf(vertex.uv.y) };
+            memcpy(out, packed, sizeof(packed));
+        }
+        else
+        {
+            memcpy(out, &vertex.uv, sizeof(float) * 2);
+        }
+        out += getVertexAttributeSize(format.uv);
+
+        if (format.normal == VertexInputAttribute_T::eNormalOctSnorm16)
+        {
+            int32_t oct[2];
+            encodeOctahedral(vertex.normal, INT16_MAX, oct);
+            const int16_t packed[2] = { static_cast<int16_t>(oct[0]), static_cast<int16_t>(oct[1]) };
+            memcpy(out, packed, sizeof(packed));
+        }
+        else if (format.normal == VertexInputAttribute_T::eNormalOctSnorm8)
+        {
+            int32_t oct[2];
+            encodeOctahedral(vertex.normal, INT8_MAX, oct);
+            const int8_t packed[2] = { static_cast<int8_t>(oct[0]), static_cast<int8_t>(oct[1]) };
+            memcpy(out, packed, sizeof(packed));
+        }
+        else
+        {
+            memcpy(out, &vertex.normal, sizeof(float) * 3);
+        }
+    }
+}
+
+Vertex decodeVertex(const uint8_t* src, const VertexFormat& format, const PositionQuantization& quantization, const uint8_t* positionSrc)
+{
+    assert(!format.separatePositions || positionSrc != nullptr);
+
+    Vertex vertex;
+
+    if (!format.separatePositions)
+        positionSrc = src;
+
+    if (format.position == VertexInputAttribute_T::ePositionUnorm16)
+    {
+        uint16_t packed[4];
+        memcpy(packed, positionSrc, sizeof(packed));
+        for (uint32_t c = 0; c < 3; ++c)
+        {
+            vertex.pos[c] = quantization.offset[c] + (packed[c] / 65535.0f) * quantization.scale[c];
+        }
+    }
+    else
+    {
+        memcpy(&vertex.pos, positionSrc, sizeof(float) * 3);
+    }
+
+    if (!format.separatePositions)
+        src += getVertexAttributeSize(format.position);
+
+    if (format.uv == VertexInputAttribute_T::eUvHalf)
+    {
+        uint16_t packed[2];
+        memcpy(packed, src, sizeof(packed));
+        vertex.uv = glm::vec2(halfToFloat(packed[0]), halfToFloat(packed[1]));
+    }
+    else
+    {
+        memcpy(&vertex.uv, src, sizeof(float) * 2);
+    }
+    src += getVertexAttributeSize(format.uv);
+
+    if (format.normal == VertexInputAttribute_T::eNormalOctSnorm16)
+    {
+        int16_t packed[2];
+        memcpy(packed, src, sizeof(packed));
+        vertex.normal = decodeOctahedral(snormToFloat(packed[0], INT16_MAX), snormToFloat(packed[1], INT16_MAX));
+    }
+    else if (format.normal == VertexInputAttribute_T::eNormalOctSnorm8)
+    {
+        int8_t packed[2];
+        memcpy(packed, src, sizeof(packed));
+        vertex.normal = decodeOctahedral(snormToFloat(packed[0], INT8_MAX), snormToFloat(packed[1], INT8_MAX));
+    }
+    else
+    {
+        memcpy(&vertex.normal, src, sizeof(float) * 3);
+    }
+
+    return vertex;
+}
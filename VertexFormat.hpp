@@ -0,0 +1,64 @@
+#ifndef VERTEX_FORMAT_HPP
+#define VERTEX_FORMAT_HPP
+
+#include <stdint.h>
+#include <stddef.h>
+#include <vector>
+
+#include "MeshFile.hpp"
+
+struct Vertex;
+
+// Encoding of each vertex attribute, written to the vertex buffer in position/uv/normal order
+struct VertexFormat
+{
+    VertexInputAttribute_T position = VertexInputAttribute_T::ePosition;
+    VertexInputAttribute_T uv       = VertexInputAttribute_T::eUv;
+    VertexInputAttribute_T normal   = VertexInputAttribute_T::eNormal;
+
+    // positions go to a stream of their own (ePositions), so depth only passes fetch nothing else
+    bool separatePositions = false;
+
+    bool operator==(const VertexFormat&) const = default;
+};
+
+// Maps ePositionUnorm16 back to object space : position = offset + unorm * scale
+struct PositionQuantization
+{
+    float offset[3] = { 0.0f, 0.0f, 0.0f };
+    float scale[3]  = { 1.0f, 1.0f, 1.0f };
+};
+
+static_assert(sizeof(PositionQuantization) == 24, "PositionQuantization layout is part of the file format");
+
+// Shader input location of the attribute : 0 position, 1 uv, 2 normal
+uint32_t getVertexAttributeLocation(VertexInputAttribute_T attrib);
+
+uint32_t getVertexAttributeSize(VertexInputAttribute_T attrib);
+
+/*
+ * Sum of the attribute sizes, padded to the largest component size. Attributes are written in
+ * position/uv/normal order, which keeps every attribute aligned to its component size as Vulkan
+ * requires, without padding between them.
+ */
+uint32_t getVertexStride(const uint8_t* attribs, uint32_t attribCount);
+
+// Bytes per vertex in the main vertex stream, which leaves out positions when they are separate
+uint32_t getVertexStride(const VertexFormat& format);
+
+// Bytes per vertex in the position stream, 0 when positions are interleaved
+uint32_t getPositionStride(const VertexFormat& format);
+
+// Fills format from a .mesh attribute list, returns false if the list is not one position, one uv and one normal in that order
+bool getVertexFormat(const uint8_t* attribs, uint32_t attribCount, VertexFormat* format);
+
+// Bounds of the positions, so unorm16 spans exactly the mesh extent
+PositionQuantization computePositionQuantization(const Vertex* vertices, size_t vertexCount);
+
+// Writes vertexCount * getVertexStride(format) bytes to dst, and the positions to positionDst if they are separate
+void encodeVertices(const Vertex* vertices, size_t vertexCount, const VertexFormat& format, const PositionQuantization& quantization, uint8_t* dst, uint8_t* positionDst = nullptr);
+
+// CPU reference of the shader decode, used by the tools to measure encoding error
+Vertex decodeVertex(const uint8_t* src, const VertexFormat& format, const PositionQuantization& quantization, const uint8_t* positionSrc = nullptr);
+
+#endif // VERTEX_FORMAT_HPP
@@ -4,6 +4,10 @@
 #include <stdlib.h>
 #include <iostream>
 #include <fstream>
+#include <unordered_map>
+#include <algorithm>
+#include <chrono>
+#include <thread>
 
 #include <vulkan/vulkan.h>
 #include <GLFW/glfw3.h>
@@ -20,8 +24,57 @@
 #include "Helpers.hpp"
 #include "Resources.hpp"
 #include "Loader.hpp"
+#include "Meshlet.hpp"
+#include "MeshStreamer.hpp"
+#include "PipelineBuilder.hpp"
+#include "PipelineCache.hpp"
+#include "UniformRing.hpp"
 
-// #define MESH_SHADING
+// relative to the working directory, like the meshes
+static const char* PIPELINE_CACHE_PATH = "pipeline.cache";
+
+// meshlets each mesh.task workgroup tests, MESHLETS_PER_TASK there
+constexpr uint32_t MESHLETS_PER_TASK = 32;
+
+// what mesh.task culls meshlets against, and whether mesh.mesh culls their triangles.
+// CULL_OCCLUSION draws in two phases against a depth pyramid, see culling.glsl.
+enum : uint32_t
+{
+    CULL_FRUSTUM   = 1u << 0,
+    CULL_CONE      = 1u << 1,
+    CULL_TRIANGLE  = 1u << 2,
+    CULL_OCCLUSION = 1u << 3,
+};
+
+// Winding of the scene's front faces in the framebuffer. The meshes are counter clockwise seen from
+// outside, the projection keeps y up and the viewport y down, which mirrors them to clockwise.
+// mesh.mesh culls back faces with the same convention as the rasterizer.
+constexpr VkFrontFace SCENE_FRONT_FACE = VK_FRONT_FACE_CLOCKWISE;
+
+// PHASE_* of culling.glsl
+enum : uint32_t
+{
+    PHASE_EARLY = 0, // meshlets visible in the last frame
+    PHASE_LATE  = 1, // meshlets the early phase did not draw, tested against its depth pyramid
+};
+
+// Written by mesh.task, meshletcull.comp and mesh.mesh with atomics, one per frame in flight,
+// read back once its fence is signaled. The triangles are only counted with CULL_TRIANGLE.
+struct CullingStats
+{
+    uint32_t meshletsEmitted;
+    uint32_t meshletsCulled;
+    uint32_t trianglesEmitted;
+    uint32_t trianglesCulled;
+    uint32_t meshletsOccluded; // with CULL_OCCLUSION, hidden by the depth pyramid and not drawn in the early phase
+};
+
+// MeshletDrawBuffer of meshletcull.comp : a draw count per phase, then the draws of each phase,
+// meshletCount VkDrawIndexedIndirectCommand apart
+constexpr VkDeviceSize MESHLET_DRAW_COUNTS_SIZE = 4 * sizeof(uint32_t);
+
+// allocations beginDefragmentation may plan to move at once, the scene buffers are a handful of them
+constexpr uint32_t MAX_DEFRAGMENTATION_MOVES = 256;
 
 struct AppManager
 {
@@ -39,6 +92,64 @@ struct AppManager
 
     uint32_t indexCount[BUFFER_COUNT];
 
+    // levels of detail of the scene mesh, the full mesh first, and the one drawn this frame
+    std::vector<MeshLod> lods;
+    uint32_t lodIndex = 0;
+
+    // vertex layout of the scene mesh, the pipeline is built to match it
+    VertexFormat vertexFormat;
+    PositionQuantization positionQuantization;
+
+    // loads meshes in the background, the next graphics submission waits for streamWaitValue
+    std::unique_ptr<MeshStreamer> meshStreamer;
+    uint64_t streamWaitValue = 0;
+
+    // uniforms are pushed into the region of frameIndex every frame
+    UniformRing uniformRing;
+    uint32_t frameIndex = 0;
+
+    // the pipeline cache was loaded from disk, pipeline creation should mostly hit it
+    bool pipelineCacheWarm = false;
+
+    // ids of the pipeline builder, requested again whenever the scene vertex format changes
+    std::unique_ptr<PipelineBuilder> pipelineBuilder;
+    uint32_t pipelines[PIPELINE_COUNT];
+
+    // VK_EXT_mesh_shader entry point, and the most task workgroups a single draw may launch. Null
+    // when the device lacks the extension, its task and mesh shader features or subgroup ballots in
+    // the mesh stage, only default.vert draws then.
+    PFN_vkCmdDrawMeshTasksEXT cmdDrawMeshTasksEXT = nullptr;
+    uint32_t maxTaskWorkGroupCountX = 0;
+    uint32_t maxTaskWorkGroupTotalCount = 0;
+
+    // the task and mesh stages, 0 without mesh shading, layouts and barriers may only name them with it
+    VkShaderStageFlags meshShaderStages = 0;
+    VkPipelineStageFlags taskPipelineStage = 0;
+    VkPipelineStageFlags meshPipelineStage = 0;
+
+    // VK_KHR_draw_indirect_count entry point, the vertex path draws what meshletcull.comp kept. Null
+    // without the extension, the vertex path has no occlusion culling then.
+    PFN_vkCmdDrawIndexedIndirectCountKHR cmdDrawIndexedIndirectCountKHR = nullptr;
+    uint32_t maxComputeWorkGroupCountX = 0;
+
+    // depth pyramid, the swapchain extent rounded down to powers of two
+    VkExtent2D depthPyramidExtent { 0, 0 };
+    uint32_t depthPyramidLevels = 0;
+    bool depthPyramidUndefined = true; // until the first frame moves it to the general layout it is bound in
+
+    // the meshlet visibility bits belong to the previous scene mesh, the next occlusion culled frame clears them
+    bool meshletVisibilityReset = false;
+
+    // largest counts of the scene meshlets, mesh.mesh sizes its per thread loops with them
+    uint32_t meshletMaxVertices = 0;
+    uint32_t meshletMaxTriangles = 0;
+
+    // what mesh.task culled in the last frame that used this frame in flight slot
+    CullingStats cullingStats {};
+
+    // F5 or the gui asked to move the scene buffers out of the least used memory blocks, done by the next update
+    bool defragmentMemory = false;
+
 } g_app;
 
 struct ConfigManager
@@ -48,6 +159,25 @@ struct ConfigManager
 
     glm::vec3 materialAlbedo { 1.0f, 0.0f, 0.0f };
     float materialRoughness { 0.5f };
+
+    // coarsest level of detail whose error covers at most this many pixels is drawn
+    float lodPixelError { 1.0f };
+
+    bool wireframe { false };
+
+    // draws the scene meshlets with mesh.task and mesh.mesh instead of the index buffer with default.vert
+    bool meshShading { false };
+
+    // mesh.task drops meshlets outside the frustum or facing away, mesh.mesh the triangles
+    // covering no sample with CULL_TRIANGLE, CULL_* flags. With CULL_OCCLUSION the vertex path
+    // culls the full mesh meshlets too, with meshletcull.comp.
+    uint32_t meshletCulling { CULL_FRUSTUM | CULL_CONE };
+
+    // threads of a mesh.mesh workgroup, 32 or 64, 0 until init picks what the device prefers
+    uint32_t meshWorkgroupSize { 0 };
+
+    // --device, in the order vkEnumeratePhysicalDevices lists them
+    uint32_t physicalDeviceIndex { 2 };
 } g_config;
 
 struct Camera {
@@ -65,6 +195,8 @@ struct PerFrameUBO
     glm::mat4 viewMatrix;
     glm::mat4 projMatrix;
     glm::vec4 viewPos; // making vec4 for now... worry about alignment later
+    glm::vec4 frustumPlanes[6]; // world space, normalized, pointing inwards, see getFrustumPlanes
+    glm::vec2 viewportSize; // pixels, for the small triangle test of mesh.mesh
 };
 
 struct PerMatUBO
@@ -79,6 +211,30 @@ struct LightUBO
     glm::vec4 intensity; // making vec4 for now... worry about alignment later
 };
 
+// Dequantizes ePositionUnorm16 : position = offset + unorm * scale (offset 0, scale 1 for float positions).
+// The rest is only read by the meshlet culling shaders and mesh.mesh.
+struct VertexPushConst
+{
+    glm::vec4 positionOffset;
+    glm::vec4 positionScale;
+    uint32_t meshletCount;
+    uint32_t cullFlags;  // CULL_*
+    uint32_t statsSlot;  // frame in flight, CullingStats to count into
+    uint32_t phase;      // PHASE_*, with CULL_OCCLUSION
+};
+
+// every stage of the scene pipeline layout reading VertexPushConst
+static VkShaderStageFlags getVertexPushConstStages()
+{
+    return VK_SHADER_STAGE_VERTEX_BIT | g_app.meshShaderStages | VK_SHADER_STAGE_COMPUTE_BIT;
+}
+
+struct DepthReducePushConst
+{
+    glm::uvec2 inputSize;
+    glm::uvec2 outputSize;
+};
+
 // -------------------------
 // GLFW INPUT HANDLER
 // -------------------------
@@ -146,34 +302,55 @@ static void mouseButtonCallback(GLFWwindow* window, int button, int action, int
     }
 }
 
+static void keyCallback(GLFWwindow* window, int key, int scancode, int action, int mods) {
+    if (!g_app.initDone)
+        return;
+
+    if (key == GLFW_KEY_F5 && action == GLFW_PRESS && !ImGui::GetIO().WantCaptureKeyboard)
+        g_app.defragmentMemory = true;
+}
+
 // -------------------------
 // RENDERPASS
 // -------------------------
 
-void createRenderPass()
+// How a render pass over the swapchain image and the depth attachment begins and ends. Passes
+// only differing in these are compatible, they share framebuffers and pipelines.
+struct ScenePassDesc
+{
+    VkAttachmentLoadOp loadOp;
+    VkImageLayout colorInitialLayout;
+    VkImageLayout colorFinalLayout;
+    VkAttachmentStoreOp depthStoreOp;
+    VkImageLayout depthInitialLayout;
+    VkImageLayout depthFinalLayout;
+    VkSubpassDependency dependencies[2]; // at the start and at the end of the render pass
+};
+
+static VkRenderPass createScenePass(const ScenePassDesc& desc)
 {
     const std::array<VkAttachmentDescription, 2> attachments{{
         {
             // Color
             .format = g_vk.swapchain.format,
             .samples = VK_SAMPLE_COUNT_1_BIT,
-            .loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR,
+            .loadOp = desc.loadOp,
             .storeOp = VK_ATTACHMENT_STORE_OP_STORE,
             .stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE,
             .stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE,
-            .initialLayout = VK_IMAGE_LAYOUT_UNDEFINED,
-            .finalLayout = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR,
+            .initialLayout = desc.colorInitialLayout,
+            .finalLayout = desc.colorFinalLayout,
         },
         {
             // Depth
             .format = VK_FORMAT_D32_SFLOAT,
             .samples = VK_SAMPLE_COUNT_1_BIT,
-            .loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR,
-            .storeOp = VK_ATTACHMENT_STORE_OP_DONT_CARE,
+            .loadOp = desc.loadOp,
+            .storeOp = desc.depthStoreOp,
             .stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE,
             .stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE,
-            .initialLayout = VK_IMAGE_LAYOUT_UNDEFINED,
-            .finalLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL
+            .initialLayout = desc.depthInitialLayout,
+            .finalLayout = desc.depthFinalLayout
         },
     }};
 
@@ -200,27 +377,6 @@ void createRenderPass()
         .preserveAttachmentCount = 0,
         .pPreserveAttachments = nullptr};
 
-    const VkSubpassDependency dependencies[2]{
-        {// First dependency at the start of the renderpass
-            // Does the transition from final to initial layout
-            .srcSubpass = VK_SUBPASS_EXTERNAL,                             // Producer of the dependency
-            .dstSubpass = 0,                                               // Consumer is our single subpass that will wait for the execution dependency
-            .srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT, // Match our pWaitDstStageMask when we vkQueueSubmit
-            .dstStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT, // is a loadOp stage for color attachments
-            .srcAccessMask = 0,                                            // semaphore wait already does memory dependency for us
-            .dstAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT,         // is a loadOp CLEAR access mask for color attachments
-            .dependencyFlags = VK_DEPENDENCY_BY_REGION_BIT},
-        {// Second dependency at the end the renderpass
-            // Does the transition from the initial to the final layout
-            // Technically this is the same as the implicit subpass dependency, but we are gonna state it explicitly here
-            .srcSubpass = 0,                                               // Producer of the dependency is our single subpass
-            .dstSubpass = VK_SUBPASS_EXTERNAL,                             // Consumer are all commands outside of the renderpass
-            .srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT, // is a storeOp stage for color attachments
-            .dstStageMask = VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT,          // Do not block any subsequent work
-            .srcAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT,         // is a storeOp `STORE` access mask for color attachments
-            .dstAccessMask = 0,
-            .dependencyFlags = VK_DEPENDENCY_BY_REGION_BIT}};
-
     const VkRenderPassCreateInfo createInfo{
         .sType = VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO,
         .pNext = nullptr,
@@ -230,14 +386,142 @@ void createRenderPass()
         .subpassCount = 1,
         .pSubpasses = &subpass,
         .dependencyCount = 2,
-        .pDependencies = dependencies};
+        .pDependencies = desc.dependencies};
 
-    VK_CHECK(vkCreateRenderPass(g_vk.device, &createInfo, nullptr, &g_vk.renderPass));
+    VkRenderPass renderPass;
+    VK_CHECK(vkCreateRenderPass(g_vk.device, &createInfo, nullptr, &renderPass));
+    return renderPass;
+}
+
+void createRenderPass()
+{
+    const VkSubpassDependency startDependency {// First dependency at the start of the renderpass
+        // Does the transition from final to initial layout
+        // The depth attachment is shared by the frames in flight, its clear waits for the depth tests of the previous frame
+        .srcSubpass = VK_SUBPASS_EXTERNAL,                             // Producer of the dependency
+        .dstSubpass = 0,                                               // Consumer is our single subpass that will wait for the execution dependency
+        .srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT,  // Match our pWaitDstStageMask when we vkQueueSubmit
+        .dstStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT | VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT, // is a loadOp stage for color and depth attachments
+        .srcAccessMask = VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT,                                              // semaphore wait already does memory dependency for color
+        .dstAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT,       // is a loadOp CLEAR access mask
+        .dependencyFlags = VK_DEPENDENCY_BY_REGION_BIT};
+
+    const VkSubpassDependency endDependency {// Second dependency at the end the renderpass
+        // Does the transition from the initial to the final layout
+        // Technically this is the same as the implicit subpass dependency, but we are gonna state it explicitly here
+        .srcSubpass = 0,                                               // Producer of the dependency is our single subpass
+        .dstSubpass = VK_SUBPASS_EXTERNAL,                             // Consumer are all commands outside of the renderpass
+        .srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT, // is a storeOp stage for color attachments
+        .dstStageMask = VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT,          // Do not block any subsequent work
+        .srcAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT,         // is a storeOp `STORE` access mask for color attachments
+        .dstAccessMask = 0,
+        .dependencyFlags = VK_DEPENDENCY_BY_REGION_BIT};
+
+    g_vk.renderPass = createScenePass({
+        .loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR,
+        .colorInitialLayout = VK_IMAGE_LAYOUT_UNDEFINED,
+        .colorFinalLayout = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR,
+        .depthStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE,
+        .depthInitialLayout = VK_IMAGE_LAYOUT_UNDEFINED,
+        .depthFinalLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL,
+        .dependencies = { startDependency, endDependency },
+    });
+
+    // Occlusion culling : the early pass keeps its depth for the pyramid the compute shaders build
+    // in between, the late pass draws on top of it
+    g_vk.occlusionRenderPasses[OCCLUSION_PASS_EARLY] = createScenePass({
+        .loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR,
+        .colorInitialLayout = VK_IMAGE_LAYOUT_UNDEFINED,
+        .colorFinalLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL,
+        .depthStoreOp = VK_ATTACHMENT_STORE_OP_STORE,
+        .depthInitialLayout = VK_IMAGE_LAYOUT_UNDEFINED,
+        .depthFinalLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL,
+        .dependencies = {
+            startDependency,
+            {
+                // the depth is sampled by depthreduce.comp
+                .srcSubpass = 0,
+                .dstSubpass = VK_SUBPASS_EXTERNAL,
+                .srcStageMask = VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT,
+                .dstStageMask = VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                .srcAccessMask = VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT,
+                .dstAccessMask = VK_ACCESS_SHADER_READ_BIT,
+                .dependencyFlags = 0x0,
+            },
+        },
+    });
+
+    g_vk.occlusionRenderPasses[OCCLUSION_PASS_LATE] = createScenePass({
+        .loadOp = VK_ATTACHMENT_LOAD_OP_LOAD,
+        .colorInitialLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL,
+        .colorFinalLayout = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR,
+        .depthStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE,
+        .depthInitialLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL,
+        .depthFinalLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL,
+        .dependencies = {
+            {
+                // the early pass writes and the depth pyramid reads come first
+                .srcSubpass = VK_SUBPASS_EXTERNAL,
+                .dstSubpass = 0,
+                .srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                .dstStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT | VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT,
+                .srcAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT,
+                .dstAccessMask = VK_ACCESS_COLOR_ATTACHMENT_READ_BIT | VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT,
+                .dependencyFlags = 0x0,
+            },
+            endDependency,
+        },
+    });
+}
+
+// Largest power of two not above value, value > 0
+static uint32_t getPreviousPowerOfTwo(uint32_t value)
+{
+    uint32_t result = 1;
+    while (result * 2 <= value)
+        result *= 2;
+    return result;
+}
+
+// Max depth mips of the early occlusion pass. Level 0 is the swapchain extent rounded down to
+// powers of two, so every level halves the one above exactly.
+static void createDepthPyramid()
+{
+    g_app.depthPyramidExtent = {
+        .width = getPreviousPowerOfTwo(g_vk.swapchain.extent.width),
+        .height = getPreviousPowerOfTwo(g_vk.swapchain.extent.height),
+    };
+
+    g_app.depthPyramidLevels = 1;
+    while ((std::max(g_app.depthPyramidExtent.width, g_app.depthPyramidExtent.height) >> g_app.depthPyramidLevels) > 0)
+        ++g_app.depthPyramidLevels;
+    assert(g_app.depthPyramidLevels <= DEPTH_PYRAMID_MAX_LEVELS);
+
+    createAttachment(g_vk.device, VK_FORMAT_R32_SFLOAT, { g_app.depthPyramidExtent.width, g_app.depthPyramidExtent.height, 1 }, VK_IMAGE_USAGE_STORAGE_BIT | VK_IMAGE_USAGE_SAMPLED_BIT, VK_IMAGE_ASPECT_COLOR_BIT, g_app.depthPyramidLevels, g_vk.attachments[ATTACHMENT_DEPTH_PYRAMID]);
+
+    for (uint32_t level = 0; level < g_app.depthPyramidLevels; ++level)
+        g_vk.imageViews[IMAGE_VIEW_DEPTH_PYRAMID_LEVEL + level] = createImageView(g_vk.device, g_vk.attachments[ATTACHMENT_DEPTH_PYRAMID].image, VK_FORMAT_R32_SFLOAT, VK_IMAGE_ASPECT_COLOR_BIT, level, 1);
+
+    // texelFetch ignores the filter, the sampler only makes the images sampleable
+    const VkSamplerCreateInfo samplerCreateInfo {
+        .sType = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO,
+        .magFilter = VK_FILTER_NEAREST,
+        .minFilter = VK_FILTER_NEAREST,
+        .mipmapMode = VK_SAMPLER_MIPMAP_MODE_NEAREST,
+        .addressModeU = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE,
+        .addressModeV = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE,
+        .addressModeW = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE,
+        .minLod = 0.0f,
+        .maxLod = VK_LOD_CLAMP_NONE,
+    };
+
+    VK_CHECK(vkCreateSampler(g_vk.device, &samplerCreateInfo, nullptr, &g_vk.depthPyramidSampler));
 }
 
 void createFramebuffers()
 {
-    createAttachment(g_vk.device, VK_FORMAT_D32_SFLOAT, { g_vk.swapchain.extent.width, g_vk.swapchain.extent.height, 1 }, VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT, VK_IMAGE_ASPECT_DEPTH_BIT, g_vk.attachments[ATTACHMENT_DEPTH]);
+    // sampled by depthreduce.comp with occlusion culling
+    createAttachment(g_vk.device, VK_FORMAT_D32_SFLOAT, { g_vk.swapchain.extent.width, g_vk.swapchain.extent.height, 1 }, VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT | VK_IMAGE_USAGE_SAMPLED_BIT, VK_IMAGE_ASPECT_DEPTH_BIT, 1, g_vk.attachments[ATTACHMENT_DEPTH]);
 
     VkFramebufferCreateInfo createInfo{
         .sType = VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO,
@@ -293,15 +577,19 @@ void createDesriptorPools()
     VK_CHECK(vkCreateDescriptorPool(g_vk.device, &createInfo, nullptr, &g_vk.descriptorPools[DESCRIPTOR_POOL_IMGUI]));
 }
 {
-    std::array<VkDescriptorPoolSize, 1> poolSizes{{
-        {VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 3},
+    // the scene sets, then a depth reduce set per pyramid level
+    std::array<VkDescriptorPoolSize, 4> poolSizes{{
+        {VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC, 3},
+        {VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 7},
+        {VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 1 + DEPTH_PYRAMID_MAX_LEVELS},
+        {VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, DEPTH_PYRAMID_MAX_LEVELS},
     }};
 
     const VkDescriptorPoolCreateInfo createInfo {
         .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO,
         .pNext = nullptr,
         .flags = 0x0,
-        .maxSets = 2u,
+        .maxSets = 3u + DEPTH_PYRAMID_MAX_LEVELS,
         .poolSizeCount = static_cast<uint32_t>(poolSizes.size()),
         .pPoolSizes = poolSizes.data(),
     };
@@ -315,14 +603,14 @@ void createDescriptorSetLayouts()
     std::array<VkDescriptorSetLayoutBinding, 2> set0Bindings{{
         {
             .binding = 0,
-            .descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER,
+            .descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC,
             .descriptorCount = 1,
-            .stageFlags = VK_SHADER_STAGE_VERTEX_BIT,
+            .stageFlags = VK_SHADER_STAGE_VERTEX_BIT | g_app.meshShaderStages | VK_SHADER_STAGE_COMPUTE_BIT,
             .pImmutableSamplers = nullptr,
         },
         {
             .binding = 1,
-            .descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER,
+            .descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC,
             .descriptorCount = 1,
             .stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT,
             .pImmutableSamplers = nullptr,
@@ -342,7 +630,7 @@ void createDescriptorSetLayouts()
     std::array<VkDescriptorSetLayoutBinding, 1> set1Bindings{{
         {
             .binding = 0,
-            .descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER,
+            .descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC,
             .descriptorCount = 1,
             .stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT,
             .pImmutableSamplers = nullptr,
@@ -358,6 +646,59 @@ void createDescriptorSetLayouts()
     };
 
     vkCreateDescriptorSetLayout(g_vk.device, &set1LayoutCreateInfo, nullptr, &g_vk.descriptorSetLayouts[DESCRIPTOR_SET_LAYOUT_DEFAULT_1]);
+
+    // meshlets, vertices, positions and meshlet bounds of the scene mesh, fetched by the task and
+    // mesh shaders, then the culling stats mesh.task counts into. The meshlet visibility bits,
+    // the draws of meshletcull.comp and the depth pyramid are for occlusion culling.
+    std::array<VkDescriptorSetLayoutBinding, 8> set2Bindings;
+    for (uint32_t i = 0; i < set2Bindings.size(); ++i)
+    {
+        set2Bindings[i] = {
+            .binding = i,
+            .descriptorType = (i == 7) ? VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER : VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+            .descriptorCount = 1,
+            .stageFlags = g_app.meshShaderStages | VK_SHADER_STAGE_COMPUTE_BIT,
+            .pImmutableSamplers = nullptr,
+        };
+    }
+
+    VkDescriptorSetLayoutCreateInfo set2LayoutCreateInfo{
+        .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO,
+        .pNext = nullptr,
+        .flags = 0x0,
+        .bindingCount = static_cast<uint32_t>(set2Bindings.size()),
+        .pBindings = set2Bindings.data(),
+    };
+
+    vkCreateDescriptorSetLayout(g_vk.device, &set2LayoutCreateInfo, nullptr, &g_vk.descriptorSetLayouts[DESCRIPTOR_SET_LAYOUT_DEFAULT_2]);
+
+    // depthreduce.comp, the level above and the level it writes
+    const std::array<VkDescriptorSetLayoutBinding, 2> depthReduceBindings{{
+        {
+            .binding = 0,
+            .descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
+            .descriptorCount = 1,
+            .stageFlags = VK_SHADER_STAGE_COMPUTE_BIT,
+            .pImmutableSamplers = nullptr,
+        },
+        {
+            .binding = 1,
+            .descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE,
+            .descriptorCount = 1,
+            .stageFlags = VK_SHADER_STAGE_COMPUTE_BIT,
+            .pImmutableSamplers = nullptr,
+        },
+    }};
+
+    VkDescriptorSetLayoutCreateInfo depthReduceLayoutCreateInfo{
+        .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO,
+        .pNext = nullptr,
+        .flags = 0x0,
+        .bindingCount = static_cast<uint32_t>(depthReduceBindings.size()),
+        .pBindings = depthReduceBindings.data(),
+    };
+
+    vkCreateDescriptorSetLayout(g_vk.device, &depthReduceLayoutCreateInfo, nullptr, &g_vk.descriptorSetLayouts[DESCRIPTOR_SET_LAYOUT_DEPTH_REDUCE]);
 }
 
 void createDescriptorSets()
@@ -379,21 +720,44 @@ void createDescriptorSets()
     };
 
     vkAllocateDescriptorSets(g_vk.device, &materialSetAllocInfo, &g_vk.descriptorSets[DESCRIPTOR_SET_MATERIAL]);
+
+    VkDescriptorSetAllocateInfo geometrySetAllocInfo{
+        .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO,
+        .descriptorPool = g_vk.descriptorPools[DESCRIPTOR_POOL_DEFAULT],
+        .descriptorSetCount = 1,
+        .pSetLayouts = &g_vk.descriptorSetLayouts[DESCRIPTOR_SET_LAYOUT_DEFAULT_2],
+    };
+
+    vkAllocateDescriptorSets(g_vk.device, &geometrySetAllocInfo, &g_vk.descriptorSets[DESCRIPTOR_SET_GEOMETRY]);
+
+    // one per pyramid level, the levels the swapchain extent does not need stay unused
+    std::array<VkDescriptorSetLayout, DEPTH_PYRAMID_MAX_LEVELS> depthReduceSetLayouts;
+    depthReduceSetLayouts.fill(g_vk.descriptorSetLayouts[DESCRIPTOR_SET_LAYOUT_DEPTH_REDUCE]);
+
+    VkDescriptorSetAllocateInfo depthReduceSetAllocInfo{
+        .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO,
+        .descriptorPool = g_vk.descriptorPools[DESCRIPTOR_POOL_DEFAULT],
+        .descriptorSetCount = static_cast<uint32_t>(depthReduceSetLayouts.size()),
+        .pSetLayouts = depthReduceSetLayouts.data(),
+    };
+
+    vkAllocateDescriptorSets(g_vk.device, &depthReduceSetAllocInfo, &g_vk.descriptorSets[DESCRIPTOR_SET_DEPTH_REDUCE]);
 }
 
+// Every uniform lives in the uniform ring, the dynamic offsets given at bind time pick the data
 void updateDescriptorSets()
 {
 {   // Frame
     const std::array<VkDescriptorBufferInfo, 2> descriptorBufferInfo {{
         {
-            .buffer = g_vk.buffers[BUFFER_PER_FRAME_UBO].buffer,
+            .buffer = g_vk.buffers[BUFFER_UNIFORM_RING].buffer,
             .offset = 0,
-            .range = VK_WHOLE_SIZE,
+            .range = sizeof(PerFrameUBO),
         },
         {
-            .buffer = g_vk.buffers[BUFFER_LIGHT_UBO].buffer,
+            .buffer = g_vk.buffers[BUFFER_UNIFORM_RING].buffer,
             .offset = 0,
-            .range = VK_WHOLE_SIZE,
+            .range = sizeof(LightUBO),
         },
     }};
 
@@ -404,7 +768,7 @@ void updateDescriptorSets()
             .dstBinding = 0,
             .dstArrayElement = 0,
             .descriptorCount = 1,
-            .descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER,
+            .descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC,
             .pImageInfo = nullptr,
             .pBufferInfo = &descriptorBufferInfo[0],
             .pTexelBufferView = nullptr,
@@ -415,7 +779,7 @@ void updateDescriptorSets()
             .dstBinding = 1,
             .dstArrayElement = 0,
             .descriptorCount = 1,
-            .descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER,
+            .descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC,
             .pImageInfo = nullptr,
             .pBufferInfo = &descriptorBufferInfo[1],
             .pTexelBufferView = nullptr,
@@ -427,9 +791,9 @@ void updateDescriptorSets()
 
 {   // Material
     const VkDescriptorBufferInfo descriptorBufferInfo {
-        .buffer = g_vk.buffers[BUFFER_MATERIAL_UBO].buffer,
+        .buffer = g_vk.buffers[BUFFER_UNIFORM_RING].buffer,
         .offset = 0,
-        .range = VK_WHOLE_SIZE,
+        .range = sizeof(PerMatUBO),
     };
 
     const std::array<VkWriteDescriptorSet, 1> writes {{
@@ -439,7 +803,7 @@ void updateDescriptorSets()
             .dstBinding = 0,
             .dstArrayElement = 0,
             .descriptorCount = 1,
-            .descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER,
+            .descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC,
             .pImageInfo = nullptr,
             .pBufferInfo = &descriptorBufferInfo,
             .pTexelBufferView = nullptr,
@@ -450,6 +814,134 @@ void updateDescriptorSets()
 }
 }
 
+// Points the culling and mesh shaders at the scene mesh buffers, no frame in flight may be using the set
+void updateGeometryDescriptorSet()
+{
+    const Buffer& positionBuffer = g_app.vertexFormat.separatePositions ? g_vk.buffers[BUFFER_OBJECT_POSITION] : g_vk.buffers[BUFFER_OBJECT_VERTEX];
+
+    const std::array<VkDescriptorBufferInfo, 7> descriptorBufferInfo {{
+        {
+            .buffer = g_vk.buffers[BUFFER_OBJECT_MESHLET].buffer,
+            .offset = 0,
+            .range = VK_WHOLE_SIZE,
+        },
+        {
+            .buffer = g_vk.buffers[BUFFER_OBJECT_VERTEX].buffer,
+            .offset = 0,
+            .range = VK_WHOLE_SIZE,
+        },
+        {
+            .buffer = positionBuffer.buffer,
+            .offset = 0,
+            .range = VK_WHOLE_SIZE,
+        },
+        {
+            .buffer = g_vk.buffers[BUFFER_OBJECT_MESHLET_BOUNDS].buffer,
+            .offset = 0,
+            .range = VK_WHOLE_SIZE,
+        },
+        {
+            .buffer = g_vk.buffers[BUFFER_CULLING_STATS].buffer,
+            .offset = 0,
+            .range = VK_WHOLE_SIZE,
+        },
+        {
+            .buffer = g_vk.buffers[BUFFER_MESHLET_VISIBILITY].buffer,
+            .offset = 0,
+            .range = VK_WHOLE_SIZE,
+        },
+        {
+            .buffer = g_vk.buffers[BUFFER_MESHLET_DRAWS].buffer,
+            .offset = 0,
+            .range = VK_WHOLE_SIZE,
+        },
+    }};
+
+    // sampled in the general layout it is built in
+    const VkDescriptorImageInfo depthPyramidInfo {
+        .sampler = g_vk.depthPyramidSampler,
+        .imageView = g_vk.attachments[ATTACHMENT_DEPTH_PYRAMID].view,
+        .imageLayout = VK_IMAGE_LAYOUT_GENERAL,
+    };
+
+    std::array<VkWriteDescriptorSet, 8> writes;
+    for (uint32_t i = 0; i < descriptorBufferInfo.size(); ++i)
+    {
+        writes[i] = {
+            .sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
+            .dstSet = g_vk.descriptorSets[DESCRIPTOR_SET_GEOMETRY],
+            .dstBinding = i,
+            .dstArrayElement = 0,
+            .descriptorCount = 1,
+            .descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+            .pImageInfo = nullptr,
+            .pBufferInfo = &descriptorBufferInfo[i],
+            .pTexelBufferView = nullptr,
+        };
+    }
+
+    writes[7] = {
+        .sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
+        .dstSet = g_vk.descriptorSets[DESCRIPTOR_SET_GEOMETRY],
+        .dstBinding = 7,
+        .dstArrayElement = 0,
+        .descriptorCount = 1,
+        .descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
+        .pImageInfo = &depthPyramidInfo,
+        .pBufferInfo = nullptr,
+        .pTexelBufferView = nullptr,
+    };
+
+    vkUpdateDescriptorSets(g_vk.device, static_cast<uint32_t>(writes.size()), writes.data(), 0, nullptr);
+}
+
+// Level 0 reduces the depth attachment, in the layout the early occlusion pass leaves it in,
+// every other level the one above it
+void updateDepthReduceDescriptorSets()
+{
+    for (uint32_t level = 0; level < g_app.depthPyramidLevels; ++level)
+    {
+        const VkDescriptorImageInfo inputInfo {
+            .sampler = g_vk.depthPyramidSampler,
+            .imageView = (level == 0) ? g_vk.attachments[ATTACHMENT_DEPTH].view : g_vk.imageViews[IMAGE_VIEW_DEPTH_PYRAMID_LEVEL + level - 1],
+            .imageLayout = (level == 0) ? VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL : VK_IMAGE_LAYOUT_GENERAL,
+        };
+
+        const VkDescriptorImageInfo outputInfo {
+            .sampler = VK_NULL_HANDLE,
+            .imageView = g_vk.imageViews[IMAGE_VIEW_DEPTH_PYRAMID_LEVEL + level],
+            .imageLayout = VK_IMAGE_LAYOUT_GENERAL,
+        };
+
+        const std::array<VkWriteDescriptorSet, 2> writes {{
+            {
+                .sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
+                .dstSet = g_vk.descriptorSets[DESCRIPTOR_SET_DEPTH_REDUCE + level],
+                .dstBinding = 0,
+                .dstArrayElement = 0,
+                .descriptorCount = 1,
+                .descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
+                .pImageInfo = &inputInfo,
+                .pBufferInfo = nullptr,
+                .pTexelBufferView = nullptr,
+            },
+            {
+                .sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
+                .dstSet = g_vk.descriptorSets[DESCRIPTOR_SET_DEPTH_REDUCE + level],
+                .dstBinding = 1,
+                .dstArrayElement = 0,
+                .descriptorCount = 1,
+                .descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE,
+                .pImageInfo = &outputInfo,
+                .pBufferInfo = nullptr,
+                .pTexelBufferView = nullptr,
+            },
+        }};
+
+        vkUpdateDescriptorSets(g_vk.device, static_cast<uint32_t>(writes.size()), writes.data(), 0, nullptr);
+    }
+}
+
 
 // -------------------------
 // PIPELINES
@@ -457,17 +949,18 @@ void updateDescriptorSets()
 
 void createPipelineLayouts()
 {
-    std::array<VkDescriptorSetLayout, 2> setLayouts{
+    std::array<VkDescriptorSetLayout, 3> setLayouts{
         g_vk.descriptorSetLayouts[DESCRIPTOR_SET_LAYOUT_DEFAULT_0],
-        g_vk.descriptorSetLayouts[DESCRIPTOR_SET_LAYOUT_DEFAULT_1]};
+        g_vk.descriptorSetLayouts[DESCRIPTOR_SET_LAYOUT_DEFAULT_1],
+        g_vk.descriptorSetLayouts[DESCRIPTOR_SET_LAYOUT_DEFAULT_2]};
 
-    // std::array<VkPushConstantRange, 1> ranges {{
-    //     {
-    //         .stageFlags = VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT,
-    //         .offset = 0,
-    //         .size = sizeof(PushConst),
-    //     }
-    // }};
+    const std::array<VkPushConstantRange, 1> ranges {{
+        {
+            .stageFlags = getVertexPushConstStages(),
+            .offset = 0,
+            .size = sizeof(VertexPushConst),
+        }
+    }};
 
     const VkPipelineLayoutCreateInfo createInfo{
         .sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO,
@@ -475,166 +968,78 @@ void createPipelineLayouts()
         .pSetLayouts = setLayouts.data(),
         // .setLayoutCount = 0,
         // .pSetLayouts = nullptr,
-        .pushConstantRangeCount = 0, // static_cast<uint32_t>(ranges.size()),
-        .pPushConstantRanges = nullptr // ranges.data(),
+        .pushConstantRangeCount = static_cast<uint32_t>(ranges.size()),
+        .pPushConstantRanges = ranges.data(),
     };
 
     VK_CHECK(vkCreatePipelineLayout(g_vk.device, &createInfo, nullptr, &g_vk.pipelineLayout));
-}
 
-void createPipelines()
-{
-    const std::array<VkPipelineShaderStageCreateInfo, 2> shaderStageCreateInfo{{{
-                                                                                        .sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO,
-                                                                                        .stage = VK_SHADER_STAGE_VERTEX_BIT,
-                                                                                        .module = createShaderModule(g_vk.device, "../shaders/spirv/default-vert.spv"),
-                                                                                        .pName = "main",
-                                                                                    },
-                                                                                    {
-                                                                                        .sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO,
-                                                                                        .stage = VK_SHADER_STAGE_FRAGMENT_BIT,
-                                                                                        .module = createShaderModule(g_vk.device, "../shaders/spirv/default-frag.spv"),
-                                                                                        .pName = "main",
-                                                                                    }}};
-    
-    const std::array<VkVertexInputBindingDescription, 1> vertexInputBindings {{
-        {
-            .binding = 0,
-            .stride = 32,
-            .inputRate = VK_VERTEX_INPUT_RATE_VERTEX,
-        }
-    }};
+    const VkPushConstantRange depthReduceRange {
+        .stageFlags = VK_SHADER_STAGE_COMPUTE_BIT,
+        .offset = 0,
+        .size = sizeof(DepthReducePushConst),
+    };
 
-    const std::array<VkVertexInputAttributeDescription, 3> vertexInputAttributes {{
-        {
-            .location = 0,
-            .binding = 0,
-            .format = VK_FORMAT_R32G32B32_SFLOAT,
-            .offset = 0,
-        },
-        {
-            .location = 1,
-            .binding = 0,
-            .format = VK_FORMAT_R32G32_SFLOAT,
-            .offset = 12,
-        },
-        {
-            .location = 2,
-            .binding = 0,
-            .format = VK_FORMAT_R32G32B32_SFLOAT,
-            .offset = 20,
-        },
-    }};
+    const VkPipelineLayoutCreateInfo depthReduceCreateInfo{
+        .sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO,
+        .setLayoutCount = 1,
+        .pSetLayouts = &g_vk.descriptorSetLayouts[DESCRIPTOR_SET_LAYOUT_DEPTH_REDUCE],
+        .pushConstantRangeCount = 1,
+        .pPushConstantRanges = &depthReduceRange,
+    };
 
-    const VkPipelineVertexInputStateCreateInfo vertexInputStateCreateInfo{
-        .sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO,
-        .vertexBindingDescriptionCount = static_cast<uint32_t>(vertexInputBindings.size()),
-        .pVertexBindingDescriptions = vertexInputBindings.data(),
-        .vertexAttributeDescriptionCount = static_cast<uint32_t>(vertexInputAttributes.size()),
-        .pVertexAttributeDescriptions = vertexInputAttributes.data()
-    };
-
-    const VkViewport viewport{
-        .x = 0,
-        .y = 0,
-        .width = static_cast<float>(g_vk.swapchain.extent.width),
-        .height = static_cast<float>(g_vk.swapchain.extent.height),
-        .minDepth = 0.0f,
-        .maxDepth = 1.0f,
-    };
-
-    const VkRect2D scissorRect{
-        .offset = {.x = 0, .y = 0},
-        .extent = g_vk.swapchain.extent};
-
-    const VkPipelineViewportStateCreateInfo viewportStateCreateInfo{
-        .sType = VK_STRUCTURE_TYPE_PIPELINE_VIEWPORT_STATE_CREATE_INFO,
-        .viewportCount = 1,
-        .pViewports = &viewport,
-        .scissorCount = 1,
-        .pScissors = &scissorRect,
-    };
-
-    const VkPipelineDepthStencilStateCreateInfo depthStencilStateCreateInfo {
-        .sType = VK_STRUCTURE_TYPE_PIPELINE_DEPTH_STENCIL_STATE_CREATE_INFO,
-        .depthTestEnable = VK_TRUE,
-        .depthWriteEnable = VK_TRUE,
-        .depthCompareOp = VK_COMPARE_OP_LESS,
-        .depthBoundsTestEnable = VK_FALSE,
-        .stencilTestEnable = VK_FALSE,
-    };
-
-    const VkPipelineColorBlendAttachmentState colorBlendAttachmentState{
-        .blendEnable = VK_FALSE,
-        .srcColorBlendFactor = VK_BLEND_FACTOR_ZERO,
-        .dstColorBlendFactor = VK_BLEND_FACTOR_ZERO,
-        .colorBlendOp = VK_BLEND_OP_ADD,
-        .srcAlphaBlendFactor = VK_BLEND_FACTOR_ZERO,
-        .dstAlphaBlendFactor = VK_BLEND_FACTOR_ZERO,
-        .alphaBlendOp = VK_BLEND_OP_ADD,
-        .colorWriteMask = VK_COLOR_COMPONENT_R_BIT | VK_COLOR_COMPONENT_G_BIT | VK_COLOR_COMPONENT_B_BIT | VK_COLOR_COMPONENT_A_BIT,
-    };
-
-    const VkPipelineColorBlendStateCreateInfo colorBlendStateCreateInfo{
-        .sType = VK_STRUCTURE_TYPE_PIPELINE_COLOR_BLEND_STATE_CREATE_INFO,
-        .logicOpEnable = VK_FALSE,
-        .logicOp = VK_LOGIC_OP_COPY,
-        .attachmentCount = 1,
-        .pAttachments = &colorBlendAttachmentState,
-        .blendConstants = {0, 0, 0, 0}};
-
-    const VkPipelineInputAssemblyStateCreateInfo inputAssemblyStateCreateInfo{
-        .sType = VK_STRUCTURE_TYPE_PIPELINE_INPUT_ASSEMBLY_STATE_CREATE_INFO,
-        .topology = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST,
-        .primitiveRestartEnable = VK_FALSE,
-    };
-
-    const VkPipelineRasterizationStateCreateInfo rasterizationStateCreateInfo{
-        .sType = VK_STRUCTURE_TYPE_PIPELINE_RASTERIZATION_STATE_CREATE_INFO,
-        .depthClampEnable = VK_FALSE,
-        .rasterizerDiscardEnable = VK_FALSE,
-        .polygonMode = VK_POLYGON_MODE_FILL,
-        .cullMode = VK_CULL_MODE_NONE,
-        .frontFace = VK_FRONT_FACE_COUNTER_CLOCKWISE,
-        .depthBiasEnable = VK_FALSE,
-        .depthBiasConstantFactor = 0.0f,
-        .depthBiasClamp = 0.0f,
-        .depthBiasSlopeFactor = 0.0f,
-        .lineWidth = 1.0f,
-    };
-
-    const VkPipelineMultisampleStateCreateInfo multisampleStateCreateInfo{
-        .sType = VK_STRUCTURE_TYPE_PIPELINE_MULTISAMPLE_STATE_CREATE_INFO,
-        .rasterizationSamples = VK_SAMPLE_COUNT_1_BIT,
-        .sampleShadingEnable = VK_FALSE,
-        .minSampleShading = 0.0f,
-        .pSampleMask = nullptr,
-        .alphaToCoverageEnable = VK_FALSE,
-        .alphaToOneEnable = VK_FALSE,
-    };
-
-    const VkGraphicsPipelineCreateInfo pipelineCreateInfo{
-        .sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO,
-        .stageCount = static_cast<uint32_t>(shaderStageCreateInfo.size()),
-        .pStages = shaderStageCreateInfo.data(),
-        .pVertexInputState = &vertexInputStateCreateInfo,
-        .pInputAssemblyState = &inputAssemblyStateCreateInfo,
-        .pViewportState = &viewportStateCreateInfo,
-        .pRasterizationState = &rasterizationStateCreateInfo,
-        .pMultisampleState = &multisampleStateCreateInfo,
-        .pDepthStencilState = &depthStencilStateCreateInfo,
-        .pColorBlendState = &colorBlendStateCreateInfo,
-        .layout = g_vk.pipelineLayout,
-        .renderPass = g_vk.renderPass,
-        .subpass = 0,
-        .basePipelineHandle = VK_NULL_HANDLE,
-        .basePipelineIndex = 0,
+    VK_CHECK(vkCreatePipelineLayout(g_vk.device, &depthReduceCreateInfo, nullptr, &g_vk.depthReducePipelineLayout));
+}
+
+// Queues the scene pipelines for the vertex format of the scene mesh, the workers compile them
+// while the frame loop goes on
+static void requestScenePipelines()
+{
+    // default.vert decodes octahedral normals when this is 1
+    const uint32_t normalEncoding = (g_app.vertexFormat.normal == VertexInputAttribute_T::eNormal) ? 0u : 1u;
+
+    PipelineDesc desc {
+        .name = "scene",
+        .vertexShader = "../shaders/spirv/default-vert.spv",
+        .fragmentShader = "../shaders/spirv/default-frag.spv",
+        .vertexSpecialization = { normalEncoding },
+        .vertexFormat = g_app.vertexFormat,
+        .frontFace = SCENE_FRONT_FACE,
     };
+    g_app.pipelines[PIPELINE_SCENE] = g_app.pipelineBuilder->request(desc);
 
-    VK_CHECK(vkCreateGraphicsPipelines(g_vk.device, VK_NULL_HANDLE, 1, &pipelineCreateInfo, nullptr, &g_vk.pipeline));
+    desc.name = "scene wireframe";
+    desc.polygonMode = VK_POLYGON_MODE_LINE;
+    g_app.pipelines[PIPELINE_SCENE_WIREFRAME] = g_app.pipelineBuilder->request(desc);
 
-    vkDestroyShaderModule(g_vk.device, shaderStageCreateInfo[0].module, nullptr);
-    vkDestroyShaderModule(g_vk.device, shaderStageCreateInfo[1].module, nullptr);
+    if (g_app.cmdDrawMeshTasksEXT == nullptr)
+        return;
+
+    // mesh.mesh reads the vertex buffers as raw words, the layout goes in as specialization constants
+    const VertexFormat& format = g_app.vertexFormat;
+    const uint32_t positionFormat = (format.position == VertexInputAttribute_T::ePositionUnorm16) ? 1u : 0u;
+    const uint32_t normalFormat = (format.normal == VertexInputAttribute_T::eNormalOctSnorm16) ? 1u
+                                : (format.normal == VertexInputAttribute_T::eNormalOctSnorm8) ? 2u : 0u;
+    const uint32_t vertexStride = getVertexStride(format);
+    const uint32_t positionStride = format.separatePositions ? getPositionStride(format) : vertexStride;
+    const uint32_t normalOffset = (format.separatePositions ? 0u : getVertexAttributeSize(format.position)) + getVertexAttributeSize(format.uv);
+
+    PipelineDesc meshDesc {
+        .name = "scene mesh shading",
+        .taskShader = "../shaders/spirv/mesh-task.spv",
+        .meshShader = "../shaders/spirv/mesh-mesh.spv",
+        .fragmentShader = "../shaders/spirv/default-frag.spv",
+        .vertexSpecialization = { positionFormat, normalFormat, vertexStride, positionStride, normalOffset,
+                                  g_config.meshWorkgroupSize, g_app.meshletMaxVertices, g_app.meshletMaxTriangles,
+                                  static_cast<uint32_t>(SCENE_FRONT_FACE) },
+        .vertexFormat = format,
+        .frontFace = SCENE_FRONT_FACE,
+    };
+    g_app.pipelines[PIPELINE_SCENE_MESH] = g_app.pipelineBuilder->request(meshDesc);
+
+    meshDesc.name = "scene mesh shading wireframe";
+    meshDesc.polygonMode = VK_POLYGON_MODE_LINE;
+    g_app.pipelines[PIPELINE_SCENE_MESH_WIREFRAME] = g_app.pipelineBuilder->request(meshDesc);
 }
 
 
@@ -642,14 +1047,17 @@ void createPipelines()
 // COMMAND POOLS / BUFFERS
 // -------------------------
 
+// One pool per frame in flight, reset as a whole once the frame's fence is signaled
 void createCommandPools()
 {
-    g_vk.commandPools[COMMAND_POOL_DEFAULT] = createCommandPool(g_vk.device, g_vk.queueFamilyIndices[QUEUE_GRAPHICS]);
+    for (uint32_t i = 0; i < MAX_FRAMES_IN_FLIGHT; ++i)
+        g_vk.commandPools[COMMAND_POOL_FRAME + i] = createCommandPool(g_vk.device, g_vk.queueFamilyIndices[QUEUE_GRAPHICS]);
 }
 
 void createCommandBuffers()
 {
-    g_vk.commandBuffers[COMMAND_BUFFER_DEFAULT] = createCommandBuffer(g_vk.device, g_vk.commandPools[COMMAND_POOL_DEFAULT]);
+    for (uint32_t i = 0; i < MAX_FRAMES_IN_FLIGHT; ++i)
+        g_vk.commandBuffers[COMMAND_BUFFER_FRAME + i] = createCommandBuffer(g_vk.device, g_vk.commandPools[COMMAND_POOL_FRAME + i]);
 }
 
 // -------------------------
@@ -658,7 +1066,19 @@ void createCommandBuffers()
 
 void createSynchornizationResources()
 {
-    g_vk.fences[FENCE_IMAGE_ACQUIRE] = createFence(g_vk.device, false);
+    for (uint32_t i = 0; i < MAX_FRAMES_IN_FLIGHT; ++i)
+    {
+        g_vk.semaphores[SEMAPHORE_IMAGE_ACQUIRED + i] = createSemaphore(g_vk.device);
+        g_vk.semaphores[SEMAPHORE_RENDER_FINISHED + i] = createSemaphore(g_vk.device);
+        // signaled, the first use of each frame has nothing to wait for
+        g_vk.fences[FENCE_FRAME + i] = createFence(g_vk.device, true);
+    }
+}
+
+// Waits for every submitted frame, before destroying resources they may still use
+static void waitForFramesInFlight()
+{
+    VK_CHECK(vkWaitForFences(g_vk.device, MAX_FRAMES_IN_FLIGHT, &g_vk.fences[FENCE_FRAME], VK_TRUE, UINT64_MAX));
 }
 
 
@@ -672,105 +1092,622 @@ void init()
         .window = g_app.window,
         .windowWidth = g_app.windowWidth,
         .windowHeight = g_app.windowHeight,
+        .physicalDeviceIndex = g_config.physicalDeviceIndex,
         .requestedInstanceExtensions = {"VK_KHR_surface", "VK_KHR_xcb_surface"},
         .requestedInstanceLayers = {"VK_LAYER_KHRONOS_validation"},
-        .requestedDeviceExtensions = { VK_KHR_SWAPCHAIN_EXTENSION_NAME, VK_NV_MESH_SHADER_EXTENSION_NAME },
-        .requestedDeviceFeatures = {SupportedDeviceFeature::eSynchronization2, SupportedDeviceFeature::eDescriptorIndexing, SupportedDeviceFeature::eMeshShadingNV},
-        .requestedQueueTypes = {VK_QUEUE_GRAPHICS_BIT},
-        .requestedQueuePriorities = { 1.0f },
-        .requestedSwapchainImageCount = 2u,
+        .requestedDeviceExtensions = { VK_KHR_SWAPCHAIN_EXTENSION_NAME },
+        .requestedDeviceFeatures = {SupportedDeviceFeature::eSynchronization2, SupportedDeviceFeature::eDescriptorIndexing, SupportedDeviceFeature::eTimelineSemaphore, SupportedDeviceFeature::eFillModeNonSolid},
+        // mesh shading and occlusion culling in the vertex path, the app runs without them
+        .optionalDeviceExtensions = { VK_EXT_MESH_SHADER_EXTENSION_NAME, VK_KHR_DRAW_INDIRECT_COUNT_EXTENSION_NAME },
+        .optionalDeviceFeatures = { SupportedDeviceFeature::eMeshShading },
+        .requestedQueueTypes = {VK_QUEUE_GRAPHICS_BIT, VK_QUEUE_TRANSFER_BIT},
+        .requestedQueuePriorities = { 1.0f, 1.0f },
+        .requestedSwapchainImageCount = MAX_FRAMES_IN_FLIGHT + 1, // one image being presented while the others are rendered
         .requestedSwapchainFormat = VK_FORMAT_R8G8B8A8_SRGB,
         .requestedSwapchainPresentMode = VK_PRESENT_MODE_FIFO_KHR};
 
     g_vk = vkmInit(initParams);
 
-    setPhysicalDeviceMemoryProperties(g_vk.physicalDeviceMemoryProperties);
+    VkPhysicalDeviceSubgroupProperties subgroupProperties {
+        .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_SUBGROUP_PROPERTIES,
+    };
+    VkPhysicalDeviceMeshShaderPropertiesEXT meshShaderProperties {
+        .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MESH_SHADER_PROPERTIES_EXT,
+        .pNext = &subgroupProperties,
+    };
+    const bool meshShaderExtension = vkmIsDeviceExtensionEnabled(g_vk, VK_EXT_MESH_SHADER_EXTENSION_NAME);
+    VkPhysicalDeviceProperties2 properties {
+        .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PROPERTIES_2,
+        .pNext = meshShaderExtension ? static_cast<void*>(&meshShaderProperties) : static_cast<void*>(&subgroupProperties),
+    };
+    vkGetPhysicalDeviceProperties2(g_vk.physicalDevice, &properties);
+    g_app.maxComputeWorkGroupCountX = properties.properties.limits.maxComputeWorkGroupCount[0];
+
+    // mesh.mesh compacts the triangles it keeps with subgroup ballots
+    const VkSubgroupFeatureFlags subgroupOperations = VK_SUBGROUP_FEATURE_BASIC_BIT | VK_SUBGROUP_FEATURE_BALLOT_BIT;
+    const bool meshSubgroupBallot = meshShaderExtension && (subgroupProperties.supportedStages & VK_SHADER_STAGE_MESH_BIT_EXT) != 0 && (subgroupProperties.supportedOperations & subgroupOperations) == subgroupOperations;
+
+    if (vkmIsDeviceFeatureEnabled(g_vk, SupportedDeviceFeature::eMeshShading) && meshSubgroupBallot)
+    {
+        g_app.cmdDrawMeshTasksEXT = reinterpret_cast<PFN_vkCmdDrawMeshTasksEXT>(vkGetDeviceProcAddr(g_vk.device, "vkCmdDrawMeshTasksEXT"));
+        g_app.meshShaderStages = VK_SHADER_STAGE_TASK_BIT_EXT | VK_SHADER_STAGE_MESH_BIT_EXT;
+        g_app.taskPipelineStage = VK_PIPELINE_STAGE_TASK_SHADER_BIT_EXT;
+        g_app.meshPipelineStage = VK_PIPELINE_STAGE_MESH_SHADER_BIT_EXT;
+        g_app.maxTaskWorkGroupCountX = meshShaderProperties.maxTaskWorkGroupCount[0];
+        g_app.maxTaskWorkGroupTotalCount = meshShaderProperties.maxTaskWorkGroupTotalCount;
+
+        // 32 and 64 threads and whole meshlets fit the minimum limits of VK_EXT_mesh_shader, 128
+        // invocations and 256 outputs. Without --mesh-workgroup the device preference decides.
+        if (g_config.meshWorkgroupSize == 0)
+            g_config.meshWorkgroupSize = (meshShaderProperties.maxPreferredMeshWorkGroupInvocations >= 64) ? 64 : 32;
+        assert(MESHLET_MAX_VERTICES <= meshShaderProperties.maxMeshOutputVertices && MESHLET_MAX_TRIANGLES <= meshShaderProperties.maxMeshOutputPrimitives);
+        LOG("Mesh shader workgroups of %u threads, %u preferred\n", g_config.meshWorkgroupSize, meshShaderProperties.maxPreferredMeshWorkGroupInvocations);
+    }
+    else
+    {
+        LOG("Mesh shading is not supported%s, drawing with the vertex shader\n", (meshShaderExtension && !meshSubgroupBallot) ? " (no subgroup ballots in mesh shaders)" : "");
+        if (g_config.meshShading)
+        {
+            LOG("Ignoring --mesh-shading\n");
+        }
+        g_config.meshShading = false;
+    }
+
+    if (vkmIsDeviceExtensionEnabled(g_vk, VK_KHR_DRAW_INDIRECT_COUNT_EXTENSION_NAME))
+        g_app.cmdDrawIndexedIndirectCountKHR = reinterpret_cast<PFN_vkCmdDrawIndexedIndirectCountKHR>(vkGetDeviceProcAddr(g_vk.device, "vkCmdDrawIndexedIndirectCountKHR"));
+
+    g_vk.pipelineCache = loadPipelineCache(g_vk.device, g_vk.physicalDevice, PIPELINE_CACHE_PATH, g_app.pipelineCacheWarm);
 
     createDesriptorPools();
     createDescriptorSetLayouts();
     createDescriptorSets();
     createRenderPass();
     createFramebuffers();
+    createDepthPyramid();
+    updateDepthReduceDescriptorSets();
     createPipelineLayouts();
-    createPipelines();
     createCommandPools();
     createCommandBuffers();
     createSynchornizationResources();
 
-    // Staging Buffer 
-    VkDeviceSize stagingBufferSize = 50000000;
+    // the main thread keeps recording frames, one core is left to it
+    g_app.pipelineBuilder = std::make_unique<PipelineBuilder>(PipelineBuilderParams {
+        .device = g_vk.device,
+        .pipelineCache = g_vk.pipelineCache,
+        .pipelineLayout = g_vk.pipelineLayout,
+        .renderPass = g_vk.renderPass,
+        .extent = g_vk.swapchain.extent,
+        .threadCount = std::clamp(std::thread::hardware_concurrency(), 2u, 5u) - 1u,
+    });
+
+    // occlusion culling, independent of the scene vertex format
+    g_app.pipelines[PIPELINE_DEPTH_REDUCE] = g_app.pipelineBuilder->request({
+        .name = "depth reduce",
+        .computeShader = "../shaders/spirv/depthreduce-comp.spv",
+        .layout = g_vk.depthReducePipelineLayout,
+    });
+    g_app.pipelines[PIPELINE_MESHLET_CULL] = g_app.pipelineBuilder->request({
+        .name = "meshlet cull",
+        .computeShader = "../shaders/spirv/meshletcull-comp.spv",
+    });
+
+    // Staging Buffer, the mesh streamer uses it as an upload ring and splits anything larger
+    VkDeviceSize stagingBufferSize = 16 * 1024 * 1024;
     createBuffer(g_vk.device, stagingBufferSize, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, g_vk.buffers[BUFFER_STAGING]);
+    mapBuffer(g_vk.device, g_vk.buffers[BUFFER_STAGING]);
 
-    // PerFrameUBO Buffer
-    createBuffer(g_vk.device, sizeof(PerFrameUBO), VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, g_vk.buffers[BUFFER_PER_FRAME_UBO]);
-
-    g_app.projMatrix = glm::ortho(-1.0f, 1.0f, -1.0f, 1.0f, -2.0f, 2.0f);
+    // Uniforms, pushed every frame
+    createUniformRing(g_vk.device, g_vk.physicalDevice, 64 * 1024, MAX_FRAMES_IN_FLIGHT, g_vk.buffers[BUFFER_UNIFORM_RING], g_app.uniformRing);
 
-    const PerFrameUBO perFrameUBO {
-        .viewMatrix = g_camera.matrix,
-        .projMatrix = g_app.projMatrix
-    };
+    // Culling stats, zeroed by the host before each frame counts into its slot
+    createBuffer(g_vk.device, sizeof(CullingStats) * MAX_FRAMES_IN_FLIGHT, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, g_vk.buffers[BUFFER_CULLING_STATS]);
+    mapBuffer(g_vk.device, g_vk.buffers[BUFFER_CULLING_STATS]);
+    memset(g_vk.buffers[BUFFER_CULLING_STATS].mappedData, 0, sizeof(CullingStats) * MAX_FRAMES_IN_FLIGHT);
 
-    uploadToBuffer(g_vk.device, g_vk.buffers[BUFFER_PER_FRAME_UBO], sizeof(PerFrameUBO), 0, (void*)&perFrameUBO);
+    g_app.projMatrix = glm::ortho(-1.0f, 1.0f, -1.0f, 1.0f, -2.0f, 2.0f);
 
-    // PerMatUBO Buffer
-    createBuffer(g_vk.device, sizeof(PerMatUBO), VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, g_vk.buffers[BUFFER_MATERIAL_UBO]);
     g_config.materialAlbedo = glm::vec3(1.0f, 0.0f, 0.0f);
     g_config.materialRoughness = 0.5f;
-    glm::vec4 materialAlbedo = glm::vec4(g_config.materialAlbedo, 0.0f);
-    glm::vec4 materialRoughness = glm::vec4(g_config.materialRoughness, 0.0f, 0.0f, 0.0f);
-    uploadToBuffer(g_vk.device, g_vk.buffers[BUFFER_MATERIAL_UBO], sizeof(glm::vec4), offsetof(PerMatUBO, albedo), (void*)&materialAlbedo);
-    uploadToBuffer(g_vk.device, g_vk.buffers[BUFFER_MATERIAL_UBO], sizeof(glm::vec4), offsetof(PerMatUBO, roughness), (void*)&materialRoughness);
-
-    // LightUBO
-    createBuffer(g_vk.device, sizeof(LightUBO), VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, g_vk.buffers[BUFFER_LIGHT_UBO]);
     g_config.dirLightIntensity = glm::vec3(1.0f, 1.0f, 1.0f);
     g_config.dirLightPosition = glm::vec3(5.0f, 10.0f, 10.0f);
-    glm::vec4 dirLightIntensity = glm::vec4(g_config.dirLightIntensity, 0.0f);
-    glm::vec4 dirLightPosition = glm::vec4(g_config.dirLightPosition, 0.0f);
-    uploadToBuffer(g_vk.device, g_vk.buffers[BUFFER_LIGHT_UBO], sizeof(glm::vec4), offsetof(LightUBO, position), (void*)&dirLightPosition);
-    uploadToBuffer(g_vk.device, g_vk.buffers[BUFFER_LIGHT_UBO], sizeof(glm::vec4), offsetof(LightUBO, intensity), (void*)&dirLightIntensity);
-    
+
     // Geometry SSBO
     VkDeviceSize geometrySSBOSize = 50000000;
     createBuffer(g_vk.device, geometrySSBOSize, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, g_vk.buffers[BUFFER_GEOMETRY_SSBO]);
 
-    // Scene
-    MeshBufferData meshVertexData = loadMeshFile("../meshes/sphere.mesh");
-
-    createBuffer(g_vk.device, sizeof(float) * meshVertexData.vertices.size(), VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, g_vk.buffers[BUFFER_OBJECT_VERTEX]);
-    uploadBuffer(g_vk.device, g_vk.commandPools[COMMAND_BUFFER_DEFAULT], g_vk.commandBuffers[COMMAND_BUFFER_DEFAULT], g_vk.queues[QUEUE_GRAPHICS], g_vk.buffers[BUFFER_STAGING], g_vk.buffers[BUFFER_OBJECT_VERTEX], sizeof(float) * meshVertexData.vertices.size(), meshVertexData.vertices.data());
-    createBuffer(g_vk.device, sizeof(uint32_t) * meshVertexData.indices.size(), VK_BUFFER_USAGE_INDEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, g_vk.buffers[BUFFER_OBJECT_INDEX]);
-    uploadBuffer(g_vk.device, g_vk.commandPools[COMMAND_BUFFER_DEFAULT], g_vk.commandBuffers[COMMAND_BUFFER_DEFAULT], g_vk.queues[QUEUE_GRAPHICS], g_vk.buffers[BUFFER_STAGING], g_vk.buffers[BUFFER_OBJECT_INDEX], sizeof(uint32_t) * meshVertexData.indices.size(), meshVertexData.indices.data());
-    g_app.indexCount[BUFFER_OBJECT_INDEX] = meshVertexData.indices.size();
+    // Scene, nothing is drawn until the streamer hands it over
+    g_app.meshStreamer = std::make_unique<MeshStreamer>(MeshStreamerParams {
+        .device = g_vk.device,
+        .transferQueue = g_vk.queues[QUEUE_TRANSFER],
+        .transferQueueFamilyIndex = g_vk.queueFamilyIndices[QUEUE_TRANSFER],
+        .graphicsQueue = g_vk.queues[QUEUE_GRAPHICS],
+        .graphicsQueueFamilyIndex = g_vk.queueFamilyIndices[QUEUE_GRAPHICS],
+        .stagingBuffer = &g_vk.buffers[BUFFER_STAGING],
+    });
+    g_app.meshStreamer->request("../meshes/sphere.mesh");
 
     updateDescriptorSets();
 }
 
+// Makes a streamed mesh the scene mesh. Frames in flight may still draw the previous mesh, they
+// are waited for first.
+static void setSceneMesh(StreamedMesh& mesh)
+{
+    waitForFramesInFlight();
+
+    destroyBuffer(g_vk.device, g_vk.buffers[BUFFER_OBJECT_VERTEX]);
+    destroyBuffer(g_vk.device, g_vk.buffers[BUFFER_OBJECT_INDEX]);
+    destroyBuffer(g_vk.device, g_vk.buffers[BUFFER_OBJECT_POSITION]);
+    destroyBuffer(g_vk.device, g_vk.buffers[BUFFER_OBJECT_MESHLET]);
+    destroyBuffer(g_vk.device, g_vk.buffers[BUFFER_OBJECT_MESHLET_BOUNDS]);
+    destroyBuffer(g_vk.device, g_vk.buffers[BUFFER_OBJECT_MESHLET_INDEX]);
+    destroyBuffer(g_vk.device, g_vk.buffers[BUFFER_MESHLET_VISIBILITY]);
+    destroyBuffer(g_vk.device, g_vk.buffers[BUFFER_MESHLET_DRAWS]);
+
+    g_vk.buffers[BUFFER_OBJECT_VERTEX] = mesh.vertexBuffer;
+    g_vk.buffers[BUFFER_OBJECT_INDEX] = mesh.indexBuffer;
+    g_vk.buffers[BUFFER_OBJECT_POSITION] = mesh.positionBuffer;
+    g_vk.buffers[BUFFER_OBJECT_MESHLET] = mesh.meshletBuffer;
+    g_vk.buffers[BUFFER_OBJECT_MESHLET_BOUNDS] = mesh.meshletBoundsBuffer;
+    g_vk.buffers[BUFFER_OBJECT_MESHLET_INDEX] = mesh.meshletIndexBuffer;
+    g_vk.meshlets[BUFFER_OBJECT_INDEX] = std::move(mesh.meshlets);
+
+    // occlusion culling state, a visibility word per culling workgroup and the draws of both phases
+    const uint32_t meshletCount = static_cast<uint32_t>(g_vk.meshlets[BUFFER_OBJECT_INDEX].size());
+    const uint32_t visibilityWordCount = std::max((meshletCount + MESHLETS_PER_TASK - 1) / MESHLETS_PER_TASK, 1u);
+    createBuffer(g_vk.device, visibilityWordCount * sizeof(uint32_t), VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_SRC_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, g_vk.buffers[BUFFER_MESHLET_VISIBILITY]);
+    createBuffer(g_vk.device, MESHLET_DRAW_COUNTS_SIZE + 2 * std::max(meshletCount, 1u) * sizeof(VkDrawIndexedIndirectCommand), VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_SRC_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, g_vk.buffers[BUFFER_MESHLET_DRAWS]);
+    g_app.meshletVisibilityReset = true;
+
+    g_app.meshletMaxVertices = 0;
+    g_app.meshletMaxTriangles = 0;
+    for (const Meshlet& meshlet : g_vk.meshlets[BUFFER_OBJECT_INDEX])
+    {
+        g_app.meshletMaxVertices = std::max<uint32_t>(g_app.meshletMaxVertices, meshlet.vertexCount);
+        g_app.meshletMaxTriangles = std::max<uint32_t>(g_app.meshletMaxTriangles, meshlet.triangleCount);
+    }
+
+    g_app.indexCount[BUFFER_OBJECT_INDEX] = mesh.indexCount;
+    g_app.lods = std::move(mesh.lods);
+    g_app.lodIndex = 0;
+    g_app.positionQuantization = mesh.positionQuantization;
+    g_app.streamWaitValue = mesh.timelineValue;
+
+    // vertex input and meshlet sizes depend on how the scene mesh was baked, pipelines of formats seen before are reused
+    g_app.vertexFormat = mesh.vertexFormat;
+    requestScenePipelines();
+    updateGeometryDescriptorSet();
+
+    LOG("Scene mesh %s : %u vertices, %u triangles, %zu meshlets\n", mesh.path.c_str(), mesh.vertexCount, g_app.lods[0].indexCount / 3, g_vk.meshlets[BUFFER_OBJECT_INDEX].size());
+}
+
+// Moves the scene buffers out of the least used device memory block of each pool, e.g. once scene
+// swaps left the blocks of earlier meshes mostly empty. Other allocations of those blocks stay where
+// they are. Waits for the frames in flight and the copies, it only runs on request.
+static void defragmentSceneMemory()
+{
+    waitForFramesInFlight();
+
+    std::vector<DefragmentationMove> moves = beginDefragmentation(MAX_DEFRAGMENTATION_MOVES);
+    if (moves.empty())
+        return;
+
+    static const std::array<uint32_t, 8> sceneBuffers {
+        BUFFER_OBJECT_VERTEX, BUFFER_OBJECT_INDEX, BUFFER_OBJECT_POSITION, BUFFER_OBJECT_MESHLET,
+        BUFFER_OBJECT_MESHLET_BOUNDS, BUFFER_OBJECT_MESHLET_INDEX, BUFFER_MESHLET_VISIBILITY, BUFFER_MESHLET_DRAWS,
+    };
+
+    // the frame command buffer is free, every frame in flight is done with it
+    VkCommandBuffer commandBuffer = g_vk.commandBuffers[COMMAND_BUFFER_FRAME + g_app.frameIndex];
+    vkResetCommandPool(g_vk.device, g_vk.commandPools[COMMAND_POOL_FRAME + g_app.frameIndex], 0x0);
+
+    const VkCommandBufferBeginInfo commandBufferBeginInfo {
+        .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO,
+        .flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT};
+
+    VK_CHECK(vkBeginCommandBuffer(commandBuffer, &commandBufferBeginInfo));
+
+    // the copies read what the frames and the streamer wrote, the next frames read the copies
+    const VkMemoryBarrier copySrcBarrier {
+        .sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER,
+        .srcAccessMask = VK_ACCESS_MEMORY_WRITE_BIT,
+        .dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT,
+    };
+    vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0x0, 1, &copySrcBarrier, 0, nullptr, 0, nullptr);
+
+    std::vector<VkBuffer> oldBuffers;
+    for (DefragmentationMove& move : moves)
+    {
+        const auto sceneBuffer = std::find_if(sceneBuffers.begin(), sceneBuffers.end(), [&](uint32_t buffer) {
+            const DeviceAllocation& allocation = g_vk.buffers[buffer].allocation;
+            return allocation.memory == move.src.memory && allocation.offset == move.src.offset;
+        });
+
+        move.skip = (sceneBuffer == sceneBuffers.end());
+        if (!move.skip)
+            oldBuffers.push_back(moveBuffer(g_vk.device, commandBuffer, g_vk.buffers[*sceneBuffer], move.dst));
+    }
+
+    const VkMemoryBarrier copyDstBarrier {
+        .sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER,
+        .srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT,
+        .dstAccessMask = VK_ACCESS_MEMORY_READ_BIT | VK_ACCESS_MEMORY_WRITE_BIT,
+    };
+    vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, 0x0, 1, &copyDstBarrier, 0, nullptr, 0, nullptr);
+
+    VK_CHECK(vkEndCommandBuffer(commandBuffer));
+
+    // a scene mesh no frame has drawn yet may still be uploading on the transfer queue
+    const bool waitForStream = (g_app.streamWaitValue != 0);
+    const VkSemaphore streamSemaphore = g_app.meshStreamer->getSemaphore();
+    const VkPipelineStageFlags streamWaitStage = VK_PIPELINE_STAGE_TRANSFER_BIT;
+
+    const VkTimelineSemaphoreSubmitInfo timelineSubmitInfo {
+        .sType = VK_STRUCTURE_TYPE_TIMELINE_SEMAPHORE_SUBMIT_INFO,
+        .waitSemaphoreValueCount = 1,
+        .pWaitSemaphoreValues = &g_app.streamWaitValue,
+    };
+
+    const VkSubmitInfo submitInfo {
+        .sType = VK_STRUCTURE_TYPE_SUBMIT_INFO,
+        .pNext = waitForStream ? &timelineSubmitInfo : nullptr,
+        .waitSemaphoreCount = waitForStream ? 1u : 0u,
+        .pWaitSemaphores = &streamSemaphore,
+        .pWaitDstStageMask = &streamWaitStage,
+        .commandBufferCount = 1,
+        .pCommandBuffers = &commandBuffer,
+    };
+
+    VK_CHECK(vkQueueSubmit(g_vk.queues[QUEUE_GRAPHICS], 1, &submitInfo, VK_NULL_HANDLE));
+    VK_CHECK(vkQueueWaitIdle(g_vk.queues[QUEUE_GRAPHICS]));
+
+    for (VkBuffer buffer : oldBuffers)
+        vkDestroyBuffer(g_vk.device, buffer, nullptr);
+
+    LOG("Defragmentation : %zu scene buffers moved, %zu other allocations kept\n", oldBuffers.size(), moves.size() - oldBuffers.size());
+    endDefragmentation(moves);
+
+    // the moved buffers are new VkBuffer objects
+    if (!oldBuffers.empty())
+        updateGeometryDescriptorSet();
+    logDeviceMemoryStats();
+}
+
 void update()
 {
-    if (g_camera.dirty)
+    for (StreamedMesh& mesh : g_app.meshStreamer->poll())
+        setSceneMesh(mesh);
+
+    if (g_app.defragmentMemory)
+    {
+        defragmentSceneMemory();
+        g_app.defragmentMemory = false;
+    }
+
+    if (g_app.lods.empty())
+        return;
+
+    // screen space error of the scene mesh, drawn at the origin, with the projection of PerFrameUBO
+    const float viewDepth = -(g_camera.matrix * glm::vec4(0.0f, 0.0f, 0.0f, 1.0f)).z;
+    const float pixelsPerUnit = getPixelsPerUnit(g_app.projMatrix, viewDepth, g_vk.swapchain.extent.height);
+    const uint32_t lodIndex = selectLod(g_app.lods.data(), static_cast<uint32_t>(g_app.lods.size()), pixelsPerUnit, g_config.lodPixelError);
+
+    if (lodIndex != g_app.lodIndex)
     {
-        uploadToBuffer(g_vk.device, g_vk.buffers[BUFFER_PER_FRAME_UBO], sizeof(glm::mat4), offsetof(PerFrameUBO, viewMatrix), (void*)&g_camera.matrix);
-        uploadToBuffer(g_vk.device, g_vk.buffers[BUFFER_PER_FRAME_UBO], sizeof(glm::vec3), offsetof(PerFrameUBO, viewPos), (void*)&g_camera.pos);
+        LOG("LOD %u -> %u : %u triangles, %.2f pixels of error\n", g_app.lodIndex, lodIndex, g_app.lods[lodIndex].indexCount / 3, g_app.lods[lodIndex].error * pixelsPerUnit);
+        g_app.lodIndex = lodIndex;
     }
 }
 
+// The vertex path draws the meshlets meshletcull.comp keeps with an indirect count
+static bool isOcclusionCullingAvailable()
+{
+    return g_config.meshShading || g_app.cmdDrawIndexedIndirectCountKHR != nullptr;
+}
+
 void gui()
 {
-    // bool open = true;
-    // if (ImGui::Begin("App Config", &open))
-    // {
+    if (ImGui::Begin("App Config"))
+    {
+        // both paths draw the same scene mesh, switching only binds another pipeline. Without mesh
+        // shading support there is only the vertex shader.
+        if (g_app.cmdDrawMeshTasksEXT != nullptr)
+        {
+            static const char* geometryPaths[] { "Vertex shader", "Mesh shader" };
+            int geometryPath = g_config.meshShading ? 1 : 0;
+            if (ImGui::Combo("Geometry", &geometryPath, geometryPaths, IM_ARRAYSIZE(geometryPaths)))
+            {
+                g_config.meshShading = (geometryPath == 1);
+                LOG("Geometry path : %s\n", geometryPaths[geometryPath]);
+            }
+        }
+
+        ImGui::Checkbox("Wireframe", &g_config.wireframe);
+
+        // both paths, the vertex path then draws the full mesh meshlets meshletcull.comp keeps
+        if (isOcclusionCullingAvailable())
+            ImGui::CheckboxFlags("Occlusion culling", &g_config.meshletCulling, CULL_OCCLUSION);
+        const bool occlusionCulling = isOcclusionCullingAvailable() && (g_config.meshletCulling & CULL_OCCLUSION) != 0;
+        const bool meshletCulling = g_config.meshShading || occlusionCulling;
+
+        if (meshletCulling)
+        {
+            ImGui::CheckboxFlags("Frustum culling", &g_config.meshletCulling, CULL_FRUSTUM);
+            ImGui::CheckboxFlags("Backface cone culling", &g_config.meshletCulling, CULL_CONE);
+        }
+
+        if (g_config.meshShading)
+        {
+            ImGui::CheckboxFlags("Triangle culling", &g_config.meshletCulling, CULL_TRIANGLE);
+
+            // the other size is another pipeline, the builder compiles it in the background
+            static const char* workgroupSizes[] { "32", "64" };
+            int workgroupSize = (g_config.meshWorkgroupSize == 64) ? 1 : 0;
+            if (ImGui::Combo("Mesh workgroup", &workgroupSize, workgroupSizes, IM_ARRAYSIZE(workgroupSizes)))
+            {
+                g_config.meshWorkgroupSize = (workgroupSize == 1) ? 64 : 32;
+                if (!g_app.lods.empty())
+                    requestScenePipelines();
+            }
+        }
+
+        if (!g_app.lods.empty())
+        {
+            if (meshletCulling)
+            {
+                // counted MAX_FRAMES_IN_FLIGHT frames ago
+                const CullingStats& stats = g_app.cullingStats;
+                const uint32_t tested = stats.meshletsEmitted + stats.meshletsCulled + stats.meshletsOccluded;
+                ImGui::Text("%zu meshlets : %u emitted, %u culled (%.1f%%)", g_vk.meshlets[BUFFER_OBJECT_INDEX].size(), stats.meshletsEmitted, stats.meshletsCulled, (tested > 0) ? 100.0f * stats.meshletsCulled / tested : 0.0f);
+                if (occlusionCulling)
+                    ImGui::Text("%u meshlets occluded (%.1f%%)", stats.meshletsOccluded, (tested > 0) ? 100.0f * stats.meshletsOccluded / tested : 0.0f);
+
+                // of the triangles in emitted meshlets
+                const uint32_t trianglesTested = stats.trianglesEmitted + stats.trianglesCulled;
+                if (trianglesTested > 0)
+                    ImGui::Text("%u triangles : %u emitted, %u culled (%.1f%%)", trianglesTested, stats.trianglesEmitted, stats.trianglesCulled, 100.0f * stats.trianglesCulled / trianglesTested);
+            }
+            else
+                ImGui::Text("LOD %u : %u triangles", g_app.lodIndex, g_app.lods[g_app.lodIndex].indexCount / 3);
+        }
+
+        if (ImGui::Button("Defragment memory"))
+            g_app.defragmentMemory = true;
+
+        const ImGuiIO& io = ImGui::GetIO();
+        ImGui::Text("%.3f ms/frame (%.1f FPS)", 1000.0f / io.Framerate, io.Framerate);
+    }
+    ImGui::End();
+}
+
+// Planes of the clip volume Vulkan rasterizes, -w <= x, y <= w and 0 <= z <= w, in the space viewProj
+// transforms from. Normalized so a sphere is outside when dot(plane.xyz, center) + plane.w < -radius.
+static void getFrustumPlanes(const glm::mat4& viewProj, glm::vec4 planes[6])
+{
+    const glm::mat4 rows = glm::transpose(viewProj);
+
+    planes[0] = rows[3] + rows[0]; // left
+    planes[1] = rows[3] - rows[0]; // right
+    planes[2] = rows[3] + rows[1]; // top, y points down in Vulkan clip space
+    planes[3] = rows[3] - rows[1]; // bottom
+    planes[4] = rows[2];           // near
+    planes[5] = rows[3] - rows[2]; // far
+
+    for (uint32_t i = 0; i < 6; ++i)
+        planes[i] /= glm::length(glm::vec3(planes[i]));
+}
+
+// What every use of the scene mesh in a frame binds
+struct SceneBindings
+{
+    std::array<uint32_t, 3> dynamicOffsets; // in set and binding order : frame, light, material
+    VertexPushConst pushConst;
+};
+
+static void bindScene(VkCommandBuffer commandBuffer, VkPipelineBindPoint bindPoint, const SceneBindings& scene, uint32_t phase)
+{
+    const std::array<VkDescriptorSet, 3> sets {{
+        g_vk.descriptorSets[DESCRIPTOR_SET_FRAME],
+        g_vk.descriptorSets[DESCRIPTOR_SET_MATERIAL],
+        g_vk.descriptorSets[DESCRIPTOR_SET_GEOMETRY],
+    }};
+
+    vkCmdBindDescriptorSets(commandBuffer, bindPoint, g_vk.pipelineLayout, 0, sets.size(), sets.data(), scene.dynamicOffsets.size(), scene.dynamicOffsets.data());
+
+    VertexPushConst pushConst = scene.pushConst;
+    pushConst.phase = phase;
+    vkCmdPushConstants(commandBuffer, g_vk.pipelineLayout, getVertexPushConstStages(), 0, sizeof(VertexPushConst), &pushConst);
+}
+
+// Draws the scene mesh in the current render pass. With occlusion culling mesh.task culls the
+// meshlets of the phase itself, the vertex path draws what cullMeshlets kept for it.
+static void drawScene(VkCommandBuffer commandBuffer, const SceneBindings& scene, uint32_t phase, bool occlusionCulling)
+{
+    const uint32_t pipelineIndex = g_config.meshShading
+        ? (g_config.wireframe ? PIPELINE_SCENE_MESH_WIREFRAME : PIPELINE_SCENE_MESH)
+        : (g_config.wireframe ? PIPELINE_SCENE_WIREFRAME : PIPELINE_SCENE);
+
+    // only waits on the first frame using a pipeline the workers have not finished
+    const VkPipeline pipeline = g_app.pipelineBuilder->get(g_app.pipelines[pipelineIndex]);
+    vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline);
+
+    bindScene(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, scene, phase);
+
+    const uint32_t meshletCount = scene.pushConst.meshletCount;
+
+    if (g_config.meshShading)
+    {
+        // MESHLETS_PER_TASK meshlets per task workgroup, in rows of at most maxTaskWorkGroupCountX
+        const uint32_t taskCount = (meshletCount + MESHLETS_PER_TASK - 1) / MESHLETS_PER_TASK;
+        const uint32_t taskCountX = std::min(taskCount, g_app.maxTaskWorkGroupCountX);
+        const uint32_t taskCountY = (taskCountX > 0) ? (taskCount + taskCountX - 1) / taskCountX : 0;
+        assert(taskCountX * taskCountY <= g_app.maxTaskWorkGroupTotalCount);
+
+        if (taskCount > 0)
+            g_app.cmdDrawMeshTasksEXT(commandBuffer, taskCountX, taskCountY, 1);
+    }
+    else
+    {
+        if (g_app.vertexFormat.separatePositions)
+        {
+            const std::array<VkBuffer, 2> vertexBuffers { g_vk.buffers[BUFFER_OBJECT_POSITION].buffer, g_vk.buffers[BUFFER_OBJECT_VERTEX].buffer };
+            static const std::array<VkDeviceSize, 2> pOffsets { 0, 0 };
+            vkCmdBindVertexBuffers(commandBuffer, 0, 2, vertexBuffers.data(), pOffsets.data());
+        }
+        else
+        {
+            static const VkDeviceSize pOffsets = 0;
+            vkCmdBindVertexBuffers(commandBuffer, 0, 1, &g_vk.buffers[BUFFER_OBJECT_VERTEX].buffer, &pOffsets);
+        }
+
+        if (occlusionCulling)
+        {
+            // one draw per kept meshlet of the full mesh, level of detail does not apply
+            const VkBuffer drawBuffer = g_vk.buffers[BUFFER_MESHLET_DRAWS].buffer;
+            const VkDeviceSize drawOffset = MESHLET_DRAW_COUNTS_SIZE + static_cast<VkDeviceSize>(phase) * meshletCount * sizeof(VkDrawIndexedIndirectCommand);
+            vkCmdBindIndexBuffer(commandBuffer, g_vk.buffers[BUFFER_OBJECT_MESHLET_INDEX].buffer, 0, VK_INDEX_TYPE_UINT32);
+            g_app.cmdDrawIndexedIndirectCountKHR(commandBuffer, drawBuffer, drawOffset, drawBuffer, phase * sizeof(uint32_t), meshletCount, sizeof(VkDrawIndexedIndirectCommand));
+        }
+        else
+        {
+            vkCmdBindIndexBuffer(commandBuffer, g_vk.buffers[BUFFER_OBJECT_INDEX].buffer, 0, VK_INDEX_TYPE_UINT32);
+            const MeshLod& lod = g_app.lods[g_app.lodIndex];
+            vkCmdDrawIndexed(commandBuffer, lod.indexCount, 1, lod.indexOffset, 0, 0);
+        }
+    }
+}
+
+// Zeroes the draw counts of both phases, and the meshlet visibility of a new scene mesh, once the
+// last frame is done culling and drawing with them
+static void beginOcclusionCulling(VkCommandBuffer commandBuffer)
+{
+    const VkMemoryBarrier startBarrier {
+        .sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER,
+        .srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT,
+        .dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT,
+    };
+    vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT | g_app.taskPipelineStage | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0x0, 1, &startBarrier, 0, nullptr, 0, nullptr);
+
+    vkCmdFillBuffer(commandBuffer, g_vk.buffers[BUFFER_MESHLET_DRAWS].buffer, 0, MESHLET_DRAW_COUNTS_SIZE, 0);
+    if (g_app.meshletVisibilityReset)
+    {
+        vkCmdFillBuffer(commandBuffer, g_vk.buffers[BUFFER_MESHLET_VISIBILITY].buffer, 0, VK_WHOLE_SIZE, 0);
+        g_app.meshletVisibilityReset = false;
+    }
+
+    // the visibility the last frame's late phase wrote is read by this frame's early phase
+    const VkMemoryBarrier endBarrier {
+        .sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER,
+        .srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT | VK_ACCESS_SHADER_WRITE_BIT,
+        .dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT | VK_ACCESS_INDIRECT_COMMAND_READ_BIT,
+    };
+    vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT | g_app.taskPipelineStage | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT | g_app.taskPipelineStage | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0x0, 1, &endBarrier, 0, nullptr, 0, nullptr);
+}
+
+// meshletcull.comp for the vertex path, outside of render passes. The indirect draw of the phase reads its draws.
+static void cullMeshlets(VkCommandBuffer commandBuffer, const SceneBindings& scene, uint32_t phase)
+{
+    vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, g_app.pipelineBuilder->get(g_app.pipelines[PIPELINE_MESHLET_CULL]));
+    bindScene(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, scene, phase);
+
+    // MESHLETS_PER_TASK meshlets per workgroup, in rows of at most maxComputeWorkGroupCountX like the task workgroups
+    const uint32_t groupCount = (scene.pushConst.meshletCount + MESHLETS_PER_TASK - 1) / MESHLETS_PER_TASK;
+    const uint32_t groupCountX = std::min(groupCount, g_app.maxComputeWorkGroupCountX);
+    const uint32_t groupCountY = (groupCountX > 0) ? (groupCount + groupCountX - 1) / groupCountX : 0;
+
+    if (groupCount > 0)
+        vkCmdDispatch(commandBuffer, groupCountX, groupCountY, 1);
+
+    const VkMemoryBarrier drawBarrier {
+        .sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER,
+        .srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT,
+        .dstAccessMask = VK_ACCESS_INDIRECT_COMMAND_READ_BIT,
+    };
+    vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT, 0x0, 1, &drawBarrier, 0, nullptr, 0, nullptr);
+}
+
+// Moves the whole depth pyramid to the general layout, discarding its contents
+static void discardDepthPyramid(VkCommandBuffer commandBuffer, VkPipelineStageFlags srcStages, VkPipelineStageFlags dstStages, VkAccessFlags dstAccess)
+{
+    const VkImageMemoryBarrier barrier {
+        .sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER,
+        .srcAccessMask = 0,
+        .dstAccessMask = dstAccess,
+        .oldLayout = VK_IMAGE_LAYOUT_UNDEFINED,
+        .newLayout = VK_IMAGE_LAYOUT_GENERAL,
+        .srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+        .dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+        .image = g_vk.attachments[ATTACHMENT_DEPTH_PYRAMID].image,
+        .subresourceRange = {
+            .aspectMask = VK_IMAGE_ASPECT_COLOR_BIT,
+            .baseMipLevel = 0,
+            .levelCount = g_app.depthPyramidLevels,
+            .baseArrayLayer = 0,
+            .layerCount = 1 },
+    };
+    vkCmdPipelineBarrier(commandBuffer, srcStages, dstStages, 0x0, 0, nullptr, 0, nullptr, 1, &barrier);
+}
+
+// Reduces the depth of the early occlusion pass into the pyramid, level by level, for the late
+// phase. The pyramid is rebuilt from scratch every frame, its last contents are discarded.
+static void buildDepthPyramid(VkCommandBuffer commandBuffer)
+{
+    // the last frame's late phase is done reading the pyramid, and this frame's early phase the
+    // meshlet visibility the late phase writes
+    discardDepthPyramid(commandBuffer, g_app.taskPipelineStage | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_WRITE_BIT);
+
+    vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, g_app.pipelineBuilder->get(g_app.pipelines[PIPELINE_DEPTH_REDUCE]));
 
-    //     ImGui::End();
-    // }
+    VkExtent2D inputExtent = g_vk.swapchain.extent;
+    for (uint32_t level = 0; level < g_app.depthPyramidLevels; ++level)
+    {
+        const VkExtent2D outputExtent {
+            .width = std::max(g_app.depthPyramidExtent.width >> level, 1u),
+            .height = std::max(g_app.depthPyramidExtent.height >> level, 1u),
+        };
+
+        vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, g_vk.depthReducePipelineLayout, 0, 1, &g_vk.descriptorSets[DESCRIPTOR_SET_DEPTH_REDUCE + level], 0, nullptr);
+
+        const DepthReducePushConst pushConst {
+            .inputSize = glm::uvec2(inputExtent.width, inputExtent.height),
+            .outputSize = glm::uvec2(outputExtent.width, outputExtent.height),
+        };
+        vkCmdPushConstants(commandBuffer, g_vk.depthReducePipelineLayout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(DepthReducePushConst), &pushConst);
+
+        vkCmdDispatch(commandBuffer, (outputExtent.width + 7) / 8, (outputExtent.height + 7) / 8, 1);
+
+        // the next level reads this one, the late phase culling the whole pyramid
+        const bool lastLevel = (level + 1 == g_app.depthPyramidLevels);
+        const VkMemoryBarrier levelBarrier {
+            .sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER,
+            .srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT,
+            .dstAccessMask = VK_ACCESS_SHADER_READ_BIT,
+        };
+        const VkPipelineStageFlags dstStages = lastLevel ? (g_app.taskPipelineStage | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT) : VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT;
+        vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, dstStages, 0x0, 1, &levelBarrier, 0, nullptr, 0, nullptr);
+
+        inputExtent = outputExtent;
+    }
 }
 
 void draw()
 {
-    VK_CHECK(vkAcquireNextImageKHR(g_vk.device, g_vk.swapchain.swapchain, UINT64_MAX, VK_NULL_HANDLE, g_vk.fences[FENCE_IMAGE_ACQUIRE], &g_vk.currentSwapchainImageIdx));
-    VK_CHECK(vkWaitForFences(g_vk.device, 1, &g_vk.fences[FENCE_IMAGE_ACQUIRE], VK_TRUE, UINT64_MAX));
-    VK_CHECK(vkResetFences(g_vk.device, 1, &g_vk.fences[FENCE_IMAGE_ACQUIRE]));
+    const uint32_t frameIndex = g_app.frameIndex;
+    const VkFence frameFence = g_vk.fences[FENCE_FRAME + frameIndex];
+    const VkSemaphore imageAcquiredSemaphore = g_vk.semaphores[SEMAPHORE_IMAGE_ACQUIRED + frameIndex];
+    const VkSemaphore renderFinishedSemaphore = g_vk.semaphores[SEMAPHORE_RENDER_FINISHED + frameIndex];
+
+    // the only CPU wait : the submission MAX_FRAMES_IN_FLIGHT frames ago, which used the same
+    // command pool, semaphores and uniform region
+    VK_CHECK(vkWaitForFences(g_vk.device, 1, &frameFence, VK_TRUE, UINT64_MAX));
+    VK_CHECK(vkResetFences(g_vk.device, 1, &frameFence));
+
+    // that submission is done counting into the slot, this one starts over
+    CullingStats* cullingStats = static_cast<CullingStats*>(g_vk.buffers[BUFFER_CULLING_STATS].mappedData) + frameIndex;
+    g_app.cullingStats = *cullingStats;
+    *cullingStats = {};
+
+    VK_CHECK(vkAcquireNextImageKHR(g_vk.device, g_vk.swapchain.swapchain, UINT64_MAX, imageAcquiredSemaphore, VK_NULL_HANDLE, &g_vk.currentSwapchainImageIdx));
 
     static const VkCommandBufferBeginInfo commandBufferBeginInfo{
         .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO,
@@ -785,7 +1722,8 @@ void draw()
         }
     }};
 
-    const VkRenderPassBeginInfo renderPassBeginInfo{
+    // the occlusion culling passes are compatible with renderPass, and ignore the clear values of what they load
+    VkRenderPassBeginInfo renderPassBeginInfo{
         .sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO,
         .renderPass = g_vk.renderPass,
         .framebuffer = g_vk.framebuffers[g_vk.currentSwapchainImageIdx],
@@ -796,58 +1734,150 @@ void draw()
         .pClearValues = clearValues.data(),
     };
 
-    vkResetCommandPool(g_vk.device, g_vk.commandPools[COMMAND_POOL_DEFAULT], 0x0);
+    vkResetCommandPool(g_vk.device, g_vk.commandPools[COMMAND_POOL_FRAME + frameIndex], 0x0);
 
-    VkCommandBuffer commandBuffer = g_vk.commandBuffers[COMMAND_BUFFER_DEFAULT];
+    beginUniformFrame(g_app.uniformRing, frameIndex);
+
+    PerFrameUBO perFrameUBO {
+        .viewMatrix = g_camera.matrix,
+        .projMatrix = g_app.projMatrix,
+        .viewPos = glm::vec4(g_camera.pos, 1.0f),
+        .viewportSize = glm::vec2(g_vk.swapchain.extent.width, g_vk.swapchain.extent.height),
+    };
+    getFrustumPlanes(g_app.projMatrix * g_camera.matrix, perFrameUBO.frustumPlanes);
+
+    const LightUBO lightUBO {
+        .position = glm::vec4(g_config.dirLightPosition, 0.0f),
+        .intensity = glm::vec4(g_config.dirLightIntensity, 0.0f),
+    };
+
+    const PerMatUBO perMatUBO {
+        .albedo = glm::vec4(g_config.materialAlbedo, 0.0f),
+        .roughness = glm::vec4(g_config.materialRoughness, 0.0f, 0.0f, 0.0f),
+    };
+
+    const uint32_t perFrameOffset = pushUniforms(g_app.uniformRing, &perFrameUBO, sizeof(perFrameUBO));
+    const uint32_t lightOffset = pushUniforms(g_app.uniformRing, &lightUBO, sizeof(lightUBO));
+    const uint32_t materialOffset = pushUniforms(g_app.uniformRing, &perMatUBO, sizeof(perMatUBO));
+
+    VkCommandBuffer commandBuffer = g_vk.commandBuffers[COMMAND_BUFFER_FRAME + frameIndex];
 
     VK_CHECK(vkBeginCommandBuffer(commandBuffer, &commandBufferBeginInfo));
 
-    vkCmdBeginRenderPass(commandBuffer, &renderPassBeginInfo, VK_SUBPASS_CONTENTS_INLINE);
+    // the geometry set binds the pyramid in the general layout, occlusion culling or not
+    if (g_app.depthPyramidUndefined)
+    {
+        discardDepthPyramid(commandBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, g_app.taskPipelineStage | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0x0);
+        g_app.depthPyramidUndefined = false;
+    }
 
-    vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, g_vk.pipeline);
+    // only the gui until the streamer delivers the scene mesh
+    const bool sceneReady = !g_app.lods.empty();
+    const bool occlusionCulling = sceneReady && isOcclusionCullingAvailable() && (g_config.meshletCulling & CULL_OCCLUSION) != 0;
+
+    // meshlets of the full mesh, level of detail only applies to the vertex path without occlusion culling
+    const uint32_t meshletCount = static_cast<uint32_t>(g_vk.meshlets[BUFFER_OBJECT_INDEX].size());
+
+    const bool quantizedPositions = (g_app.vertexFormat.position == VertexInputAttribute_T::ePositionUnorm16);
+    const PositionQuantization& quantization = g_app.positionQuantization;
+    const SceneBindings scene {
+        .dynamicOffsets = { perFrameOffset, lightOffset, materialOffset },
+        .pushConst = {
+            .positionOffset = quantizedPositions ? glm::vec4(quantization.offset[0], quantization.offset[1], quantization.offset[2], 0.0f) : glm::vec4(0.0f),
+            .positionScale = quantizedPositions ? glm::vec4(quantization.scale[0], quantization.scale[1], quantization.scale[2], 0.0f) : glm::vec4(1.0f),
+            .meshletCount = meshletCount,
+            .cullFlags = g_config.meshletCulling,
+            .statsSlot = frameIndex,
+            .phase = PHASE_EARLY,
+        },
+    };
 
-    const std::array<VkDescriptorSet, 2> sets {{
-        g_vk.descriptorSets[DESCRIPTOR_SET_FRAME],
-        g_vk.descriptorSets[DESCRIPTOR_SET_MATERIAL],
-    }};
+    if (occlusionCulling)
+    {
+        // early phase : what was visible in the last frame, its depth then builds the pyramid
+        beginOcclusionCulling(commandBuffer);
+        if (!g_config.meshShading)
+            cullMeshlets(commandBuffer, scene, PHASE_EARLY);
+
+        renderPassBeginInfo.renderPass = g_vk.occlusionRenderPasses[OCCLUSION_PASS_EARLY];
+        vkCmdBeginRenderPass(commandBuffer, &renderPassBeginInfo, VK_SUBPASS_CONTENTS_INLINE);
+        drawScene(commandBuffer, scene, PHASE_EARLY, true);
+        vkCmdEndRenderPass(commandBuffer);
 
-    vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, g_vk.pipelineLayout, 0, sets.size(), sets.data(), 0, nullptr);
-    // vkCmdPushConstants(commandBuffer, g_vk_app.pipeline_layout[PIPELINE_DEFAULT], VK_SHADER_STAGE_FRAGMENT_BIT, 0, 4, &g_app.tex_idx);
+        buildDepthPyramid(commandBuffer);
 
-    static const VkDeviceSize pOffsets = 0;
-    vkCmdBindVertexBuffers(commandBuffer, 0, 1, &g_vk.buffers[BUFFER_OBJECT_VERTEX].buffer, &pOffsets);
-    vkCmdBindIndexBuffer(commandBuffer, g_vk.buffers[BUFFER_OBJECT_INDEX].buffer, 0, VK_INDEX_TYPE_UINT32);
-    vkCmdDrawIndexed(commandBuffer, g_app.indexCount[BUFFER_OBJECT_INDEX], 1, 0, 0, 0);
+        // late phase : what the pyramid does not hide and the early phase did not draw
+        if (!g_config.meshShading)
+            cullMeshlets(commandBuffer, scene, PHASE_LATE);
 
+        renderPassBeginInfo.renderPass = g_vk.occlusionRenderPasses[OCCLUSION_PASS_LATE];
+        vkCmdBeginRenderPass(commandBuffer, &renderPassBeginInfo, VK_SUBPASS_CONTENTS_INLINE);
+        drawScene(commandBuffer, scene, PHASE_LATE, true);
+    }
+    else
+    {
+        vkCmdBeginRenderPass(commandBuffer, &renderPassBeginInfo, VK_SUBPASS_CONTENTS_INLINE);
+        if (sceneReady)
+            drawScene(commandBuffer, scene, PHASE_EARLY, false);
+    }
+
+    // recorded by gui() before draw
     if (g_app.displayGui)
     {
-        gui();
+        ImGui_ImplVulkan_RenderDrawData(ImGui::GetDrawData(), commandBuffer);
     }
 
     vkCmdEndRenderPass(commandBuffer);
 
+    // the culling stats are read on the host once the frame fence is signaled
+    if (g_config.meshShading || occlusionCulling)
+    {
+        const VkMemoryBarrier statsBarrier {
+            .sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER,
+            .srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT,
+            .dstAccessMask = VK_ACCESS_HOST_READ_BIT,
+        };
+        vkCmdPipelineBarrier(commandBuffer, g_app.taskPipelineStage | g_app.meshPipelineStage | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_HOST_BIT, 0x0, 1, &statsBarrier, 0, nullptr, 0, nullptr);
+    }
+
     VK_CHECK(vkEndCommandBuffer(commandBuffer));
 
+    // the swapchain image is written from the color attachment output stage, the first frame drawing
+    // a streamed mesh also waits for its copies on the transfer queue, read by vertex input, the
+    // culling compute shader or the task and mesh shaders
+    const bool waitForStream = (g_app.streamWaitValue != 0);
+
+    const std::array<VkSemaphore, 2> waitSemaphores { imageAcquiredSemaphore, g_app.meshStreamer->getSemaphore() };
+    const std::array<VkPipelineStageFlags, 2> waitStages { VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT, VK_PIPELINE_STAGE_VERTEX_INPUT_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT | g_app.taskPipelineStage | g_app.meshPipelineStage };
+    const std::array<uint64_t, 2> waitValues { 0, g_app.streamWaitValue }; // binary semaphores ignore their value
+    const uint32_t waitSemaphoreCount = waitForStream ? 2u : 1u;
+
+    const VkTimelineSemaphoreSubmitInfo timelineSubmitInfo{
+        .sType = VK_STRUCTURE_TYPE_TIMELINE_SEMAPHORE_SUBMIT_INFO,
+        .waitSemaphoreValueCount = waitSemaphoreCount,
+        .pWaitSemaphoreValues = waitValues.data(),
+    };
+
     const VkSubmitInfo submitInfo{
         .sType = VK_STRUCTURE_TYPE_SUBMIT_INFO,
-        .waitSemaphoreCount = 0,
-        .pWaitSemaphores = nullptr,
-        .pWaitDstStageMask = nullptr,
+        .pNext = waitForStream ? &timelineSubmitInfo : nullptr,
+        .waitSemaphoreCount = waitSemaphoreCount,
+        .pWaitSemaphores = waitSemaphores.data(),
+        .pWaitDstStageMask = waitStages.data(),
         .commandBufferCount = 1,
-        .pCommandBuffers = &g_vk.commandBuffers[COMMAND_BUFFER_DEFAULT],
-        .signalSemaphoreCount = 0,
-        .pSignalSemaphores = nullptr,
+        .pCommandBuffers = &commandBuffer,
+        .signalSemaphoreCount = 1,
+        .pSignalSemaphores = &renderFinishedSemaphore,
     };
 
-    VK_CHECK(vkQueueSubmit(g_vk.queues[QUEUE_GRAPHICS], 1, &submitInfo, VK_NULL_HANDLE));
-
-    VK_CHECK(vkQueueWaitIdle(g_vk.queues[QUEUE_GRAPHICS]));
+    VK_CHECK(vkQueueSubmit(g_vk.queues[QUEUE_GRAPHICS], 1, &submitInfo, frameFence));
+    g_app.streamWaitValue = 0;
 
     // Present (wait for graphics work to complete)
     const VkPresentInfoKHR presentInfo{
         .sType = VK_STRUCTURE_TYPE_PRESENT_INFO_KHR,
-        .waitSemaphoreCount = 0,
-        .pWaitSemaphores = nullptr,
+        .waitSemaphoreCount = 1,
+        .pWaitSemaphores = &renderFinishedSemaphore,
         .swapchainCount = 1,
         .pSwapchains = &g_vk.swapchain.swapchain,
         .pImageIndices = &g_vk.currentSwapchainImageIdx,
@@ -856,11 +1886,37 @@ void draw()
 
     VK_CHECK(vkQueuePresentKHR(g_vk.queues[QUEUE_GRAPHICS], &presentInfo));
 
-    VK_CHECK(vkQueueWaitIdle(g_vk.queues[QUEUE_GRAPHICS]));
+    g_app.frameIndex = (g_app.frameIndex + 1) % MAX_FRAMES_IN_FLIGHT;
 }
 
-int main()
+int main(int argc, char** argv)
 {
+    for (int i = 1; i < argc; ++i)
+    {
+        if (strcmp(argv[i], "--mesh-shading") == 0)
+        {
+            g_config.meshShading = true;
+        }
+        else if (strcmp(argv[i], "--device") == 0 && i + 1 < argc)
+        {
+            g_config.physicalDeviceIndex = static_cast<uint32_t>(atoi(argv[++i]));
+        }
+        else if (strcmp(argv[i], "--mesh-workgroup") == 0 && i + 1 < argc)
+        {
+            const uint32_t size = static_cast<uint32_t>(atoi(argv[++i]));
+            if (size == 32 || size == 64)
+                g_config.meshWorkgroupSize = size;
+            else
+            {
+                LOG("Mesh workgroups are 32 or 64 threads, ignoring --mesh-workgroup %u\n", size);
+            }
+        }
+        else
+        {
+            LOG("Unknown argument %s, usage : %s [--mesh-shading] [--device N] [--mesh-workgroup 32|64]\n", argv[i], argv[0]);
+        }
+    }
+
     glfwInit();
     glfwWindowHint(GLFW_CLIENT_API, GLFW_NO_API);
     glfwWindowHint(GLFW_RESIZABLE, GLFW_FALSE);
@@ -872,10 +1928,12 @@ int main()
         EXIT("=> Failure <=\n");
     }
     glfwMakeContextCurrent(g_app.window);
-    // glfwSetKeyCallback(g_app.window, key_callback);
+    glfwSetKeyCallback(g_app.window, keyCallback);
     glfwSetCursorPosCallback(g_app.window, cursorPositionCallback);
     glfwSetMouseButtonCallback(g_app.window, mouseButtonCallback);
 
+    const auto startupBegin = std::chrono::steady_clock::now();
+
     LOG("-- Begin -- Init\n");
     init();
     LOG("-- End -- Init\n");
@@ -899,7 +1957,7 @@ int main()
     init_info.Device = g_vk.device;
     init_info.QueueFamily = g_vk.queueFamilyIndices[QUEUE_GRAPHICS];
     init_info.Queue = g_vk.queues[QUEUE_GRAPHICS];
-    init_info.PipelineCache = VK_NULL_HANDLE;
+    init_info.PipelineCache = g_vk.pipelineCache;
     init_info.DescriptorPool = g_vk.descriptorPools[DESCRIPTOR_POOL_IMGUI];
     init_info.Subpass = 0;
     init_info.MinImageCount = 2;
@@ -914,7 +1972,7 @@ int main()
     // Upload Fonts
     {
         // Use any command queue
-        VkCommandBuffer command_buffer = g_vk.commandBuffers[COMMAND_BUFFER_DEFAULT];
+        VkCommandBuffer command_buffer = g_vk.commandBuffers[COMMAND_BUFFER_FRAME];
 
         const VkCommandBufferBeginInfo command_buffer_begin_info{
             .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO,
@@ -937,10 +1995,14 @@ int main()
 
         ImGui_ImplVulkan_DestroyFontUploadObjects();
 
-        vkResetCommandPool(g_vk.device, g_vk.commandPools[COMMAND_POOL_DEFAULT], 0x0);
+        vkResetCommandPool(g_vk.device, g_vk.commandPools[COMMAND_POOL_FRAME], 0x0);
     }
 
+    const double startupMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - startupBegin).count();
+    LOG("Startup took %.1f ms (%s pipeline cache)\n", startupMs, g_app.pipelineCacheWarm ? "warm" : "cold");
+
     LOG("-- Begin -- Run\n");
+    LOG("Geometry path : %s\n", g_config.meshShading ? "mesh shader" : "vertex shader");
 
     const glm::vec3 starting_pos{20, 20, 0};
 
@@ -953,6 +2015,15 @@ int main()
 
         update();
 
+        if (g_app.displayGui)
+        {
+            ImGui_ImplVulkan_NewFrame();
+            ImGui_ImplGlfw_NewFrame();
+            ImGui::NewFrame();
+            gui();
+            ImGui::Render();
+        }
+
         draw();
 
         glfwSwapBuffers(g_app.window);
@@ -962,10 +2033,16 @@ int main()
 
     LOG("-- End -- Run\n");
 
+    g_app.meshStreamer.reset();
+    logDeviceMemoryStats();
+
     ImGui_ImplVulkan_Shutdown();
     ImGui_ImplGlfw_Shutdown();
     ImGui::DestroyContext();
 
+    g_app.pipelineBuilder.reset();
+    savePipelineCache(g_vk.device, g_vk.pipelineCache, PIPELINE_CACHE_PATH);
+
     vkmDestroy(g_vk);
 
     glfwDestroyWindow(g_app.window);
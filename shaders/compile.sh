@@ -1,4 +1,8 @@
 ${VULKAN_SDK}/bin/glslc default.vert -o spirv/default-vert.spv
 ${VULKAN_SDK}/bin/glslc default.frag -o spirv/default-frag.spv
-${VULKAN_SDK}/bin/glslc mesh.mesh -o spirv/mesh-mesh.spv
-${VULKAN_SDK}/bin/glslc mesh.frag -o spirv/mesh-frag.spv
\ No newline at end of file
+# GL_EXT_mesh_shader needs SPIR-V 1.4, which Vulkan 1.2 has
+${VULKAN_SDK}/bin/glslc --target-env=vulkan1.2 mesh.task -o spirv/mesh-task.spv
+${VULKAN_SDK}/bin/glslc --target-env=vulkan1.2 mesh.mesh -o spirv/mesh-mesh.spv
+${VULKAN_SDK}/bin/glslc mesh.frag -o spirv/mesh-frag.spv
+${VULKAN_SDK}/bin/glslc depthreduce.comp -o spirv/depthreduce-comp.spv
+${VULKAN_SDK}/bin/glslc meshletcull.comp -o spirv/meshletcull-comp.spv
@@ -0,0 +1,214 @@
+/*
+Meshlet culling shared by mesh.task and meshletcull.comp, included after the extensions.
+
+Workgroups test MESHLETS_PER_TASK meshlets, one per invocation, so the visibility bits of a
+workgroup are one word of MeshletVisibilityBuffer. cullMeshlet has barriers, every invocation
+of the workgroup calls it.
+
+Occlusion culling draws each frame in two phases. The early phase draws the meshlets that were
+visible in the last frame, the depth pyramid is then built from its depth. The late phase tests
+every meshlet against the pyramid, stores the result as the new visibility bits and draws the
+visible meshlets the early phase did not.
+*/
+
+#define MESHLETS_PER_TASK 32
+
+#define CULL_FRUSTUM   1u
+#define CULL_CONE      2u
+#define CULL_OCCLUSION 8u
+
+#define PHASE_EARLY 0u
+#define PHASE_LATE  1u
+
+struct MeshletBounds
+{
+    vec4 sphere;   // xyz center, w radius
+    vec4 aabbMin;
+    vec4 aabbMax;
+    vec4 coneApex;
+    vec4 coneAxis; // xyz axis, w cutoff
+};
+
+// CullingStats of main.cpp, one per frame in flight
+struct CullingStats
+{
+    uint meshletsEmitted;
+    uint meshletsCulled;
+    uint trianglesEmitted; // counted by mesh.mesh
+    uint trianglesCulled;
+    uint meshletsOccluded;
+};
+
+layout(set=0, binding=0) uniform PerFrameUBO
+{
+    mat4 viewMatrix;
+    mat4 projMatrix;
+    vec3 viewPos;
+    vec4 frustumPlanes[6]; // world space, normalized, pointing inwards
+} FrameUBO;
+
+layout(set=2, binding=3) readonly buffer MeshletBoundsBuffer
+{
+    MeshletBounds bounds[];
+};
+
+layout(set=2, binding=4) buffer CullingStatsBuffer
+{
+    CullingStats stats[];
+};
+
+layout(set=2, binding=5) buffer MeshletVisibilityBuffer
+{
+    uint visibility[];
+};
+
+// max depth of the early phase, level 0 is the depth attachment scaled down to a power of two
+layout(set=2, binding=7) uniform sampler2D depthPyramid;
+
+layout(push_constant) uniform PushConsts
+{
+    vec4 positionOffset;
+    vec4 positionScale;
+    uint meshletCount;
+    uint cullFlags;  // CULL_*
+    uint statsSlot;  // frame in flight
+    uint phase;      // PHASE_*, with CULL_OCCLUSION
+} push_consts;
+
+shared uint visibleBits;
+shared uint emittedCount;
+shared uint culledCount;
+shared uint occludedCount;
+
+bool isOutsideFrustum(vec4 sphere)
+{
+    for (uint i = 0; i < 6; ++i)
+    {
+        if (dot(FrameUBO.frustumPlanes[i].xyz, sphere.xyz) + FrameUBO.frustumPlanes[i].w < -sphere.w)
+            return true;
+    }
+    return false;
+}
+
+bool isBackfacing(MeshletBounds meshletBounds)
+{
+    // orthographic projections look along the view axis from everywhere
+    const bool orthographic = FrameUBO.projMatrix[3][3] == 1.0f;
+    const vec3 forward = -vec3(FrameUBO.viewMatrix[0][2], FrameUBO.viewMatrix[1][2], FrameUBO.viewMatrix[2][2]);
+    const vec3 viewDir = orthographic ? forward : normalize(meshletBounds.coneApex.xyz - FrameUBO.viewPos);
+
+    // strict, a cutoff of 1 marks cones too wide to ever cull
+    return dot(viewDir, meshletBounds.coneAxis.xyz) > meshletBounds.coneAxis.w;
+}
+
+// The nearest depth of the box against the farthest depth of the pyramid texels under it, read
+// from the level where the box covers at most 2x2 texels
+bool isOccluded(MeshletBounds meshletBounds)
+{
+    const mat4 viewProj = FrameUBO.projMatrix * FrameUBO.viewMatrix;
+
+    vec3 boundsMin = vec3(1e30f);
+    vec3 boundsMax = vec3(-1e30f);
+    for (uint i = 0; i < 8; ++i)
+    {
+        const vec3 corner = mix(meshletBounds.aabbMin.xyz, meshletBounds.aabbMax.xyz, vec3(i & 1u, (i >> 1) & 1u, (i >> 2) & 1u));
+        const vec4 clip = viewProj * vec4(corner, 1.0f);
+
+        // boxes reaching behind the eye project without bounds, they are kept
+        if (clip.w <= 0.0f)
+            return false;
+
+        boundsMin = min(boundsMin, clip.xyz / clip.w);
+        boundsMax = max(boundsMax, clip.xyz / clip.w);
+    }
+
+    const vec2 uvMin = clamp(boundsMin.xy * 0.5f + 0.5f, 0.0f, 1.0f);
+    const vec2 uvMax = clamp(boundsMax.xy * 0.5f + 0.5f, 0.0f, 1.0f);
+
+    const vec2 texels = (uvMax - uvMin) * vec2(textureSize(depthPyramid, 0));
+    const int level = min(int(ceil(log2(max(max(texels.x, texels.y), 1.0f)))), textureQueryLevels(depthPyramid) - 1);
+
+    const ivec2 levelSize = textureSize(depthPyramid, level);
+    const ivec2 texelMin = min(ivec2(uvMin * vec2(levelSize)), levelSize - 1);
+    const ivec2 texelMax = min(ivec2(uvMax * vec2(levelSize)), levelSize - 1);
+
+    float maxDepth = 0.0f;
+    for (int y = texelMin.y; y <= texelMax.y; ++y)
+    {
+        for (int x = texelMin.x; x <= texelMax.x; ++x)
+            maxDepth = max(maxDepth, texelFetch(depthPyramid, ivec2(x, y), level).r);
+    }
+
+    return boundsMin.z > maxDepth;
+}
+
+// Whether the meshlet of this invocation is drawn in this phase. Counts into the stats, and in
+// the late phase stores the visibility bits of the workgroup.
+bool cullMeshlet(uint taskIndex)
+{
+    const uint meshletIndex = taskIndex * MESHLETS_PER_TASK + gl_LocalInvocationIndex;
+    const uint meshletBit = 1u << gl_LocalInvocationIndex;
+    const bool occlusion = (push_consts.cullFlags & CULL_OCCLUSION) != 0;
+
+    if (gl_LocalInvocationIndex == 0)
+    {
+        visibleBits = 0;
+        emittedCount = 0;
+        culledCount = 0;
+        occludedCount = 0;
+    }
+
+    barrier();
+
+    bool drawn = false;
+    if (meshletIndex < push_consts.meshletCount)
+    {
+        const MeshletBounds meshletBounds = bounds[meshletIndex];
+
+        const bool culled = (((push_consts.cullFlags & CULL_FRUSTUM) != 0) && isOutsideFrustum(meshletBounds.sphere))
+                         || (((push_consts.cullFlags & CULL_CONE) != 0) && isBackfacing(meshletBounds));
+
+        // meshlets drawn in the early phase are counted there, and only there
+        const bool drawnEarly = occlusion && !culled && (visibility[taskIndex] & meshletBit) != 0;
+
+        if (!occlusion)
+        {
+            drawn = !culled;
+        }
+        else if (push_consts.phase == PHASE_EARLY)
+        {
+            drawn = drawnEarly;
+        }
+        else
+        {
+            const bool occluded = !culled && isOccluded(meshletBounds);
+            if (!culled && !occluded)
+                atomicOr(visibleBits, meshletBit);
+
+            drawn = !culled && !occluded && !drawnEarly;
+            if (occluded && !drawnEarly)
+                atomicAdd(occludedCount, 1);
+        }
+
+        if (drawn)
+            atomicAdd(emittedCount, 1);
+        else if (culled && !(occlusion && push_consts.phase == PHASE_EARLY))
+            atomicAdd(culledCount, 1);
+    }
+
+    barrier();
+
+    if (gl_LocalInvocationIndex == 0)
+    {
+        // the last row of a two dimensional grid may run past the meshlets
+        const bool inRange = taskIndex * MESHLETS_PER_TASK < push_consts.meshletCount;
+        if (occlusion && push_consts.phase == PHASE_LATE && inRange)
+            visibility[taskIndex] = visibleBits;
+
+        atomicAdd(stats[push_consts.statsSlot].meshletsEmitted, emittedCount);
+        atomicAdd(stats[push_consts.statsSlot].meshletsCulled, culledCount);
+        atomicAdd(stats[push_consts.statsSlot].meshletsOccluded, occludedCount);
+    }
+
+    return drawn;
+}
@@ -1,7 +1,10 @@
 #version 450
 
-layout(location=0) in vec3 a_pos;
-layout(location=1) in vec2 a_uv;
+// 0 : a_norm is a float normal, 1 : a_norm.xy is an octahedral snorm normal
+layout(constant_id=0) const uint NORMAL_ENCODING = 0;
+
+layout(location=0) in vec3 a_pos;  // float, or unorm16 quantized against the mesh bounds
+layout(location=1) in vec2 a_uv;   // float or half, both arrive as float
 layout(location=2) in vec3 a_norm;
 
 layout(set=0, binding=0) uniform PerFrameUBO
@@ -25,11 +28,11 @@ layout(location=2) out vec3 out_viewPos;
 //     PerObjData obj_data[];
 // } draw_ssbo;
 
-// layout(push_constant) uniform PushConsts
-// {
-//     int draw_idx;
-//     int tex_idx;
-// } push_consts;
+layout(push_constant) uniform PushConsts
+{
+    vec4 positionOffset;
+    vec4 positionScale;
+} push_consts;
 
 // struct Vertex
 // {
@@ -43,15 +46,26 @@ layout(location=2) out vec3 out_viewPos;
 //     Vertex vertices[];
 // };
 
+vec3 decodeOctahedral(vec2 e)
+{
+    vec3 n = vec3(e, 1.0f - abs(e.x) - abs(e.y));
+    float t = max(-n.z, 0.0f);
+    n.xy += mix(vec2(t), vec2(-t), greaterThanEqual(n.xy, vec2(0.0f)));
+    return normalize(n);
+}
+
 void main()
 {
     // Vertex vertexInfo = vertices[gl_VertexIndex];
     // gl_Position = vec4(vertexInfo.vx, vertexInfo.vy, vertexInfo.vz, 1.0f); 
     // out_norm = vec3(vertexInfo.nx, vertexInfo.ny, vertexInfo.nz);
 
-    gl_Position = FrameUBO.projMatrix * FrameUBO.viewMatrix * vec4(a_pos, 1.0f);
+    vec3 pos = push_consts.positionOffset.xyz + a_pos * push_consts.positionScale.xyz;
+    vec3 norm = (NORMAL_ENCODING == 1) ? decodeOctahedral(a_norm.xy) : a_norm;
+
+    gl_Position = FrameUBO.projMatrix * FrameUBO.viewMatrix * vec4(pos, 1.0f);
 
-    out_worldPos = a_pos;
-    out_normal   = a_norm;
+    out_worldPos = pos;
+    out_normal   = norm;
     out_viewPos  = FrameUBO.viewPos;
 }
\ No newline at end of file
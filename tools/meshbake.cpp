@@ -0,0 +1,192 @@
+/*
+ * Bakes an OBJ file into the .mesh format loadMeshFile reads, doing all preprocessing offline
+ * so the runtime only pays for I/O.
+ *
+ *  meshbake <input.obj> <output.mesh> [--max-vertices N] [--max-triangles N] [--threads N]
+ *           [--position float|unorm16] [--uv float|half] [--normal float|oct16|oct8]
+ *           [--vertex-cache none|tipsify|forsyth]   (default tipsify)
+ *           [--separate-positions] [--overdraw]
+ *           [--lods N] [--lod-error F]   (default 8 levels, 1 for none, F relative to the bounds diagonal)
+ *           [--hierarchy]                (coarser meshlet levels for per cluster level of detail, stored
+ *                                         only, the renderer does not draw them yet)
+ */
+
+#include <chrono>
+#include <string>
+#include <string.h>
+#include <stdlib.h>
+
+#include "Defines.hpp"
+#include "Loader.hpp"
+#include "Meshlet.hpp"
+#include "MeshletBounds.hpp"
+#include "VertexCache.hpp"
+#include "Overdraw.hpp"
+#include "Lod.hpp"
+
+static void printUsage()
+{
+    LOG("usage : meshbake <input.obj> <output.mesh> [--max-vertices N] [--max-triangles N] [--threads N]\n"
+        "                 [--position float|unorm16] [--uv float|half] [--normal float|oct16|oct8]\n"
+        "                 [--vertex-cache none|tipsify|forsyth] [--separate-positions] [--overdraw]\n"
+        "                 [--lods N] [--lod-error F] [--hierarchy]\n");
+}
+
+static bool parseVertexCacheOptimizer(const char* name, VertexCacheOptimizer_T* optimizer)
+{
+    static const struct { const char* name; VertexCacheOptimizer_T optimizer; } optimizers[] {
+        { "none"   , VertexCacheOptimizer_T::eNone },
+        { "tipsify", VertexCacheOptimizer_T::eTipsify },
+        { "forsyth", VertexCacheOptimizer_T::eForsyth },
+    };
+
+    for (const auto& entry : optimizers)
+    {
+        if (strcmp(entry.name, name) == 0)
+        {
+            *optimizer = entry.optimizer;
+            return true;
+        }
+    }
+
+    return false;
+}
+
+static bool parseAttributeEncoding(const char* name, VertexInputAttribute_T* attrib)
+{
+    static const struct { const char* name; VertexInputAttribute_T attrib; } encodings[] {
+        { "float"  , VertexInputAttribute_T::ePosition },
+        { "unorm16", VertexInputAttribute_T::ePositionUnorm16 },
+        { "float"  , VertexInputAttribute_T::eUv },
+        { "half"   , VertexInputAttribute_T::eUvHalf },
+        { "float"  , VertexInputAttribute_T::eNormal },
+        { "oct16"  , VertexInputAttribute_T::eNormalOctSnorm16 },
+        { "oct8"   , VertexInputAttribute_T::eNormalOctSnorm8 },
+    };
+
+    // only accept encodings of the attribute being parsed
+    const uint32_t location = getVertexAttributeLocation(*attrib);
+    for (const auto& encoding : encodings)
+    {
+        if (getVertexAttributeLocation(encoding.attrib) == location && strcmp(encoding.name, name) == 0)
+        {
+            *attrib = encoding.attrib;
+            return true;
+        }
+    }
+
+    return false;
+}
+
+int main(int argc, char** argv)
+{
+    if (argc < 3)
+    {
+        printUsage();
+        return EXIT_FAILURE;
+    }
+
+    const std::string inputPath = argv[1];
+    const std::string outputPath = argv[2];
+
+    ObjLoadParams loadParams { .threadCount = 0 };
+    MeshletBuildParams meshletParams {};
+    VertexFormat vertexFormat {};
+    VertexCacheOptimizer_T vertexCacheOptimizer = VertexCacheOptimizer_T::eTipsify;
+    bool overdraw = false;
+    LodBuildParams lodParams {};
+    bool hierarchy = false;
+
+    for (int i = 3; i < argc; ++i)
+    {
+        if (i + 1 < argc && strcmp(argv[i], "--max-vertices") == 0)
+            meshletParams.maxVertices = static_cast<uint32_t>(atoi(argv[++i]));
+        else if (i + 1 < argc && strcmp(argv[i], "--max-triangles") == 0)
+            meshletParams.maxTriangles = static_cast<uint32_t>(atoi(argv[++i]));
+        else if (i + 1 < argc && strcmp(argv[i], "--threads") == 0)
+            loadParams.threadCount = static_cast<uint32_t>(atoi(argv[++i]));
+        else if (i + 1 < argc && strcmp(argv[i], "--position") == 0 && parseAttributeEncoding(argv[i + 1], &vertexFormat.position))
+            ++i;
+        else if (i + 1 < argc && strcmp(argv[i], "--uv") == 0 && parseAttributeEncoding(argv[i + 1], &vertexFormat.uv))
+            ++i;
+        else if (i + 1 < argc && strcmp(argv[i], "--normal") == 0 && parseAttributeEncoding(argv[i + 1], &vertexFormat.normal))
+            ++i;
+        else if (i + 1 < argc && strcmp(argv[i], "--vertex-cache") == 0 && parseVertexCacheOptimizer(argv[i + 1], &vertexCacheOptimizer))
+            ++i;
+        else if (strcmp(argv[i], "--separate-positions") == 0)
+            vertexFormat.separatePositions = true;
+        else if (strcmp(argv[i], "--overdraw") == 0)
+            overdraw = true;
+        else if (i + 1 < argc && strcmp(argv[i], "--lods") == 0)
+            lodParams.maxLodCount = static_cast<uint32_t>(atoi(argv[++i]));
+        else if (i + 1 < argc && strcmp(argv[i], "--lod-error") == 0)
+            lodParams.maxError = static_cast<float>(atof(argv[++i]));
+        else if (strcmp(argv[i], "--hierarchy") == 0)
+            hierarchy = true;
+        else
+        {
+            printUsage();
+            return EXIT_FAILURE;
+        }
+    }
+
+    if (meshletParams.maxVertices < 3 || meshletParams.maxVertices > MESHLET_MAX_VERTICES ||
+        meshletParams.maxTriangles < 1 || meshletParams.maxTriangles > MESHLET_MAX_TRIANGLES)
+    {
+        EXIT("Meshlet limits must be within 3.." << MESHLET_MAX_VERTICES << " vertices and 1.." << MESHLET_MAX_TRIANGLES << " triangles");
+    }
+
+    if (lodParams.maxLodCount < 1 || lodParams.maxLodCount > LOD_MAX_COUNT || lodParams.maxError < 0.0f)
+    {
+        EXIT("LOD count must be within 1.." << LOD_MAX_COUNT << " and the LOD error positive");
+    }
+
+    const auto start = std::chrono::steady_clock::now();
+
+    // OBJ parsing also deduplicates vertices
+    ObjectBufferData objectData = loadObjFile(inputPath, loadParams);
+    LOG("Loaded %s : %zu vertices, %zu triangles\n", inputPath.c_str(), objectData.vertices.size(), objectData.indices.size() / 3);
+
+    std::vector<Meshlet> meshlets = buildMeshlets(objectData, meshletParams);
+
+    // triangle order inside each meshlet is free, the vertex path draws the same index buffer
+    optimizeVertexCache(meshlets, vertexCacheOptimizer);
+
+    // whole meshlets outwards facing first, the order inside them stays the vertex cache one
+    if (overdraw)
+        optimizeOverdraw(meshlets, objectData.vertices.data(), objectData.vertices.size());
+
+    // triangles in meshlet order, vertices in first use order, unused vertices dropped
+    reorderByMeshlets(objectData, meshlets);
+
+    MeshBufferData meshData = toMeshBufferData(objectData, vertexFormat);
+
+    // built on the final meshlets, its coarser meshlets index the same vertices
+    if (hierarchy)
+    {
+        meshData.meshletHierarchy = buildMeshletHierarchy(meshlets, objectData.vertices.data(), objectData.vertices.size(), { .meshletParams = meshletParams });
+        if (meshData.meshletHierarchy.meshlets.empty())
+            meshData.meshletHierarchy = {};
+        else
+            optimizeVertexCache(meshData.meshletHierarchy.meshlets, vertexCacheOptimizer);
+    }
+
+    // from the unquantized positions, quantization moves vertices by less than the culling tolerances
+    meshData.meshletBounds = computeMeshletBounds(meshlets, objectData.vertices.data(), objectData.vertices.size());
+    meshData.meshlets = std::move(meshlets);
+
+    // coarser levels go after the full mesh in the same index buffer, meshlets only cover the full mesh
+    if (lodParams.maxLodCount > 1)
+    {
+        meshData.lods = buildLodChain(meshData.indices, objectData.vertices.data(), objectData.vertices.size(), lodParams);
+        if (meshData.lods.size() == 1)
+            meshData.lods.clear();
+    }
+
+    writeMeshFile(outputPath, meshData);
+
+    const double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    LOG("Wrote %s : %u vertices (%u + %u bytes each), %u triangles, %zu + %zu meshlets, %zu levels of detail in %.2f ms\n", outputPath.c_str(), meshData.vertexCount, getPositionStride(vertexFormat), getVertexStride(vertexFormat), getMeshLods(meshData)[0].indexCount / 3, meshData.meshlets.size(), meshData.meshletHierarchy.meshlets.size(), std::max<size_t>(meshData.lods.size(), 1), ms);
+
+    return EXIT_SUCCESS;
+}
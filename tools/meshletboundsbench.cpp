@@ -0,0 +1,125 @@
+/*
+ * Measures the meshlet bounds kernels in meshlets per second.
+ *
+ *  meshletboundsbench [--meshlets N] [--runs N] [file.obj ...]
+ *
+ * Without files it runs on the cube, sphere and monkey in ../objects. The meshlets of each mesh are
+ * tiled into N meshlets (default 1M) over as many translated copies of the vertices, so the
+ * working set is that of a large mesh. Each kernel keeps its best of the runs, and its results
+ * are compared against the scalar kernel.
+ */
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <string>
+#include <vector>
+#include <string.h>
+#include <stdlib.h>
+
+#include "Defines.hpp"
+#include "Loader.hpp"
+#include "Meshlet.hpp"
+#include "MeshletBounds.hpp"
+
+static float getMaxDifference(const std::vector<MeshletBounds>& a, const std::vector<MeshletBounds>& b)
+{
+    const float* fa = &a[0].sphere.x;
+    const float* fb = &b[0].sphere.x;
+    const size_t count = a.size() * sizeof(MeshletBounds) / sizeof(float);
+
+    float maxDifference = 0.0f;
+    for (size_t i = 0; i < count; ++i)
+        maxDifference = std::max(maxDifference, std::abs(fa[i] - fb[i]));
+
+    return maxDifference;
+}
+
+static void bench(const std::string& path, size_t targetMeshletCount, uint32_t runCount)
+{
+    const ObjectBufferData objectData = loadObjFile(path, { .threadCount = 0 });
+    const std::vector<Meshlet> meshlets = buildMeshlets(objectData);
+
+    const size_t copyCount = (targetMeshletCount + meshlets.size() - 1) / meshlets.size();
+    const uint32_t vertexCount = static_cast<uint32_t>(objectData.vertices.size());
+
+    std::vector<Vertex> vertices;
+    vertices.reserve(objectData.vertices.size() * copyCount);
+    std::vector<Meshlet> tiled;
+    tiled.reserve(meshlets.size() * copyCount);
+
+    for (size_t copy = 0; copy < copyCount; ++copy)
+    {
+        for (Vertex vertex : objectData.vertices)
+        {
+            vertex.pos.x += 4.0f * copy;
+            vertices.push_back(vertex);
+        }
+
+        for (Meshlet meshlet : meshlets)
+        {
+            for (uint32_t i = 0; i < meshlet.vertexCount; ++i)
+                meshlet.vertices[i] += static_cast<uint32_t>(copy) * vertexCount;
+            tiled.push_back(meshlet);
+        }
+    }
+
+    LOG("\n%s : %zu meshlets tiled %zu times, %zu meshlets, %zu vertices\n", path.c_str(), meshlets.size(), copyCount, tiled.size(), vertices.size());
+    LOG("%-8s | %10s | %14s | %7s | %s\n", "kernel", "ms", "meshlets/s", "speedup", "max difference");
+
+    const std::vector<MeshletBounds> reference = computeMeshletBounds(tiled, vertices.data(), vertices.size(), MeshletBoundsKernel_T::eScalar);
+
+    double scalarMs = 0.0;
+    for (MeshletBoundsKernel_T kernel : { MeshletBoundsKernel_T::eScalar, MeshletBoundsKernel_T::eSse2, MeshletBoundsKernel_T::eAvx2 })
+    {
+        if (!isMeshletBoundsKernelSupported(kernel))
+        {
+            LOG("%-8s | not supported by this CPU\n", getMeshletBoundsKernelName(kernel));
+            continue;
+        }
+
+        std::vector<MeshletBounds> bounds;
+        double bestMs = 1e30;
+        for (uint32_t run = 0; run < runCount; ++run)
+        {
+            const auto start = std::chrono::steady_clock::now();
+            bounds = computeMeshletBounds(tiled, vertices.data(), vertices.size(), kernel);
+            bestMs = std::min(bestMs, std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count());
+        }
+
+        if (kernel == MeshletBoundsKernel_T::eScalar)
+            scalarMs = bestMs;
+
+        LOG("%-8s | %10.2f | %14.0f | %6.2fx | %g\n", getMeshletBoundsKernelName(kernel), bestMs, tiled.size() / (bestMs / 1000.0), scalarMs / bestMs, getMaxDifference(bounds, reference));
+    }
+}
+
+int main(int argc, char** argv)
+{
+    size_t targetMeshletCount = 1u << 20;
+    uint32_t runCount = 5;
+    std::vector<std::string> paths;
+
+    for (int i = 1; i < argc; ++i)
+    {
+        if (i + 1 < argc && strcmp(argv[i], "--meshlets") == 0)
+            targetMeshletCount = static_cast<size_t>(atoll(argv[++i]));
+        else if (i + 1 < argc && strcmp(argv[i], "--runs") == 0)
+            runCount = static_cast<uint32_t>(atoi(argv[++i]));
+        else
+            paths.push_back(argv[i]);
+    }
+
+    if (targetMeshletCount == 0 || runCount == 0)
+        EXIT("Meshlet and run counts must be positive");
+
+    if (paths.empty())
+        paths = { "../objects/cube.obj", "../objects/sphere.obj", "../objects/monkey.obj" };
+
+    LOG("Best kernel on this CPU : %s\n", getMeshletBoundsKernelName(getBestMeshletBoundsKernel()));
+
+    for (const std::string& path : paths)
+        bench(path, targetMeshletCount, runCount);
+
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,111 @@
+/*
+ * Compares the two ways of getting a .mesh file into (emulated) staging memory:
+ *
+ *  vectors : loadMeshFile into std::vectors, then memcpy into staging (the old init() path)
+ *  mapped  : map the file and memcpy each region straight into staging (the current init() path)
+ *
+ *  meshloadbench <file.mesh> [vectors|mapped]
+ *
+ * Peak RSS is per process, so without a mode the tool runs itself once per mode.
+ */
+
+#include <chrono>
+#include <string>
+#include <string.h>
+#include <stdlib.h>
+#include <sys/mman.h>
+#include <sys/resource.h>
+
+#include "Defines.hpp"
+#include "Loader.hpp"
+#include "MappedFile.hpp"
+
+static double peakRssMB()
+{
+    rusage usage {};
+    getrusage(RUSAGE_SELF, &usage);
+    return usage.ru_maxrss / 1024.0;
+}
+
+// Stands in for the persistently mapped staging buffer
+static char* allocateStaging(size_t size)
+{
+    void* staging = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (staging == MAP_FAILED)
+    {
+        EXIT("Failed to allocate " << size << " bytes of staging memory");
+    }
+    return static_cast<char*>(staging);
+}
+
+int main(int argc, char** argv)
+{
+    if (argc < 2)
+    {
+        LOG("usage : meshloadbench <file.mesh> [vectors|mapped]\n");
+        return EXIT_FAILURE;
+    }
+
+    const std::string filepath = argv[1];
+
+    if (argc < 3)
+    {
+        for (const char* mode : { "vectors", "mapped" })
+        {
+            const std::string command = std::string(argv[0]) + " \"" + filepath + "\" " + mode;
+            if (system(command.c_str()) != 0)
+                return EXIT_FAILURE;
+        }
+        return EXIT_SUCCESS;
+    }
+
+    const std::string mode = argv[2];
+    const double baseRss = peakRssMB();
+    const auto start = std::chrono::steady_clock::now();
+
+    size_t uploadSize = 0;
+    if (mode == "vectors")
+    {
+        const MeshBufferData meshData = loadMeshFile(filepath);
+
+        const size_t vertexSize = meshData.vertices.size();
+        const size_t indexSize = sizeof(uint32_t) * meshData.indices.size();
+        const size_t positionSize = meshData.positions.size();
+        uploadSize = vertexSize + indexSize + positionSize;
+
+        char* staging = allocateStaging(uploadSize);
+        memcpy(staging, meshData.vertices.data(), vertexSize);
+        memcpy(staging + vertexSize, meshData.indices.data(), indexSize);
+        if (positionSize > 0)
+            memcpy(staging + vertexSize + indexSize, meshData.positions.data(), positionSize);
+        munmap(staging, uploadSize);
+    }
+    else if (mode == "mapped")
+    {
+        const MappedFile file(filepath);
+        const MeshFileView view = viewMeshFile(file);
+
+        const size_t vertexSize = size_t(view.vertexCount) * view.vertexStride;
+        const size_t indexSize = sizeof(uint32_t) * view.indexCount;
+        const size_t positionSize = size_t(view.vertexCount) * getPositionStride(view.vertexFormat);
+        uploadSize = vertexSize + indexSize + positionSize;
+
+        char* staging = allocateStaging(uploadSize);
+        memcpy(staging, view.vertices, vertexSize);
+        memcpy(staging + vertexSize, view.indices, indexSize);
+        if (view.positions != nullptr)
+            memcpy(staging + vertexSize + indexSize, view.positions, positionSize);
+        munmap(staging, uploadSize);
+    }
+    else
+    {
+        EXIT("Unknown mode " << mode);
+    }
+
+    const double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+    LOG("%-8s %8.2f MB uploaded in %8.2f ms | peak RSS %8.2f MB (+%.2f MB over startup)\n",
+        mode.c_str(), uploadSize / (1024.0 * 1024.0), ms, peakRssMB(), peakRssMB() - baseRss);
+
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,284 @@
+/*
+ * Benchmarks loadObjFile against the original istringstream based parser, and the parallel
+ * loadObjFile mode against the serial one.
+ *
+ *  objbench [file.obj ...]
+ *
+ * Without arguments it runs on the bundled ../objects/*.obj files plus generated grids of
+ * increasing size, written next to the binary, and checks the parallel mode on a grid with
+ * degenerate faces.
+ */
+
+#include <chrono>
+#include <fstream>
+#include <sstream>
+#include <unordered_map>
+#include <array>
+#include <vector>
+#include <string>
+#include <stdio.h>
+#include <string.h>
+
+#include "Defines.hpp"
+#include "Loader.hpp"
+
+// The parser loadObjFile replaced, kept as the baseline
+static ObjectBufferData loadObjFileIstream(const std::string& filepath)
+{
+    std::ifstream file (filepath, std::ifstream::in);
+    assert(file.is_open());
+
+    std::vector<glm::vec3> positions;
+    std::vector<glm::vec2> texCoords;
+    std::vector<glm::vec3> normals;
+
+    ObjectBufferData objectData;
+    std::unordered_map<std::string, uint32_t> indexLookup;
+    uint32_t nextIdx = 0;
+
+    std::string line;
+    while (std::getline(file, line))
+    {
+        std::string header;
+        std::istringstream iss(line);
+        iss >> header;
+
+        if (header == "v")
+        {
+            glm::vec3 pos;
+            iss >> pos[0] >> pos[1] >> pos[2];
+            positions.push_back(pos);
+        }
+        else if (header == "vt")
+        {
+            glm::vec2 uv;
+            iss >> uv[0] >> uv[1];
+            texCoords.push_back(uv);
+        }
+        else if (header == "vn")
+        {
+            glm::vec3 norm;
+            iss >> norm[0] >> norm[1] >> norm[2];
+            normals.push_back(norm);
+        }
+        else if (header == "f")
+        {
+            std::array<std::string, 3> faces;
+            iss >> faces[0] >> faces[1] >> faces[2];
+
+            for (uint8_t i = 0; i < faces.size(); i++)
+            {
+                auto iter = indexLookup.find(faces[i]);
+                if (iter != indexLookup.end())
+                {
+                    objectData.indices.push_back(iter->second);
+                }
+                else
+                {
+                    std::istringstream issFace(faces[i]);
+
+                    std::string strPosIdx, strUvIdx, strNormalIdx;
+                    std::getline(issFace, strPosIdx, '/');
+                    std::getline(issFace, strUvIdx, '/');
+                    std::getline(issFace, strNormalIdx, '/');
+
+                    objectData.vertices.emplace_back(positions[std::stoi(strPosIdx)-1], texCoords[std::stoi(strUvIdx)-1], normals[std::stoi(strNormalIdx)-1]);
+
+                    indexLookup.emplace(faces[i], nextIdx);
+                    objectData.indices.push_back(nextIdx++);
+                }
+            }
+        }
+    }
+
+    return objectData;
+}
+
+// Writes a (gridSize x gridSize) quad grid with a wavy surface, split into v/vt/vn triangles
+static void writeGridObj(const std::string& filepath, uint32_t gridSize)
+{
+    FILE* f = fopen(filepath.c_str(), "w");
+    if (f == nullptr)
+    {
+        EXIT("Failed to create " << filepath);
+    }
+
+    const uint32_t rowLength = gridSize + 1;
+    for (uint32_t y = 0; y <= gridSize; ++y)
+    {
+        for (uint32_t x = 0; x <= gridSize; ++x)
+        {
+            const float u = float(x) / gridSize;
+            const float v = float(y) / gridSize;
+            fprintf(f, "v %.6f %.6f %.6f\n", u * 2.0f - 1.0f, 0.1f * sinf(u * 20.0f) * cosf(v * 20.0f), v * 2.0f - 1.0f);
+            fprintf(f, "vt %.6f %.6f\n", u, v);
+            fprintf(f, "vn %.6f %.6f %.6f\n", 0.0f, 1.0f, 0.0f);
+        }
+    }
+
+    for (uint32_t y = 0; y < gridSize; ++y)
+    {
+        for (uint32_t x = 0; x < gridSize; ++x)
+        {
+            const uint32_t a = y * rowLength + x + 1;
+            const uint32_t b = a + 1;
+            const uint32_t c = a + rowLength;
+            const uint32_t d = c + 1;
+            fprintf(f, "f %u/%u/%u %u/%u/%u %u/%u/%u\n", a, a, a, c, c, c, b, b, b);
+            fprintf(f, "f %u/%u/%u %u/%u/%u %u/%u/%u\n", b, b, b, c, c, c, d, d, d);
+        }
+    }
+
+    fclose(f);
+}
+
+// Writes a (gridSize x gridSize) grid of quads, with faces of one and two corners in between. Some
+// of those corners use vertices of the quads, the others vertices no triangle uses.
+static void writeDegenerateFacesObj(const std::string& filepath, uint32_t gridSize)
+{
+    FILE* f = fopen(filepath.c_str(), "w");
+    if (f == nullptr)
+    {
+        EXIT("Failed to create " << filepath);
+    }
+
+    const uint32_t rowLength = gridSize + 1;
+    for (uint32_t y = 0; y <= gridSize; ++y)
+    {
+        for (uint32_t x = 0; x <= gridSize; ++x)
+        {
+            const float u = float(x) / gridSize;
+            const float v = float(y) / gridSize;
+            fprintf(f, "v %.6f %.6f %.6f\n", u * 2.0f - 1.0f, 0.0f, v * 2.0f - 1.0f);
+            fprintf(f, "vt %.6f %.6f\n", u, v);
+            fprintf(f, "vn %.6f %.6f %.6f\n", 0.0f, 1.0f, 0.0f);
+        }
+    }
+
+    for (uint32_t y = 0; y < gridSize; ++y)
+    {
+        // relative indices reach the vertex of this row only
+        fprintf(f, "v %.6f %.6f %.6f\nvt 0.5 0.5\nvn 0.0 -1.0 0.0\n", 0.0f, -1.0f, float(y) / gridSize);
+        fprintf(f, "f -1/-1/-1\n");
+
+        for (uint32_t x = 0; x < gridSize; ++x)
+        {
+            const uint32_t a = y * rowLength + x + 1;
+            const uint32_t b = a + 1;
+            const uint32_t c = a + rowLength;
+            const uint32_t d = c + 1;
+            if (x % 7 == 0)
+                fprintf(f, "f %u/%u/%u -1/-1/-1\n", d, d, d);
+            if (x % 11 == 0)
+                fprintf(f, "f %u/%u/%u\n", b, b, b);
+
+            fprintf(f, "f %u/%u/%u %u/%u/%u %u/%u/%u %u/%u/%u\n", a, a, a, c, c, c, d, d, d, b, b, b);
+        }
+    }
+
+    fclose(f);
+}
+
+static size_t fileSize(const std::string& filepath)
+{
+    std::ifstream file(filepath, std::ifstream::binary | std::ifstream::ate);
+    return file.is_open() ? static_cast<size_t>(file.tellg()) : 0;
+}
+
+static bool sameObjectData(const ObjectBufferData& a, const ObjectBufferData& b)
+{
+    return a.indices == b.indices &&
+           a.vertices.size() == b.vertices.size() &&
+           memcmp(a.vertices.data(), b.vertices.data(), sizeof(Vertex) * a.vertices.size()) == 0;
+}
+
+template<typename Fn>
+static double bestOfMs(uint32_t runs, Fn&& fn)
+{
+    double best = 1e30;
+    for (uint32_t i = 0; i < runs; ++i)
+    {
+        const auto start = std::chrono::steady_clock::now();
+        fn();
+        best = std::min(best, std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count());
+    }
+    return best;
+}
+
+static void benchFile(const std::string& filepath)
+{
+    const double mb = fileSize(filepath) / (1024.0 * 1024.0);
+    const uint32_t runs = (mb < 8.0) ? 10 : 3;
+
+    ObjectBufferData baseline, current;
+    const double baselineMs = bestOfMs(runs, [&]() { baseline = loadObjFileIstream(filepath); });
+    const double currentMs  = bestOfMs(runs, [&]() { current  = loadObjFile(filepath); });
+
+    LOG("%-28s %8.2f MB %8zu tris | istream %9.2f ms %8.1f MB/s | loadObjFile %9.2f ms %8.1f MB/s | x%5.1f %s\n",
+        filepath.c_str(), mb, current.indices.size() / 3,
+        baselineMs, mb / (baselineMs / 1000.0),
+        currentMs, mb / (currentMs / 1000.0),
+        baselineMs / currentMs,
+        sameObjectData(baseline, current) ? "match" : "MISMATCH");
+
+    // parallel mode only kicks in for files of at least a MB
+    if (mb < 1.0)
+        return;
+
+    for (const uint32_t threadCount : { 2u, 4u, 8u, 16u })
+    {
+        ObjectBufferData parallel;
+        const double parallelMs = bestOfMs(runs, [&]() { parallel = loadObjFile(filepath, { .threadCount = threadCount }); });
+
+        LOG("%-28s %2u threads %9.2f ms %8.1f MB/s | x%5.2f vs 1 thread %s\n",
+            "", threadCount, parallelMs, mb / (parallelMs / 1000.0),
+            currentMs / parallelMs,
+            sameObjectData(current, parallel) ? "identical" : "MISMATCH");
+    }
+}
+
+// Only the serial and parallel modes, the istream baseline reads nothing but triangles
+static void compareParallelFile(const std::string& filepath)
+{
+    const ObjectBufferData serial = loadObjFile(filepath);
+
+    for (const uint32_t threadCount : { 2u, 4u, 8u, 16u })
+    {
+        const ObjectBufferData parallel = loadObjFile(filepath, { .threadCount = threadCount });
+
+        LOG("%-28s %8zu vertices %8zu tris | %2u threads %s\n",
+            filepath.c_str(), parallel.vertices.size(), parallel.indices.size() / 3, threadCount,
+            sameObjectData(serial, parallel) ? "identical" : "MISMATCH");
+    }
+}
+
+int main(int argc, char** argv)
+{
+    if (argc > 1)
+    {
+        for (int i = 1; i < argc; ++i)
+            benchFile(argv[i]);
+        return 0;
+    }
+
+    for (const char* name : { "cube", "sphere", "monkey" })
+        benchFile(std::string("../objects/") + name + ".obj");
+
+    for (const uint32_t gridSize : { 256u, 1024u })
+    {
+        const std::string filepath = "grid" + std::to_string(gridSize) + ".obj";
+        writeGridObj(filepath, gridSize);
+        benchFile(filepath);
+        remove(filepath.c_str());
+    }
+
+    // faces of fewer than 3 corners make no triangles, and no vertices in either mode
+    {
+        const std::string filepath = "degenerate512.obj";
+        writeDegenerateFacesObj(filepath, 512);
+        compareParallelFile(filepath);
+        remove(filepath.c_str());
+    }
+
+    return 0;
+}
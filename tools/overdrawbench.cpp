@@ -0,0 +1,92 @@
+/*
+ * Measures how optimizeOverdraw trades vertex cache efficiency for overdraw.
+ *
+ *  overdrawbench [--threshold F] [file.obj ...]
+ *
+ * Without files it runs on the bundled ../objects/*.obj files. Each mesh goes through tipsify
+ * first, then optimizeOverdraw at a few thresholds, F adding one more. Overdraw comes from the
+ * CPU estimator in Overdraw.hpp, with and without back face culling : the pipeline currently
+ * draws both sides, sorting assumes the back faces are culled. optimizeOverdraw logs its own
+ * timing, which leaves out the estimator runs.
+ */
+
+#include <string>
+#include <vector>
+#include <string.h>
+#include <stdlib.h>
+
+#include "Defines.hpp"
+#include "Loader.hpp"
+#include "Meshlet.hpp"
+#include "Overdraw.hpp"
+#include "VertexCache.hpp"
+
+static void report(const char* name, const std::vector<uint32_t>& indices, const ObjectBufferData& objectData)
+{
+    const Vertex* vertices = objectData.vertices.data();
+    const size_t vertexCount = objectData.vertices.size();
+
+    const VertexCacheStats cache = analyzeVertexCache(indices.data(), indices.size(), vertexCount, VERTEX_CACHE_DEFAULT_SIZE, VertexCacheModel_T::eFifo);
+    const OverdrawStats culled = analyzeOverdraw(indices.data(), indices.size(), vertices, vertexCount, true);
+    const OverdrawStats twoSided = analyzeOverdraw(indices.data(), indices.size(), vertices, vertexCount, false);
+
+    LOG("%-28s | %8.3f | %9.3f %9.3f\n", name, cache.acmr, culled.overdraw, twoSided.overdraw);
+}
+
+static void bench(const std::string& path, const std::vector<float>& thresholds)
+{
+    ObjectBufferData objectData = loadObjFile(path, { .threadCount = 0 });
+    LOG("\n%s : %zu vertices, %zu triangles\n", path.c_str(), objectData.vertices.size(), objectData.indices.size() / 3);
+    LOG("%-28s | %8s | %9s %9s\n", "order", "FIFO16", "overdraw", "2-sided");
+
+    report("input order", objectData.indices, objectData);
+
+    optimizeVertexCache(objectData, VertexCacheOptimizer_T::eTipsify);
+    report("tipsify", objectData.indices, objectData);
+
+    for (float threshold : thresholds)
+    {
+        std::vector<uint32_t> indices = objectData.indices;
+        optimizeOverdraw(indices.data(), indices.size(), objectData.vertices.data(), objectData.vertices.size(), threshold);
+
+        char name[64];
+        snprintf(name, sizeof(name), "tipsify + overdraw %.2f", threshold);
+        report(name, indices, objectData);
+    }
+
+    // what meshbake --overdraw does
+    std::vector<Meshlet> meshlets = buildMeshlets(objectData);
+    optimizeVertexCache(meshlets, VertexCacheOptimizer_T::eTipsify);
+    report("meshlets", getMeshletIndices(meshlets), objectData);
+
+    optimizeOverdraw(meshlets, objectData.vertices.data(), objectData.vertices.size());
+    report("meshlets + overdraw", getMeshletIndices(meshlets), objectData);
+}
+
+int main(int argc, char** argv)
+{
+    std::vector<float> thresholds { 1.0f, OVERDRAW_DEFAULT_THRESHOLD, 1.25f, 1.5f, 2.0f };
+    std::vector<std::string> paths;
+
+    for (int i = 1; i < argc; ++i)
+    {
+        if (i + 1 < argc && strcmp(argv[i], "--threshold") == 0)
+            thresholds.push_back(static_cast<float>(atof(argv[++i])));
+        else
+            paths.push_back(argv[i]);
+    }
+
+    for (float threshold : thresholds)
+    {
+        if (threshold < 1.0f)
+            EXIT("Overdraw threshold must be at least 1, got " << threshold);
+    }
+
+    if (paths.empty())
+        paths = { "../objects/cube.obj", "../objects/sphere.obj", "../objects/monkey.obj" };
+
+    for (const std::string& path : paths)
+        bench(path, thresholds);
+
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,175 @@
+/*
+ * Benchmarks the vertex cache optimizers and estimates what they save on the GPU.
+ *
+ *  vertexcachebench [file.obj ...]
+ *
+ * Without arguments it runs on the bundled ../objects/*.obj files. Every mesh is also run with
+ * its triangles shuffled, the order a careless exporter could produce. The GPU estimate assumes
+ * one vertex shader invocation per simulated cache miss (FIFO, 16 entries).
+ *
+ * A second table simulates the memory side of vertex fetch before and after optimizeVertexFetch,
+ * for interleaved float vertices and for a float position only stream as a depth pass reads it.
+ */
+
+#include <chrono>
+#include <random>
+#include <vector>
+#include <string>
+#include <stdio.h>
+
+#include "Defines.hpp"
+#include "Loader.hpp"
+#include "Meshlet.hpp"
+#include "VertexCache.hpp"
+
+struct BenchResult
+{
+    const char* name;
+    double ms;
+    size_t triangleCount;
+    VertexCacheStats fifo16;
+    VertexCacheStats fifo32;
+    VertexCacheStats lru16;
+    VertexCacheStats lru32;
+};
+
+static BenchResult analyze(const char* name, double ms, const std::vector<uint32_t>& indices, size_t vertexCount)
+{
+    BenchResult result { name, ms, indices.size() / 3 };
+    result.fifo16 = analyzeVertexCache(indices.data(), indices.size(), vertexCount, 16, VertexCacheModel_T::eFifo);
+    result.fifo32 = analyzeVertexCache(indices.data(), indices.size(), vertexCount, 32, VertexCacheModel_T::eFifo);
+    result.lru16 = analyzeVertexCache(indices.data(), indices.size(), vertexCount, 16, VertexCacheModel_T::eLru);
+    result.lru32 = analyzeVertexCache(indices.data(), indices.size(), vertexCount, 32, VertexCacheModel_T::eLru);
+    return result;
+}
+
+static void benchFetch(const ObjectBufferData& input)
+{
+    constexpr uint32_t positionStride = sizeof(float) * 3;
+
+    struct Row
+    {
+        const char* name;
+        ObjectBufferData data;
+    };
+
+    std::vector<Row> rows;
+    rows.push_back({ "input order", input });
+
+    rows.push_back({ "tipsify", input });
+    optimizeVertexCache(rows.back().data, VertexCacheOptimizer_T::eTipsify);
+
+    rows.push_back({ "tipsify + fetch order", rows.back().data });
+    optimizeVertexFetch(rows.back().data);
+
+    // what meshbake does
+    rows.push_back({ "meshlets + fetch order", input });
+    std::vector<Meshlet> meshlets = buildMeshlets(rows.back().data);
+    optimizeVertexCache(meshlets, VertexCacheOptimizer_T::eTipsify);
+    reorderByMeshlets(rows.back().data, meshlets);
+
+    LOG("\n%-24s | %10s %10s %10s | %10s %10s\n", "vertex fetch", "miss rate", "overfetch", "KB read", "pos miss", "pos KB");
+
+    for (const Row& row : rows)
+    {
+        const std::vector<uint32_t>& indices = row.data.indices;
+        const size_t vertexCount = row.data.vertices.size();
+
+        const VertexFetchStats interleaved = analyzeVertexFetch(indices.data(), indices.size(), vertexCount, sizeof(Vertex));
+        const VertexFetchStats positions = analyzeVertexFetch(indices.data(), indices.size(), vertexCount, positionStride);
+
+        LOG("%-24s | %10.3f %10.2f %10.1f | %10.3f %10.1f\n",
+            row.name, interleaved.missRate, interleaved.overfetch, interleaved.bytesRead / 1024.0, positions.missRate, positions.bytesRead / 1024.0);
+    }
+}
+
+static void bench(const std::string& label, const ObjectBufferData& objectData)
+{
+    const size_t vertexCount = objectData.vertices.size();
+    std::vector<BenchResult> results;
+
+    results.push_back(analyze("input order", 0.0, objectData.indices, vertexCount));
+
+    const struct { const char* name; VertexCacheOptimizer_T optimizer; } optimizers[] {
+        { "tipsify", VertexCacheOptimizer_T::eTipsify },
+        { "forsyth", VertexCacheOptimizer_T::eForsyth },
+    };
+
+    for (const auto& entry : optimizers)
+    {
+        std::vector<uint32_t> indices = objectData.indices;
+
+        const auto start = std::chrono::steady_clock::now();
+        optimizeVertexCache(indices.data(), indices.size(), vertexCount, entry.optimizer);
+        const double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+        results.push_back(analyze(entry.name, ms, indices, vertexCount));
+    }
+
+    // what meshbake does : optimize inside every meshlet
+    const std::vector<Meshlet> meshlets = buildMeshlets(objectData);
+    for (const auto& entry : optimizers)
+    {
+        std::vector<Meshlet> optimized = meshlets;
+
+        const auto start = std::chrono::steady_clock::now();
+        optimizeVertexCache(optimized, entry.optimizer);
+        const double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+        std::vector<uint32_t> indices;
+        for (const Meshlet& meshlet : optimized)
+        {
+            for (uint32_t i = 0; i < meshlet.triangleCount * 3u; ++i)
+                indices.push_back(meshlet.vertices[meshlet.indices[i]]);
+        }
+
+        results.push_back(analyze((entry.optimizer == VertexCacheOptimizer_T::eTipsify) ? "tipsify per meshlet" : "forsyth per meshlet", ms, indices, vertexCount));
+    }
+
+    LOG("\n%s : %zu vertices, %zu triangles\n", label.c_str(), vertexCount, objectData.indices.size() / 3);
+    LOG("%-20s %9s %9s | %8s %8s %8s %8s | %8s | %12s %8s\n",
+        "order", "ms", "Mtri/s", "FIFO16", "FIFO32", "LRU16", "LRU32", "ATVR16", "VS invocs", "saved");
+
+    const double baseInvocations = results[0].fifo16.acmr * results[0].triangleCount;
+    for (const BenchResult& r : results)
+    {
+        const double invocations = r.fifo16.acmr * r.triangleCount;
+        LOG("%-20s %9.2f %9.2f | %8.3f %8.3f %8.3f %8.3f | %8.3f | %12.0f %7.1f%%\n",
+            r.name, r.ms, (r.ms > 0.0) ? (r.triangleCount / 1000.0) / r.ms : 0.0,
+            r.fifo16.acmr, r.fifo32.acmr, r.lru16.acmr, r.lru32.acmr, r.fifo16.atvr,
+            invocations, (baseInvocations > 0.0) ? 100.0 * (1.0 - invocations / baseInvocations) : 0.0);
+    }
+
+    benchFetch(objectData);
+}
+
+int main(int argc, char** argv)
+{
+    std::vector<std::string> paths;
+    for (int i = 1; i < argc; ++i)
+        paths.push_back(argv[i]);
+
+    if (paths.empty())
+        paths = { "../objects/cube.obj", "../objects/sphere.obj", "../objects/monkey.obj" };
+
+    std::mt19937 rng(1234);
+
+    for (const std::string& path : paths)
+    {
+        ObjectBufferData objectData = loadObjFile(path, { .threadCount = 0 });
+        bench(path, objectData);
+
+        // shuffle whole triangles, keeping their winding
+        const size_t triangleCount = objectData.indices.size() / 3;
+        for (size_t t = triangleCount; t > 1; --t)
+        {
+            const size_t other = std::uniform_int_distribution<size_t>(0, t - 1)(rng);
+            for (uint32_t k = 0; k < 3; ++k)
+                std::swap(objectData.indices[(t - 1) * 3 + k], objectData.indices[other * 3 + k]);
+        }
+
+        bench(path + " (shuffled)", objectData);
+    }
+
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,187 @@
+/*
+ * Reports bytes per vertex and encoding error of every vertex attribute encoding meshbake supports.
+ *
+ *  vertexformatreport <input.obj>
+ *
+ * Position error is in object space units and relative to the bounds diagonal, uv error in uv
+ * units and normal error as the angle in degrees between the input and the decoded normal.
+ * Per-meshlet position quantization is reported for comparison only: the runtime vertex layout
+ * shares vertices between meshlets, so .mesh files store per-mesh bounds.
+ */
+
+#include <math.h>
+#include <string>
+#include <vector>
+#include <algorithm>
+
+#include "Defines.hpp"
+#include "Loader.hpp"
+#include "Meshlet.hpp"
+#include "VertexFormat.hpp"
+
+struct ErrorStats
+{
+    double max = 0.0;
+    double sum = 0.0;
+    size_t count = 0;
+
+    void add(double error)
+    {
+        max = std::max(max, error);
+        sum += error;
+        count++;
+    }
+
+    double mean() const { return (count > 0) ? sum / count : 0.0; }
+};
+
+static double positionError(const Vertex& a, const Vertex& b)
+{
+    return glm::length(a.pos - b.pos);
+}
+
+static double uvError(const Vertex& a, const Vertex& b)
+{
+    return std::max(fabs(double(a.uv.x) - b.uv.x), fabs(double(a.uv.y) - b.uv.y));
+}
+
+static double normalError(const Vertex& a, const Vertex& b)
+{
+    const float lengthA = glm::length(a.normal);
+    const float lengthB = glm::length(b.normal);
+    if (lengthA == 0.0f || lengthB == 0.0f)
+        return 0.0;
+
+    // atan2 stays accurate for tiny angles, where acos of a dot product close to 1 does not
+    const glm::vec3 na = a.normal / lengthA;
+    const glm::vec3 nb = b.normal / lengthB;
+    return atan2(glm::length(glm::cross(na, nb)), glm::dot(na, nb)) * 180.0 / M_PI;
+}
+
+// Encodes all vertices with format, decodes them again and measures the error
+static ErrorStats measure(const std::vector<Vertex>& vertices, const VertexFormat& format, double (*error)(const Vertex&, const Vertex&))
+{
+    const PositionQuantization quantization = computePositionQuantization(vertices.data(), vertices.size());
+    const uint32_t stride = getVertexStride(format);
+
+    std::vector<uint8_t> encoded(vertices.size() * stride);
+    encodeVertices(vertices.data(), vertices.size(), format, quantization, encoded.data());
+
+    ErrorStats stats;
+    for (size_t i = 0; i < vertices.size(); ++i)
+    {
+        stats.add(error(vertices[i], decodeVertex(encoded.data() + i * stride, format, quantization)));
+    }
+
+    return stats;
+}
+
+// Quantizes every meshlet against its own bounds, vertices shared by several meshlets are encoded once per meshlet
+static ErrorStats measurePerMeshlet(const std::vector<Vertex>& vertices, const std::vector<Meshlet>& meshlets, size_t* encodedVertexCount)
+{
+    const VertexFormat format { .position = VertexInputAttribute_T::ePositionUnorm16 };
+    const uint32_t stride = getVertexStride(format);
+
+    ErrorStats stats;
+    std::vector<Vertex> meshletVertices;
+    std::vector<uint8_t> encoded;
+
+    *encodedVertexCount = 0;
+    for (const Meshlet& meshlet : meshlets)
+    {
+        meshletVertices.resize(meshlet.vertexCount);
+        for (uint32_t i = 0; i < meshlet.vertexCount; ++i)
+        {
+            meshletVertices[i] = vertices[meshlet.vertices[i]];
+        }
+
+        const PositionQuantization quantization = computePositionQuantization(meshletVertices.data(), meshletVertices.size());
+        encoded.resize(meshletVertices.size() * stride);
+        encodeVertices(meshletVertices.data(), meshletVertices.size(), format, quantization, encoded.data());
+
+        for (uint32_t i = 0; i < meshlet.vertexCount; ++i)
+        {
+            stats.add(positionError(meshletVertices[i], decodeVertex(encoded.data() + i * stride, format, quantization)));
+        }
+
+        *encodedVertexCount += meshlet.vertexCount;
+    }
+
+    return stats;
+}
+
+int main(int argc, char** argv)
+{
+    if (argc < 2)
+    {
+        LOG("usage : vertexformatreport <input.obj>\n");
+        return EXIT_FAILURE;
+    }
+
+    const ObjectBufferData objectData = loadObjFile(argv[1], { .threadCount = 0 });
+    const std::vector<Vertex>& vertices = objectData.vertices;
+    const std::vector<Meshlet> meshlets = buildMeshlets(objectData);
+
+    const PositionQuantization bounds = computePositionQuantization(vertices.data(), vertices.size());
+    const double diagonal = sqrt(double(bounds.scale[0]) * bounds.scale[0] + double(bounds.scale[1]) * bounds.scale[1] + double(bounds.scale[2]) * bounds.scale[2]);
+
+    LOG("%zu vertices, %zu meshlets, bounds diagonal %.4f\n\n", vertices.size(), meshlets.size(), diagonal);
+
+    LOG("%-9s %-17s %8s %14s %14s %12s\n", "attribute", "encoding", "bytes", "max error", "mean error", "max/diagonal");
+
+    struct Row
+    {
+        const char* attribute;
+        const char* encoding;
+        VertexFormat format;
+        VertexInputAttribute_T attrib;
+        double (*error)(const Vertex&, const Vertex&);
+    };
+
+    const Row rows[] {
+        { "position", "float32x3"      , { .position = VertexInputAttribute_T::ePosition }         , VertexInputAttribute_T::ePosition        , positionError },
+        { "position", "unorm16x4 mesh" , { .position = VertexInputAttribute_T::ePositionUnorm16 }  , VertexInputAttribute_T::ePositionUnorm16 , positionError },
+        { "uv"      , "float32x2"      , { .uv = VertexInputAttribute_T::eUv }                     , VertexInputAttribute_T::eUv              , uvError },
+        { "uv"      , "float16x2"      , { .uv = VertexInputAttribute_T::eUvHalf }                 , VertexInputAttribute_T::eUvHalf          , uvError },
+        { "normal"  , "float32x3"      , { .normal = VertexInputAttribute_T::eNormal }             , VertexInputAttribute_T::eNormal          , normalError },
+        { "normal"  , "oct snorm16x2"  , { .normal = VertexInputAttribute_T::eNormalOctSnorm16 }   , VertexInputAttribute_T::eNormalOctSnorm16, normalError },
+        { "normal"  , "oct snorm8x2"   , { .normal = VertexInputAttribute_T::eNormalOctSnorm8 }    , VertexInputAttribute_T::eNormalOctSnorm8 , normalError },
+    };
+
+    for (const Row& row : rows)
+    {
+        const ErrorStats stats = measure(vertices, row.format, row.error);
+        const bool isPosition = (getVertexAttributeLocation(row.attrib) == 0);
+
+        if (isPosition)
+        {
+            LOG("%-9s %-17s %8.2f %14.6g %14.6g %12.3g\n", row.attribute, row.encoding, double(getVertexAttributeSize(row.attrib)), stats.max, stats.mean(), stats.max / diagonal);
+        }
+        else
+        {
+            LOG("%-9s %-17s %8.2f %14.6g %14.6g %12s\n", row.attribute, row.encoding, double(getVertexAttributeSize(row.attrib)), stats.max, stats.mean(), "-");
+        }
+    }
+
+    // bytes include the duplicated shared vertices and 24 bytes of bounds per meshlet, spread over the mesh vertices
+    size_t encodedVertexCount = 0;
+    const ErrorStats meshletStats = measurePerMeshlet(vertices, meshlets, &encodedVertexCount);
+    const double meshletBytes = (8.0 * encodedVertexCount + sizeof(PositionQuantization) * meshlets.size()) / std::max<size_t>(vertices.size(), 1);
+    LOG("%-9s %-17s %8.2f %14.6g %14.6g %12.3g\n", "position", "unorm16x4 meshlet", meshletBytes, meshletStats.max, meshletStats.mean(), meshletStats.max / diagonal);
+
+    LOG("\n%-32s %8s\n", "vertex format", "stride");
+
+    const struct { const char* name; VertexFormat format; } presets[] {
+        { "float / float / float"      , {} },
+        { "float / half / oct16"       , { VertexInputAttribute_T::ePosition       , VertexInputAttribute_T::eUvHalf, VertexInputAttribute_T::eNormalOctSnorm16 } },
+        { "unorm16 / half / oct16"     , { VertexInputAttribute_T::ePositionUnorm16, VertexInputAttribute_T::eUvHalf, VertexInputAttribute_T::eNormalOctSnorm16 } },
+        { "unorm16 / half / oct8"      , { VertexInputAttribute_T::ePositionUnorm16, VertexInputAttribute_T::eUvHalf, VertexInputAttribute_T::eNormalOctSnorm8 } },
+    };
+
+    for (const auto& preset : presets)
+    {
+        LOG("%-32s %8u\n", preset.name, getVertexStride(preset.format));
+    }
+
+    return EXIT_SUCCESS;
+}
@@ -24,9 +24,19 @@ static void setPNext(void** pNext, void** prevStruct, void* nextStruct, Supporte
                 static_cast<VkPhysicalDeviceDescriptorIndexingFeatures*>(*prevStruct)->pNext = nextStruct;
                 break;
             }
-            case SupportedDeviceFeature::eMeshShadingNV:
+            case SupportedDeviceFeature::eMeshShading:
             {
-                static_cast<VkPhysicalDeviceMeshShaderFeaturesNV*>(*prevStruct)->pNext = nextStruct;
+                static_cast<VkPhysicalDeviceMeshShaderFeaturesEXT*>(*prevStruct)->pNext = nextStruct;
+                break;
+            }
+            case SupportedDeviceFeature::eTimelineSemaphore:
+            {
+                static_cast<VkPhysicalDeviceTimelineSemaphoreFeatures*>(*prevStruct)->pNext = nextStruct;
+                break;
+            }
+            case SupportedDeviceFeature::eFillModeNonSolid:
+            {
+                static_cast<VkPhysicalDeviceFeatures2*>(*prevStruct)->pNext = nextStruct;
                 break;
             }
         };
@@ -47,9 +57,19 @@ static void deleteFeatureStruct(void* featureStruct, SupportedDeviceFeature feat
             delete static_cast<VkPhysicalDeviceDescriptorIndexingFeatures*>(featureStruct);
             break;
         }
-        case SupportedDeviceFeature::eMeshShadingNV:
+        case SupportedDeviceFeature::eMeshShading:
         {
-            delete static_cast<VkPhysicalDeviceMeshShaderFeaturesNV*>(featureStruct);
+            delete static_cast<VkPhysicalDeviceMeshShaderFeaturesEXT*>(featureStruct);
+            break;
+        }
+        case SupportedDeviceFeature::eTimelineSemaphore:
+        {
+            delete static_cast<VkPhysicalDeviceTimelineSemaphoreFeatures*>(featureStruct);
+            break;
+        }
+        case SupportedDeviceFeature::eFillModeNonSolid:
+        {
+            delete static_cast<VkPhysicalDeviceFeatures2*>(featureStruct);
             break;
         }
     };
@@ -96,16 +116,42 @@ vkmDeviceFeatureManager::vkmDeviceFeatureManager(const std::vector<SupportedDevi
 
                 break;
             }
-            case SupportedDeviceFeature::eMeshShadingNV:
+            case SupportedDeviceFeature::eMeshShading:
             {
-                VkPhysicalDeviceMeshShaderFeaturesNV* featureStruct = new VkPhysicalDeviceMeshShaderFeaturesNV();
-                featureStruct->sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MESH_SHADER_FEATURES_NV;
+                VkPhysicalDeviceMeshShaderFeaturesEXT* featureStruct = new VkPhysicalDeviceMeshShaderFeaturesEXT();
+                featureStruct->sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MESH_SHADER_FEATURES_EXT;
+                featureStruct->taskShader = VK_TRUE;
                 featureStruct->meshShader = VK_TRUE;
 
                 featureStructs.push_back( featureStruct );
 
                 setPNext(&pNext, &prevFeatureStruct, featureStruct, prevFeatureType);
-                prevFeatureType = SupportedDeviceFeature::eMeshShadingNV;
+                prevFeatureType = SupportedDeviceFeature::eMeshShading;
+                break;
+            }
+            case SupportedDeviceFeature::eTimelineSemaphore:
+            {
+                VkPhysicalDeviceTimelineSemaphoreFeatures* featureStruct = new VkPhysicalDeviceTimelineSemaphoreFeatures();
+                featureStruct->sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_TIMELINE_SEMAPHORE_FEATURES;
+                featureStruct->timelineSemaphore = VK_TRUE;
+
+                featureStructs.push_back( featureStruct );
+
+                setPNext(&pNext, &prevFeatureStruct, featureStruct, prevFeatureType);
+                prevFeatureType = SupportedDeviceFeature::eTimelineSemaphore;
+                break;
+            }
+            case SupportedDeviceFeature::eFillModeNonSolid:
+            {
+                // core features go in the chain too, pEnabledFeatures stays null
+                VkPhysicalDeviceFeatures2* featureStruct = new VkPhysicalDeviceFeatures2();
+                featureStruct->sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2;
+                featureStruct->features.fillModeNonSolid = VK_TRUE;
+
+                featureStructs.push_back( featureStruct );
+
+                setPNext(&pNext, &prevFeatureStruct, featureStruct, prevFeatureType);
+                prevFeatureType = SupportedDeviceFeature::eFillModeNonSolid;
                 break;
             }
             case SupportedDeviceFeature::eInvalidFeature:
@@ -122,4 +168,63 @@ vkmDeviceFeatureManager::~vkmDeviceFeatureManager()
     {
         deleteFeatureStruct(featureStructs[i], featureTypes[i]);
     }
-}
\ No newline at end of file
+}
+
+const char* vkmDeviceFeatureManager::getExtension(SupportedDeviceFeature feature)
+{
+    switch (feature)
+    {
+        case SupportedDeviceFeature::eMeshShading:
+            return VK_EXT_MESH_SHADER_EXTENSION_NAME;
+        default:
+            return nullptr;
+    }
+}
+
+bool vkmDeviceFeatureManager::isSupported(VkPhysicalDevice physicalDevice, SupportedDeviceFeature feature)
+{
+    VkPhysicalDeviceSynchronization2FeaturesKHR synchronization2Features {
+        .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_SYNCHRONIZATION_2_FEATURES_KHR,
+    };
+    VkPhysicalDeviceDescriptorIndexingFeatures descriptorIndexingFeatures {
+        .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DESCRIPTOR_INDEXING_FEATURES,
+    };
+    VkPhysicalDeviceMeshShaderFeaturesEXT meshShaderFeatures {
+        .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MESH_SHADER_FEATURES_EXT,
+    };
+    VkPhysicalDeviceTimelineSemaphoreFeatures timelineSemaphoreFeatures {
+        .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_TIMELINE_SEMAPHORE_FEATURES,
+    };
+    VkPhysicalDeviceFeatures2 features {
+        .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2,
+    };
+
+    // only the struct of the feature goes in the chain, the others may belong to unsupported extensions
+    switch (feature)
+    {
+        case SupportedDeviceFeature::eSynchronization2:  features.pNext = &synchronization2Features; break;
+        case SupportedDeviceFeature::eDescriptorIndexing: features.pNext = &descriptorIndexingFeatures; break;
+        case SupportedDeviceFeature::eMeshShading:        features.pNext = &meshShaderFeatures; break;
+        case SupportedDeviceFeature::eTimelineSemaphore:  features.pNext = &timelineSemaphoreFeatures; break;
+        default: break;
+    }
+
+    vkGetPhysicalDeviceFeatures2(physicalDevice, &features);
+
+    switch (feature)
+    {
+        case SupportedDeviceFeature::eSynchronization2:
+            return synchronization2Features.synchronization2;
+        case SupportedDeviceFeature::eDescriptorIndexing:
+            return descriptorIndexingFeatures.shaderSampledImageArrayNonUniformIndexing && descriptorIndexingFeatures.runtimeDescriptorArray &&
+                   descriptorIndexingFeatures.descriptorBindingPartiallyBound && descriptorIndexingFeatures.descriptorBindingVariableDescriptorCount;
+        case SupportedDeviceFeature::eMeshShading:
+            return meshShaderFeatures.taskShader && meshShaderFeatures.meshShader;
+        case SupportedDeviceFeature::eTimelineSemaphore:
+            return timelineSemaphoreFeatures.timelineSemaphore;
+        case SupportedDeviceFeature::eFillModeNonSolid:
+            return features.features.fillModeNonSolid;
+        default:
+            return false;
+    }
+}
@@ -16,6 +16,11 @@ public:
     ~vkmDeviceFeatureManager();
 
     void* getPNext() { return pNext; }
+
+    // Extension the feature belongs to, nullptr for core features
+    static const char* getExtension(SupportedDeviceFeature feature);
+    // The extension of the feature has to be supported
+    static bool isSupported(VkPhysicalDevice physicalDevice, SupportedDeviceFeature feature);
 };
 
 #endif // VKM_DEVICE_FEATURE_MANAGER
\ No newline at end of file
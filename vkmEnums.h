@@ -1,33 +1,45 @@
 #ifndef VKM_ENUMS_HPP
 #define VKM_ENUMS_HPP
 
+#include <stdint.h>
+
+constexpr uint32_t MAX_FRAMES_IN_FLIGHT = 2;
+
+// mips of the depth pyramid, enough for a 32768 pixels wide window
+constexpr uint32_t DEPTH_PYRAMID_MAX_LEVELS = 16;
+
 enum
 {
     QUEUE_GRAPHICS = 0,
+    QUEUE_TRANSFER = 1, // a transfer only family when the device has one, used by the mesh streamer
     QUEUE_COUNT
 };
 
+// Per frame objects are indexed with X_FRAME + frameIndex, frameIndex < MAX_FRAMES_IN_FLIGHT
+
 enum
 {
-    COMMAND_POOL_DEFAULT = 0,
-    COMMAND_POOL_COUNT
+    COMMAND_POOL_FRAME = 0,
+    COMMAND_POOL_COUNT = COMMAND_POOL_FRAME + MAX_FRAMES_IN_FLIGHT
 };
 
 enum
 {
-    COMMAND_BUFFER_DEFAULT = 0,
-    COMMAND_BUFFER_COUNT
+    COMMAND_BUFFER_FRAME = 0,
+    COMMAND_BUFFER_COUNT = COMMAND_BUFFER_FRAME + MAX_FRAMES_IN_FLIGHT
 };
 
 enum
 {
-    SEMAPHORE_COUNT
+    SEMAPHORE_IMAGE_ACQUIRED = 0,
+    SEMAPHORE_RENDER_FINISHED = SEMAPHORE_IMAGE_ACQUIRED + MAX_FRAMES_IN_FLIGHT,
+    SEMAPHORE_COUNT = SEMAPHORE_RENDER_FINISHED + MAX_FRAMES_IN_FLIGHT
 };
 
 enum
 {
-    FENCE_IMAGE_ACQUIRE = 0,
-    FENCE_COUNT
+    FENCE_FRAME = 0, // signaled once the frame's submission is done
+    FENCE_COUNT = FENCE_FRAME + MAX_FRAMES_IN_FLIGHT
 };
 
 enum
@@ -41,6 +53,8 @@ enum
 {
     DESCRIPTOR_SET_LAYOUT_DEFAULT_0 = 0,
     DESCRIPTOR_SET_LAYOUT_DEFAULT_1 = 1,
+    DESCRIPTOR_SET_LAYOUT_DEFAULT_2 = 2,
+    DESCRIPTOR_SET_LAYOUT_DEPTH_REDUCE = 3,
     DESCRIPTOR_SET_LAYOUT_COUNT
 };
 
@@ -48,7 +62,9 @@ enum
 {
     DESCRIPTOR_SET_FRAME    = 0,
     DESCRIPTOR_SET_MATERIAL = 1,
-    DESCRIPTOR_SET_COUNT
+    DESCRIPTOR_SET_GEOMETRY = 2, // storage buffers the task and mesh shaders fetch meshlets, bounds and vertices from
+    DESCRIPTOR_SET_DEPTH_REDUCE = 3, // + level, reads the level above (the depth attachment for level 0) and writes the level
+    DESCRIPTOR_SET_COUNT = DESCRIPTOR_SET_DEPTH_REDUCE + DEPTH_PYRAMID_MAX_LEVELS
 };
 
 enum
@@ -57,15 +73,40 @@ enum
     BUFFER_GEOMETRY_SSBO = 1,
     BUFFER_OBJECT_INDEX  = 2,
     BUFFER_OBJECT_VERTEX = 3,
-    BUFFER_PER_FRAME_UBO = 4,
-    BUFFER_LIGHT_UBO     = 5,
-    BUFFER_MATERIAL_UBO  = 6,
+    BUFFER_UNIFORM_RING  = 4, // PerFrameUBO, LightUBO and PerMatUBO of every frame in flight
+    BUFFER_OBJECT_POSITION = 5, // only used when the mesh stores positions in their own stream
+    BUFFER_OBJECT_MESHLET  = 6, // full mesh meshlets, one mesh shader workgroup each
+    BUFFER_OBJECT_MESHLET_BOUNDS = 7, // one MeshletBounds per meshlet, for culling
+    BUFFER_CULLING_STATS = 8, // CullingStats of every frame in flight, host visible, written by the culling shaders
+    BUFFER_OBJECT_MESHLET_INDEX = 9, // full mesh indices meshlet by meshlet, drawn indirectly by the vertex path with occlusion culling
+    BUFFER_MESHLET_VISIBILITY   = 10, // one bit per meshlet, set when it was visible in the last frame
+    BUFFER_MESHLET_DRAWS        = 11, // draw counts and indexed draws of both occlusion culling phases, written by meshletcull.comp
     BUFFER_COUNT
 };
 
+enum
+{
+    PIPELINE_SCENE           = 0,
+    PIPELINE_SCENE_WIREFRAME = 1,
+    PIPELINE_SCENE_MESH      = 2, // same scene through the mesh shader path
+    PIPELINE_SCENE_MESH_WIREFRAME = 3,
+    PIPELINE_DEPTH_REDUCE    = 4, // compute, one depth pyramid level from the one above
+    PIPELINE_MESHLET_CULL    = 5, // compute, mesh.task culling for the vertex path
+    PIPELINE_COUNT
+};
+
+// Render passes of occlusion culling, compatible with the main one so they share its pipelines and framebuffers
+enum
+{
+    OCCLUSION_PASS_EARLY = 0, // clears, then keeps color and depth for the depth pyramid and the late pass
+    OCCLUSION_PASS_LATE  = 1, // loads them and presents
+    OCCLUSION_PASS_COUNT
+};
+
 enum
 {
     ATTACHMENT_DEPTH = 0,
+    ATTACHMENT_DEPTH_PYRAMID = 1, // max depth of the early pass, the view covers every level
     ATTACHMENT_COUNT
 };
 
@@ -77,7 +118,8 @@ enum
 enum
 {
     IMAGE_VIEW_DEPTH = 0,
-    IMAGE_VIEW_COUNT
+    IMAGE_VIEW_DEPTH_PYRAMID_LEVEL = 1, // + level
+    IMAGE_VIEW_COUNT = IMAGE_VIEW_DEPTH_PYRAMID_LEVEL + DEPTH_PYRAMID_MAX_LEVELS
 };
 
 #endif // VKM_ENUMS_HPP
\ No newline at end of file
@@ -1,4 +1,7 @@
 
+#include <algorithm>
+#include <string.h>
+
 #include "vkmInit.hpp"
 #include "Defines.hpp"
 #include "vkmDeviceFeatureManager.hpp"
@@ -31,7 +34,7 @@ static VkSurfaceKHR createSurface(VkInstance instance, GLFWwindow *window)
     return surface;
 }
 
-static VkPhysicalDevice selectPhysicalDevice(VkInstance instance)
+static VkPhysicalDevice selectPhysicalDevice(VkInstance instance, uint32_t physicalDeviceIndex)
 {
     uint32_t numPhysicalDevice = 0;
     vkEnumeratePhysicalDevices(instance, &numPhysicalDevice, nullptr);
@@ -46,7 +49,9 @@ static VkPhysicalDevice selectPhysicalDevice(VkInstance instance)
         LOG("%i : %s\n", i, props.deviceName);
     }
 
-    const uint32_t physicalDeviceIndex = 2u;
+    if (physicalDeviceIndex >= numPhysicalDevice)
+        EXIT("No physical device " << physicalDeviceIndex << ", there are " << numPhysicalDevice);
+
     LOG("Using Physical Device %u\n\n", physicalDeviceIndex);
 
     return physicalDevices[physicalDeviceIndex];
@@ -119,19 +124,97 @@ static std::vector<uint32_t> selectQueueFamilyIndices(VkPhysicalDevice physicalD
     return queueFamilyIndices;
 }
 
-static VkDevice createDevice(VkPhysicalDevice physicalDevice, const std::vector<uint32_t> &queueFamilyIndices, const std::vector<const char*> &requestedDeviceExtensions, const std::vector<SupportedDeviceFeature>& requestedDeviceFeatures)
+// Index of each requested queue within its family. Requests that share a family get a queue of
+// their own while the family has enough of them, and share its last queue after that.
+static std::vector<uint32_t> selectQueueIndices(VkPhysicalDevice physicalDevice, const std::vector<uint32_t> &queueFamilyIndices)
 {
-    const float q_priority = 1.0f;
+    uint32_t numQueueFamilyProperties = 0;
+    vkGetPhysicalDeviceQueueFamilyProperties(physicalDevice, &numQueueFamilyProperties, nullptr);
+    std::vector<VkQueueFamilyProperties> queueFamilyProperties(numQueueFamilyProperties);
+    vkGetPhysicalDeviceQueueFamilyProperties(physicalDevice, &numQueueFamilyProperties, queueFamilyProperties.data());
+
+    std::vector<uint32_t> usedQueueCounts(numQueueFamilyProperties, 0);
+    std::vector<uint32_t> queueIndices(queueFamilyIndices.size(), 0);
+
+    for (uint32_t i = 0; i < queueFamilyIndices.size(); ++i)
+    {
+        const uint32_t family = queueFamilyIndices[i];
+        queueIndices[i] = std::min(usedQueueCounts[family]++, queueFamilyProperties[family].queueCount - 1);
+    }
+
+    return queueIndices;
+}
+
+// The requested extensions, then the optional ones the device supports
+static std::vector<const char*> selectDeviceExtensions(VkPhysicalDevice physicalDevice, const std::vector<const char*> &requestedExtensions, const std::vector<const char*> &optionalExtensions)
+{
+    uint32_t numExtensionProperties = 0;
+    VK_CHECK(vkEnumerateDeviceExtensionProperties(physicalDevice, nullptr, &numExtensionProperties, nullptr));
+    std::vector<VkExtensionProperties> extensionProperties(numExtensionProperties);
+    VK_CHECK(vkEnumerateDeviceExtensionProperties(physicalDevice, nullptr, &numExtensionProperties, extensionProperties.data()));
+
+    std::vector<const char*> extensions = requestedExtensions;
+    for (const char* extension : optionalExtensions)
+    {
+        const bool supported = std::any_of(extensionProperties.begin(), extensionProperties.end(), [&](const VkExtensionProperties& properties) { return strcmp(properties.extensionName, extension) == 0; });
+        if (supported)
+            extensions.push_back(extension);
+        else
+            LOG("Optional device extension %s is not supported\n", extension);
+    }
+
+    return extensions;
+}
+
+// The requested features, then the optional ones the device supports with their extension enabled
+static std::vector<SupportedDeviceFeature> selectDeviceFeatures(VkPhysicalDevice physicalDevice, const std::vector<const char*> &extensions, const std::vector<SupportedDeviceFeature> &requestedFeatures, const std::vector<SupportedDeviceFeature> &optionalFeatures)
+{
+    std::vector<SupportedDeviceFeature> features = requestedFeatures;
+    for (const SupportedDeviceFeature feature : optionalFeatures)
+    {
+        const char* extension = vkmDeviceFeatureManager::getExtension(feature);
+        const bool extensionEnabled = (extension == nullptr) || std::any_of(extensions.begin(), extensions.end(), [&](const char* enabled) { return strcmp(enabled, extension) == 0; });
+
+        if (extensionEnabled && vkmDeviceFeatureManager::isSupported(physicalDevice, feature))
+            features.push_back(feature);
+        else
+            LOG("Optional device feature %u is not supported\n", static_cast<uint32_t>(feature));
+    }
+
+    return features;
+}
+
+static VkDevice createDevice(VkPhysicalDevice physicalDevice, const std::vector<uint32_t> &queueFamilyIndices, const std::vector<uint32_t> &queueIndices, const std::vector<const char*> &requestedDeviceExtensions, const std::vector<SupportedDeviceFeature>& requestedDeviceFeatures)
+{
+    // a family may only appear once, with as many queues as the requests for it use
+    std::vector<uint32_t> families;
+    std::vector<uint32_t> familyQueueCounts;
+    for (uint32_t i = 0; i < queueFamilyIndices.size(); ++i)
+    {
+        const auto it = std::find(families.begin(), families.end(), queueFamilyIndices[i]);
+        if (it == families.end())
+        {
+            families.push_back(queueFamilyIndices[i]);
+            familyQueueCounts.push_back(queueIndices[i] + 1);
+        }
+        else
+        {
+            uint32_t& queueCount = familyQueueCounts[it - families.begin()];
+            queueCount = std::max(queueCount, queueIndices[i] + 1);
+        }
+    }
+
+    const std::vector<float> q_priorities(queueFamilyIndices.size(), 1.0f);
 
     std::vector<VkDeviceQueueCreateInfo> queueCreateInfos;
-    queueCreateInfos.reserve(queueFamilyIndices.size());
-    for (const uint32_t idx : queueFamilyIndices)
+    queueCreateInfos.reserve(families.size());
+    for (uint32_t i = 0; i < families.size(); ++i)
     {
         const VkDeviceQueueCreateInfo queueCreateInfo{
             .sType = VK_STRUCTURE_TYPE_DEVICE_QUEUE_CREATE_INFO,
-            .queueFamilyIndex = idx,
-            .queueCount = 1u,
-            .pQueuePriorities = &q_priority};
+            .queueFamilyIndex = families[i],
+            .queueCount = familyQueueCounts[i],
+            .pQueuePriorities = q_priorities.data()};
 
         queueCreateInfos.push_back(queueCreateInfo);
     }
@@ -154,13 +237,13 @@ static VkDevice createDevice(VkPhysicalDevice physicalDevice, const std::vector<
     return device;
 }
 
-static std::vector<VkQueue> getQueues(VkDevice device, const std::vector<uint32_t> &queueFamilyIndices)
+static std::vector<VkQueue> getQueues(VkDevice device, const std::vector<uint32_t> &queueFamilyIndices, const std::vector<uint32_t> &queueIndices)
 {
     std::vector<VkQueue> queues(queueFamilyIndices.size(), VK_NULL_HANDLE);
 
     for (uint32_t i = 0; i < queueFamilyIndices.size(); ++i)
     {
-        vkGetDeviceQueue(device, queueFamilyIndices[i], 0, &queues[i]);
+        vkGetDeviceQueue(device, queueFamilyIndices[i], queueIndices[i], &queues[i]);
     }
 
     return queues;
@@ -358,25 +441,46 @@ VulkanResources vkmInit(const vkmInitParams& params)
     VulkanResources resources {};
     resources.instance = createInstance(params.requestedInstanceExtensions, params.requestedInstanceLayers);
     resources.surface = createSurface(resources.instance, params.window);
-    resources.physicalDevice = selectPhysicalDevice(resources.instance);
+    resources.physicalDevice = selectPhysicalDevice(resources.instance, params.physicalDeviceIndex);
     resources.queueFamilyIndices = selectQueueFamilyIndices(resources.physicalDevice, resources.surface, params.requestedQueueTypes);
-    resources.device = createDevice(resources.physicalDevice, resources.queueFamilyIndices, params.requestedDeviceExtensions, params.requestedDeviceFeatures);
-    resources.queues = getQueues(resources.device, resources.queueFamilyIndices);
+    const std::vector<uint32_t> queueIndices = selectQueueIndices(resources.physicalDevice, resources.queueFamilyIndices);
+    resources.enabledDeviceExtensions = selectDeviceExtensions(resources.physicalDevice, params.requestedDeviceExtensions, params.optionalDeviceExtensions);
+    resources.enabledDeviceFeatures = selectDeviceFeatures(resources.physicalDevice, resources.enabledDeviceExtensions, params.requestedDeviceFeatures, params.optionalDeviceFeatures);
+    resources.device = createDevice(resources.physicalDevice, resources.queueFamilyIndices, queueIndices, resources.enabledDeviceExtensions, resources.enabledDeviceFeatures);
+    resources.queues = getQueues(resources.device, resources.queueFamilyIndices, queueIndices);
     resources.swapchain = createSwapchain(resources.device, resources.physicalDevice, resources.surface, params.requestedSwapchainImageCount, params.requestedSwapchainFormat, { params.windowWidth, params.windowHeight }, params.requestedSwapchainPresentMode);
 
     vkGetPhysicalDeviceMemoryProperties(resources.physicalDevice, &resources.physicalDeviceMemoryProperties);
+    initDeviceAllocator(resources.device, resources.physicalDevice);
 
     return resources;
 }
 
+bool vkmIsDeviceExtensionEnabled(const VulkanResources& resources, const char* extension)
+{
+    return std::any_of(resources.enabledDeviceExtensions.begin(), resources.enabledDeviceExtensions.end(), [&](const char* enabled) { return strcmp(enabled, extension) == 0; });
+}
+
+bool vkmIsDeviceFeatureEnabled(const VulkanResources& resources, SupportedDeviceFeature feature)
+{
+    return std::find(resources.enabledDeviceFeatures.begin(), resources.enabledDeviceFeatures.end(), feature) != resources.enabledDeviceFeatures.end();
+}
+
 void vkmDestroy(VulkanResources& resources)
 {
     for (Buffer& buffer : resources.buffers)
         destroyBuffer(resources.device, buffer);
 
+    for (VkImageView imageView : resources.imageViews)
+        vkDestroyImageView(resources.device, imageView, nullptr);
+
     for (Attachment& attachment : resources.attachments)
         destroyAttachment(resources.device, attachment);
 
+    vkDestroySampler(resources.device, resources.depthPyramidSampler, nullptr);
+
+    destroyDeviceAllocator();
+
     for (size_t i = 0; i < DESCRIPTOR_SET_LAYOUT_COUNT; ++i)
         vkDestroyDescriptorSetLayout(resources.device, resources.descriptorSetLayouts[i], nullptr);
 
@@ -393,12 +497,15 @@ void vkmDestroy(VulkanResources& resources)
         vkDestroyFence(resources.device, resources.fences[i], nullptr);
 
     vkDestroyPipelineLayout(resources.device, resources.pipelineLayout, nullptr);
-    vkDestroyPipeline(resources.device, resources.pipeline, nullptr);
+    vkDestroyPipelineLayout(resources.device, resources.depthReducePipelineLayout, nullptr);
+    vkDestroyPipelineCache(resources.device, resources.pipelineCache, nullptr);
 
     for (size_t i = 0; i < resources.framebuffers.size(); ++i)
         vkDestroyFramebuffer(resources.device, resources.framebuffers[i], nullptr);
 
     vkDestroyRenderPass(resources.device, resources.renderPass, nullptr);
+    for (VkRenderPass renderPass : resources.occlusionRenderPasses)
+        vkDestroyRenderPass(resources.device, renderPass, nullptr);
 
     for (uint32_t i = 0; i < resources.swapchain.images.size(); ++i)
         vkDestroyImageView(resources.device, resources.swapchain.imageViews[i], nullptr);
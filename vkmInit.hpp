@@ -8,20 +8,15 @@
 
 #include "vkmEnums.h"
 #include "Resources.hpp"
-
-struct Meshlet
-{
-    uint32_t vertices[64];
-    uint8_t indices[126];
-    uint8_t triangleCount;
-    uint8_t vertexCount;
-};
+#include "Meshlet.hpp"
 
 enum class SupportedDeviceFeature
 {
     eSynchronization2   = 0,
     eDescriptorIndexing = 1,
-    eMeshShadingNV      = 2,
+    eMeshShading        = 2, // VK_EXT_mesh_shader, task and mesh stages
+    eTimelineSemaphore  = 3,
+    eFillModeNonSolid   = 4, // core feature, wireframe pipelines
     eInvalidFeature     
 };
 
@@ -31,12 +26,18 @@ struct vkmInitParams
     uint32_t windowWidth;
     uint32_t windowHeight;
 
+    uint32_t physicalDeviceIndex; // in vkEnumeratePhysicalDevices order, all of them are logged
+
     std::vector<const char *> requestedInstanceExtensions;
     std::vector<const char *> requestedInstanceLayers;
 
     std::vector<const char *>           requestedDeviceExtensions;
     std::vector<SupportedDeviceFeature> requestedDeviceFeatures;
 
+    // enabled only when the physical device supports them, VulkanResources lists what was enabled
+    std::vector<const char *>           optionalDeviceExtensions;
+    std::vector<SupportedDeviceFeature> optionalDeviceFeatures;
+
     std::vector<VkQueueFlagBits> requestedQueueTypes;
     std::vector<float> requestedQueuePriorities;
 
@@ -62,15 +63,20 @@ struct VulkanResources
     VkPhysicalDevice physicalDevice;
     VkPhysicalDeviceMemoryProperties physicalDeviceMemoryProperties;
     VkDevice device;
+    std::vector<const char *> enabledDeviceExtensions;          // the requested ones, then the supported optional ones
+    std::vector<SupportedDeviceFeature> enabledDeviceFeatures;
     std::vector<uint32_t> queueFamilyIndices;
     std::vector<VkQueue> queues;
     Swapchain swapchain;
 
     // App Specific
     VkRenderPass renderPass = VK_NULL_HANDLE;
+    VkRenderPass occlusionRenderPasses[OCCLUSION_PASS_COUNT] {};
     std::vector<VkFramebuffer> framebuffers;
-    VkPipeline pipeline = VK_NULL_HANDLE;
+    VkPipelineCache pipelineCache = VK_NULL_HANDLE; // shared by every pipeline creation, saved on exit
     VkPipelineLayout pipelineLayout = VK_NULL_HANDLE;
+    VkPipelineLayout depthReducePipelineLayout = VK_NULL_HANDLE;
+    VkSampler depthPyramidSampler = VK_NULL_HANDLE; // nearest, the shaders reduce texels themselves
     VkCommandPool commandPools[COMMAND_POOL_COUNT];
     VkCommandBuffer commandBuffers[COMMAND_BUFFER_COUNT];
     VkDescriptorPool descriptorPools[DESCRIPTOR_POOL_COUNT];
@@ -81,7 +87,7 @@ struct VulkanResources
     Buffer buffers[BUFFER_COUNT];
     uint32_t currentSwapchainImageIdx = 0;
     Attachment attachments[ATTACHMENT_COUNT];
-    VkImageView imageViews[IMAGE_VIEW_COUNT];
+    VkImageView imageViews[IMAGE_VIEW_COUNT] {};
     std::vector<Meshlet> meshlets[BUFFER_COUNT];
 };
 
@@ -89,4 +95,7 @@ struct VulkanResources
 VulkanResources vkmInit(const vkmInitParams& params);
 void vkmDestroy(VulkanResources& resources);
 
+bool vkmIsDeviceExtensionEnabled(const VulkanResources& resources, const char* extension);
+bool vkmIsDeviceFeatureEnabled(const VulkanResources& resources, SupportedDeviceFeature feature);
+
 #endif // VKM_INIT_HPP
\ No newline at end of file